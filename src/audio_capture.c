@@ -6,8 +6,10 @@
 
 #include "audio_capture.h"
 #include "audio_save.h"
+#include "sample_convert.h"
 
 HRESULT InitializeAudioCapture(AudioCaptureContext *ctx) {
+    DWORD streamFlags = ctx->microphone ? 0 : AUDCLNT_STREAMFLAGS_LOOPBACK;
     HRESULT hr;
 
     // Initialize COM library
@@ -19,8 +21,9 @@ HRESULT InitializeAudioCapture(AudioCaptureContext *ctx) {
                           &IID_IMMDeviceEnumerator, (void**)&ctx->pEnumerator);
     if (FAILED(hr)) return hr;
 
-    // Get the default audio render device
-    hr = ctx->pEnumerator->lpVtbl->GetDefaultAudioEndpoint(ctx->pEnumerator, eRender, eConsole, &ctx->pDevice);
+    // Get the default audio render device, or the default capture device for a microphone
+    hr = ctx->pEnumerator->lpVtbl->GetDefaultAudioEndpoint(ctx->pEnumerator, ctx->microphone ? eCapture : eRender,
+                                                           eConsole, &ctx->pDevice);
     if (FAILED(hr)) return hr;
 
     // Activate the IAudioClient interface
@@ -36,12 +39,35 @@ HRESULT InitializeAudioCapture(AudioCaptureContext *ctx) {
     printf("Channels: %d\n", ctx->pwfx->nChannels);
     printf("Bits per Sample: %d\n", ctx->pwfx->wBitsPerSample);
 
-    // Initialize the audio client in loopback mode
-    hr = ctx->pAudioClient->lpVtbl->Initialize(ctx->pAudioClient,
-                                               AUDCLNT_SHAREMODE_SHARED,
-                                               AUDCLNT_STREAMFLAGS_LOOPBACK,
-                                               0, 0, ctx->pwfx, NULL);
-    if (FAILED(hr)) return hr;
+    // Initialize the audio client (in loopback mode for the render endpoint), event-driven if requested
+    if (ctx->mode == CAPTURE_MODE_EVENT) {
+        hr = ctx->pAudioClient->lpVtbl->Initialize(ctx->pAudioClient,
+                                                   AUDCLNT_SHAREMODE_SHARED,
+                                                   streamFlags | AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+                                                   0, 0, ctx->pwfx, NULL);
+        if (SUCCEEDED(hr)) {
+            ctx->hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+            if (!ctx->hEvent) return HRESULT_FROM_WIN32(GetLastError());
+            hr = ctx->pAudioClient->lpVtbl->SetEventHandle(ctx->pAudioClient, ctx->hEvent);
+            if (FAILED(hr)) return hr;
+        } else {
+            // A failed Initialize leaves the client unusable; activate a fresh one and poll instead
+            printf("Event-driven capture unavailable (0x%08lx), falling back to polling\n", hr);
+            ctx->pAudioClient->lpVtbl->Release(ctx->pAudioClient);
+            ctx->pAudioClient = NULL;
+            hr = ctx->pDevice->lpVtbl->Activate(ctx->pDevice, &IID_IAudioClient, CLSCTX_ALL, NULL, (void**)&ctx->pAudioClient);
+            if (FAILED(hr)) return hr;
+            ctx->mode = CAPTURE_MODE_POLL;
+        }
+    }
+
+    if (ctx->mode == CAPTURE_MODE_POLL) {
+        hr = ctx->pAudioClient->lpVtbl->Initialize(ctx->pAudioClient,
+                                                   AUDCLNT_SHAREMODE_SHARED,
+                                                   streamFlags,
+                                                   0, 0, ctx->pwfx, NULL);
+        if (FAILED(hr)) return hr;
+    }
 
     // Get the capture client
     hr = ctx->pAudioClient->lpVtbl->GetService(ctx->pAudioClient, &IID_IAudioCaptureClient, (void**)&ctx->pCaptureClient);
@@ -72,7 +98,8 @@ void CleanupAudioCapture(AudioCaptureContext *ctx) {
     if (ctx->pEnumerator) ctx->pEnumerator->lpVtbl->Release(ctx->pEnumerator);
     if (ctx->pwfx) CoTaskMemFree(ctx->pwfx);
     if (ctx->captureBuffer) free(ctx->captureBuffer);
-    if (ctx->file) fclose(ctx->file);
+    if (ctx->writer) WavWriterFinalize(ctx->writer);
+    if (ctx->hEvent) CloseHandle(ctx->hEvent);
     CoUninitialize();
 }
 
@@ -86,10 +113,27 @@ HRESULT CaptureAudioData(AudioCaptureContext *ctx) {
     BYTE *pData;
     DWORD flags;
     int capturing = 1;
+    WavFormat deviceFormat;
+    SampleFormat inSamples;
+    SampleFormat outSamples;
+    SampleConverter converter;
+
+    // Pick the converter from the mix format to the writer's format once per stream
+    WavFormatFromWaveFormat(&deviceFormat, ctx->pwfx);
+    if (SampleFormatFromWav(&deviceFormat, &inSamples) != 0 ||
+        SampleFormatFromWav(&ctx->writer->format, &outSamples) != 0 ||
+        SampleConverterInit(&converter, &inSamples, &outSamples) != 0 ||
+        SampleFormatFrameBytes(&outSamples) > ctx->blockAlign) {
+        return E_INVALIDARG;
+    }
 
     while (capturing) {
-        // Sleep for a while
-        Sleep(10);
+        // Wait for the endpoint to signal a packet, or poll on a timer
+        if (ctx->hEvent) {
+            WaitForSingleObject(ctx->hEvent, CAPTURE_POLL_INTERVAL_MS * 10);
+        } else {
+            Sleep(CAPTURE_POLL_INTERVAL_MS);
+        }
 
         // Get the available data size
         hr = ctx->pCaptureClient->lpVtbl->GetNextPacketSize(ctx->pCaptureClient, &packetLength);
@@ -109,29 +153,13 @@ HRESULT CaptureAudioData(AudioCaptureContext *ctx) {
                 memset(pData, 0, totalBytes);
             }
 
-            // Convert 32-bit float to 16-bit PCM
-            if (ctx->pwfx->wBitsPerSample == 32) {
-                int sampleCount = frameCount * ctx->pwfx->nChannels;
-                short *convertedBuffer = (short *)malloc(sampleCount * sizeof(short));
-                float *floatData = (float *)pData;
-
-                for (int i = 0; i < sampleCount; ++i) {
-                    float sample = floatData[i];
-                    if (sample > 1.0f) sample = 1.0f;
-                    if (sample < -1.0f) sample = -1.0f;
-                    convertedBuffer[i] = (short)(sample * 32767);
-                }
-
-                // Write 16-bit PCM data to file
-                fwrite(convertedBuffer, sizeof(short), sampleCount, ctx->file);
-                ctx->dataLength += sampleCount * sizeof(short);
-
-                free(convertedBuffer);
+            if (inSamples.type == outSamples.type) {
+                WavWriterAppend(ctx->writer, pData, frameCount);
             } else {
-                // Write directly if 16-bit PCM
-                fwrite(pData, totalBytes, 1, ctx->file);
-                ctx->dataLength += totalBytes;
+                SampleConverterRun(&converter, ctx->captureBuffer, pData, frameCount, NULL);
+                WavWriterAppend(ctx->writer, ctx->captureBuffer, frameCount);
             }
+            ctx->dataLength += (UINT64)frameCount * SampleFormatFrameBytes(&outSamples);
 
             // Release the buffer
             hr = ctx->pCaptureClient->lpVtbl->ReleaseBuffer(ctx->pCaptureClient, frameCount);
@@ -154,4 +182,125 @@ HRESULT CaptureAudioData(AudioCaptureContext *ctx) {
     ctx->pAudioClient->lpVtbl->Stop(ctx->pAudioClient);
 
     return hr;
-}
\ No newline at end of file
+}
+
+typedef struct {
+    CaptureSource base;
+    AudioCaptureContext ctx;
+} WasapiCaptureSource;
+
+static int WasapiStart(CaptureSource *src) {
+    WasapiCaptureSource *w = (WasapiCaptureSource *)src;
+    return FAILED(StartAudioCapture(&w->ctx)) ? -1 : 0;
+}
+
+static int WasapiWait(CaptureSource *src, uint32_t timeoutMs) {
+    WasapiCaptureSource *w = (WasapiCaptureSource *)src;
+
+    if (!w->ctx.hEvent) {
+        Sleep(CAPTURE_POLL_INTERVAL_MS);
+        return 1;
+    }
+
+    switch (WaitForSingleObject(w->ctx.hEvent, timeoutMs)) {
+    case WAIT_OBJECT_0: return 1;
+    case WAIT_TIMEOUT: return 0;
+    default: return -1;
+    }
+}
+
+static int WasapiReadPacket(CaptureSource *src, CapturePacket *packet) {
+    WasapiCaptureSource *w = (WasapiCaptureSource *)src;
+    IAudioCaptureClient *client = w->ctx.pCaptureClient;
+    UINT32 packetLength = 0;
+    UINT64 qpcPosition = 0;
+    BYTE *pData;
+    DWORD flags;
+    HRESULT hr;
+
+    hr = client->lpVtbl->GetNextPacketSize(client, &packetLength);
+    if (FAILED(hr)) return -1;
+    if (packetLength == 0) return 0;
+
+    hr = client->lpVtbl->GetBuffer(client, &pData, &packetLength, &flags, NULL, &qpcPosition);
+    if (FAILED(hr)) return -1;
+
+    packet->data = (flags & AUDCLNT_BUFFERFLAGS_SILENT) ? NULL : pData;
+    packet->frames = packetLength;
+    packet->flags = 0;
+    if (flags & AUDCLNT_BUFFERFLAGS_SILENT) packet->flags |= CAPTURE_PACKET_SILENT;
+    if (flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) packet->flags |= CAPTURE_PACKET_DISCONTINUITY;
+    if (flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) packet->flags |= CAPTURE_PACKET_TIMESTAMP_ERROR;
+
+    // QPC position is in 100 ns units on the same clock as PlatformNowNs
+    packet->timestampNs = (flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) ? 0 : qpcPosition * 100;
+    return 1;
+}
+
+static int WasapiReleasePacket(CaptureSource *src, CapturePacket *packet) {
+    WasapiCaptureSource *w = (WasapiCaptureSource *)src;
+    HRESULT hr = w->ctx.pCaptureClient->lpVtbl->ReleaseBuffer(w->ctx.pCaptureClient, packet->frames);
+    return FAILED(hr) ? -1 : 0;
+}
+
+static void WasapiStop(CaptureSource *src) {
+    WasapiCaptureSource *w = (WasapiCaptureSource *)src;
+    w->ctx.pAudioClient->lpVtbl->Stop(w->ctx.pAudioClient);
+}
+
+static void WasapiDestroy(CaptureSource *src) {
+    WasapiCaptureSource *w = (WasapiCaptureSource *)src;
+    CleanupAudioCapture(&w->ctx);
+    free(w);
+}
+
+static const CaptureSourceVtbl WasapiVtbl = {
+    "wasapi-loopback",
+    WasapiStart,
+    WasapiWait,
+    WasapiReadPacket,
+    WasapiReleasePacket,
+    WasapiStop,
+    WasapiDestroy
+};
+
+static const CaptureSourceVtbl WasapiMicrophoneVtbl = {
+    "wasapi-microphone",
+    WasapiStart,
+    WasapiWait,
+    WasapiReadPacket,
+    WasapiReleasePacket,
+    WasapiStop,
+    WasapiDestroy
+};
+
+static HRESULT CreateWasapiSource(CaptureMode mode, int microphone, CaptureSource **out) {
+    WasapiCaptureSource *w = (WasapiCaptureSource *)calloc(1, sizeof(*w));
+    WavFormat format;
+    HRESULT hr;
+
+    if (!w) return E_OUTOFMEMORY;
+
+    w->ctx.mode = mode;
+    w->ctx.microphone = microphone;
+    hr = InitializeAudioCapture(&w->ctx);
+    if (FAILED(hr)) {
+        CleanupAudioCapture(&w->ctx);
+        free(w);
+        return hr;
+    }
+
+    WavFormatFromWaveFormat(&format, w->ctx.pwfx);
+    CaptureSourceInitBase(&w->base, microphone ? &WasapiMicrophoneVtbl : &WasapiVtbl, &format, w->ctx.mode);
+
+    *out = &w->base;
+    return S_OK;
+}
+
+HRESULT CreateWasapiCaptureSource(CaptureMode mode, CaptureSource **out) {
+    return CreateWasapiSource(mode, 0, out);
+}
+
+HRESULT CreateWasapiMicrophoneSource(CaptureMode mode, CaptureSource **out) {
+    return CreateWasapiSource(mode, 1, out);
+}
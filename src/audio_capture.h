@@ -6,6 +6,10 @@
 #include <mmdeviceapi.h>
 #include <audioclient.h>
 #include <stdio.h>
+#include "wav_writer.h"
+#include "capture_source.h"
+
+#define CAPTURE_POLL_INTERVAL_MS 10
 
 typedef struct {
     IMMDeviceEnumerator *pEnumerator;
@@ -13,13 +17,16 @@ typedef struct {
     IAudioClient *pAudioClient;
     IAudioCaptureClient *pCaptureClient;
     WAVEFORMATEX *pwfx;
-    FILE *file;
+    WavWriter *writer;
     UINT32 bufferFrameCount;
     UINT32 bytesPerSample;
     UINT32 blockAlign;
     UINT32 captureBufferSize;
     BYTE *captureBuffer;
-    DWORD dataLength;
+    UINT64 dataLength;
+    CaptureMode mode;
+    int microphone;               // Default capture endpoint instead of render loopback
+    HANDLE hEvent;
 } AudioCaptureContext;
 
 HRESULT InitializeAudioCapture(AudioCaptureContext *ctx);
@@ -27,4 +34,10 @@ void CleanupAudioCapture(AudioCaptureContext *ctx);
 HRESULT StartAudioCapture(AudioCaptureContext *ctx);
 HRESULT CaptureAudioData(AudioCaptureContext *ctx);
 
+// Default render endpoint in loopback, as a CaptureSource. Event mode falls back
+// to polling when the endpoint refuses AUDCLNT_STREAMFLAGS_EVENTCALLBACK.
+HRESULT CreateWasapiCaptureSource(CaptureMode mode, CaptureSource **out);
+// Default capture endpoint (the microphone), as a CaptureSource.
+HRESULT CreateWasapiMicrophoneSource(CaptureMode mode, CaptureSource **out);
+
 #endif // AUDIO_CAPTURE_H
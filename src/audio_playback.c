@@ -0,0 +1,162 @@
+// audio_playback.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mmsystem.h>
+
+#include "audio_playback.h"
+
+typedef struct {
+    OutputSink base;
+    HWAVEOUT hWaveOut;
+    HANDLE hEvent;
+    WAVEHDR headers[OUTPUT_SINK_MAX_BLOCKS];
+    SinkQueue queue;
+} WaveOutSink;
+
+static void PrintWaveOutError(const char *what, MMRESULT result) {
+    char errorMsg[256];
+    waveOutGetErrorTextA(result, errorMsg, sizeof(errorMsg));
+    printf("%s failed. Error: %s (code %d)\n", what, errorMsg, result);
+}
+
+static int WaveOutSinkOpen(OutputSink *sink, const WavFormat *format, PlaybackBlock *blocks, uint32_t blockCount) {
+    WaveOutSink *w = (WaveOutSink *)sink;
+    WAVEFORMATEX wfx = {0};
+    MMRESULT result;
+    int retryCount = 0;
+
+    if (blockCount > OUTPUT_SINK_MAX_BLOCKS) return -1;
+
+    sink->format = *format;
+    sink->blockAlign = (uint16_t)(format->channels * (format->bitsPerSample / 8));
+
+    wfx.wFormatTag = format->formatTag;
+    wfx.nChannels = format->channels;
+    wfx.nSamplesPerSec = format->sampleRate;
+    wfx.wBitsPerSample = format->bitsPerSample;
+    wfx.nBlockAlign = sink->blockAlign;
+    wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * wfx.nBlockAlign;
+
+    printf("Opening waveOut: channels=%d, sample rate=%d, bits per sample=%d\n",
+           wfx.nChannels, (int)wfx.nSamplesPerSec, wfx.wBitsPerSample);
+
+    do {
+        result = waveOutOpen(&w->hWaveOut, WAVE_MAPPER, &wfx, (DWORD_PTR)w->hEvent, 0, CALLBACK_EVENT);
+        if (result != MMSYSERR_NOERROR) {
+            PrintWaveOutError("waveOutOpen", result);
+            Sleep(WAVEOUT_RETRY_DELAY_MS);
+            retryCount++;
+        }
+    } while (result != MMSYSERR_NOERROR && retryCount < WAVEOUT_OPEN_RETRIES);
+
+    if (result != MMSYSERR_NOERROR) {
+        w->hWaveOut = NULL;
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < blockCount; ++i) {
+        memset(&w->headers[i], 0, sizeof(WAVEHDR));
+        blocks[i].sinkData = &w->headers[i];
+    }
+    SinkQueueClear(&w->queue);
+    return 0;
+}
+
+static int WaveOutSinkSubmit(OutputSink *sink, PlaybackBlock *block) {
+    WaveOutSink *w = (WaveOutSink *)sink;
+    WAVEHDR *hdr = (WAVEHDR *)block->sinkData;
+    MMRESULT result;
+
+    memset(hdr, 0, sizeof(WAVEHDR));
+    hdr->lpData = (LPSTR)block->data;
+    hdr->dwBufferLength = block->frames * sink->blockAlign;
+
+    result = waveOutPrepareHeader(w->hWaveOut, hdr, sizeof(WAVEHDR));
+    if (result != MMSYSERR_NOERROR) {
+        PrintWaveOutError("waveOutPrepareHeader", result);
+        return -1;
+    }
+
+    result = waveOutWrite(w->hWaveOut, hdr, sizeof(WAVEHDR));
+    if (result != MMSYSERR_NOERROR) {
+        PrintWaveOutError("waveOutWrite", result);
+        waveOutUnprepareHeader(w->hWaveOut, hdr, sizeof(WAVEHDR));
+        return -1;
+    }
+    return SinkQueuePush(&w->queue, block, 0);
+}
+
+static int WaveOutSinkWaitDone(OutputSink *sink, uint32_t timeoutMs, PlaybackBlock **done) {
+    WaveOutSink *w = (WaveOutSink *)sink;
+    PlaybackBlock *block = SinkQueuePeek(&w->queue, NULL);
+    DWORD startTick = GetTickCount();
+
+    if (!block) return 0;
+
+    // The event fires for every completed header, so recheck the oldest one each time
+    while (!(((WAVEHDR *)block->sinkData)->dwFlags & WHDR_DONE)) {
+        DWORD elapsed = GetTickCount() - startTick;
+        if (elapsed >= timeoutMs) return 0;
+        if (WaitForSingleObject(w->hEvent, timeoutMs - elapsed) == WAIT_FAILED) return -1;
+    }
+
+    SinkQueuePop(&w->queue);
+    waveOutUnprepareHeader(w->hWaveOut, (WAVEHDR *)block->sinkData, sizeof(WAVEHDR));
+    *done = block;
+    return 1;
+}
+
+static void WaveOutSinkReset(OutputSink *sink) {
+    WaveOutSink *w = (WaveOutSink *)sink;
+    PlaybackBlock *block;
+
+    if (!w->hWaveOut) return;
+
+    // Marks every queued header done
+    waveOutReset(w->hWaveOut);
+    while ((block = SinkQueuePop(&w->queue)) != NULL) {
+        waveOutUnprepareHeader(w->hWaveOut, (WAVEHDR *)block->sinkData, sizeof(WAVEHDR));
+    }
+}
+
+static void WaveOutSinkClose(OutputSink *sink) {
+    WaveOutSink *w = (WaveOutSink *)sink;
+
+    if (!w->hWaveOut) return;
+    WaveOutSinkReset(sink);
+    waveOutClose(w->hWaveOut);
+    w->hWaveOut = NULL;
+}
+
+static void WaveOutSinkDestroy(OutputSink *sink) {
+    WaveOutSink *w = (WaveOutSink *)sink;
+    WaveOutSinkClose(sink);
+    CloseHandle(w->hEvent);
+    free(w);
+}
+
+static const OutputSinkVtbl WaveOutSinkVtbl = {
+    "waveout",
+    WaveOutSinkOpen,
+    WaveOutSinkSubmit,
+    WaveOutSinkWaitDone,
+    WaveOutSinkReset,
+    WaveOutSinkClose,
+    WaveOutSinkDestroy
+};
+
+HRESULT CreateWaveOutSink(OutputSink **out) {
+    WaveOutSink *w = (WaveOutSink *)calloc(1, sizeof(*w));
+    if (!w) return E_OUTOFMEMORY;
+
+    w->hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!w->hEvent) {
+        free(w);
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    w->base.lpVtbl = &WaveOutSinkVtbl;
+    *out = &w->base;
+    return S_OK;
+}
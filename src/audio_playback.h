@@ -0,0 +1,16 @@
+// audio_playback.h
+#ifndef AUDIO_PLAYBACK_H
+#define AUDIO_PLAYBACK_H
+
+#include <windows.h>
+#include "output_sink.h"
+
+#define WAVEOUT_OPEN_RETRIES 3
+#define WAVEOUT_RETRY_DELAY_MS 100
+
+// Default waveOut device as an OutputSink. Completions are signalled through an
+// event (CALLBACK_EVENT), so blocks are refilled on the thread that waits on the
+// sink and never from inside the driver callback.
+HRESULT CreateWaveOutSink(OutputSink **out);
+
+#endif // AUDIO_PLAYBACK_H
@@ -1,31 +1,30 @@
 // audio_save.c
+#include <mmreg.h>
+
 #include "audio_save.h"
-void WriteWavHeader(FILE *file, WAVEFORMATEX *pwfx, DWORD dataSize) {
-    DWORD fileSize = dataSize + 36; // Total file size minus 8 bytes for RIFF header
-    DWORD fmtSize = 16;
-    WORD  formatTag = WAVE_FORMAT_PCM; // Changed to PCM
-    WORD  channels = pwfx->nChannels;
-    DWORD sampleRate = pwfx->nSamplesPerSec;
-    WORD  bitsPerSample = pwfx->wBitsPerSample;
-    WORD  blockAlign = pwfx->nBlockAlign;
-    DWORD byteRate = pwfx->nAvgBytesPerSec;
 
-    fwrite("RIFF", 1, 4, file);
-    fwrite(&fileSize, sizeof(DWORD), 1, file);
-    fwrite("WAVE", 1, 4, file);
-    fwrite("fmt ", 1, 4, file);
-    fwrite(&fmtSize, sizeof(DWORD), 1, file);
-    fwrite(&formatTag, sizeof(WORD), 1, file);
-    fwrite(&channels, sizeof(WORD), 1, file);
-    fwrite(&sampleRate, sizeof(DWORD), 1, file);
-    fwrite(&byteRate, sizeof(DWORD), 1, file);
-    fwrite(&blockAlign, sizeof(WORD), 1, file);
-    fwrite(&bitsPerSample, sizeof(WORD), 1, file);
-    fwrite("data", 1, 4, file);
-    fwrite(&dataSize, sizeof(DWORD), 1, file);
+void WavFormatFromWaveFormat(WavFormat *format, const WAVEFORMATEX *pwfx) {
+    format->formatTag = pwfx->wFormatTag;
+    format->channels = pwfx->nChannels;
+    format->sampleRate = pwfx->nSamplesPerSec;
+    format->bitsPerSample = pwfx->wBitsPerSample;
+    format->channelMask = 0;
+
+    // Shared-mode mix formats are usually WAVE_FORMAT_EXTENSIBLE; tag them by their subformat
+    if (pwfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE) {
+        const WAVEFORMATEXTENSIBLE *ext = (const WAVEFORMATEXTENSIBLE *)pwfx;
+        // KSDATAFORMAT_SUBTYPE_* GUIDs carry the plain format tag in Data1
+        format->formatTag = (WORD)ext->SubFormat.Data1;
+        format->channelMask = ext->dwChannelMask;
+    }
+}
+
+void WriteWavHeader(FILE *file, WAVEFORMATEX *pwfx, UINT64 dataSize) {
+    WavFormat format;
+
+    WavFormatFromWaveFormat(&format, pwfx);
 
-    // Check if all writes were successful
-    if (ferror(file)) {
+    if (WavWriteHeader(file, &format, dataSize) != 0 || ferror(file)) {
         fprintf(stderr, "Error writing WAV header\n");
     }
 }
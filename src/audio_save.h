@@ -5,7 +5,9 @@
 #include <windows.h>
 #include <stdio.h>
 #include "audio_capture.h"
+#include "wav_writer.h"
 
-void WriteWavHeader(FILE *file, WAVEFORMATEX *pwfx, DWORD dataSize);
+void WavFormatFromWaveFormat(WavFormat *format, const WAVEFORMATEX *pwfx);
+void WriteWavHeader(FILE *file, WAVEFORMATEX *pwfx, UINT64 dataSize);
 
-#endif // AUDIO_SAVE_H
\ No newline at end of file
+#endif // AUDIO_SAVE_H
@@ -0,0 +1,3405 @@
+// bench.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "capture_mixer.h"
+#include "capture_pipeline.h"
+#include "edit_list.h"
+#include "flac_encoder.h"
+#include "level_meter.h"
+#include "loudness.h"
+#include "onset_slicer.h"
+#include "output_sink.h"
+#include "platform.h"
+#include "playback.h"
+#include "resampler.h"
+#include "ring_buffer.h"
+#include "sample_convert.h"
+#include "silence_gate.h"
+#include "spectrum.h"
+#include "take_export.h"
+#include "take_storage.h"
+#include "wav_reader.h"
+#include "wav_writer.h"
+#include "waveform_overview.h"
+
+#define BENCH_AMPLITUDE 0.5f
+#define BENCH_NOISE 0.05f             // Keeps FLAC from predicting the tone perfectly
+#define BENCH_FREQUENCY 440.0
+#define BENCH_PI 3.14159265358979323846
+#define BENCH_MIXER_SECONDS 120       // Virtual capture time per mixer run, long enough to see drift
+#define BENCH_MIXER_JITTER_MS 0.2     // Packet timestamps scatter this far either way
+#define BENCH_MIXER_BASE_NS 1000000000ull
+#define BENCH_SPECTRUM_TAKE_SECONDS 120
+#define BENCH_SPECTRUM_TOLERANCE 1e-5 // Worst magnitude error against the direct DFT, of full scale
+#define BENCH_SLICE_SECONDS 300       // Synthetic percussion sliced per run
+#define BENCH_SLICE_TOLERANCE_MS 2.0  // Furthest a found onset may be from the true one
+#define BENCH_SLICE_NOISE_DB -70.0    // Noise floor under the hits
+#define BENCH_LOUDNESS_TOLERANCE 0.1  // LU either way, as EBU Tech 3341 allows a meter
+#define BENCH_TRUE_PEAK_OVER 0.2      // dB a true peak reading may be over the reference
+#define BENCH_TRUE_PEAK_UNDER 0.4     // and under it
+#define BENCH_NORMALIZE_SECONDS 60
+#define BENCH_NORMALIZE_TARGET -12.0  // LUFS, above the take, so its peaks must be limited
+#define BENCH_NORMALIZE_TOLERANCE 0.2 // LU; limiting takes a little off the loudness
+#define BENCH_EDIT_SECONDS 10         // Take edited at random
+#define BENCH_EDIT_STEPS 40           // Edits, undos and redos, each checked against the eager reference
+#define BENCH_EDIT_TOLERANCE 1e-6     // Of full scale; both renders do the same float arithmetic
+#define BENCH_EDIT_S16_TOLERANCE (1.0 / 32768)    // Playback rounds to 16 bits
+#define BENCH_OVERRUN_SECONDS 20      // Packets offered to the throttled ring
+#define BENCH_OVERRUN_WORDS (BENCH_PACKET_FRAMES * BENCH_CHANNELS)    // Numbered 32-bit words per packet
+#define BENCH_OVERRUN_RING_PACKETS 8
+#define BENCH_STORAGE_SECONDS 600     // Appended and walked per storage run
+#define BENCH_STORAGE_FRAME_BYTES 24  // Checked takes: a frame that does not divide a chunk
+#define BENCH_STORAGE_CHECK_BYTES (TAKE_REGION_BYTES + 3 * TAKE_CHUNK_BYTES)    // Into a second region
+#define BENCH_STORAGE_SLICES 200      // Random slices walked per check
+#define BENCH_REALLOC_INITIAL (1024 * 1024)   // The GUI's take buffer started at this and doubled
+#define BENCH_SWEEP_TONES 24          // Tones per band per resampler sweep
+#define BENCH_RESAMPLE_RIPPLE_DB 0.0001    // Passband gain either side of unity
+#define BENCH_METER_SECONDS 10        // Metered per channel count and sample type
+#define BENCH_METER_RMS_TOLERANCE 1e-5    // Relative; the kernels sum squares in float lanes
+#define BENCH_OVERVIEW_SECONDS 60     // Fills six levels of the pyramid
+#define BENCH_OVERVIEW_COLUMNS 1920   // Widest overview drawn
+#define BENCH_GATE_HISS_DB -70.0      // Quiet bursts, under the gate threshold
+#define BENCH_PREROLL_WRAPS 3         // Times the armed ring wraps before the commit
+#define BENCH_PREROLL_LIVE_SECONDS 1  // Stored after the commit
+#define BENCH_NOISE_SEED 0x12345678u  // The synthetic source's noise generator starts here
+#define BENCH_RF64_GAP (5ull << 30)   // Bytes of hole in the RF64 file, past what a RIFF size can hold
+
+typedef struct {
+    BenchResults results;
+    uint32_t threads;
+    float *signal;                // One second of BENCH_CHANNELS frames, looped
+    int16_t *signal16;
+    int failed;
+} Bench;
+
+typedef void (*BenchRunFn)(void *ctx);
+
+static BenchResult *AddResult(Bench *b, const char *group, const char *name, uint32_t threads,
+                              uint64_t frames, uint32_t rate, uint64_t ns) {
+    BenchResult *r;
+
+    if (b->results.count == BENCH_MAX_RESULTS) return NULL;
+    r = &b->results.results[b->results.count++];
+    memset(r, 0, sizeof(*r));
+    snprintf(r->group, sizeof(r->group), "%s", group);
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->threads = threads;
+    r->frames = frames;
+    r->audioSeconds = (double)frames / rate;
+    r->seconds = ns / 1e9;
+    return r;
+}
+
+// Fastest of BENCH_REPEATS runs, in nanoseconds
+static uint64_t TimeBest(BenchRunFn fn, void *ctx) {
+    uint64_t best = UINT64_MAX;
+
+    for (int i = 0; i < BENCH_REPEATS; ++i) {
+        uint64_t start = PlatformNowNs();
+        fn(ctx);
+        uint64_t elapsed = PlatformNowNs() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static int MakeSignal(Bench *b) {
+    size_t samples = (size_t)BENCH_SAMPLE_RATE * BENCH_CHANNELS;
+    uint32_t state = 0x12345678u;
+
+    b->signal = (float *)malloc(samples * sizeof(float));
+    b->signal16 = (int16_t *)malloc(samples * sizeof(int16_t));
+    if (!b->signal || !b->signal16) return -1;
+
+    for (uint32_t i = 0; i < BENCH_SAMPLE_RATE; ++i) {
+        float tone = BENCH_AMPLITUDE * (float)sin(2.0 * BENCH_PI * BENCH_FREQUENCY * i / BENCH_SAMPLE_RATE);
+        for (uint16_t ch = 0; ch < BENCH_CHANNELS; ++ch) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            b->signal[(size_t)i * BENCH_CHANNELS + ch] = tone + BENCH_NOISE * ((float)state / 4294967296.0f * 2.0f - 1.0f);
+        }
+    }
+    ConvertFloatToS16(b->signal16, b->signal, samples, NULL);
+    return 0;
+}
+
+// Conversion
+
+typedef struct {
+    ConvertKernel kernel;
+    DitherState *dither;
+    SampleConverter converter;
+    const void *src;
+    void *dst;
+    uint32_t blocks;
+} ConvertRun;
+
+static void RunFloatKernel(void *ctx) {
+    ConvertRun *run = (ConvertRun *)ctx;
+
+    if (run->dither) DitherInit(run->dither, 1);
+    for (uint32_t i = 0; i < run->blocks; ++i) {
+        ConvertFloatToS16WithKernel(run->kernel, (int16_t *)run->dst, (const float *)run->src,
+                                    (size_t)BENCH_BLOCK_FRAMES * BENCH_CHANNELS, run->dither);
+    }
+}
+
+static void RunConverter(void *ctx) {
+    ConvertRun *run = (ConvertRun *)ctx;
+
+    for (uint32_t i = 0; i < run->blocks; ++i) {
+        SampleConverterRun(&run->converter, run->dst, run->src, BENCH_BLOCK_FRAMES, NULL);
+    }
+}
+
+// Undithered, every kernel must match the scalar reference bit for bit,
+// including on NaN, infinities and samples far out of range
+static void CheckKernels(Bench *b, const float *src, size_t count, int16_t *expected, int16_t *actual) {
+    ConvertFloatToS16WithKernel(CONVERT_KERNEL_SCALAR, expected, src, count, NULL);
+    for (int k = 1; k < CONVERT_KERNEL_COUNT; ++k) {
+        if (ConvertFloatToS16WithKernel((ConvertKernel)k, actual, src, count, NULL) != 0) continue;
+        if (memcmp(actual, expected, count * sizeof(int16_t)) != 0) {
+            fprintf(stderr, "The %s kernel does not match the scalar reference\n", ConvertKernelName((ConvertKernel)k));
+            b->failed = 1;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (isnan(src[i]) && expected[i] != -32768) {
+            fprintf(stderr, "NaN converted to %d instead of -32768\n", expected[i]);
+            b->failed = 1;
+            return;
+        }
+    }
+}
+
+// One block converted over and over, so the kernels are timed on data already in cache
+static void BenchConvert(Bench *b) {
+    size_t blockBytes = (size_t)BENCH_BLOCK_FRAMES * BENCH_CHANNELS * sizeof(float);
+    uint8_t *src = (uint8_t *)malloc(blockBytes);
+    uint8_t *dst = (uint8_t *)malloc(blockBytes);
+    DitherState dither;
+    ConvertRun run = {0};
+    char name[40];
+
+    if (!src || !dst) {
+        b->failed = 1;
+        free(src);
+        free(dst);
+        return;
+    }
+
+    run.blocks = BENCH_KERNEL_SECONDS * BENCH_SAMPLE_RATE / BENCH_BLOCK_FRAMES;
+    uint64_t frames = (uint64_t)run.blocks * BENCH_BLOCK_FRAMES;
+
+    // The signal with awkward samples dropped in, converted whole and with a scalar tail
+    static const float special[] = { NAN, -NAN, INFINITY, -INFINITY, 1.0f, -1.0f, 1.5f, -1.5f, 1e30f, -1e30f };
+    size_t count = (size_t)BENCH_BLOCK_FRAMES * BENCH_CHANNELS;
+    float *checked = (float *)src;
+    memcpy(checked, b->signal, blockBytes);
+    for (size_t i = 0; i < count; i += 61) checked[i] = special[i % (sizeof(special) / sizeof(special[0]))];
+    CheckKernels(b, checked, count, (int16_t *)dst, (int16_t *)dst + count);
+    CheckKernels(b, checked, count - 5, (int16_t *)dst, (int16_t *)dst + count);
+
+    run.src = b->signal;
+    run.dst = dst;
+    for (int k = 0; k < CONVERT_KERNEL_COUNT; ++k) {
+        if (!ConvertKernelSupported((ConvertKernel)k)) continue;
+        run.kernel = (ConvertKernel)k;
+        for (int dithered = 0; dithered < 2; ++dithered) {
+            run.dither = dithered ? &dither : NULL;
+            snprintf(name, sizeof(name), "f32_to_s16%s/%s", dithered ? "_dither" : "", ConvertKernelName(run.kernel));
+            AddResult(b, "convert", name, 1, frames, BENCH_SAMPLE_RATE, TimeBest(RunFloatKernel, &run));
+        }
+    }
+
+    // Every other pair through the converters the pipeline uses, on the best kernel
+    for (int in = 0; in < SAMPLE_TYPE_COUNT; ++in) {
+        SampleFormat floatFormat = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+        SampleFormat inFormat = { (SampleType)in, BENCH_CHANNELS, 0 };
+        SampleConverter toIn;
+
+        SampleConverterInit(&toIn, &floatFormat, &inFormat);
+        SampleConverterRun(&toIn, src, b->signal, BENCH_BLOCK_FRAMES, NULL);
+        run.src = src;
+
+        for (int out = 0; out < SAMPLE_TYPE_COUNT; ++out) {
+            SampleFormat outFormat = { (SampleType)out, BENCH_CHANNELS, 0 };
+            if (in == out || SampleConverterInit(&run.converter, &inFormat, &outFormat) != 0) continue;
+            snprintf(name, sizeof(name), "%s_to_%s", SampleTypeName((SampleType)in), SampleTypeName((SampleType)out));
+            AddResult(b, "convert", name, 1, frames, BENCH_SAMPLE_RATE, TimeBest(RunConverter, &run));
+        }
+    }
+
+    free(src);
+    free(dst);
+}
+
+// Bits of precision in a sample type; float counts its 24-bit significand
+static int SampleTypeBits(SampleType type) {
+    switch (type) {
+    case SAMPLE_S16: return 16;
+    case SAMPLE_S32: return 32;
+    default: return 24;
+    }
+}
+
+// Sample i of an interleaved buffer as a fraction of full scale
+static double SampleValue(const uint8_t *samples, SampleType type, size_t i) {
+    int16_t s16;
+    int32_t s32;
+    float f32;
+    const uint8_t *p;
+
+    switch (type) {
+    case SAMPLE_S16:
+        memcpy(&s16, samples + i * 2, 2);
+        return s16 / 32768.0;
+    case SAMPLE_S24:
+        p = samples + i * 3;
+        return ((int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8) / 8388608.0;
+    case SAMPLE_S32:
+        memcpy(&s32, samples + i * 4, 4);
+        return s32 / 2147483648.0;
+    default:
+        memcpy(&f32, samples + i * 4, 4);
+        return f32;
+    }
+}
+
+// Every sample type through every type and layout and back. Where the middle
+// holds every value of the first the samples must come back exact (s16 through
+// f32, say); otherwise within one LSB of the coarser of the two.
+static void BenchRoundTrips(Bench *b) {
+    size_t samples = (size_t)BENCH_BLOCK_FRAMES * BENCH_CHANNELS;
+    float *source = (float *)malloc(samples * sizeof(float));
+    uint8_t *first = (uint8_t *)malloc(samples * sizeof(int32_t));
+    uint8_t *middle = (uint8_t *)malloc(samples * sizeof(int32_t));
+    uint8_t *back = (uint8_t *)malloc(samples * sizeof(int32_t));
+    SampleFormat floatFormat = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+    double worst = 0.0;
+    uint32_t trips = 0;
+
+    if (!source || !first || !middle || !back) {
+        b->failed = 1;
+        free(source);
+        free(first);
+        free(middle);
+        free(back);
+        return;
+    }
+    // The signal, led by full scale both ways
+    memcpy(source, b->signal, samples * sizeof(float));
+    source[0] = -1.0f;
+    source[1] = 1.0f;
+    source[2] = 0.0f;
+    source[3] = -0.5f;
+
+    uint64_t start = PlatformNowNs();
+    for (int in = 0; in < SAMPLE_TYPE_COUNT; ++in) {
+        SampleFormat inFormat = { (SampleType)in, BENCH_CHANNELS, 0 };
+        SampleConverter converter;
+
+        SampleConverterInit(&converter, &floatFormat, &inFormat);
+        SampleConverterRun(&converter, first, source, BENCH_BLOCK_FRAMES, NULL);
+
+        for (int mid = 0; mid < SAMPLE_TYPE_COUNT; ++mid) {
+            for (int planar = 0; planar < 2; ++planar) {
+                SampleFormat midFormat = { (SampleType)mid, BENCH_CHANNELS, planar };
+                SampleConverter there, returned;
+                int exact = in == mid || (in != SAMPLE_F32 && SampleTypeBits((SampleType)mid) >= SampleTypeBits((SampleType)in));
+                int bits = SampleTypeBits((SampleType)(SampleTypeBits((SampleType)mid) < SampleTypeBits((SampleType)in) ? mid : in));
+                double error = 0.0;
+
+                if (in == mid && !planar) continue;
+                if (SampleConverterInit(&there, &inFormat, &midFormat) != 0 ||
+                    SampleConverterInit(&returned, &midFormat, &inFormat) != 0) {
+                    b->failed = 1;
+                    continue;
+                }
+                SampleConverterRun(&there, middle, first, BENCH_BLOCK_FRAMES, NULL);
+                SampleConverterRun(&returned, back, middle, BENCH_BLOCK_FRAMES, NULL);
+                trips++;
+
+                if (exact) {
+                    if (memcmp(back, first, samples * SampleTypeBytes((SampleType)in)) != 0) error = INFINITY;
+                } else {
+                    for (size_t i = 0; i < samples; ++i) {
+                        double d = fabs(SampleValue(back, (SampleType)in, i) - SampleValue(first, (SampleType)in, i));
+                        if (d > error) error = d;
+                    }
+                    if (error > worst) worst = error;
+                }
+                if (error > (exact ? 0.0 : ldexp(1.0, 1 - bits))) {
+                    fprintf(stderr, "%s through %s%s and back is off by %g of full scale\n",
+                            SampleTypeName((SampleType)in), SampleTypeName((SampleType)mid), planar ? " planar" : "",
+                            error);
+                    b->failed = 1;
+                }
+            }
+        }
+    }
+    uint64_t elapsed = PlatformNowNs() - start;
+
+    BenchResult *r = AddResult(b, "convert", "round_trips", 1, (uint64_t)trips * 2 * BENCH_BLOCK_FRAMES,
+                               BENCH_SAMPLE_RATE, elapsed);
+    if (r) r->maxError = worst;
+    free(source);
+    free(first);
+    free(middle);
+    free(back);
+}
+
+// Ring buffer
+
+typedef struct {
+    RingBuffer ring;
+    const uint8_t *packet;
+    size_t packetBytes;
+    uint64_t bytes;
+    uint32_t *numbered;           // Overrun run: the packet being sent
+    uint64_t dropped;             // Packets the full ring turned away
+    atomic_int done;
+} RingRun;
+
+// Stands in for the capture thread: 10 ms packets, as fast as they fit
+static int RingProducer(void *arg) {
+    RingRun *run = (RingRun *)arg;
+    uint64_t sent = 0;
+
+    while (sent < run->bytes) {
+        if (RingBufferWritable(&run->ring) < run->packetBytes) {
+            PlatformSleepMs(0);
+            continue;
+        }
+        RingBufferWrite(&run->ring, run->packet, run->packetBytes);
+        sent += run->packetBytes;
+    }
+    return 0;
+}
+
+// Producer and consumer on their own threads, sized and drained as the capture pipeline does
+static void BenchRing(Bench *b) {
+    size_t frameBytes = BENCH_CHANNELS * sizeof(float);
+    uint8_t *stage = (uint8_t *)malloc(PIPELINE_STAGE_BYTES);
+    PlatformThread producer;
+    RingRun run;
+    uint64_t received = 0;
+
+    memset(&run, 0, sizeof(run));
+    run.packet = (const uint8_t *)b->signal;
+    run.packetBytes = BENCH_PACKET_FRAMES * frameBytes;
+    run.bytes = (uint64_t)BENCH_RING_SECONDS * BENCH_SAMPLE_RATE * frameBytes;
+
+    if (!stage || RingBufferInit(&run.ring, (size_t)PIPELINE_RING_SECONDS * BENCH_SAMPLE_RATE * frameBytes) != 0) {
+        b->failed = 1;
+        free(stage);
+        return;
+    }
+
+    uint64_t start = PlatformNowNs();
+    if (PlatformThreadCreate(&producer, RingProducer, &run) != 0) {
+        b->failed = 1;
+    } else {
+        while (received < run.bytes) {
+            size_t n = RingBufferRead(&run.ring, stage, PIPELINE_STAGE_BYTES);
+            if (n == 0) PlatformSleepMs(0);
+            received += n;
+        }
+        PlatformThreadJoin(producer);
+        AddResult(b, "ring", "spsc_10ms_packets", 2, run.bytes / frameBytes, BENCH_SAMPLE_RATE, PlatformNowNs() - start);
+    }
+
+    RingBufferFree(&run.ring);
+    free(stage);
+}
+
+// Stands in for a capture thread whose storage thread has stalled: it never
+// waits, so packets that do not fit are dropped as QueuePacket drops them.
+// Word j of packet i holds i * BENCH_OVERRUN_WORDS + j.
+static int OverrunProducer(void *arg) {
+    RingRun *run = (RingRun *)arg;
+    uint32_t packets = (uint32_t)(run->bytes / run->packetBytes);
+
+    for (uint32_t i = 0; i < packets; ++i) {
+        for (uint32_t j = 0; j < BENCH_OVERRUN_WORDS; ++j) run->numbered[j] = i * BENCH_OVERRUN_WORDS + j;
+        if (RingBufferWrite(&run->ring, run->numbered, run->packetBytes) == 0) run->dropped++;
+        PlatformSleepMs(0);
+    }
+    atomic_store(&run->done, 1);
+    return 0;
+}
+
+// A consumer that reads a little every millisecond against a ring of a few
+// packets. The overrun counters must account for exactly the whole packets
+// missing from what arrived, and everything that arrived must be in order.
+static void BenchRingOverrun(Bench *b) {
+    uint32_t words[PIPELINE_STAGE_BYTES / 64];
+    uint32_t packets = BENCH_OVERRUN_SECONDS * BENCH_SAMPLE_RATE / BENCH_PACKET_FRAMES;
+    uint32_t next = 0;            // Packet expected next
+    uint32_t packet = 0;
+    uint32_t offset = 0;          // Word within the packet being received
+    uint64_t missing = 0;
+    int mismatch = 0;
+    PlatformThread producer;
+    RingRun run;
+
+    memset(&run, 0, sizeof(run));
+    run.packetBytes = BENCH_OVERRUN_WORDS * sizeof(uint32_t);
+    run.bytes = (uint64_t)packets * run.packetBytes;
+    run.numbered = (uint32_t *)malloc(run.packetBytes);
+    atomic_init(&run.done, 0);
+
+    if (!run.numbered || RingBufferInit(&run.ring, BENCH_OVERRUN_RING_PACKETS * run.packetBytes) != 0) {
+        b->failed = 1;
+        free(run.numbered);
+        return;
+    }
+
+    uint64_t start = PlatformNowNs();
+    if (PlatformThreadCreate(&producer, OverrunProducer, &run) != 0) {
+        b->failed = 1;
+        RingBufferFree(&run.ring);
+        free(run.numbered);
+        return;
+    }
+    for (;;) {
+        int done = atomic_load(&run.done);
+        size_t n = RingBufferRead(&run.ring, words, sizeof(words)) / sizeof(uint32_t);
+
+        for (size_t i = 0; i < n; ++i) {
+            if (offset == 0) {
+                packet = words[i] / BENCH_OVERRUN_WORDS;
+                if (packet < next) mismatch = 1;
+                else missing += packet - next;
+                next = packet + 1;
+            }
+            if (words[i] != packet * BENCH_OVERRUN_WORDS + offset) mismatch = 1;
+            offset = (offset + 1) % BENCH_OVERRUN_WORDS;
+        }
+        if (n == 0 && done) break;
+        PlatformSleepMs(1);
+    }
+    PlatformThreadJoin(producer);
+    uint64_t elapsed = PlatformNowNs() - start;
+    missing += packets - next;
+
+    uint64_t overruns = atomic_load(&run.ring.overrunCount);
+    uint64_t overrunBytes = atomic_load(&run.ring.overrunBytes);
+    if (mismatch || offset != 0) {
+        fprintf(stderr, "Ring overrun run received bytes out of sequence\n");
+        b->failed = 1;
+    } else if (missing == 0 || missing == packets || overruns != missing || run.dropped != missing ||
+               overrunBytes != missing * run.packetBytes) {
+        fprintf(stderr, "Ring overrun run lost %llu packets but counted %llu overruns of %llu bytes\n",
+                (unsigned long long)missing, (unsigned long long)overruns, (unsigned long long)overrunBytes);
+        b->failed = 1;
+    }
+
+    BenchResult *r = AddResult(b, "ring", "overrun_throttled", 2, run.bytes / (BENCH_CHANNELS * sizeof(float)),
+                               BENCH_SAMPLE_RATE, elapsed);
+    if (r) r->framesDropped = overrunBytes / (BENCH_CHANNELS * sizeof(float));
+    RingBufferFree(&run.ring);
+    free(run.numbered);
+}
+
+// File writing
+
+static void ScratchPath(char *path, size_t size, const char *ext) {
+    snprintf(path, size, "%s%s", BENCH_SCRATCH_BASE, ext);
+}
+
+// Appends frames of the looped 16-bit signal in blocks. Returns -1 on a failed write.
+typedef int (*AppendFn)(void *writer, const void *frames, uint32_t frameCount);
+
+static int AppendSignal(Bench *b, AppendFn append, void *writer, uint64_t frames) {
+    uint32_t pos = 0;
+
+    while (frames > 0) {
+        uint32_t n = BENCH_BLOCK_FRAMES;
+        if (n > BENCH_SAMPLE_RATE - pos) n = BENCH_SAMPLE_RATE - pos;
+        if (n > frames) n = (uint32_t)frames;
+        if (append(writer, b->signal16 + (size_t)pos * BENCH_CHANNELS, n) != 0) return -1;
+        pos = (pos + n) % BENCH_SAMPLE_RATE;
+        frames -= n;
+    }
+    return 0;
+}
+
+static int AppendWav(void *writer, const void *frames, uint32_t frameCount) {
+    return WavWriterAppend((WavWriter *)writer, frames, frameCount);
+}
+
+static int AppendFlac(void *writer, const void *frames, uint32_t frameCount) {
+    return FlacEncoderAppend((FlacEncoder *)writer, frames, frameCount);
+}
+
+static void S16Format(WavFormat *format) {
+    memset(format, 0, sizeof(*format));
+    format->formatTag = WAV_FORMAT_PCM;
+    format->channels = BENCH_CHANNELS;
+    format->sampleRate = BENCH_SAMPLE_RATE;
+    format->bitsPerSample = 16;
+}
+
+static uint8_t *PutLE(uint8_t *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) *p++ = (uint8_t)(v >> (8 * i));
+    return p;
+}
+
+// The header a finished WavWriter file should start with, spelled out apart
+// from the writer: RIFF, the JUNK chunk held for ds64, fmt and data. Past
+// 4 GiB it is RF64, with the 32-bit sizes pinned to 0xFFFFFFFF and the real
+// ones in ds64. Integer PCM only; mono or stereo, extensible past 16 bits.
+static size_t ExpectedWavHeader(uint8_t *buf, const WavFormat *format, uint64_t dataBytes) {
+    static const uint8_t subFormatTail[12] = { 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+    int extensible = format->bitsPerSample > 16;
+    uint32_t fmtSize = extensible ? 40 : 16;
+    uint16_t blockAlign = format->channels * (format->bitsPerSample / 8);
+    size_t length = 12 + 8 + WAV_DS64_PAYLOAD + 8 + fmtSize + 8;
+    uint64_t riffSize = length - 8 + dataBytes + (dataBytes & 1);
+    int rf64 = riffSize > 0xFFFFFFFFull;
+    uint8_t *p = buf;
+
+    memcpy(p, rf64 ? "RF64" : "RIFF", 4);
+    p = PutLE(p + 4, rf64 ? 0xFFFFFFFFull : riffSize, 4);
+    memcpy(p, "WAVE", 4);
+    p += 4;
+    if (rf64) {
+        memcpy(p, "ds64", 4);
+        p = PutLE(p + 4, WAV_DS64_PAYLOAD, 4);
+        p = PutLE(p, riffSize, 8);
+        p = PutLE(p, dataBytes, 8);
+        p = PutLE(p, dataBytes / blockAlign, 8);
+        p = PutLE(p, 0, 4);
+    } else {
+        memcpy(p, "JUNK", 4);
+        p = PutLE(p + 4, WAV_DS64_PAYLOAD, 4);
+        memset(p, 0, WAV_DS64_PAYLOAD);
+        p += WAV_DS64_PAYLOAD;
+    }
+
+    memcpy(p, "fmt ", 4);
+    p = PutLE(p + 4, fmtSize, 4);
+    p = PutLE(p, extensible ? WAV_FORMAT_EXTENSIBLE : WAV_FORMAT_PCM, 2);
+    p = PutLE(p, format->channels, 2);
+    p = PutLE(p, format->sampleRate, 4);
+    p = PutLE(p, (uint64_t)format->sampleRate * blockAlign, 4);
+    p = PutLE(p, blockAlign, 2);
+    p = PutLE(p, format->bitsPerSample, 2);
+    if (extensible) {
+        p = PutLE(p, 22, 2);
+        p = PutLE(p, format->bitsPerSample, 2);
+        p = PutLE(p, format->channels == 1 ? 0x4 : 0x3, 4);
+        p = PutLE(p, WAV_FORMAT_PCM, 4);
+        memcpy(p, subFormatTail, sizeof(subFormatTail));
+        p += sizeof(subFormatTail);
+    }
+
+    memcpy(p, "data", 4);
+    p = PutLE(p + 4, rf64 ? 0xFFFFFFFFull : dataBytes, 4);
+    return (size_t)(p - buf);
+}
+
+// Reads a finished file back and compares it byte for byte with the expected
+// header, data that repeats loop and, for odd data, a zero pad byte.
+static int CheckWavFile(const char *path, const WavFormat *format, uint64_t dataBytes, const uint8_t *loop,
+                        size_t loopBytes) {
+    uint8_t expected[WAV_MAX_HEADER];
+    uint8_t block[16384];
+    size_t length = ExpectedWavHeader(expected, format, dataBytes);
+    uint64_t pos = 0;
+    int result = 0;
+    FILE *f = fopen(path, "rb");
+
+    if (!f) return -1;
+    if (fread(block, 1, length, f) != length || memcmp(block, expected, length) != 0) result = -1;
+
+    while (result == 0 && pos < dataBytes) {
+        size_t offset = (size_t)(pos % loopBytes);
+        size_t n = sizeof(block);
+        if (n > loopBytes - offset) n = loopBytes - offset;
+        if (n > dataBytes - pos) n = (size_t)(dataBytes - pos);
+        if (fread(block, 1, n, f) != n || memcmp(block, loop + offset, n) != 0) result = -1;
+        pos += n;
+    }
+    if (result == 0 && (dataBytes & 1) && fgetc(f) != 0) result = -1;
+    if (result == 0 && fgetc(f) != EOF) result = -1;
+    fclose(f);
+    return result;
+}
+
+// A mono 24-bit file has an odd block, so an odd frame count leaves an odd
+// data chunk that must be followed by a pad byte the sizes do not count
+static void CheckOddWav(Bench *b) {
+    uint32_t frames = BENCH_SAMPLE_RATE / 10 + 1;
+    const uint8_t *data = (const uint8_t *)b->signal16;
+    WavFormat format;
+    WavWriter writer;
+    char path[64];
+    int result;
+
+    S16Format(&format);
+    format.channels = 1;
+    format.bitsPerSample = 24;
+    ScratchPath(path, sizeof(path), ".wav");
+
+    uint64_t start = PlatformNowNs();
+    if (WavWriterOpen(&writer, path, &format) != 0) {
+        b->failed = 1;
+        return;
+    }
+    result = WavWriterAppend(&writer, data, frames);
+    if (WavWriterFinalize(&writer) != 0) result = -1;
+    uint64_t elapsed = PlatformNowNs() - start;
+
+    if (result == 0 && CheckWavFile(path, &format, (uint64_t)frames * 3, data, (size_t)frames * 3) != 0) {
+        fprintf(stderr, "WAV file with an odd data chunk read back differs from what was written\n");
+        result = -1;
+    }
+    remove(path);
+
+    if (result != 0) {
+        b->failed = 1;
+        return;
+    }
+    AddResult(b, "wav", "write_s24_mono_odd", 1, frames, BENCH_SAMPLE_RATE, elapsed);
+}
+
+// Reads bytes at the file's position and compares them with expected
+static int CheckFileBytes(FILE *f, const uint8_t *expected, size_t bytes) {
+    uint8_t block[16384];
+
+    while (bytes > 0) {
+        size_t n = bytes < sizeof(block) ? bytes : sizeof(block);
+        if (fread(block, 1, n, f) != n || memcmp(block, expected, n) != 0) return -1;
+        expected += n;
+        bytes -= n;
+    }
+    return 0;
+}
+
+// A second of audio either side of a hole of BENCH_RF64_GAP bytes. Moving
+// the stdio writer's position and count past the hole stands in for the
+// appends, so the file system only stores the blocks that were written. The
+// finished file must be RF64 with the 64-bit sizes in ds64, and the reader
+// must find the audio after the hole where the writer put it.
+static void CheckRf64Wav(Bench *b) {
+    size_t secondBytes = (size_t)BENCH_SAMPLE_RATE * BENCH_CHANNELS * sizeof(int16_t);
+    uint64_t dataBytes = 2 * secondBytes + BENCH_RF64_GAP;
+    const uint8_t *signal = (const uint8_t *)b->signal16;
+    uint8_t *readBack = (uint8_t *)malloc(secondBytes);
+    uint8_t expected[WAV_MAX_HEADER];
+    WavFormat format;
+    WavWriter writer;
+    WavReader reader;
+    char path[64];
+    int result;
+
+    if (!readBack) {
+        b->failed = 1;
+        return;
+    }
+    S16Format(&format);
+    ScratchPath(path, sizeof(path), ".wav");
+
+    uint64_t start = PlatformNowNs();
+    if (WavWriterOpen(&writer, path, &format) != 0) {
+        free(readBack);
+        b->failed = 1;
+        return;
+    }
+    result = WavWriterAppend(&writer, signal, BENCH_SAMPLE_RATE);
+    if (result == 0) result = PlatformFileSeek(writer.file, (int64_t)BENCH_RF64_GAP, SEEK_CUR);
+    writer.dataBytes += BENCH_RF64_GAP;
+    if (result == 0) result = WavWriterAppend(&writer, signal, BENCH_SAMPLE_RATE);
+    if (WavWriterFinalize(&writer) != 0) result = -1;
+    uint64_t elapsed = PlatformNowNs() - start;
+
+    if (result == 0) {
+        size_t length = ExpectedWavHeader(expected, &format, dataBytes);
+        FILE *f = fopen(path, "rb");
+
+        if (!f || CheckFileBytes(f, expected, length) != 0 || CheckFileBytes(f, signal, secondBytes) != 0 ||
+            PlatformFileSeek(f, (int64_t)BENCH_RF64_GAP, SEEK_CUR) != 0 ||
+            CheckFileBytes(f, signal, secondBytes) != 0 || fgetc(f) != EOF) {
+            fprintf(stderr, "RF64 file read back differs from what was written\n");
+            result = -1;
+        }
+        if (f) fclose(f);
+    }
+    if (result == 0) {
+        uint64_t frames = dataBytes / (BENCH_CHANNELS * sizeof(int16_t));
+
+        if (WavReaderOpen(&reader, path) != 0) {
+            result = -1;
+        } else {
+            if (reader.dataBytes != dataBytes || reader.totalFrames != frames ||
+                WavReaderSeek(&reader, frames - BENCH_SAMPLE_RATE) != 0 ||
+                WavReaderRead(&reader, readBack, BENCH_SAMPLE_RATE) != BENCH_SAMPLE_RATE ||
+                memcmp(readBack, signal, secondBytes) != 0) {
+                result = -1;
+            }
+            WavReaderClose(&reader);
+        }
+        if (result != 0) fprintf(stderr, "WAV reader lost the audio past 4 GiB in the RF64 file\n");
+    }
+    remove(path);
+    free(readBack);
+
+    if (result != 0) {
+        b->failed = 1;
+        return;
+    }
+    AddResult(b, "wav", "rf64_past_hole", 1, 2 * BENCH_SAMPLE_RATE, BENCH_SAMPLE_RATE, elapsed);
+}
+
+// Open to finalize, so the timing includes the header patches and the final
+// flush. The file is then read back and checked byte for byte.
+static void BenchWav(Bench *b, uint64_t frames) {
+    WavFormat format;
+    WavWriter writer;
+    char path[64];
+    int result;
+
+    S16Format(&format);
+    ScratchPath(path, sizeof(path), ".wav");
+
+    uint64_t start = PlatformNowNs();
+    if (WavWriterOpen(&writer, path, &format) != 0) {
+        b->failed = 1;
+        return;
+    }
+    result = AppendSignal(b, AppendWav, &writer, frames);
+    if (WavWriterFinalize(&writer) != 0) result = -1;
+    uint64_t elapsed = PlatformNowNs() - start;
+
+    if (result == 0 && CheckWavFile(path, &format, frames * BENCH_CHANNELS * sizeof(int16_t),
+                                    (const uint8_t *)b->signal16,
+                                    (size_t)BENCH_SAMPLE_RATE * BENCH_CHANNELS * sizeof(int16_t)) != 0) {
+        fprintf(stderr, "WAV file read back differs from what was written\n");
+        result = -1;
+    }
+    remove(path);
+
+    if (result != 0) {
+        b->failed = 1;
+        return;
+    }
+    AddResult(b, "wav", "write_s16", 1, frames, BENCH_SAMPLE_RATE, elapsed);
+}
+
+static void BenchFlac(Bench *b, uint64_t frames, uint32_t threads) {
+    WavFormat format;
+    FlacEncoder encoder;
+    char path[64];
+    int result;
+
+    S16Format(&format);
+    ScratchPath(path, sizeof(path), ".flac");
+
+    uint64_t start = PlatformNowNs();
+    if (FlacEncoderOpen(&encoder, path, &format, threads) != 0) {
+        b->failed = 1;
+        return;
+    }
+    result = AppendSignal(b, AppendFlac, &encoder, frames);
+    if (FlacEncoderFinalize(&encoder) != 0) result = -1;
+    uint64_t elapsed = PlatformNowNs() - start;
+    remove(path);
+
+    if (result != 0) {
+        b->failed = 1;
+        return;
+    }
+    AddResult(b, "flac", "write_s16", threads, frames, BENCH_SAMPLE_RATE, elapsed);
+}
+
+// Streams a long WAV through stdio or the disk writer, timing every append.
+// stdio's rate is largely the page cache's; its worst append is where
+// writeback caught up with it. The disk writer's run includes waiting for its
+// queue to drain at finalize.
+static void BenchDisk(Bench *b, int direct) {
+    uint64_t frames = (uint64_t)BENCH_DISK_MEGABYTES * 1000000 / (BENCH_CHANNELS * sizeof(int16_t));
+    uint64_t worstAppendNs = 0;
+    uint32_t pos = 0;
+    const char *name;
+    BenchResult *r;
+    WavFormat format;
+    WavWriter writer;
+    char path[64];
+    int result = 0;
+
+    S16Format(&format);
+    ScratchPath(path, sizeof(path), ".wav");
+
+    uint64_t start = PlatformNowNs();
+    if ((direct ? WavWriterOpenDirect(&writer, path, &format) : WavWriterOpen(&writer, path, &format)) != 0) {
+        b->failed = 1;
+        return;
+    }
+    for (uint64_t left = frames; left > 0 && result == 0;) {
+        uint32_t n = BENCH_BLOCK_FRAMES;
+        if (n > BENCH_SAMPLE_RATE - pos) n = BENCH_SAMPLE_RATE - pos;
+        if (n > left) n = (uint32_t)left;
+
+        uint64_t appendStart = PlatformNowNs();
+        result = WavWriterAppend(&writer, b->signal16 + (size_t)pos * BENCH_CHANNELS, n);
+        uint64_t appendNs = PlatformNowNs() - appendStart;
+        if (appendNs > worstAppendNs) worstAppendNs = appendNs;
+
+        pos = (pos + n) % BENCH_SAMPLE_RATE;
+        left -= n;
+    }
+    if (WavWriterFinalize(&writer) != 0) result = -1;
+    uint64_t elapsed = PlatformNowNs() - start;
+    remove(path);
+
+    if (result != 0) {
+        b->failed = 1;
+        return;
+    }
+    // The disk writer may have fallen back to the OS cache on this filesystem
+    name = !direct ? "stream_stdio" : writer.disk.stats.direct ? "stream_direct" : "stream_writer_cached";
+    r = AddResult(b, "disk", name, direct, frames, BENCH_SAMPLE_RATE, elapsed);
+    if (!r) return;
+    r->bytes = writer.dataBytes;
+    r->worstWriteSeconds = (direct ? writer.disk.stats.maxWriteNs : worstAppendNs) / 1e9;
+    r->worstAppendSeconds = worstAppendNs / 1e9;
+}
+
+// Resampling
+
+typedef struct {
+    Resampler resampler;
+    const float *in;
+    float *out;
+    uint32_t blocks;
+} ResampleRun;
+
+static void RunResampler(void *ctx) {
+    ResampleRun *run = (ResampleRun *)ctx;
+
+    ResamplerReset(&run->resampler);
+    for (uint32_t i = 0; i < run->blocks; ++i) {
+        ResamplerProcess(&run->resampler, run->in, BENCH_BLOCK_FRAMES, run->out);
+    }
+}
+
+static void BenchResample(Bench *b) {
+    static const uint32_t rates[][2] = { { 48000, 44100 }, { 44100, 48000 }, { 96000, 48000 } };
+    ResampleRun run;
+    char name[40];
+
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        if (ResamplerInit(&run.resampler, rates[i][0], rates[i][1], BENCH_CHANNELS) != 0) {
+            b->failed = 1;
+            continue;
+        }
+        run.in = b->signal;
+        run.out = (float *)malloc((size_t)ResamplerMaxOutput(&run.resampler, BENCH_BLOCK_FRAMES) *
+                                  BENCH_CHANNELS * sizeof(float));
+        run.blocks = BENCH_KERNEL_SECONDS * rates[i][0] / BENCH_BLOCK_FRAMES;
+
+        if (!run.out) {
+            b->failed = 1;
+        } else {
+            snprintf(name, sizeof(name), "%u_to_%u", rates[i][0], rates[i][1]);
+            AddResult(b, "resample", name, 1, (uint64_t)run.blocks * BENCH_BLOCK_FRAMES, rates[i][0],
+                      TimeBest(RunResampler, &run));
+        }
+        free(run.out);
+        ResamplerClose(&run.resampler);
+    }
+}
+
+// Sends one second of a tone through r from a reset state and fits a sine at
+// its frequency to the output, away from the ends. Gives the gain at the tone
+// and the level of everything the fit leaves, both in dB against the tone as
+// it went in.
+static void ResampleTone(Resampler *r, double frequency, float *in, float *out, double *gainDb, double *restDb) {
+    uint32_t written;
+    double step = 2.0 * BENCH_PI * frequency / r->outRate;
+    double cc = 0.0, ss = 0.0, cs = 0.0, xc = 0.0, xs = 0.0, xx = 0.0;
+
+    for (uint32_t i = 0; i < r->inRate; ++i) {
+        in[i] = (float)(BENCH_AMPLITUDE * sin(2.0 * BENCH_PI * frequency * i / r->inRate));
+    }
+    ResamplerReset(r);
+    written = ResamplerProcess(r, in, r->inRate, out);
+
+    // Least squares fit of a cos + b sin over the middle 80%
+    uint32_t first = written / 10;
+    uint32_t end = written - written / 10;
+    for (uint32_t i = first; i < end; ++i) {
+        double c = cos(step * i);
+        double s = sin(step * i);
+        cc += c * c;
+        ss += s * s;
+        cs += c * s;
+        xc += out[i] * c;
+        xs += out[i] * s;
+        xx += (double)out[i] * out[i];
+    }
+    double det = cc * ss - cs * cs;
+    double a = (xc * ss - xs * cs) / det;
+    double b = (xs * cc - xc * cs) / det;
+    double fitted = a * xc + b * xs;
+    double rest = xx - fitted > 0.0 ? xx - fitted : 0.0;
+    double tone = (double)BENCH_AMPLITUDE * BENCH_AMPLITUDE / 2.0 * (end - first);
+
+    *gainDb = 20.0 * log10(sqrt(a * a + b * b) / BENCH_AMPLITUDE);
+    *restDb = 10.0 * log10((rest > 0.0 ? rest : 1e-30) / tone);
+}
+
+// Sine sweeps through each conversion. Tones in the passband, up to 0.45 of the
+// lower rate, must come out at unity gain within BENCH_RESAMPLE_RIPPLE_DB, with
+// anything else they leave in the output (images, aliases, noise) at least
+// RESAMPLER_STOPBAND_DB down. When decimating, tones between the output and
+// input Nyquist frequencies must be at least that far down in total.
+static void BenchResampleSweeps(Bench *b) {
+    static const uint32_t rates[][2] = { { 48000, 44100 }, { 44100, 48000 }, { 96000, 48000 }, { 48000, 16000 } };
+    char name[40];
+
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        uint32_t inRate = rates[i][0];
+        uint32_t outRate = rates[i][1];
+        uint32_t lower = inRate < outRate ? inRate : outRate;
+        double ripple = 0.0;
+        double rejection = INFINITY;
+        Resampler r;
+
+        if (ResamplerInit(&r, inRate, outRate, 1) != 0) {
+            b->failed = 1;
+            continue;
+        }
+        float *in = (float *)malloc(inRate * sizeof(float));
+        float *out = (float *)malloc((size_t)ResamplerMaxOutput(&r, inRate) * sizeof(float));
+        if (!in || !out) {
+            b->failed = 1;
+            free(in);
+            free(out);
+            ResamplerClose(&r);
+            continue;
+        }
+
+        uint64_t start = PlatformNowNs();
+        for (uint32_t t = 0; t < BENCH_SWEEP_TONES; ++t) {
+            double frequency = 0.45 * lower * (t + 0.5) / BENCH_SWEEP_TONES;
+            double gainDb, restDb;
+
+            ResampleTone(&r, frequency, in, out, &gainDb, &restDb);
+            if (fabs(gainDb) > ripple) ripple = fabs(gainDb);
+            if (-restDb < rejection) rejection = -restDb;
+            if (fabs(gainDb) > BENCH_RESAMPLE_RIPPLE_DB || -restDb < RESAMPLER_STOPBAND_DB) {
+                fprintf(stderr, "%u to %u: a %.0f Hz tone came out at %+.5f dB with the rest %.1f dB down\n",
+                        inRate, outRate, frequency, gainDb, -restDb);
+                b->failed = 1;
+            }
+        }
+        for (uint32_t t = 0; inRate > outRate && t < BENCH_SWEEP_TONES; ++t) {
+            double frequency = (outRate + (inRate - outRate) * (t + 0.5) / BENCH_SWEEP_TONES) / 2.0;
+            double gainDb, restDb;
+
+            // All of what comes out is rejected badly; the fit only splits it
+            ResampleTone(&r, frequency, in, out, &gainDb, &restDb);
+            double totalDb = 10.0 * log10(pow(10.0, gainDb / 10.0) / 2.0 + pow(10.0, restDb / 10.0));
+            if (-totalDb < rejection) rejection = -totalDb;
+            if (-totalDb < RESAMPLER_STOPBAND_DB) {
+                fprintf(stderr, "%u to %u: a %.0f Hz tone above the output Nyquist came through %.1f dB down\n",
+                        inRate, outRate, frequency, -totalDb);
+                b->failed = 1;
+            }
+        }
+        uint64_t elapsed = PlatformNowNs() - start;
+
+        snprintf(name, sizeof(name), "sweep_%u_to_%u", inRate, outRate);
+        uint32_t tones = inRate > outRate ? 2 * BENCH_SWEEP_TONES : BENCH_SWEEP_TONES;
+        BenchResult *result = AddResult(b, "resample", name, 1, (uint64_t)tones * inRate, inRate, elapsed);
+        if (result) {
+            result->rippleDb = ripple;
+            result->rejectionDb = rejection;
+        }
+        free(in);
+        free(out);
+        ResamplerClose(&r);
+    }
+}
+
+// Mixer
+
+typedef struct {
+    uint32_t sampleRate;
+    uint16_t channels;
+    double clockSkewPpm;          // Against the master; the master runs true
+} MixerBenchInput;
+
+typedef struct {
+    const char *name;
+    MixerLayout layout;
+    uint32_t inputCount;
+    MixerBenchInput inputs[3];
+} MixerBenchCase;
+
+// When an input's own clock reaches a frame, from the stream's start
+static double MixerBenchFrameNs(const MixerBenchInput *in, uint64_t frame) {
+    return frame * 1e9 / (in->sampleRate * (1.0 + in->clockSkewPpm * 1e-6));
+}
+
+// Captures BENCH_MIXER_SECONDS in virtual time on one thread: every input's
+// packets are pushed when its own skewed clock would deliver them, stamped
+// with jittered times, and the mixer is pulled after each master packet. The
+// alignment error is measured against where each input truly is, not against
+// the timestamps the mixer sees, and only CaptureMixerPull is timed.
+static void BenchMixerCase(Bench *b, const MixerBenchCase *bc) {
+    CaptureMixerConfig config = {0};
+    CaptureMixer m;
+    WavFormat formats[MIXER_MAX_INPUTS];
+    uint64_t packets[MIXER_MAX_INPUTS] = {0};
+    uint64_t endFrames = (uint64_t)BENCH_MIXER_SECONDS * bc->inputs[0].sampleRate;
+    uint64_t settleFrames = (uint64_t)(MIXER_SETTLE_SECONDS * bc->inputs[0].sampleRate);
+    uint32_t seed = 1;
+    double worstFrames[MIXER_MAX_INPUTS] = {0};
+    double settledPos[MIXER_MAX_INPUTS] = {0};
+    double worstAlign = 0.0;
+    double driftError = 0.0;
+    float *out;
+    BenchResult *r;
+
+    for (uint32_t i = 0; i < bc->inputCount; ++i) {
+        SampleFormat format = { SAMPLE_F32, bc->inputs[i].channels, 0 };
+        SampleFormatToWav(&format, bc->inputs[i].sampleRate, &formats[i]);
+    }
+    config.layout = bc->layout;
+    if (CaptureMixerInit(&m, formats, bc->inputCount, &config) != 0) {
+        b->failed = 1;
+        return;
+    }
+    out = (float *)malloc((size_t)MIXER_BLOCK_FRAMES * m.channels * sizeof(float));
+    if (!out) {
+        CaptureMixerClose(&m);
+        b->failed = 1;
+        return;
+    }
+
+    while (packets[0] * (bc->inputs[0].sampleRate / 100) < endFrames) {
+        const MixerBenchInput *in;
+        CapturePacket packet;
+        uint32_t next = 0;
+        uint32_t packetFrames;
+        double jitterNs;
+
+        // Whichever input delivers its next packet first, as the capture threads would
+        for (uint32_t i = 1; i < bc->inputCount; ++i) {
+            uint64_t end = (packets[i] + 1) * (bc->inputs[i].sampleRate / 100);
+            uint64_t nextEnd = (packets[next] + 1) * (bc->inputs[next].sampleRate / 100);
+            if (MixerBenchFrameNs(&bc->inputs[i], end) < MixerBenchFrameNs(&bc->inputs[next], nextEnd)) {
+                next = i;
+            }
+        }
+        in = &bc->inputs[next];
+        packetFrames = in->sampleRate / 100;
+
+        seed = seed * 1664525u + 1013904223u;
+        jitterNs = ((seed >> 8) / 16777216.0 * 2.0 - 1.0) * BENCH_MIXER_JITTER_MS * 1e6;
+        packet.data = (const uint8_t *)(b->signal + (size_t)(packets[next] % 100) * packetFrames * in->channels);
+        packet.frames = packetFrames;
+        packet.flags = 0;
+        packet.timestampNs = BENCH_MIXER_BASE_NS +
+                             (uint64_t)(MixerBenchFrameNs(in, packets[next] * packetFrames) + jitterNs);
+        if (CaptureMixerPush(&m, next, &packet) != 0) b->failed = 1;
+        packets[next]++;
+        if (next != 0) continue;
+
+        while (CaptureMixerPull(&m, out, MIXER_BLOCK_FRAMES) > 0) {
+            if (m.outFrames < settleFrames) continue;
+            if (settledPos[0] == 0.0) {
+                for (uint32_t i = 0; i < bc->inputCount; ++i) settledPos[i] = m.inputs[i].readPos;
+            }
+            for (uint32_t i = 1; i < bc->inputCount; ++i) {
+                const MixerBenchInput *bi = &bc->inputs[i];
+                double truth = m.inputs[0].readPos * bi->sampleRate * (1.0 + bi->clockSkewPpm * 1e-6) /
+                               bc->inputs[0].sampleRate;
+                double error = fabs(m.inputs[i].readPos - truth);
+                if (error > worstFrames[i]) worstFrames[i] = error;
+            }
+        }
+    }
+
+    // Drift as applied: how far each input was read against the master once settled
+    for (uint32_t i = 1; i < bc->inputCount; ++i) {
+        double align = worstFrames[i] / bc->inputs[i].sampleRate;
+        double ratio = (m.inputs[i].readPos - settledPos[i]) / (m.inputs[0].readPos - settledPos[0]);
+        double applied = (ratio / m.inputs[i].nominalRatio - 1.0) * 1e6;
+        double drift = fabs(applied - bc->inputs[i].clockSkewPpm);
+
+        if (!m.inputs[i].timed || m.inputs[i].stats.relocks > 0) b->failed = 1;
+        if (align > worstAlign) worstAlign = align;
+        if (drift > driftError) driftError = drift;
+    }
+
+    r = AddResult(b, "mixer", bc->name, 1, m.outFrames, m.sampleRate, m.mixNs);
+    if (r) {
+        r->driftErrorPpm = driftError;
+        r->worstAlignSeconds = worstAlign;
+    }
+    free(out);
+    CaptureMixerClose(&m);
+}
+
+static void BenchMixer(Bench *b) {
+    static const MixerBenchCase cases[] = {
+        { "48k_+250ppm", MIXER_LAYOUT_SUM, 2, { { 48000, 2, 0.0 }, { 48000, 2, 250.0 } } },
+        { "44k1_mono_-120ppm", MIXER_LAYOUT_SUM, 2, { { 48000, 2, 0.0 }, { 44100, 1, -120.0 } } },
+        { "multitrack_3_inputs", MIXER_LAYOUT_MULTITRACK, 3,
+          { { 48000, 2, 0.0 }, { 48000, 2, 250.0 }, { 44100, 1, -120.0 } } },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) BenchMixerCase(b, &cases[i]);
+}
+
+// Spectrum
+
+typedef struct {
+    Spectrogram spectrogram;
+    const float *signal;
+    uint32_t seconds;
+} SpectrumRun;
+
+static void RunSpectrogram(void *ctx) {
+    SpectrumRun *run = (SpectrumRun *)ctx;
+
+    for (uint32_t i = 0; i < run->seconds; ++i) {
+        SpectrogramProcess(&run->spectrogram, run->signal, BENCH_SAMPLE_RATE);
+    }
+}
+
+// Largest difference between the plan's magnitudes and a direct DFT in
+// double precision of the same windowed frame, or a negative value if the
+// plan could not be made
+static double SpectrumError(const float *signal, uint32_t size) {
+    SpectrumPlan plan;
+    SpectrumWork work;
+    float *magnitudes;
+    double *x;
+    double worst = 0.0;
+
+    if (SpectrumPlanInit(&plan, size) != 0) return -1.0;
+    magnitudes = (float *)malloc(plan.bins * sizeof(float));
+    x = (double *)malloc(size * sizeof(double));
+    if (!magnitudes || !x || SpectrumWorkInit(&work, &plan) != 0) {
+        free(magnitudes);
+        free(x);
+        SpectrumPlanClose(&plan);
+        return -1.0;
+    }
+
+    SpectrumTransform(&plan, &work, signal, magnitudes);
+    for (uint32_t n = 0; n < size; ++n) x[n] = (double)signal[n] * plan.window[n];
+    for (uint32_t k = 0; k < plan.bins; ++k) {
+        double re = 0.0, im = 0.0, reference;
+        for (uint32_t n = 0; n < size; ++n) {
+            double angle = -2.0 * BENCH_PI * (double)((uint64_t)k * n % size) / size;
+            re += x[n] * cos(angle);
+            im += x[n] * sin(angle);
+        }
+        reference = sqrt(re * re + im * im) * plan.scale;
+        if (k == 0 || k == plan.bins - 1) reference *= 0.5;
+        if (fabs(reference - magnitudes[k]) > worst) worst = fabs(reference - magnitudes[k]);
+    }
+
+    SpectrumWorkClose(&work);
+    SpectrumPlanClose(&plan);
+    free(magnitudes);
+    free(x);
+    return worst;
+}
+
+// Live analysis of the stereo signal at a quarter-frame hop, and a whole take
+// analyzed on one and on several threads
+static void BenchSpectrum(Bench *b) {
+    static const uint32_t sizes[] = { 512, 2048, 8192 };
+    SpectrogramConfig config = {0};
+    SampleFormat floatFormat = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+    WavFormat format;
+    SpectrumRun run;
+    char name[40];
+
+    SampleFormatToWav(&floatFormat, BENCH_SAMPLE_RATE, &format);
+
+    // Every size is checked, though only the timed ones are reported
+    for (uint32_t size = SPECTRUM_MIN_SIZE; size <= 8192; size *= 2) {
+        double error = SpectrumError(b->signal, size);
+        if (error < 0.0 || error > BENCH_SPECTRUM_TOLERANCE) {
+            fprintf(stderr, "Spectrum of size %u is off by %g against the direct DFT\n", size, error);
+            b->failed = 1;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        BenchResult *r;
+
+        config.fftSize = sizes[i];
+        config.hop = sizes[i] / 4;
+        if (SpectrogramInit(&run.spectrogram, &format, &config) != 0) {
+            b->failed = 1;
+            continue;
+        }
+        run.signal = b->signal;
+        run.seconds = BENCH_KERNEL_SECONDS;
+
+        snprintf(name, sizeof(name), "stft_%u_hop_%u", config.fftSize, config.hop);
+        r = AddResult(b, "spectrum", name, 1, (uint64_t)run.seconds * BENCH_SAMPLE_RATE, BENCH_SAMPLE_RATE,
+                      TimeBest(RunSpectrogram, &run));
+        if (r) r->maxError = SpectrumError(b->signal, sizes[i]);
+        SpectrogramClose(&run.spectrogram);
+    }
+
+    // A take in memory, as the GUI holds it after recording
+    {
+        SampleFormat takeFormat = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+        TakeStorage take;
+        TakeSlice slice;
+
+        if (TakeStorageOpen(&take, NULL, SampleFormatFrameBytes(&takeFormat)) != 0) {
+            b->failed = 1;
+            return;
+        }
+        for (uint32_t i = 0; i < BENCH_SPECTRUM_TAKE_SECONDS; ++i) {
+            if (TakeStorageAppend(&take, b->signal, (size_t)BENCH_SAMPLE_RATE * BENCH_CHANNELS * sizeof(float)) != 0) {
+                b->failed = 1;
+                TakeStorageClose(&take);
+                return;
+            }
+        }
+        slice = TakeStorageSlice(&take, 0, TakeStorageFrames(&take));
+
+        config.fftSize = SPECTRUM_DEFAULT_SIZE;
+        config.hop = SPECTRUM_DEFAULT_HOP;
+        for (uint32_t i = 0; i < (b->threads > 0 ? 2u : 1u); ++i) {
+            TakeSpectrogram result;
+
+            if (TakeSpectrogramCompute(&result, &slice, &format, &config, i ? b->threads : 0) != 0) {
+                b->failed = 1;
+            } else {
+                snprintf(name, sizeof(name), "take_%u_hop_%u", config.fftSize, config.hop);
+                AddResult(b, "spectrum", name, result.threads, slice.frameCount, BENCH_SAMPLE_RATE, result.elapsedNs);
+                TakeSpectrogramClose(&result);
+            }
+        }
+        TakeStorageClose(&take);
+    }
+}
+
+// Slicing
+
+typedef enum {
+    SLICE_HIT_KICK = 0,           // Sine falling from 150 Hz to 50 Hz
+    SLICE_HIT_SNARE,              // Noise burst
+    SLICE_HIT_CLICK,              // Short high tone
+    SLICE_HIT_KINDS
+} SliceHitKind;
+
+typedef struct {
+    uint64_t frame;
+    uint64_t length;
+    SliceHitKind kind;
+    float amplitude;
+    float pan;                    // Left channel gain; the right gets 1 - pan
+    float decay;                  // Envelope time constant in frames
+    float frequency;
+} SliceHit;
+
+static uint32_t HashNoise(uint32_t a, uint32_t b) {
+    uint32_t h = a * 0x9E3779B9u ^ b * 0x85EBCA6Bu;
+
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static float HitSample(const SliceHit *hit, uint32_t index, uint64_t t) {
+    double seconds = (double)t / BENCH_SAMPLE_RATE;
+    double env = hit->amplitude * exp(-(double)t / hit->decay);
+
+    switch (hit->kind) {
+    case SLICE_HIT_KICK:
+        return (float)(env * sin(2.0 * BENCH_PI * (50.0 * seconds + 100.0 * 0.03 * (1.0 - exp(-seconds / 0.03)))));
+    case SLICE_HIT_SNARE:
+        return (float)(env * ((float)HashNoise(index, (uint32_t)t) / 4294967296.0f * 2.0f - 1.0f));
+    default:
+        return (float)(env * sin(2.0 * BENCH_PI * hit->frequency * seconds));
+    }
+}
+
+// Random hits 80 to 600 ms apart between -30 and -3 dBFS, each far enough
+// after the last that its tail has fallen 18 dB under the new hit.
+static uint32_t MakeSliceHits(SliceHit *hits, uint32_t capacity, uint64_t frames) {
+    uint32_t state = 0x2545F491u;
+    uint64_t frame = BENCH_SAMPLE_RATE / 4;
+    uint32_t count = 0;
+
+    while (count < capacity) {
+        SliceHit *hit = &hits[count];
+        double r[5];
+
+        for (int i = 0; i < 5; ++i) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            r[i] = state / 4294967296.0;
+        }
+        hit->kind = (SliceHitKind)(r[0] * SLICE_HIT_KINDS);
+        hit->amplitude = (float)pow(10.0, (-30.0 + 27.0 * r[1]) / 20.0);
+        hit->pan = (float)(0.3 + 0.4 * r[2]);
+        hit->frequency = (float)(1000.0 + 3000.0 * r[3]);
+        hit->decay = (hit->kind == SLICE_HIT_KICK ? 0.12f : hit->kind == SLICE_HIT_SNARE ? 0.04f : 0.015f) *
+                     BENCH_SAMPLE_RATE;
+        hit->length = (uint64_t)(hit->decay * 7.0f);
+
+        if (count > 0) {
+            const SliceHit *last = &hits[count - 1];
+            double gap = (0.08 + 0.52 * r[4]) * BENCH_SAMPLE_RATE;
+            double clear = last->decay * log(8.0 * last->amplitude / hit->amplitude);
+
+            frame = last->frame + (uint64_t)(gap > clear ? gap : clear);
+        }
+        if (frame + hit->length >= frames) break;
+        hit->frame = frame;
+        count++;
+    }
+    return count;
+}
+
+// Renders the hits over the noise floor as 16-bit stereo into the take
+static int RenderSliceHits(TakeStorage *take, const SliceHit *hits, uint32_t count, uint64_t frames) {
+    float *block = (float *)malloc((size_t)BENCH_BLOCK_FRAMES * BENCH_CHANNELS * sizeof(float));
+    int16_t *block16 = (int16_t *)malloc((size_t)BENCH_BLOCK_FRAMES * BENCH_CHANNELS * sizeof(int16_t));
+    float noise = (float)pow(10.0, BENCH_SLICE_NOISE_DB / 20.0) * 1.7320508f;    // Uniform noise of that RMS
+    uint32_t first = 0;
+    int result = 0;
+
+    if (!block || !block16) result = -1;
+    for (uint64_t start = 0; result == 0 && start < frames; start += BENCH_BLOCK_FRAMES) {
+        uint32_t n = frames - start < BENCH_BLOCK_FRAMES ? (uint32_t)(frames - start) : BENCH_BLOCK_FRAMES;
+
+        for (uint32_t i = 0; i < n * BENCH_CHANNELS; ++i) {
+            block[i] = noise * ((float)HashNoise(0xFFFFFFFFu, (uint32_t)(start * BENCH_CHANNELS + i)) /
+                                4294967296.0f * 2.0f - 1.0f);
+        }
+        while (first < count && hits[first].frame + hits[first].length <= start) first++;
+        for (uint32_t h = first; h < count && hits[h].frame < start + n; ++h) {
+            const SliceHit *hit = &hits[h];
+            uint64_t from = hit->frame > start ? hit->frame : start;
+            uint64_t to = hit->frame + hit->length < start + n ? hit->frame + hit->length : start + n;
+
+            for (uint64_t f = from; f < to; ++f) {
+                float x = HitSample(hit, h, f - hit->frame);
+                block[(f - start) * BENCH_CHANNELS] += x * hit->pan;
+                block[(f - start) * BENCH_CHANNELS + 1] += x * (1.0f - hit->pan);
+            }
+        }
+        ConvertFloatToS16(block16, block, (size_t)n * BENCH_CHANNELS, NULL);
+        result = TakeStorageAppend(take, block16, (size_t)n * BENCH_CHANNELS * sizeof(int16_t));
+    }
+    free(block);
+    free(block16);
+    return result;
+}
+
+// Matches the slice map against the true onsets, both in stream order. Slices
+// must start no later than their onset, and by no more than the snap and
+// fade-in before it.
+static void CheckSliceMap(const char *path, const SliceHit *hits, uint32_t count, uint32_t rate, BenchResult *r,
+                          int *failed) {
+    FILE *f = fopen(path, "rb");
+    uint64_t tolerance = (uint64_t)(BENCH_SLICE_TOLERANCE_MS * rate / 1000.0);
+    uint64_t lead = (uint64_t)((SLICER_DEFAULT_SNAP_MS + SLICER_DEFAULT_FADE_IN_MS) * rate / 1000.0) + tolerance;
+    uint32_t h = 0;
+    char *text;
+    const char *p;
+    long size;
+
+    if (!f) {
+        *failed = 1;
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    text = (char *)malloc((size_t)size + 1);
+    if (!text || fread(text, 1, (size_t)size, f) != (size_t)size) {
+        free(text);
+        fclose(f);
+        *failed = 1;
+        return;
+    }
+    text[size] = '\0';
+    fclose(f);
+
+    for (p = strstr(text, "\"start_frame\": "); p; p = strstr(p + 1, "\"start_frame\": ")) {
+        const char *onsetField = strstr(p, "\"onset_frame\": ");
+        uint64_t start = strtoull(p + 15, NULL, 10);
+        uint64_t onset;
+        uint64_t error;
+
+        if (!onsetField) break;
+        onset = strtoull(onsetField + 15, NULL, 10);
+        while (h < count && hits[h].frame + tolerance < onset) {
+            r->onsetsMissed++;
+            h++;
+        }
+        if (h == count) {
+            r->onsetsExtra++;
+            continue;
+        }
+        error = onset > hits[h].frame ? onset - hits[h].frame : hits[h].frame - onset;
+        if (error > tolerance || start > hits[h].frame || start + lead < hits[h].frame) {
+            r->onsetsExtra++;
+            continue;
+        }
+        if ((double)error / rate > r->worstOnsetSeconds) r->worstOnsetSeconds = (double)error / rate;
+        h++;
+    }
+    r->onsetsMissed += count - h;
+    free(text);
+    if (r->onsetsMissed || r->onsetsExtra) {
+        fprintf(stderr, "Slicing missed %u of %u onsets and found %u that are not there\n", r->onsetsMissed, count,
+                r->onsetsExtra);
+        *failed = 1;
+    }
+}
+
+// Synthetic percussion with known onsets, sliced to files in one pass
+static void BenchSlice(Bench *b) {
+    uint64_t frames = (uint64_t)BENCH_SLICE_SECONDS * BENCH_SAMPLE_RATE;
+    uint32_t capacity = BENCH_SLICE_SECONDS * 1000 / 80;
+    SliceHit *hits = (SliceHit *)malloc(capacity * sizeof(SliceHit));
+    OnsetSlicerConfig config = {0};
+    OnsetSlicerStats stats;
+    WavFormat format;
+    TakeStorage take;
+    TakeSlice slice;
+    char prefix[64];
+    char path[96];
+    uint32_t count;
+    int result;
+
+    if (!hits || TakeStorageOpen(&take, NULL, BENCH_CHANNELS * sizeof(int16_t)) != 0) {
+        free(hits);
+        b->failed = 1;
+        return;
+    }
+    count = MakeSliceHits(hits, capacity, frames);
+    if (RenderSliceHits(&take, hits, count, frames) != 0) {
+        TakeStorageClose(&take);
+        free(hits);
+        b->failed = 1;
+        return;
+    }
+
+    S16Format(&format);
+    slice = TakeStorageSlice(&take, 0, frames);
+    ScratchPath(prefix, sizeof(prefix), "_slice");
+    config.prefix = prefix;
+    result = SliceTake(&slice, &format, &config, &stats);
+
+    if (result != 0) {
+        b->failed = 1;
+    } else {
+        BenchResult *r = AddResult(b, "slice", "onsets_s16", 1, frames, BENCH_SAMPLE_RATE,
+                                   stats.endNs - stats.startNs);
+        int failed = 0;
+
+        snprintf(path, sizeof(path), "%s.json", prefix);
+        if (r) CheckSliceMap(path, hits, count, BENCH_SAMPLE_RATE, r, &failed);
+        if (failed) b->failed = 1;
+    }
+    for (uint64_t i = 1; i <= stats.slices; ++i) {
+        snprintf(path, sizeof(path), "%s_%03u.wav", prefix, (unsigned)i);
+        remove(path);
+    }
+    snprintf(path, sizeof(path), "%s.json", prefix);
+    remove(path);
+    TakeStorageClose(&take);
+    free(hits);
+}
+
+// Loudness
+
+typedef struct {
+    double seconds;
+    double level;                 // Sine peak, dBFS
+} LoudnessSegment;
+
+// A sine in both channels, or the left only, through segments of level
+typedef struct {
+    const char *name;
+    double frequency;             // 0: a quarter of the sample rate
+    double phase;
+    int leftOnly;
+    LoudnessSegment segments[5];
+    uint32_t segmentCount;
+    double loudness;              // Reference LUFS; NAN: none
+    double truePeak;              // Reference dBTP
+} LoudnessCase;
+
+// EBU Tech 3341 minimum requirement signals 1 to 5, the BS.1770 single
+// channel calibration tone and a true peak signal whose samples all miss
+// the peaks
+static const LoudnessCase loudnessCases[] = {
+    { "ebu3341_1", 1000.0, 0.0, 0, { { 20.0, -23.0 } }, 1, -23.0, -23.0 },
+    { "ebu3341_2", 1000.0, 0.0, 0, { { 20.0, -33.0 } }, 1, -33.0, -33.0 },
+    { "ebu3341_3", 1000.0, 0.0, 0, { { 10.0, -36.0 }, { 60.0, -23.0 }, { 10.0, -36.0 } }, 3, -23.0, -23.0 },
+    { "ebu3341_4", 1000.0, 0.0, 0,
+      { { 10.0, -72.0 }, { 10.0, -36.0 }, { 60.0, -23.0 }, { 10.0, -36.0 }, { 10.0, -72.0 } }, 5, -23.0, -23.0 },
+    { "ebu3341_5", 1000.0, 0.0, 0, { { 20.0, -26.0 }, { 20.1, -20.0 }, { 20.0, -26.0 } }, 3, -23.0, -20.0 },
+    { "bs1770_left_997", 997.0, 0.0, 1, { { 20.0, 0.0 } }, 1, -3.01, 0.0 },
+    { "true_peak_fs4_45deg", 0.0, BENCH_PI / 4.0, 0, { { 20.0, 0.0 } }, 1, NAN, 0.0 },
+};
+
+typedef struct {
+    LoudnessMeter *meter;
+    const float *frames;
+    uint64_t frameCount;
+} LoudnessRun;
+
+static void RunLoudness(void *ctx) {
+    LoudnessRun *run = (LoudnessRun *)ctx;
+
+    LoudnessMeterReset(run->meter);
+    for (uint64_t done = 0; done < run->frameCount; done += BENCH_BLOCK_FRAMES) {
+        uint64_t n = run->frameCount - done < BENCH_BLOCK_FRAMES ? run->frameCount - done : BENCH_BLOCK_FRAMES;
+        LoudnessMeterProcess(run->meter, run->frames + done * BENCH_CHANNELS, (uint32_t)n);
+    }
+}
+
+static uint64_t RenderLoudnessCase(const LoudnessCase *c, float *out) {
+    double frequency = c->frequency > 0.0 ? c->frequency : BENCH_SAMPLE_RATE / 4.0;
+    double step = 2.0 * BENCH_PI * frequency / BENCH_SAMPLE_RATE;
+    uint64_t t = 0;
+
+    for (uint32_t s = 0; s < c->segmentCount; ++s) {
+        uint64_t end = t + (uint64_t)(c->segments[s].seconds * BENCH_SAMPLE_RATE + 0.5);
+        double amplitude = pow(10.0, c->segments[s].level / 20.0);
+
+        for (; t < end; ++t) {
+            float v = (float)(amplitude * sin(step * (double)t + c->phase));
+            out[t * BENCH_CHANNELS] = v;
+            for (uint16_t ch = 1; ch < BENCH_CHANNELS; ++ch) out[t * BENCH_CHANNELS + ch] = c->leftOnly ? 0.0f : v;
+        }
+    }
+    return t;
+}
+
+// Sets the result's readings and errors; returns -1 if any is out of tolerance
+static int CheckLoudness(BenchResult *r, const LoudnessSummary *summary, double loudness, double truePeak) {
+    r->loudness = summary->integrated;
+    r->truePeak = summary->truePeak;
+    r->loudnessError = isnan(loudness) ? 0.0 : summary->integrated - loudness;
+    r->truePeakError = summary->truePeak - truePeak;
+    if (!isfinite(summary->integrated) && !isnan(loudness)) return -1;
+    if (fabs(r->loudnessError) > BENCH_LOUDNESS_TOLERANCE) return -1;
+    if (r->truePeakError > BENCH_TRUE_PEAK_OVER || r->truePeakError < -BENCH_TRUE_PEAK_UNDER) return -1;
+    return 0;
+}
+
+static void BenchLoudnessCases(Bench *b) {
+    uint64_t capacity = 0;
+    LoudnessMeter meter;
+    WavFormat format;
+    SampleFormat floatFormat = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+    float *frames;
+
+    for (size_t i = 0; i < sizeof(loudnessCases) / sizeof(loudnessCases[0]); ++i) {
+        double seconds = 0.0;
+        for (uint32_t s = 0; s < loudnessCases[i].segmentCount; ++s) seconds += loudnessCases[i].segments[s].seconds;
+        if ((uint64_t)(seconds * BENCH_SAMPLE_RATE) + 8 > capacity) capacity = (uint64_t)(seconds * BENCH_SAMPLE_RATE) + 8;
+    }
+    SampleFormatToWav(&floatFormat, BENCH_SAMPLE_RATE, &format);
+    frames = (float *)malloc(capacity * BENCH_CHANNELS * sizeof(float));
+    if (!frames || LoudnessMeterInit(&meter, &format) != 0) {
+        free(frames);
+        b->failed = 1;
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(loudnessCases) / sizeof(loudnessCases[0]); ++i) {
+        const LoudnessCase *c = &loudnessCases[i];
+        LoudnessRun run = { &meter, frames, RenderLoudnessCase(c, frames) };
+        uint64_t ns = TimeBest(RunLoudness, &run);
+        BenchResult *r = AddResult(b, "loudness", c->name, 1, run.frameCount, BENCH_SAMPLE_RATE, ns);
+        LoudnessSummary summary;
+
+        LoudnessMeterRead(&meter, &summary);
+        if (r && CheckLoudness(r, &summary, c->loudness, c->truePeak) != 0) b->failed = 1;
+    }
+    LoudnessMeterClose(&meter);
+    free(frames);
+}
+
+// A tone with a short loud burst every other second: the gain to the target
+// puts the bursts over the ceiling, and limiting them takes little off the
+// loudness
+static float NormalizeSample(uint64_t t) {
+    double seconds = (double)t / BENCH_SAMPLE_RATE;
+    double inPeriod = fmod(seconds, 2.0);
+    double v = pow(10.0, -20.0 / 20.0) * sin(2.0 * BENCH_PI * 1000.0 * seconds);
+
+    if (inPeriod < 0.002) v += 0.5 * sin(BENCH_PI * inPeriod / 0.002) * sin(2.0 * BENCH_PI * 3000.0 * seconds);
+    return (float)v;
+}
+
+// Measures an exported file as a loaded take is measured
+static int MeasureFile(const char *path, LoudnessSummary *summary) {
+    WavReader reader;
+    LoudnessMeter meter;
+    uint8_t *buffer;
+    uint32_t n;
+
+    if (WavReaderOpen(&reader, path) != 0) return -1;
+    buffer = (uint8_t *)malloc((size_t)BENCH_BLOCK_FRAMES * reader.blockAlign);
+    if (!buffer || LoudnessMeterInit(&meter, &reader.format) != 0) {
+        free(buffer);
+        WavReaderClose(&reader);
+        return -1;
+    }
+    while ((n = WavReaderRead(&reader, buffer, BENCH_BLOCK_FRAMES)) != 0) LoudnessMeterProcess(&meter, buffer, n);
+    LoudnessMeterRead(&meter, summary);
+    LoudnessMeterClose(&meter);
+    free(buffer);
+    WavReaderClose(&reader);
+    return 0;
+}
+
+// Exports the take at the target loudness, then measures the file it wrote
+static void BenchNormalize(Bench *b, const TakeSlice *slice, const WavFormat *format, const LoudnessSummary *measured,
+                           uint32_t outRate) {
+    TakeExportConfig config = {0};
+    TakeExport exporter;
+    LoudnessSummary summary;
+    BenchResult *r;
+    char path[64];
+    char name[40];
+
+    ScratchPath(path, sizeof(path), "_normal.wav");
+    config.path = path;
+    config.outType = SAMPLE_S16;
+    config.outRate = outRate;
+    config.threads = b->threads;
+    config.dither = 1;
+    config.normalize = 1;
+    config.targetLufs = BENCH_NORMALIZE_TARGET;
+    config.ceilingDbtp = LOUDNESS_DEFAULT_CEILING_DBTP;
+    config.loudness = *measured;
+
+    if (TakeExportStart(&exporter, slice, format, &config) != 0 || TakeExportWait(&exporter) != 0 ||
+        MeasureFile(path, &summary) != 0) {
+        b->failed = 1;
+        remove(path);
+        return;
+    }
+    remove(path);
+
+    snprintf(name, sizeof(name), outRate ? "normalize_s16_%u" : "normalize_s16", outRate);
+    r = AddResult(b, "loudness", name, exporter.stats.threads, slice->frameCount, BENCH_SAMPLE_RATE,
+                  exporter.stats.endNs - exporter.stats.startNs);
+    if (!r) return;
+    r->loudness = summary.integrated;
+    r->loudnessError = summary.integrated - BENCH_NORMALIZE_TARGET;
+    r->truePeak = summary.truePeak;
+    r->truePeakError = summary.truePeak - LOUDNESS_DEFAULT_CEILING_DBTP;
+    if (exporter.stats.limitedFrames == 0 || fabs(r->loudnessError) > BENCH_NORMALIZE_TOLERANCE ||
+        r->truePeakError > BENCH_TRUE_PEAK_OVER) {
+        b->failed = 1;
+    }
+}
+
+// The take is measured as it is built, as a recording is measured as it is stored
+static void BenchNormalizes(Bench *b) {
+    SampleFormat floatFormat = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+    uint64_t frames = (uint64_t)BENCH_NORMALIZE_SECONDS * BENCH_SAMPLE_RATE;
+    float block[BENCH_BLOCK_FRAMES * BENCH_CHANNELS];
+    LoudnessMeter meter;
+    LoudnessSummary measured;
+    TakeStorage take;
+    WavFormat format;
+    int result = 0;
+
+    SampleFormatToWav(&floatFormat, BENCH_SAMPLE_RATE, &format);
+    if (TakeStorageOpen(&take, NULL, BENCH_CHANNELS * sizeof(float)) != 0) {
+        b->failed = 1;
+        return;
+    }
+    if (LoudnessMeterInit(&meter, &format) != 0) {
+        TakeStorageClose(&take);
+        b->failed = 1;
+        return;
+    }
+    for (uint64_t t = 0; result == 0 && t < frames; t += BENCH_BLOCK_FRAMES) {
+        uint32_t n = frames - t < BENCH_BLOCK_FRAMES ? (uint32_t)(frames - t) : BENCH_BLOCK_FRAMES;
+
+        for (uint32_t i = 0; i < n; ++i) {
+            float v = NormalizeSample(t + i);
+            for (uint16_t ch = 0; ch < BENCH_CHANNELS; ++ch) block[i * BENCH_CHANNELS + ch] = v;
+        }
+        result = TakeStorageAppend(&take, block, (size_t)n * BENCH_CHANNELS * sizeof(float));
+        LoudnessMeterProcess(&meter, block, n);
+    }
+    LoudnessMeterRead(&meter, &measured);
+    LoudnessMeterClose(&meter);
+
+    if (result != 0) {
+        b->failed = 1;
+    } else {
+        TakeSlice slice = TakeStorageSlice(&take, 0, frames);
+
+        BenchNormalize(b, &slice, &format, &measured, 0);
+        BenchNormalize(b, &slice, &format, &measured, 44100);
+    }
+    TakeStorageClose(&take);
+}
+
+// Edits
+
+typedef enum {
+    BENCH_EDIT_TRIM = 0,
+    BENCH_EDIT_CUT,
+    BENCH_EDIT_GAIN,
+    BENCH_EDIT_FADE_IN,
+    BENCH_EDIT_FADE_OUT,
+    BENCH_EDIT_KINDS
+} BenchEditKind;
+
+typedef struct {
+    BenchEditKind kind;
+    uint64_t start;
+    uint64_t frames;
+    double gainDb;
+} BenchEdit;
+
+// The reference: edits applied eagerly to a copy of the take, every frame
+// carrying its own gain and fade levels along with it through trims and cuts
+typedef struct {
+    float *samples;
+    float *gain;
+    float *fadeIn;
+    float *fadeOut;
+    uint64_t frames;
+} EagerEdit;
+
+static uint32_t NextRandom(uint32_t *state) {
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void EagerReset(EagerEdit *e, const float *source, uint64_t frames) {
+    memcpy(e->samples, source, (size_t)frames * BENCH_CHANNELS * sizeof(float));
+    for (uint64_t i = 0; i < frames; ++i) e->gain[i] = e->fadeIn[i] = e->fadeOut[i] = 1.0f;
+    e->frames = frames;
+}
+
+static void EagerMove(EagerEdit *e, uint64_t from, uint64_t to, uint64_t frames) {
+    memmove(e->samples + to * BENCH_CHANNELS, e->samples + from * BENCH_CHANNELS,
+            (size_t)frames * BENCH_CHANNELS * sizeof(float));
+    memmove(e->gain + to, e->gain + from, (size_t)frames * sizeof(float));
+    memmove(e->fadeIn + to, e->fadeIn + from, (size_t)frames * sizeof(float));
+    memmove(e->fadeOut + to, e->fadeOut + from, (size_t)frames * sizeof(float));
+}
+
+// Clamps ranges as the edit list does
+static void EagerApply(EagerEdit *e, const BenchEdit *edit) {
+    uint64_t start = edit->start;
+    uint64_t frames = edit->frames;
+    float gain;
+
+    if (start >= e->frames || frames == 0) return;
+    if (frames > e->frames - start) frames = e->frames - start;
+
+    switch (edit->kind) {
+    case BENCH_EDIT_TRIM:
+        EagerMove(e, start, 0, frames);
+        e->frames = frames;
+        break;
+    case BENCH_EDIT_CUT:
+        EagerMove(e, start + frames, start, e->frames - start - frames);
+        e->frames -= frames;
+        break;
+    case BENCH_EDIT_GAIN:
+        gain = (float)pow(10.0, edit->gainDb / 20.0);
+        for (uint64_t i = 0; i < frames; ++i) e->gain[start + i] *= gain;
+        break;
+    case BENCH_EDIT_FADE_IN:
+        for (uint64_t i = 0; i < frames; ++i) e->fadeIn[start + i] = (float)((i + 0.5) / frames);
+        break;
+    case BENCH_EDIT_FADE_OUT:
+        for (uint64_t i = 0; i < frames; ++i) e->fadeOut[start + i] = (float)(((double)(frames - i) - 0.5) / frames);
+        break;
+    default:
+        break;
+    }
+}
+
+static void EagerRender(const EagerEdit *e, float *out) {
+    for (uint64_t i = 0; i < e->frames; ++i) {
+        float gain = e->gain[i] * e->fadeIn[i] * e->fadeOut[i];
+        for (uint32_t ch = 0; ch < BENCH_CHANNELS; ++ch) {
+            out[i * BENCH_CHANNELS + ch] = e->samples[i * BENCH_CHANNELS + ch] * gain;
+        }
+    }
+}
+
+static int ApplyEdit(EditList *list, const BenchEdit *edit) {
+    switch (edit->kind) {
+    case BENCH_EDIT_TRIM: return EditListTrim(list, edit->start, edit->frames);
+    case BENCH_EDIT_CUT: return EditListCut(list, edit->start, edit->frames);
+    case BENCH_EDIT_GAIN: return EditListGain(list, edit->start, edit->frames, edit->gainDb);
+    case BENCH_EDIT_FADE_IN: return EditListFadeIn(list, edit->start, edit->frames);
+    case BENCH_EDIT_FADE_OUT: return EditListFadeOut(list, edit->start, edit->frames);
+    default: return -1;
+    }
+}
+
+// Ranges other than trims may run past the end, to exercise clamping. Trims
+// and cuts stop once the edit is down to half the take.
+static void RandomEdit(uint32_t *seed, uint64_t frames, uint64_t takeFrames, BenchEdit *edit) {
+    memset(edit, 0, sizeof(*edit));
+    edit->kind = (BenchEditKind)(NextRandom(seed) % BENCH_EDIT_KINDS);
+    if (frames < takeFrames / 2 && edit->kind <= BENCH_EDIT_CUT) edit->kind = BENCH_EDIT_GAIN;
+
+    switch (edit->kind) {
+    case BENCH_EDIT_TRIM: edit->frames = frames * (80 + NextRandom(seed) % 20) / 100; break;
+    case BENCH_EDIT_CUT: edit->frames = 1 + NextRandom(seed) % (frames / 20); break;
+    case BENCH_EDIT_GAIN: edit->frames = 1 + NextRandom(seed) % (frames / 2); break;
+    default: edit->frames = 1 + NextRandom(seed) % (frames / 5); break;
+    }
+    edit->start = NextRandom(seed) % (edit->kind == BENCH_EDIT_TRIM ? frames - edit->frames + 1 : frames);
+    edit->gainDb = (double)(NextRandom(seed) % 1400) / 100.0 - 12.0;
+}
+
+// Renders the whole edit in blocks of random length, timing only the renders.
+// Returns the worst difference from the eager render in expected, or INFINITY
+// if the lengths differ.
+static double CompareRender(const EditList *list, const float *expected, uint64_t expectedFrames, float *out,
+                            uint32_t *seed, uint64_t *ns) {
+    uint64_t frame = 0;
+    double worst = 0.0;
+
+    while (frame < EditListFrames(list)) {
+        uint32_t n = 1 + NextRandom(seed) % 8192;
+        uint64_t start = PlatformNowNs();
+        uint32_t rendered = EditListRender(list, frame, n, out + frame * BENCH_CHANNELS);
+
+        *ns += PlatformNowNs() - start;
+        if (rendered == 0) break;
+        frame += rendered;
+    }
+    if (frame != expectedFrames || EditListFrames(list) != expectedFrames) return INFINITY;
+
+    for (size_t i = 0; i < (size_t)expectedFrames * BENCH_CHANNELS; ++i) {
+        double error = fabs((double)out[i] - expected[i]);
+        if (error > worst) worst = error;
+    }
+    return worst;
+}
+
+// Reads a whole WAV file as float. Returns the number of frames read, or -1.
+static int64_t ReadWavFloats(const char *path, float *dst, uint64_t capacity) {
+    WavReader reader;
+    SampleFormat inSamples;
+    SampleFormat outSamples;
+    SampleConverter toFloat;
+    uint8_t *buffer;
+    uint32_t n;
+    uint64_t frames = 0;
+
+    if (WavReaderOpen(&reader, path) != 0) return -1;
+    buffer = (uint8_t *)malloc((size_t)BENCH_BLOCK_FRAMES * reader.blockAlign);
+    if (!buffer || reader.format.channels != BENCH_CHANNELS || SampleFormatFromWav(&reader.format, &inSamples) != 0) {
+        free(buffer);
+        WavReaderClose(&reader);
+        return -1;
+    }
+    outSamples = inSamples;
+    outSamples.type = SAMPLE_F32;
+    SampleConverterInit(&toFloat, &inSamples, &outSamples);
+
+    while ((n = WavReaderRead(&reader, buffer, BENCH_BLOCK_FRAMES)) != 0 && frames + n <= capacity) {
+        SampleConverterRun(&toFloat, dst + frames * BENCH_CHANNELS, buffer, n, NULL);
+        frames += n;
+    }
+    free(buffer);
+    WavReaderClose(&reader);
+    return n == 0 ? (int64_t)frames : -1;
+}
+
+static double MaxDifference(const float *a, const float *b, uint64_t frames) {
+    double worst = 0.0;
+
+    for (size_t i = 0; i < (size_t)frames * BENCH_CHANNELS; ++i) {
+        double error = fabs((double)a[i] - b[i]);
+        if (error > worst) worst = error;
+    }
+    return worst;
+}
+
+static BenchResult *AddEditResult(Bench *b, const char *name, uint32_t threads, uint64_t frames, uint64_t ns,
+                                  uint32_t edits, double maxError, double tolerance) {
+    BenchResult *r = AddResult(b, "edit", name, threads, frames, BENCH_SAMPLE_RATE, ns);
+
+    if (!(maxError <= tolerance)) b->failed = 1;
+    if (!r) return NULL;
+    r->edits = edits;
+    r->maxError = maxError;
+    return r;
+}
+
+typedef struct {
+    EditList *list;
+    uint64_t frames;
+} TrimRun;
+
+static void RunTrimUndo(void *ctx) {
+    TrimRun *run = (TrimRun *)ctx;
+
+    EditListTrim(run->list, run->frames / 4, run->frames / 2);
+    EditListUndo(run->list);
+}
+
+// Plays the edit to a WAV file through the file sink, and checks it against
+// the reference as 16-bit playback rounds it
+static void BenchEditPlayback(Bench *b, const TakeSlice *slice, const WavFormat *format, const EditList *list,
+                              const float *expected, float *readBack) {
+    OutputSink *sink = NULL;
+    PlaybackStream stream;
+    char path[64];
+    uint64_t start = PlatformNowNs();
+    int64_t frames = -1;
+    int result;
+
+    ScratchPath(path, sizeof(path), "_edit_play.wav");
+    if (CreateFileOutputSink(path, 0, &sink) != 0) {
+        b->failed = 1;
+        return;
+    }
+    if (PlaybackStreamOpen(&stream, sink, slice, list, format, 0) == 0) {
+        while ((result = PlaybackStreamPump(&stream, PLAYBACK_WAIT_MS)) > 0) {
+        }
+        PlaybackStreamClose(&stream);
+        if (result == 0) frames = ReadWavFloats(path, readBack, EditListFrames(list));
+    }
+    uint64_t ns = PlatformNowNs() - start;
+    sink->lpVtbl->Destroy(sink);
+    remove(path);
+
+    if (frames != (int64_t)EditListFrames(list)) {
+        b->failed = 1;
+        return;
+    }
+    AddEditResult(b, "playback_s16", 1, (uint64_t)frames, ns, list->undoCount,
+                  MaxDifference(readBack, expected, (uint64_t)frames), BENCH_EDIT_S16_TOLERANCE);
+}
+
+static int ExportEdit(Bench *b, const TakeSlice *slice, const WavFormat *format, const EditList *list,
+                      uint32_t outRate, const char *path, uint64_t *ns) {
+    TakeExportConfig config = {0};
+    TakeExport exporter;
+
+    config.path = path;
+    config.outType = SAMPLE_F32;
+    config.outRate = outRate;
+    config.threads = b->threads;
+    config.edits = list;
+    if (TakeExportStart(&exporter, slice, format, &config) != 0) return -1;
+    if (TakeExportWait(&exporter) != 0) return -1;
+    *ns = exporter.stats.endNs - exporter.stats.startNs;
+    return 0;
+}
+
+// Exports the edit to float WAV, checked against the reference; resampled, it
+// is checked against exporting the reference itself as a take
+static void BenchEditExports(Bench *b, const TakeSlice *slice, const WavFormat *format, const EditList *list,
+                             const float *expected, float *readBack, float *readReference) {
+    SampleFormat floatSamples = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+    uint64_t frames = EditListFrames(list);
+    TakeStorage reference;
+    WavFormat floatFormat;
+    char path[64];
+    char referencePath[64];
+    uint64_t ns = 0;
+    uint64_t referenceNs = 0;
+    int64_t written = -1;
+    int64_t referenceWritten = -1;
+
+    ScratchPath(path, sizeof(path), "_edit.wav");
+    ScratchPath(referencePath, sizeof(referencePath), "_edit_reference.wav");
+    if (ExportEdit(b, slice, format, list, 0, path, &ns) == 0) written = ReadWavFloats(path, readBack, frames);
+    remove(path);
+    if (written != (int64_t)frames) {
+        b->failed = 1;
+        return;
+    }
+    AddEditResult(b, "export_f32", b->threads, frames, ns, list->undoCount,
+                  MaxDifference(readBack, expected, frames), BENCH_EDIT_TOLERANCE);
+
+    SampleFormatToWav(&floatSamples, BENCH_SAMPLE_RATE, &floatFormat);
+    if (TakeStorageOpen(&reference, NULL, SampleFormatFrameBytes(&floatSamples)) != 0) {
+        b->failed = 1;
+        return;
+    }
+    if (TakeStorageAppend(&reference, expected, (size_t)frames * SampleFormatFrameBytes(&floatSamples)) == 0) {
+        TakeSlice referenceSlice = TakeStorageSlice(&reference, 0, frames);
+
+        if (ExportEdit(b, slice, format, list, 44100, path, &ns) == 0) written = ReadWavFloats(path, readBack, frames);
+        if (ExportEdit(b, &referenceSlice, &floatFormat, NULL, 44100, referencePath, &referenceNs) == 0) {
+            referenceWritten = ReadWavFloats(referencePath, readReference, frames);
+        }
+    }
+    remove(path);
+    remove(referencePath);
+    TakeStorageClose(&reference);
+    if (written < 0 || written != referenceWritten) {
+        b->failed = 1;
+        return;
+    }
+    AddEditResult(b, "export_f32_44100", b->threads, frames, ns, list->undoCount,
+                  MaxDifference(readBack, readReference, (uint64_t)written), BENCH_EDIT_TOLERANCE);
+}
+
+// Random trims, cuts, gains, fades, undos and redos on a 16-bit take. After
+// each one the edit list is rendered in blocks of random length and compared
+// with the edits so far applied eagerly to a float copy of the take; the
+// final edit is then played and exported.
+static void BenchEdits(Bench *b) {
+    SampleFormat s16Samples = { SAMPLE_S16, BENCH_CHANNELS, 0 };
+    SampleFormat floatSamples = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+    uint64_t takeFrames = (uint64_t)BENCH_EDIT_SECONDS * BENCH_SAMPLE_RATE;
+    size_t samples = (size_t)takeFrames * BENCH_CHANNELS;
+    int16_t block[BENCH_BLOCK_FRAMES * BENCH_CHANNELS];
+    BenchEdit history[BENCH_EDIT_STEPS + 1];
+    uint32_t applied = 0;
+    uint32_t redoable = 0;
+    uint32_t seed = 0x2545F491u;
+    SampleConverter toFloat;
+    TakeStorage take;
+    WavFormat format;
+    EditList list;
+    EagerEdit eager;
+    uint64_t renderNs = 0;
+    uint64_t renderedFrames = 0;
+    double worst = 0.0;
+    int result = 0;
+
+    float *source = (float *)malloc(samples * sizeof(float));
+    float *expected = (float *)malloc(samples * sizeof(float));
+    float *out = (float *)malloc(samples * sizeof(float));
+    float *readBack = (float *)malloc(samples * sizeof(float));
+    eager.samples = (float *)malloc(samples * sizeof(float));
+    eager.gain = (float *)malloc(takeFrames * sizeof(float));
+    eager.fadeIn = (float *)malloc(takeFrames * sizeof(float));
+    eager.fadeOut = (float *)malloc(takeFrames * sizeof(float));
+    if (!source || !expected || !out || !readBack || !eager.samples || !eager.gain || !eager.fadeIn ||
+        !eager.fadeOut || TakeStorageOpen(&take, NULL, SampleFormatFrameBytes(&s16Samples)) != 0) {
+        result = -1;
+        take.frameBytes = 0;
+    }
+
+    // Half-scale noise, so stacked gains rarely clip on 16-bit playback
+    SampleConverterInit(&toFloat, &s16Samples, &floatSamples);
+    for (uint64_t t = 0; result == 0 && t < takeFrames; t += BENCH_BLOCK_FRAMES) {
+        uint32_t n = takeFrames - t < BENCH_BLOCK_FRAMES ? (uint32_t)(takeFrames - t) : BENCH_BLOCK_FRAMES;
+
+        for (uint32_t i = 0; i < n * BENCH_CHANNELS; ++i) {
+            block[i] = (int16_t)((int32_t)(HashNoise(i % BENCH_CHANNELS + 1, (uint32_t)(t + i / BENCH_CHANNELS)) >> 17) -
+                                 16384);
+        }
+        SampleConverterRun(&toFloat, source + t * BENCH_CHANNELS, block, n, NULL);
+        result = TakeStorageAppend(&take, block, (size_t)n * SampleFormatFrameBytes(&s16Samples));
+    }
+
+    S16Format(&format);
+    TakeSlice slice = TakeStorageSlice(&take, 0, takeFrames);
+    if (result != 0 || EditListOpen(&list, &slice, &format) != 0) {
+        if (take.frameBytes) TakeStorageClose(&take);
+        free(source);
+        free(expected);
+        free(out);
+        free(readBack);
+        free(eager.samples);
+        free(eager.gain);
+        free(eager.fadeIn);
+        free(eager.fadeOut);
+        b->failed = 1;
+        return;
+    }
+
+    // Undo and redo with nothing to undo or redo must fail and change nothing
+    for (uint32_t step = 0; step < BENCH_EDIT_STEPS && worst <= BENCH_EDIT_TOLERANCE; ++step) {
+        uint32_t choice = NextRandom(&seed) % 6;
+
+        if (choice == 0) {
+            if (EditListUndo(&list) != (applied > 0 ? 0 : -1)) worst = INFINITY;
+            if (applied > 0) applied--;
+        } else if (choice == 1) {
+            if (EditListRedo(&list) != (applied < redoable ? 0 : -1)) worst = INFINITY;
+            if (applied < redoable) applied++;
+        } else {
+            RandomEdit(&seed, EditListFrames(&list), takeFrames, &history[applied]);
+            if (ApplyEdit(&list, &history[applied]) != 0) worst = INFINITY;
+            redoable = ++applied;
+        }
+
+        EagerReset(&eager, source, takeFrames);
+        for (uint32_t i = 0; i < applied; ++i) EagerApply(&eager, &history[i]);
+        EagerRender(&eager, expected);
+        double error = CompareRender(&list, expected, eager.frames, out, &seed, &renderNs);
+        if (error > worst) worst = error;
+        renderedFrames += eager.frames;
+    }
+    AddEditResult(b, "render_random", 1, renderedFrames, renderNs, BENCH_EDIT_STEPS, worst, BENCH_EDIT_TOLERANCE);
+
+    // Whatever the steps left, end on a real edit
+    history[applied].kind = BENCH_EDIT_FADE_OUT;
+    history[applied].start = EditListFrames(&list) - EditListFrames(&list) / 10;
+    history[applied].frames = EditListFrames(&list) / 10;
+    EditListFadeOut(&list, history[applied].start, history[applied].frames);
+    EagerApply(&eager, &history[applied]);
+    EagerRender(&eager, expected);
+
+    TrimRun trim = { &list, EditListFrames(&list) };
+    uint64_t trimNs = TimeBest(RunTrimUndo, &trim);
+    AddEditResult(b, "trim_undo", 1, trim.frames, trimNs, 2, 0.0, BENCH_EDIT_TOLERANCE);
+
+    if (worst <= BENCH_EDIT_TOLERANCE) {
+        BenchEditPlayback(b, &slice, &format, &list, expected, readBack);
+        BenchEditExports(b, &slice, &format, &list, expected, readBack, out);
+    }
+
+    EditListClose(&list);
+    TakeStorageClose(&take);
+    free(source);
+    free(expected);
+    free(out);
+    free(readBack);
+    free(eager.samples);
+    free(eager.gain);
+    free(eager.fadeIn);
+    free(eager.fadeOut);
+}
+
+// Levels and overview
+
+// Noise with a full-scale sample every so often
+static void LevelNoise(float *x, size_t samples, uint32_t *seed) {
+    for (size_t i = 0; i < samples; ++i) {
+        float v = ((float)(NextRandom(seed) >> 8) / (1 << 24) - 0.5f) * 1.6f;
+        if (NextRandom(seed) % 5000 == 0) v = v < 0.0f ? -1.0f : 1.0f;
+        x[i] = v;
+    }
+}
+
+// Meters BENCH_METER_SECONDS of noise on each channel count, as float and as
+// s16, in calls of random size shorter than a block so blocks span calls.
+// After every call that finishes a block, the reading must match one worked
+// out sample by sample: the same peaks and clip counts, and the RMS within
+// BENCH_METER_RMS_TOLERANCE.
+static void BenchLevelMeter(Bench *b) {
+    uint32_t blockFrames = BENCH_SAMPLE_RATE / METER_BLOCKS_PER_SECOND;
+    uint32_t frames = BENCH_METER_SECONDS * BENCH_SAMPLE_RATE;
+    float *source = (float *)malloc((size_t)frames * METER_MAX_CHANNELS * sizeof(float));
+    int16_t *source16 = (int16_t *)malloc((size_t)frames * METER_MAX_CHANNELS * sizeof(int16_t));
+    uint64_t elapsed = 0, metered = 0;
+    double worst = 0.0;
+    uint32_t seed = 11;
+
+    if (!source || !source16) {
+        b->failed = 1;
+        free(source);
+        free(source16);
+        return;
+    }
+
+    for (uint16_t channels = 1; channels <= METER_MAX_CHANNELS; ++channels) {
+        size_t samples = (size_t)frames * channels;
+        LevelNoise(source, samples, &seed);
+        for (size_t i = 0; i < samples; ++i) source16[i] = (int16_t)lrintf(source[i] * 32767.0f);
+
+        for (int wide = 0; wide < 2; ++wide) {
+            SampleFormat samplesFormat = { wide ? SAMPLE_F32 : SAMPLE_S16, channels, 0 };
+            float maxPeak[METER_MAX_CHANNELS] = {0};
+            uint64_t clips[METER_MAX_CHANNELS] = {0};
+            uint32_t done = 0, block = 0;
+            LevelMeter meter;
+            LevelReading reading;
+            WavFormat format;
+
+            SampleFormatToWav(&samplesFormat, BENCH_SAMPLE_RATE, &format);
+            if (LevelMeterInit(&meter, &format, blockFrames) != 0) {
+                b->failed = 1;
+                continue;
+            }
+
+            while (done < frames) {
+                uint32_t n = 1 + NextRandom(&seed) % (blockFrames - 1);
+                if (n > frames - done) n = frames - done;
+                const void *in = wide ? (const void *)(source + (size_t)done * channels)
+                                      : (const void *)(source16 + (size_t)done * channels);
+
+                uint64_t start = PlatformNowNs();
+                LevelMeterProcess(&meter, in, n);
+                elapsed += PlatformNowNs() - start;
+                done += n;
+                if (done / blockFrames == block) continue;
+
+                // The block just finished, measured sample by sample as the converter widens it
+                int published = LevelMeterRead(&meter, &reading);
+                for (uint16_t ch = 0; ch < channels; ++ch) {
+                    float peak = 0.0f;
+                    double sum = 0.0;
+
+                    for (uint32_t i = block * blockFrames; i < (block + 1) * blockFrames; ++i) {
+                        size_t k = (size_t)i * channels + ch;
+                        float v = wide ? source[k] : source16[k] * (1.0f / 32767.0f);
+                        if (fabsf(v) > peak) peak = fabsf(v);
+                        if (fabsf(v) >= METER_CLIP_LEVEL) clips[ch]++;
+                        sum += (double)v * v;
+                    }
+                    if (peak > maxPeak[ch]) maxPeak[ch] = peak;
+
+                    double rms = sqrt(sum / blockFrames);
+                    double error = fabs(reading.rms[ch] - rms);
+                    if (error > worst) worst = error;
+                    if (!published || reading.blocks != block + 1 || error > BENCH_METER_RMS_TOLERANCE * rms ||
+                        reading.peak[ch] != peak || reading.maxPeak[ch] != maxPeak[ch] ||
+                        reading.clips[ch] != clips[ch]) {
+                        fprintf(stderr, "Level meter, %u channel %s, block %u channel %u: peak %g, RMS %g, %llu "
+                                        "clips; expected %g, %g, %llu\n",
+                                channels, SampleTypeName(samplesFormat.type), block, ch, reading.peak[ch],
+                                reading.rms[ch], (unsigned long long)reading.clips[ch], peak, rms,
+                                (unsigned long long)clips[ch]);
+                        b->failed = 1;
+                        done = frames;
+                        break;
+                    }
+                }
+                block++;
+            }
+            metered += frames;
+            LevelMeterClose(&meter);
+        }
+    }
+
+    BenchResult *r = AddResult(b, "meter", "levels", 1, metered, BENCH_SAMPLE_RATE, elapsed);
+    if (r) r->maxError = worst;
+    free(source);
+    free(source16);
+}
+
+// Min and max over frames [from, to) of every channel, quantized as the overview stores them
+static void OverviewReference(const float *x, uint16_t channels, uint64_t from, uint64_t to, int *lo, int *hi) {
+    float min = INFINITY, max = -INFINITY;
+
+    for (size_t i = (size_t)from * channels; i < (size_t)to * channels; ++i) {
+        if (x[i] < min) min = x[i];
+        if (x[i] > max) max = x[i];
+    }
+    *lo = (int)lrintf(fminf(fmaxf(min * 32767.0f, -32768.0f), 32767.0f));
+    *hi = (int)lrintf(fminf(fmaxf(max * 32767.0f, -32768.0f), 32767.0f));
+}
+
+// Draws one view of the overview and checks every column against the audio.
+// Only complete base buckets show, and a column reads whole buckets of the
+// level it is drawn from, so it may take in up to a bucket either side of its
+// frames: it must span everything in its frames and nothing past those
+// buckets. Columns on bucket edges are held to their frames exactly.
+static int CheckOverviewView(WaveformOverview *o, const float *x, uint64_t frames, uint64_t startFrame,
+                             uint64_t frameCount, uint32_t columns) {
+    uint64_t complete = frames / OVERVIEW_BASE_FRAMES * OVERVIEW_BASE_FRAMES;
+    double perColumn = (double)frameCount / columns;
+    uint64_t bucket = OVERVIEW_BASE_FRAMES;
+    uint32_t expected = 0;
+    float mins[BENCH_OVERVIEW_COLUMNS], maxs[BENCH_OVERVIEW_COLUMNS];
+
+    for (int level = 1; level < OVERVIEW_LEVELS && bucket * OVERVIEW_FANOUT <= perColumn; ++level) {
+        bucket *= OVERVIEW_FANOUT;
+    }
+    uint32_t filled = WaveformOverviewColumns(o, startFrame, frameCount, columns, mins, maxs);
+
+    for (uint32_t c = 0; c < columns; ++c) {
+        uint64_t from = startFrame + (uint64_t)(c * perColumn);
+        uint64_t to = startFrame + (uint64_t)((c + 1) * perColumn);
+        int innerLo, innerHi, outerLo, outerHi;
+
+        if (to <= from) to = from + 1;
+        if (from >= complete) break;
+        expected = c + 1;
+
+        uint64_t outerFrom = from / bucket * bucket;
+        uint64_t outerTo = (to + bucket - 1) / bucket * bucket;
+        if (to > complete) to = complete;
+        if (outerTo > complete) outerTo = complete;
+        OverviewReference(x, o->channels, from, to, &innerLo, &innerHi);
+        OverviewReference(x, o->channels, outerFrom, outerTo, &outerLo, &outerHi);
+
+        int lo = (int)lrintf(mins[c] * 32767.0f);
+        int hi = (int)lrintf(maxs[c] * 32767.0f);
+        if (c >= filled || lo > innerLo || hi < innerHi || lo < outerLo || hi > outerHi) {
+            fprintf(stderr, "Overview of %u channel(s), column %u of %u over frames %llu to %llu: %d to %d, "
+                            "expected at least %d to %d and at most %d to %d\n",
+                    o->channels, c, columns, (unsigned long long)from, (unsigned long long)to, lo, hi, innerLo,
+                    innerHi, outerLo, outerHi);
+            return -1;
+        }
+    }
+    if (filled != expected) {
+        fprintf(stderr, "Overview of %u channel(s) filled %u of %u columns, expected %u\n", o->channels, filled,
+                columns, expected);
+        return -1;
+    }
+    return 0;
+}
+
+// Builds overviews of BENCH_OVERVIEW_SECONDS of noise and silence appended in
+// chunks of random size, then draws them at every zoom: the whole take, its
+// last few seconds, and columns on the bucket edges of each level it fills.
+static void BenchOverview(Bench *b) {
+    static const uint16_t layouts[] = { 1, 2, 6 };
+    static const uint32_t widths[] = { 1, 7, 100, 1000, BENCH_OVERVIEW_COLUMNS };
+    uint64_t frames = (uint64_t)BENCH_OVERVIEW_SECONDS * BENCH_SAMPLE_RATE;
+    uint64_t tail = 5 * BENCH_SAMPLE_RATE;
+    float *x = (float *)malloc((size_t)frames * OVERVIEW_MAX_CHANNELS * sizeof(float));
+    uint64_t elapsed = 0, appended = 0;
+    uint32_t seed = 23;
+
+    if (!x) {
+        b->failed = 1;
+        return;
+    }
+
+    for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); ++l) {
+        SampleFormat floatFormat = { SAMPLE_F32, layouts[l], 0 };
+        uint16_t channels = layouts[l];
+        uint64_t done = 0;
+        int result = 0;
+        WaveformOverview o;
+        WavFormat format;
+
+        SampleFormatToWav(&floatFormat, BENCH_SAMPLE_RATE, &format);
+        if (WaveformOverviewInit(&o, &format) != 0) {
+            b->failed = 1;
+            continue;
+        }
+        LevelNoise(x, (size_t)frames * channels, &seed);
+
+        // Silence goes in as NULL, and is zeroed in the reference to match
+        while (done < frames) {
+            uint64_t n = 1 + NextRandom(&seed) % 20000;
+            int silent = NextRandom(&seed) % 8 == 0;
+            if (n > frames - done) n = frames - done;
+            if (silent) memset(x + done * channels, 0, (size_t)n * channels * sizeof(float));
+
+            uint64_t start = PlatformNowNs();
+            WaveformOverviewAppend(&o, silent ? NULL : x + done * channels, (uint32_t)n);
+            elapsed += PlatformNowNs() - start;
+            done += n;
+        }
+        appended += frames;
+
+        for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]) && result == 0; ++w) {
+            result = CheckOverviewView(&o, x, frames, 0, frames, widths[w]);
+            if (result == 0) result = CheckOverviewView(&o, x, frames, frames - tail, tail, widths[w]);
+        }
+        for (uint64_t bucket = OVERVIEW_BASE_FRAMES; bucket * 50 <= frames && result == 0; bucket *= OVERVIEW_FANOUT) {
+            uint64_t perColumn = bucket * (1 + NextRandom(&seed) % (OVERVIEW_FANOUT - 1));
+            uint64_t startFrame = bucket * (NextRandom(&seed) % (frames / bucket));
+            result = CheckOverviewView(&o, x, frames, startFrame, perColumn * 50, 50);
+        }
+        if (result != 0) b->failed = 1;
+        WaveformOverviewClose(&o);
+    }
+
+    AddResult(b, "meter", "overview", 1, appended, BENCH_SAMPLE_RATE, elapsed);
+    free(x);
+}
+
+// Gate
+
+typedef enum {
+    GATE_BURST_TONE,
+    GATE_BURST_HISS,              // BENCH_GATE_HISS_DB, under the threshold
+    GATE_BURST_FLAGGED            // Silence the source flags, or zeros when replayed
+} GateBurstKind;
+
+typedef struct {
+    GateBurstKind kind;
+    uint32_t frames;
+} GateBurst;
+
+// Cut points the gate's rules give for the bursts, to the window: a tone
+// window opens the output from the next window on when the gate is in a gap,
+// and quiet windows past hangover + minimum gap close it from the next window
+// on. Tone boundaries fall on half windows so every window touching a tone is
+// loud. Fills starts and ends with the kept ranges and returns how many.
+static uint32_t GateExpected(const SilenceGateConfig *config, const GateBurst *bursts, uint32_t count,
+                             uint64_t *starts, uint64_t *ends) {
+    uint64_t w = BENCH_SAMPLE_RATE * GATE_WINDOW_MS / 1000;
+    uint64_t holdFrames = (uint64_t)((config->hangoverSeconds + config->minGapSeconds) * BENCH_SAMPLE_RATE);
+    uint64_t hold = (holdFrames + w - 1) / w;
+    uint64_t position = 0, lastLoud = 0, total = 0;
+    uint32_t kept = 0;
+    int open = 0;
+
+    for (uint32_t i = 0; i < count; ++i) total += bursts[i].frames;
+    for (uint32_t i = 0; i < count; ++i, position += bursts[i - 1].frames) {
+        if (bursts[i].kind != GATE_BURST_TONE) continue;
+
+        uint64_t first = position / w;
+        if (open && first > lastLoud + hold) {
+            ends[kept++] = (lastLoud + hold + 1) * w;
+            open = 0;
+        }
+        if (!open) {
+            starts[kept] = (first + 1) * w;
+            open = 1;
+        }
+        lastLoud = (position + bursts[i].frames + w - 1) / w - 1;
+    }
+    if (open) {
+        uint64_t end = (lastLoud + hold + 1) * w;
+        ends[kept++] = end < total ? end : total;
+    }
+    return kept;
+}
+
+// Tone, hiss and silence in bursts longer and shorter than a gap, down to one
+// window either side of hangover + minimum gap at the defaults, gated as
+// float with the silence flagged and again as s16 with the silence as zeros,
+// in packets of random size. The kept ranges must be exactly the expected ones.
+static void BenchGate(Bench *b) {
+    static const GateBurst bursts[] = {
+        { GATE_BURST_HISS, 57840 },     { GATE_BURST_TONE, 144240 },    { GATE_BURST_FLAGGED, 48000 },
+        { GATE_BURST_TONE, 24240 },     { GATE_BURST_HISS, 192000 },    { GATE_BURST_TONE, 96000 },
+        { GATE_BURST_FLAGGED, 144240 }, { GATE_BURST_TONE, 12240 },     { GATE_BURST_HISS, 120480 },
+        { GATE_BURST_TONE, 48240 },     { GATE_BURST_HISS, 119760 },    { GATE_BURST_TONE, 480 },
+        { GATE_BURST_HISS, 144000 },
+    };
+    uint32_t count = sizeof(bursts) / sizeof(bursts[0]);
+    SilenceGateConfig config = { SILENCE_GATE_SPLIT, GATE_DEFAULT_THRESHOLD_DB, GATE_DEFAULT_HANGOVER_SECONDS,
+                                 GATE_DEFAULT_MIN_GAP_SECONDS };
+    float hiss = (float)(pow(10.0, BENCH_GATE_HISS_DB / 20.0) * sqrt(3.0));
+    uint64_t frames = 0, position = 0, elapsed = 0;
+    uint32_t seed = 31;
+
+    for (uint32_t i = 0; i < count; ++i) frames += bursts[i].frames;
+    float *x = (float *)malloc((size_t)frames * BENCH_CHANNELS * sizeof(float));
+    int16_t *x16 = (int16_t *)malloc((size_t)frames * BENCH_CHANNELS * sizeof(int16_t));
+    uint8_t *flagged = (uint8_t *)malloc((size_t)frames);
+    if (!x || !x16 || !flagged) {
+        b->failed = 1;
+        free(x);
+        free(x16);
+        free(flagged);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t f = 0; f < bursts[i].frames; ++f, ++position) {
+            for (uint16_t ch = 0; ch < BENCH_CHANNELS; ++ch) {
+                float v = 0.0f;
+                if (bursts[i].kind == GATE_BURST_TONE) {
+                    v = BENCH_AMPLITUDE * (float)sin(2.0 * BENCH_PI * BENCH_FREQUENCY * position / BENCH_SAMPLE_RATE);
+                } else if (bursts[i].kind == GATE_BURST_HISS) {
+                    v = hiss * ((float)(NextRandom(&seed) >> 8) / (1 << 23) - 1.0f);
+                }
+                x[position * BENCH_CHANNELS + ch] = v;
+                x16[position * BENCH_CHANNELS + ch] = (int16_t)lrintf(v * 32767.0f);
+            }
+            flagged[position] = bursts[i].kind == GATE_BURST_FLAGGED;
+        }
+    }
+
+    for (int wide = 0; wide < 2; ++wide) {
+        SampleFormat samples = { wide ? SAMPLE_F32 : SAMPLE_S16, BENCH_CHANNELS, 0 };
+        uint64_t starts[16], ends[16], expectedStarts[16], expectedEnds[16];
+        uint32_t kept = 0, expected;
+        uint64_t done = 0;
+        int open = 0, result = 0;
+        WavFormat format;
+        SilenceGate g;
+
+        SampleFormatToWav(&samples, BENCH_SAMPLE_RATE, &format);
+        if (SilenceGateInit(&g, &format, &config) != 0) {
+            b->failed = 1;
+            continue;
+        }
+        expected = GateExpected(&config, bursts, count, expectedStarts, expectedEnds);
+
+        uint64_t start = PlatformNowNs();
+        while (done < frames && result == 0) {
+            uint32_t n = 1 + NextRandom(&seed) % 2000;
+            if (n > frames - done) n = (uint32_t)(frames - done);
+            // Flagged silence arrives in packets of its own, as a source delivers it
+            for (uint32_t i = 1; i < n; ++i) {
+                if (flagged[done + i] != flagged[done]) n = i;
+            }
+
+            while (n > 0) {
+                const void *in = wide ? (const void *)(x + done * BENCH_CHANNELS)
+                                      : (const void *)(x16 + done * BENCH_CHANNELS);
+                int keep;
+                uint32_t step = SilenceGateStep(&g, wide && flagged[done] ? NULL : in, n, &keep);
+
+                if (keep && !open) {
+                    if (kept == sizeof(starts) / sizeof(starts[0])) {
+                        result = -1;
+                        break;
+                    }
+                    starts[kept] = done;
+                } else if (!keep && open) {
+                    ends[kept++] = done;
+                }
+                open = keep;
+                done += step;
+                n -= step;
+            }
+        }
+        elapsed += PlatformNowNs() - start;
+        if (open) ends[kept++] = done;
+
+        if (result == 0 && kept != expected) result = -1;
+        for (uint32_t i = 0; i < kept && i < expected && result == 0; ++i) {
+            if (starts[i] != expectedStarts[i] || ends[i] != expectedEnds[i]) result = -1;
+        }
+        uint32_t gaps = 0;
+        for (uint32_t i = 0; i < expected; ++i) gaps += expectedEnds[i] < frames;
+        if (result == 0 && g.stats.gaps != gaps) result = -1;
+        if (result != 0) {
+            fprintf(stderr, "Gate on %s bursts kept %u range(s) with %llu gap(s), expected %u with %u:\n",
+                    SampleTypeName(samples.type), kept, (unsigned long long)g.stats.gaps, expected, gaps);
+            for (uint32_t i = 0; i < kept || i < expected; ++i) {
+                fprintf(stderr, "  %10lld to %10lld, expected %10lld to %10lld\n", i < kept ? (long long)starts[i] : -1,
+                        i < kept ? (long long)ends[i] : -1, i < expected ? (long long)expectedStarts[i] : -1,
+                        i < expected ? (long long)expectedEnds[i] : -1);
+            }
+            b->failed = 1;
+        }
+        SilenceGateClose(&g);
+    }
+
+    AddResult(b, "gate", "bursts", 1, 2 * frames, BENCH_SAMPLE_RATE, elapsed);
+    free(x);
+    free(x16);
+    free(flagged);
+}
+
+// Take storage
+
+// The GUI's take buffer before TakeStorage: one block, doubled by realloc
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    uint64_t bytesCopied;         // Stored audio the block carried along when it moved
+} GrowBuffer;
+
+static int GrowBufferAppend(GrowBuffer *g, const void *bytes, size_t n) {
+    if (g->size + n > g->capacity) {
+        size_t capacity = g->capacity ? g->capacity * 2 : BENCH_REALLOC_INITIAL;
+        while (g->size + n > capacity) capacity *= 2;
+
+        uint8_t *grown = (uint8_t *)realloc(g->data, capacity);
+        if (!grown) return -1;
+        if (grown != g->data) g->bytesCopied += g->size;
+        g->data = grown;
+        g->capacity = capacity;
+    }
+    memcpy(g->data + g->size, bytes, n);
+    g->size += n;
+    return 0;
+}
+
+typedef struct {
+    const int16_t *signal;
+    uint64_t frames;
+    int grow;                     // 1: the realloc buffer, 0: TakeStorage on the heap
+    GrowBuffer buffer;
+    TakeStorage take;
+    int64_t sum;                  // What a walk added up, so its reads cannot be left out
+    int failed;
+} StorageRun;
+
+// The looped signal in 10 ms packets, as the capture thread stores it
+static int FillStorage(StorageRun *run) {
+    size_t packetBytes = (size_t)BENCH_PACKET_FRAMES * BENCH_CHANNELS * sizeof(int16_t);
+    uint32_t pos = 0;
+
+    for (uint64_t done = 0; done < run->frames; done += BENCH_PACKET_FRAMES) {
+        const int16_t *packet = run->signal + (size_t)pos * BENCH_CHANNELS;
+        int result = run->grow ? GrowBufferAppend(&run->buffer, packet, packetBytes)
+                               : TakeStorageAppend(&run->take, packet, packetBytes);
+        if (result != 0) return -1;
+        pos = (pos + BENCH_PACKET_FRAMES) % BENCH_SAMPLE_RATE;
+    }
+    return 0;
+}
+
+static void RunStorageAppend(void *ctx) {
+    StorageRun *run = (StorageRun *)ctx;
+
+    if (run->grow) {
+        memset(&run->buffer, 0, sizeof(run->buffer));
+        if (FillStorage(run) != 0) run->failed = 1;
+        free(run->buffer.data);
+    } else {
+        if (TakeStorageOpen(&run->take, NULL, BENCH_CHANNELS * sizeof(int16_t)) != 0 || FillStorage(run) != 0) {
+            run->failed = 1;
+        }
+        TakeStorageClose(&run->take);
+    }
+}
+
+static int64_t SumSamples(const int16_t *samples, size_t count) {
+    int64_t sum = 0;
+
+    for (size_t i = 0; i < count; ++i) sum += samples[i];
+    return sum;
+}
+
+// Both walk the take in blocks, one through the iterator and one by pointer
+static void RunStorageWalk(void *ctx) {
+    StorageRun *run = (StorageRun *)ctx;
+    int64_t sum = 0;
+
+    if (run->grow) {
+        const int16_t *samples = (const int16_t *)run->buffer.data;
+        for (uint64_t frame = 0; frame < run->frames; frame += BENCH_BLOCK_FRAMES) {
+            uint64_t n = run->frames - frame < BENCH_BLOCK_FRAMES ? run->frames - frame : BENCH_BLOCK_FRAMES;
+            sum += SumSamples(samples + frame * BENCH_CHANNELS, (size_t)n * BENCH_CHANNELS);
+        }
+    } else {
+        TakeSlice slice = TakeStorageSlice(&run->take, 0, run->frames);
+        TakeIterator it;
+        const void *ptr;
+        uint32_t n;
+
+        TakeIteratorInit(&it, &slice);
+        while ((n = TakeIteratorNext(&it, &ptr, BENCH_BLOCK_FRAMES)) != 0) {
+            sum += SumSamples((const int16_t *)ptr, (size_t)n * BENCH_CHANNELS);
+        }
+    }
+    run->sum = sum;
+}
+
+// Mostly within [0, limit], but past it one time in eight, to exercise clamping
+static uint64_t RandomBound(uint32_t *seed, uint64_t limit) {
+    if (NextRandom(seed) % 8 == 0) return limit + 1 + NextRandom(seed) % 1000;
+    return NextRandom(seed) % (limit + 1);
+}
+
+// Walks sub-slices of random slices in runs of random length, and reads at
+// random offsets, against the flat copy. Ranges past the end must be clamped.
+static int CheckTake(const TakeStorage *take, const uint8_t *flat, uint64_t frames, uint32_t *seed) {
+    uint32_t frameBytes = BENCH_STORAGE_FRAME_BYTES;
+    uint8_t *read = (uint8_t *)malloc(TAKE_CHUNK_BYTES * 2);
+
+    if (!read || TakeStorageFrames(take) != frames) {
+        free(read);
+        return -1;
+    }
+
+    for (int i = 0; i < BENCH_STORAGE_SLICES; ++i) {
+        uint64_t start = RandomBound(seed, frames);
+        uint64_t count = RandomBound(seed, frames);
+        TakeSlice slice = TakeStorageSlice(take, start, count);
+        if (start > frames) start = frames;
+        uint64_t expected = count < frames - start ? count : frames - start;
+
+        uint64_t subStart = RandomBound(seed, expected);
+        uint64_t subCount = RandomBound(seed, expected);
+        TakeSlice sub = TakeSliceSub(&slice, subStart, subCount);
+        if (subStart > expected) subStart = expected;
+        if (subCount > expected - subStart) subCount = expected - subStart;
+
+        if (slice.startFrame != start || slice.frameCount != expected ||
+            sub.startFrame != start + subStart || sub.frameCount != subCount) {
+            free(read);
+            return -1;
+        }
+
+        TakeIterator it;
+        const void *ptr;
+        uint32_t n;
+        uint64_t walked = 0;
+
+        TakeIteratorInit(&it, &sub);
+        while ((n = TakeIteratorNext(&it, &ptr, 1 + NextRandom(seed) % 300000)) != 0) {
+            if (memcmp(ptr, flat + (sub.startFrame + walked) * frameBytes, (size_t)n * frameBytes) != 0) {
+                free(read);
+                return -1;
+            }
+            walked += n;
+        }
+        if (walked != sub.frameCount) {
+            free(read);
+            return -1;
+        }
+
+        uint64_t offset = NextRandom(seed) % (frames * frameBytes + 1);
+        size_t bytes = NextRandom(seed) % (TAKE_CHUNK_BYTES * 2);
+        size_t available = frames * frameBytes - offset < bytes ? (size_t)(frames * frameBytes - offset) : bytes;
+        if (TakeStorageRead(take, offset, read, bytes) != available || memcmp(read, flat + offset, available) != 0) {
+            free(read);
+            return -1;
+        }
+    }
+    free(read);
+    return 0;
+}
+
+// Fills the take with pass's pattern in appends of random length
+static int FillCheckTake(TakeStorage *take, uint8_t *flat, uint64_t frames, uint32_t pass, uint32_t *seed) {
+    uint64_t bytes = frames * BENCH_STORAGE_FRAME_BYTES;
+    uint64_t done = 0;
+
+    for (uint64_t i = 0; i < bytes; ++i) flat[i] = (uint8_t)HashNoise(pass, (uint32_t)i);
+    while (done < bytes) {
+        uint64_t n = (uint64_t)(1 + NextRandom(seed) % 20000) * BENCH_STORAGE_FRAME_BYTES;
+        if (n > bytes - done) n = bytes - done;
+        if (TakeStorageAppend(take, flat + done, (size_t)n) != 0) return -1;
+        done += n;
+    }
+    return 0;
+}
+
+// Frames that do not divide a chunk, a take that spills past its first region,
+// then reset and filled again, which must reuse the pool it already has
+static void CheckStorage(Bench *b, int fileBacked) {
+    uint64_t frames = BENCH_STORAGE_CHECK_BYTES / BENCH_STORAGE_FRAME_BYTES;
+    uint8_t *flat = (uint8_t *)malloc(frames * BENCH_STORAGE_FRAME_BYTES);
+    uint32_t seed = 0x5EED5EEDu;
+    TakeStorage take;
+    char path[64];
+    int result = 0;
+
+    ScratchPath(path, sizeof(path), ".take");
+    if (!flat || TakeStorageOpen(&take, fileBacked ? path : NULL, BENCH_STORAGE_FRAME_BYTES) != 0) {
+        free(flat);
+        b->failed = 1;
+        return;
+    }
+
+    if (FillCheckTake(&take, flat, frames, 1, &seed) != 0 || CheckTake(&take, flat, frames, &seed) != 0) {
+        result = -1;
+    } else {
+        size_t regions = take.regionCount;
+
+        TakeStorageReset(&take);
+        if (TakeStorageFrames(&take) != 0 || FillCheckTake(&take, flat, frames, 2, &seed) != 0 ||
+            take.regionCount != regions || CheckTake(&take, flat, frames, &seed) != 0) {
+            result = -1;
+        }
+    }
+    if (result != 0 || take.fileBacked != fileBacked) {
+        fprintf(stderr, "%s take storage does not match its flat copy\n", fileBacked ? "File-backed" : "Heap");
+        b->failed = 1;
+    }
+    TakeStorageClose(&take);
+    remove(path);
+    free(flat);
+}
+
+// Stores hours of mono 16-bit audio in 10 ms packets, sampling the process's
+// memory every second of audio, and reports the peaks over where it started.
+// Mono keeps the 8 h realloc take within a small machine's memory. Stored
+// audio counts as copied when it changes address: every move of the realloc
+// block, which glibc makes by remapping pages and Windows by copying them;
+// the take's first chunk is watched the same way and should never move.
+static void BenchStorageMemory(Bench *b, uint32_t hours, const char *backend) {
+    size_t packetBytes = (size_t)BENCH_PACKET_FRAMES * sizeof(int16_t);
+    size_t loopBytes = (size_t)BENCH_SAMPLE_RATE * BENCH_CHANNELS * sizeof(int16_t);
+    uint64_t packets = (uint64_t)hours * 3600 * BENCH_SAMPLE_RATE / BENCH_PACKET_FRAMES;
+    const uint8_t *signal = (const uint8_t *)b->signal16;
+    int grow = strcmp(backend, "realloc") == 0;
+    uint64_t baseResident, basePrivate, resident, priv;
+    uint64_t peakResident = 0, peakPrivate = 0, copied = 0;
+    const void *first = NULL;
+    GrowBuffer buffer;
+    TakeStorage take;
+    char path[64];
+    char name[40];
+    int result = 0;
+
+    if (PlatformProcessMemory(&baseResident, &basePrivate) != 0) return;
+    memset(&buffer, 0, sizeof(buffer));
+    ScratchPath(path, sizeof(path), ".take");
+    if (!grow && TakeStorageOpen(&take, strcmp(backend, "file") == 0 ? path : NULL, sizeof(int16_t)) != 0) {
+        b->failed = 1;
+        return;
+    }
+
+    uint64_t start = PlatformNowNs();
+    for (uint64_t i = 0; i < packets && result == 0; ++i) {
+        const uint8_t *packet = signal + (size_t)(i * packetBytes % loopBytes);
+        result = grow ? GrowBufferAppend(&buffer, packet, packetBytes) : TakeStorageAppend(&take, packet, packetBytes);
+
+        if ((i + 1) % (BENCH_SAMPLE_RATE / BENCH_PACKET_FRAMES) != 0 && i + 1 != packets) continue;
+        if (!grow) {
+            const void *now;
+            TakeStorageSpan(&take, 0, &now);
+            if (first && now != first) copied += take.length;
+            first = now;
+        }
+        if (PlatformProcessMemory(&resident, &priv) == 0) {
+            if (resident > baseResident && resident - baseResident > peakResident) peakResident = resident - baseResident;
+            if (priv > basePrivate && priv - basePrivate > peakPrivate) peakPrivate = priv - basePrivate;
+        }
+    }
+    uint64_t elapsed = PlatformNowNs() - start;
+
+    if (grow) {
+        copied = buffer.bytesCopied;
+        free(buffer.data);
+    } else {
+        TakeStorageClose(&take);
+        remove(path);
+    }
+    if (result != 0) {
+        fprintf(stderr, "Storing %u h in the %s backend failed\n", hours, backend);
+        b->failed = 1;
+        return;
+    }
+
+    snprintf(name, sizeof(name), "memory_%uh_%s", hours, backend);
+    BenchResult *r = AddResult(b, "storage", name, 1, packets * BENCH_PACKET_FRAMES, BENCH_SAMPLE_RATE, elapsed);
+    if (r) {
+        r->peakResident = peakResident;
+        r->peakPrivate = peakPrivate;
+        r->bytesCopied = copied;
+    }
+}
+
+// Appending the looped signal in 10 ms packets and walking it in blocks, to
+// the chunked take and to a buffer grown by realloc, as the GUI did before.
+// Then the memory each holds over hours-long takes, and what growing copies.
+static void BenchStorage(Bench *b) {
+    static const uint32_t hours[] = { 1, 8 };
+    uint64_t frames = (uint64_t)BENCH_STORAGE_SECONDS * BENCH_SAMPLE_RATE;
+    StorageRun take = {0};
+    StorageRun grow = {0};
+
+    take.signal = grow.signal = b->signal16;
+    take.frames = grow.frames = frames;
+    grow.grow = 1;
+
+    CheckStorage(b, 0);
+    CheckStorage(b, 1);
+
+    AddResult(b, "storage", "append_take", 1, frames, BENCH_SAMPLE_RATE, TimeBest(RunStorageAppend, &take));
+    AddResult(b, "storage", "append_realloc", 1, frames, BENCH_SAMPLE_RATE, TimeBest(RunStorageAppend, &grow));
+
+    memset(&grow.buffer, 0, sizeof(grow.buffer));
+    if (TakeStorageOpen(&take.take, NULL, BENCH_CHANNELS * sizeof(int16_t)) != 0 || FillStorage(&take) != 0 ||
+        FillStorage(&grow) != 0) {
+        take.failed = 1;
+    } else {
+        AddResult(b, "storage", "walk_take", 1, frames, BENCH_SAMPLE_RATE, TimeBest(RunStorageWalk, &take));
+        AddResult(b, "storage", "walk_realloc", 1, frames, BENCH_SAMPLE_RATE, TimeBest(RunStorageWalk, &grow));
+        if (take.sum != grow.sum) {
+            fprintf(stderr, "Walking the take and the realloc buffer gave different audio\n");
+            b->failed = 1;
+        }
+    }
+    TakeStorageClose(&take.take);
+    free(grow.buffer.data);
+    if (take.failed || grow.failed) b->failed = 1;
+
+    for (size_t i = 0; i < sizeof(hours) / sizeof(hours[0]); ++i) {
+        BenchStorageMemory(b, hours[i], "realloc");
+        BenchStorageMemory(b, hours[i], "heap");
+        BenchStorageMemory(b, hours[i], "file");
+    }
+}
+
+// Pre-roll
+
+// Arms a pipeline on the synthetic noise source, free running so the ring
+// wraps BENCH_PREROLL_WRAPS times in a moment without dropping anything, and
+// commits: by polling, then scheduled with CapturePipelineCommitAt, which must
+// commit at exactly that frame. The file must hold the generator's sequence from
+// exactly preRollSeconds before the commit, for preRollSeconds + BENCH_PREROLL_LIVE_SECONDS.
+static void BenchPreRoll(Bench *b) {
+    static const double preRolls[] = { 0.5, 1.5 };
+    char path[64];
+    char name[40];
+
+    ScratchPath(path, sizeof(path), ".wav");
+    for (size_t i = 0; i < sizeof(preRolls) / sizeof(preRolls[0]); ++i) {
+        SyntheticSourceConfig sourceConfig = {0};
+        CapturePipelineConfig config = {0};
+        CapturePipeline pipeline;
+        CaptureSource *source;
+        WavReader reader;
+        uint64_t preRollFrames = (uint64_t)llround(preRolls[i] * BENCH_SAMPLE_RATE);
+        uint64_t frames = preRollFrames + (uint64_t)BENCH_PREROLL_LIVE_SECONDS * BENCH_SAMPLE_RATE;
+        uint64_t checked = 0;
+        uint32_t state = BENCH_NOISE_SEED;
+        int result = 0;
+
+        sourceConfig.sampleRate = BENCH_SAMPLE_RATE;
+        sourceConfig.channels = BENCH_CHANNELS;
+        sourceConfig.packetFrames = BENCH_PACKET_FRAMES;
+        sourceConfig.amplitude = BENCH_AMPLITUDE;
+        sourceConfig.waveform = SYNTHETIC_NOISE;
+        if (CreateSyntheticCaptureSource(&sourceConfig, CAPTURE_MODE_FREERUN, &source) != 0) {
+            b->failed = 1;
+            continue;
+        }
+        config.outPath = path;
+        config.durationSeconds = preRolls[i] + BENCH_PREROLL_LIVE_SECONDS;
+        config.armed = 1;
+        config.preRollSeconds = preRolls[i];
+        if (CapturePipelineStart(&pipeline, source, &config) != 0) {
+            source->lpVtbl->Destroy(source);
+            b->failed = 1;
+            continue;
+        }
+
+        uint64_t ringFrames = pipeline.ring.capacity / source->blockAlign;
+        uint64_t scheduled = i % 2 ? BENCH_PREROLL_WRAPS * ringFrames : 0;
+        uint64_t start = PlatformNowNs();
+        if (scheduled) CapturePipelineCommitAt(&pipeline, scheduled);
+        while (CapturePipelineIsRunning(&pipeline)) {
+            if (!scheduled && CapturePipelineIsArmed(&pipeline) &&
+                atomic_load(&pipeline.framesQueued) >= BENCH_PREROLL_WRAPS * ringFrames) {
+                CapturePipelineCommit(&pipeline);
+            }
+            PlatformSleepMs(1);
+        }
+        if (CapturePipelineWait(&pipeline) != 0) result = -1;
+        uint64_t elapsed = PlatformNowNs() - start;
+        uint64_t commit = atomic_load(&pipeline.commitFrame);
+        source->lpVtbl->Destroy(source);
+
+        // The generator's samples before the pre-roll
+        for (uint64_t k = 0; k < (commit - preRollFrames) * BENCH_CHANNELS; ++k) NextRandom(&state);
+
+        if (result == 0 && WavReaderOpen(&reader, path) == 0) {
+            float *buffer = (float *)malloc((size_t)BENCH_BLOCK_FRAMES * BENCH_CHANNELS * sizeof(float));
+            uint32_t n;
+
+            while (buffer && (n = WavReaderRead(&reader, buffer, BENCH_BLOCK_FRAMES)) != 0 && result == 0) {
+                for (size_t k = 0; k < (size_t)n * BENCH_CHANNELS; ++k) {
+                    float v = BENCH_AMPLITUDE * ((float)(NextRandom(&state) >> 8) * (2.0f / 16777216.0f) - 1.0f);
+                    if (buffer[k] != v) {
+                        fprintf(stderr, "Pre-roll of %.1f s committed at frame %llu: frame %llu of the file differs "
+                                        "from the source\n",
+                                preRolls[i], (unsigned long long)commit,
+                                (unsigned long long)(checked + k / BENCH_CHANNELS));
+                        result = -1;
+                        break;
+                    }
+                }
+                checked += n;
+            }
+            if (!buffer) result = -1;
+            free(buffer);
+            WavReaderClose(&reader);
+        } else {
+            result = -1;
+        }
+        remove(path);
+
+        if (result == 0 && (checked != frames || pipeline.stats.preRollFrames != preRollFrames ||
+                            commit < BENCH_PREROLL_WRAPS * ringFrames || (scheduled && commit != scheduled))) {
+            fprintf(stderr, "Pre-roll of %.1f s committed at frame %llu: %llu frames with %llu of pre-roll, "
+                            "expected %llu with %llu\n",
+                    preRolls[i], (unsigned long long)commit, (unsigned long long)checked,
+                    (unsigned long long)pipeline.stats.preRollFrames, (unsigned long long)frames,
+                    (unsigned long long)preRollFrames);
+            result = -1;
+        }
+        if (result != 0) {
+            b->failed = 1;
+            continue;
+        }
+
+        snprintf(name, sizeof(name), "pre_roll_%.1fs", preRolls[i]);
+        AddResult(b, "ring", name, 1, commit + BENCH_PREROLL_LIVE_SECONDS * BENCH_SAMPLE_RATE, BENCH_SAMPLE_RATE,
+                  elapsed);
+    }
+}
+
+// Export
+
+static void BenchExport(Bench *b, const TakeSlice *slice, const WavFormat *format, uint32_t threads, uint32_t outRate) {
+    TakeExportConfig config = {0};
+    TakeExport exporter;
+    char path[64];
+    char name[40];
+
+    ScratchPath(path, sizeof(path), ".wav");
+    config.path = path;
+    config.outType = SAMPLE_S16;
+    config.outRate = outRate;
+    config.threads = threads;
+
+    if (TakeExportStart(&exporter, slice, format, &config) != 0) {
+        b->failed = 1;
+        return;
+    }
+    if (TakeExportWait(&exporter) != 0) {
+        b->failed = 1;
+        remove(path);
+        return;
+    }
+    remove(path);
+
+    if (outRate) {
+        snprintf(name, sizeof(name), "f32_to_s16_%u", outRate);
+    } else {
+        snprintf(name, sizeof(name), "f32_to_s16");
+    }
+    AddResult(b, "export", name, threads, slice->frameCount, BENCH_SAMPLE_RATE,
+              exporter.stats.endNs - exporter.stats.startNs);
+}
+
+// Fills take with frames of the float signal; spillPath may be NULL for the heap
+static int FillFloatTake(Bench *b, TakeStorage *take, uint64_t frames, const char *spillPath) {
+    size_t frameBytes = (size_t)BENCH_CHANNELS * sizeof(float);
+    uint64_t left = frames;
+
+    if (TakeStorageOpen(take, spillPath, (uint32_t)frameBytes) != 0) return -1;
+    while (left > 0) {
+        uint32_t n = left < BENCH_SAMPLE_RATE ? (uint32_t)left : BENCH_SAMPLE_RATE;
+        if (TakeStorageAppend(take, b->signal, n * frameBytes) != 0) {
+            TakeStorageClose(take);
+            return -1;
+        }
+        left -= n;
+    }
+    return 0;
+}
+
+// A float take of the given length in memory, exported as the GUI saves it
+static void BenchExports(Bench *b, uint64_t frames) {
+    SampleFormat floatFormat = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+    TakeStorage take;
+    WavFormat format;
+
+    if (FillFloatTake(b, &take, frames, NULL) != 0) {
+        b->failed = 1;
+        return;
+    }
+
+    SampleFormatToWav(&floatFormat, BENCH_SAMPLE_RATE, &format);
+    TakeSlice slice = TakeStorageSlice(&take, 0, frames);
+
+    BenchExport(b, &slice, &format, 0, 0);
+    if (b->threads > 0) {
+        BenchExport(b, &slice, &format, b->threads, 0);
+        BenchExport(b, &slice, &format, b->threads, 44100);
+    }
+    TakeStorageClose(&take);
+}
+
+// Export of a take several GB long on 1 to N worker threads, N being the
+// configured thread count or every CPU when that is 0. The take spills to a
+// file so it fits in memory on any machine the bench runs on.
+static void BenchExportScaling(Bench *b) {
+    SampleFormat floatFormat = { SAMPLE_F32, BENCH_CHANNELS, 0 };
+    uint64_t frames = (uint64_t)BENCH_EXPORT_SCALING_SECONDS * BENCH_SAMPLE_RATE;
+    uint32_t most = b->threads ? b->threads : PlatformCpuCount();
+    TakeStorage take;
+    WavFormat format;
+    char path[64];
+
+    if (most > EXPORT_MAX_THREADS) most = EXPORT_MAX_THREADS;
+    ScratchPath(path, sizeof(path), ".take");
+    if (FillFloatTake(b, &take, frames, path) != 0) {
+        b->failed = 1;
+        remove(path);
+        return;
+    }
+
+    SampleFormatToWav(&floatFormat, BENCH_SAMPLE_RATE, &format);
+    TakeSlice slice = TakeStorageSlice(&take, 0, frames);
+
+    for (uint32_t threads = 1; threads <= most; ++threads) BenchExport(b, &slice, &format, threads, 0);
+    TakeStorageClose(&take);
+    remove(path);
+}
+
+// Reads path's channel count and mask, and complains if they are not as expected
+static int CheckFileMask(const char *path, uint16_t channels, uint32_t mask, const char *what) {
+    WavReader reader;
+    int result = 0;
+
+    if (WavReaderOpen(&reader, path) != 0) return -1;
+    if (reader.format.channels != channels || reader.format.channelMask != mask) {
+        fprintf(stderr, "Channel mask 0x%x on %u channels came back from %s as 0x%x on %u\n", mask, channels, what,
+                reader.format.channelMask, reader.format.channels);
+        result = -1;
+    }
+    WavReaderClose(&reader);
+    return result;
+}
+
+// Speaker masks must survive a WAV file written and read back, and an export
+// to another sample type from a take that carries one
+static void CheckChannelMasks(Bench *b) {
+    static const struct {
+        uint16_t channels;
+        uint32_t mask;
+    } layouts[] = { { 1, 0x4 }, { 2, 0x3 }, { 2, 0x600 }, { 4, 0x33 }, { 6, 0x60F }, { 8, 0x63F } };
+    int16_t frames[8 * 64] = {0};
+    char path[64];
+    char exportPath[64];
+
+    ScratchPath(path, sizeof(path), ".wav");
+    ScratchPath(exportPath, sizeof(exportPath), "_export.wav");
+    for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); ++i) {
+        TakeExportConfig config = {0};
+        TakeExport exporter;
+        TakeStorage take;
+        WavFormat format;
+        WavWriter writer;
+        int result = 0;
+
+        S16Format(&format);
+        format.channels = layouts[i].channels;
+        format.channelMask = layouts[i].mask;
+
+        if (WavWriterOpen(&writer, path, &format) != 0) {
+            b->failed = 1;
+            continue;
+        }
+        if (WavWriterAppend(&writer, frames, 64) != 0) result = -1;
+        if (WavWriterFinalize(&writer) != 0) result = -1;
+        if (result == 0) result = CheckFileMask(path, format.channels, format.channelMask, "a WAV file");
+        remove(path);
+
+        if (result == 0 && TakeStorageOpen(&take, NULL, format.channels * sizeof(int16_t)) == 0) {
+            if (TakeStorageAppend(&take, frames, (size_t)64 * format.channels * sizeof(int16_t)) != 0) result = -1;
+            TakeSlice slice = TakeStorageSlice(&take, 0, 64);
+
+            config.path = exportPath;
+            config.outType = SAMPLE_S24;
+            if (result == 0 && (TakeExportStart(&exporter, &slice, &format, &config) != 0 ||
+                                TakeExportWait(&exporter) != 0)) {
+                result = -1;
+            }
+            if (result == 0) result = CheckFileMask(exportPath, format.channels, format.channelMask, "an export");
+            remove(exportPath);
+            TakeStorageClose(&take);
+        } else if (result == 0) {
+            result = -1;
+        }
+        if (result != 0) b->failed = 1;
+    }
+}
+
+int RunBenchmarks(const BenchConfig *config) {
+    Bench *b = (Bench *)calloc(1, sizeof(Bench));
+    int result;
+
+    if (!b) return -1;
+    b->threads = config->threads > EXPORT_MAX_THREADS ? EXPORT_MAX_THREADS : config->threads;
+    if (MakeSignal(b) != 0) {
+        free(b->signal);
+        free(b->signal16);
+        free(b);
+        return -1;
+    }
+
+    printf("Benchmarking on %u CPU(s), best conversion kernel %s, %u worker thread(s)\n",
+           PlatformCpuCount(), ConvertKernelName(ConvertBestKernel()), b->threads);
+
+    fprintf(stderr, "Conversion kernels and round trips...\n");
+    BenchConvert(b);
+    BenchRoundTrips(b);
+    CheckChannelMasks(b);
+    fprintf(stderr, "Ring buffer...\n");
+    BenchRing(b);
+    BenchRingOverrun(b);
+    BenchPreRoll(b);
+    fprintf(stderr, "Take storage against a realloc buffer...\n");
+    BenchStorage(b);
+    fprintf(stderr, "Resampler...\n");
+    BenchResample(b);
+    BenchResampleSweeps(b);
+    fprintf(stderr, "Mixer: %u s of drifting inputs...\n", BENCH_MIXER_SECONDS);
+    BenchMixer(b);
+    fprintf(stderr, "Spectrum...\n");
+    BenchSpectrum(b);
+    fprintf(stderr, "Level meter and waveform overview against brute force...\n");
+    BenchLevelMeter(b);
+    BenchOverview(b);
+    fprintf(stderr, "Silence gate on bursts...\n");
+    BenchGate(b);
+    fprintf(stderr, "Slicing %u s of percussion...\n", BENCH_SLICE_SECONDS);
+    BenchSlice(b);
+    fprintf(stderr, "Loudness reference signals and normalized export...\n");
+    BenchLoudnessCases(b);
+    BenchNormalizes(b);
+    fprintf(stderr, "Edit lists against eagerly edited takes...\n");
+    BenchEdits(b);
+    fprintf(stderr, "WAV files with an odd data chunk and past 4 GiB...\n");
+    CheckOddWav(b);
+    CheckRf64Wav(b);
+
+    for (uint32_t i = 0; i < config->takeCount; ++i) {
+        uint64_t frames = (uint64_t)(config->takeSeconds[i] * BENCH_SAMPLE_RATE);
+
+        fprintf(stderr, "%.0f s take: WAV, FLAC and export...\n", config->takeSeconds[i]);
+        BenchWav(b, frames);
+        BenchFlac(b, frames, 0);
+        if (b->threads > 0) BenchFlac(b, frames, b->threads);
+        BenchExports(b, frames);
+    }
+
+    fprintf(stderr, "Export of a %u s take on 1 to N threads...\n", BENCH_EXPORT_SCALING_SECONDS);
+    BenchExportScaling(b);
+
+    fprintf(stderr, "Disk: %u MB through stdio and the disk writer...\n", BENCH_DISK_MEGABYTES);
+    BenchDisk(b, 0);
+    BenchDisk(b, 1);
+
+    BenchResultsPrint(&b->results, stdout);
+    if (b->failed) fprintf(stderr, "Some benchmarks failed and are missing from the results\n");
+
+    result = b->failed ? -1 : 0;
+    if (config->resultsPath) {
+        if (BenchResultsWrite(&b->results, config->resultsPath) != 0) {
+            fprintf(stderr, "Failed to write %s\n", config->resultsPath);
+            result = -1;
+        } else {
+            printf("Results written to %s\n", config->resultsPath);
+        }
+    }
+
+    free(b->signal);
+    free(b->signal16);
+    free(b);
+    return result;
+}
+
+void BenchResultsPrint(const BenchResults *results, FILE *out) {
+    fprintf(out, "%-9s %-24s %8s %7s %10s %12s %8s %9s %10s\n", "group", "name", "audio s", "threads", "Mframes/s",
+            "x real time", "MB/s", "worst ms", "append ms");
+    for (uint32_t i = 0; i < results->count; ++i) {
+        const BenchResult *r = &results->results[i];
+        double seconds = r->seconds > 0 ? r->seconds : 1e-9;
+        fprintf(out, "%-9s %-24s %8.1f %7u %10.2f %12.1f", r->group, r->name, r->audioSeconds, r->threads,
+                r->frames / seconds / 1e6, r->audioSeconds / seconds);
+        if (r->bytes) {
+            fprintf(out, " %8.1f %9.2f %10.2f\n", r->bytes / seconds / 1e6, r->worstWriteSeconds * 1e3,
+                    r->worstAppendSeconds * 1e3);
+        } else if (strcmp(r->group, "mixer") == 0) {
+            fprintf(out, "   worst alignment %.3f ms, drift error %.2f ppm\n", r->worstAlignSeconds * 1e3,
+                    r->driftErrorPpm);
+        } else if (strcmp(r->group, "slice") == 0) {
+            fprintf(out, "   worst onset %.2f ms, %u missed, %u extra\n", r->worstOnsetSeconds * 1e3, r->onsetsMissed,
+                    r->onsetsExtra);
+        } else if (strcmp(r->group, "edit") == 0) {
+            fprintf(out, "   %u edits, max error %.1e of full scale\n", r->edits, r->maxError);
+        } else if (r->framesDropped) {
+            fprintf(out, "   %llu frames dropped whole\n", (unsigned long long)r->framesDropped);
+        } else if (r->peakResident) {
+            fprintf(out, "   peak RSS %.0f MB (%.0f MB private), %.0f MB copied\n", r->peakResident / 1e6,
+                    r->peakPrivate / 1e6, r->bytesCopied / 1e6);
+        } else if (r->rejectionDb > 0.0) {
+            fprintf(out, "   ripple %.6f dB, rejection %.1f dB\n", r->rippleDb, r->rejectionDb);
+        } else if (strcmp(r->group, "loudness") == 0) {
+            fprintf(out, "   %.2f LUFS (%+.2f LU), true peak %.2f dBTP (%+.2f dB)\n", r->loudness, r->loudnessError,
+                    r->truePeak, r->truePeakError);
+        } else if (r->maxError > 0.0) {
+            fprintf(out, "   max error %.1e of full scale\n", r->maxError);
+        } else {
+            fprintf(out, "\n");
+        }
+    }
+}
+
+int BenchResultsWrite(const BenchResults *results, const char *path) {
+    size_t len = strlen(path);
+    int csv = len >= 4 && (strcmp(path + len - 4, ".csv") == 0 || strcmp(path + len - 4, ".CSV") == 0);
+    FILE *f = fopen(path, "w");
+
+    if (!f) return -1;
+
+    if (csv) {
+        fprintf(f, "group,name,threads,frames,audio_seconds,seconds,frames_per_second,realtime,"
+                   "bytes,megabytes_per_second,worst_write_seconds,worst_append_seconds,worst_align_seconds,"
+                   "drift_error_ppm,max_error,worst_onset_seconds,onsets_missed,onsets_extra,loudness,loudness_error,"
+                   "true_peak,true_peak_error,edits,frames_dropped,peak_resident_bytes,peak_private_bytes,bytes_copied,"
+                   "ripple_db,rejection_db\n");
+    } else {
+        fprintf(f, "{\n  \"sample_rate\": %u,\n  \"channels\": %u,\n  \"cpus\": %u,\n  \"kernel\": \"%s\",\n"
+                   "  \"results\": [",
+                BENCH_SAMPLE_RATE, BENCH_CHANNELS, PlatformCpuCount(), ConvertKernelName(ConvertBestKernel()));
+    }
+
+    for (uint32_t i = 0; i < results->count; ++i) {
+        const BenchResult *r = &results->results[i];
+        double seconds = r->seconds > 0 ? r->seconds : 1e-9;
+
+        if (csv) {
+            fprintf(f, "%s,%s,%u,%llu,%.3f,%.6f,%.0f,%.2f,%llu,%.2f,%.6f,%.6f,%.6f,%.3f,%.3g,%.6f,%u,%u,%.3f,%.3f,%.3f,%.3f,%u,%llu,%llu,%llu,%llu,%.6f,%.1f\n",
+                    r->group, r->name,
+                    r->threads, (unsigned long long)r->frames, r->audioSeconds, r->seconds, r->frames / seconds,
+                    r->audioSeconds / seconds, (unsigned long long)r->bytes, r->bytes / seconds / 1e6,
+                    r->worstWriteSeconds, r->worstAppendSeconds, r->worstAlignSeconds, r->driftErrorPpm,
+                    r->maxError, r->worstOnsetSeconds, r->onsetsMissed, r->onsetsExtra, r->loudness, r->loudnessError,
+                    r->truePeak, r->truePeakError, r->edits, (unsigned long long)r->framesDropped,
+                    (unsigned long long)r->peakResident, (unsigned long long)r->peakPrivate,
+                    (unsigned long long)r->bytesCopied, r->rippleDb, r->rejectionDb);
+        } else {
+            fprintf(f, "%s\n    {\"group\": \"%s\", \"name\": \"%s\", \"threads\": %u, \"frames\": %llu, "
+                       "\"audio_seconds\": %.3f, \"seconds\": %.6f, \"frames_per_second\": %.0f, \"realtime\": %.2f",
+                    i ? "," : "", r->group, r->name, r->threads, (unsigned long long)r->frames, r->audioSeconds,
+                    r->seconds, r->frames / seconds, r->audioSeconds / seconds);
+            if (r->bytes) {
+                fprintf(f, ", \"bytes\": %llu, \"megabytes_per_second\": %.2f, \"worst_write_seconds\": %.6f, "
+                           "\"worst_append_seconds\": %.6f",
+                        (unsigned long long)r->bytes, r->bytes / seconds / 1e6, r->worstWriteSeconds,
+                        r->worstAppendSeconds);
+            } else if (strcmp(r->group, "mixer") == 0) {
+                fprintf(f, ", \"worst_align_seconds\": %.6f, \"drift_error_ppm\": %.3f", r->worstAlignSeconds,
+                        r->driftErrorPpm);
+            } else if (strcmp(r->group, "slice") == 0) {
+                fprintf(f, ", \"worst_onset_seconds\": %.6f, \"onsets_missed\": %u, \"onsets_extra\": %u",
+                        r->worstOnsetSeconds, r->onsetsMissed, r->onsetsExtra);
+            } else if (strcmp(r->group, "loudness") == 0) {
+                fprintf(f, ", \"loudness\": %.3f, \"loudness_error\": %.3f, \"true_peak\": %.3f, "
+                           "\"true_peak_error\": %.3f",
+                        r->loudness, r->loudnessError, r->truePeak, r->truePeakError);
+            } else if (strcmp(r->group, "edit") == 0) {
+                fprintf(f, ", \"edits\": %u, \"max_error\": %.3g", r->edits, r->maxError);
+            } else if (r->framesDropped) {
+                fprintf(f, ", \"frames_dropped\": %llu", (unsigned long long)r->framesDropped);
+            } else if (r->peakResident) {
+                fprintf(f, ", \"peak_resident_bytes\": %llu, \"peak_private_bytes\": %llu, \"bytes_copied\": %llu",
+                        (unsigned long long)r->peakResident, (unsigned long long)r->peakPrivate,
+                        (unsigned long long)r->bytesCopied);
+            } else if (r->rejectionDb > 0.0) {
+                fprintf(f, ", \"ripple_db\": %.6f, \"rejection_db\": %.1f", r->rippleDb, r->rejectionDb);
+            } else if (r->maxError > 0.0) {
+                fprintf(f, ", \"max_error\": %.3g", r->maxError);
+            }
+            fprintf(f, "}");
+        }
+    }
+    if (!csv) fprintf(f, "\n  ]\n}\n");
+    return fclose(f) == 0 ? 0 : -1;
+}
@@ -0,0 +1,98 @@
+// bench.h
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_CHANNELS 2
+#define BENCH_BLOCK_FRAMES 4096
+#define BENCH_PACKET_FRAMES 480       // 10 ms, as the capture sources deliver
+#define BENCH_KERNEL_SECONDS 10       // Audio converted or resampled per in-memory run
+#define BENCH_RING_SECONDS 600        // Audio pushed through the ring, so it runs long enough to time
+#define BENCH_REPEATS 3               // In-memory runs report the fastest of these
+#define BENCH_MAX_TAKES 8
+#define BENCH_MAX_RESULTS 160
+#define BENCH_DISK_MEGABYTES 256      // Streamed per disk writer run, well past the writer's queue
+#define BENCH_EXPORT_SCALING_SECONDS 7200 // 2.8 GB of float stereo exported per thread count
+#define BENCH_SCRATCH_BASE "bench_scratch"
+
+// One timed run. frames are input frames; audioSeconds is what they amount to
+// at their own rate, so realtime = audioSeconds / seconds.
+typedef struct {
+    char group[16];               // convert, ring, storage, resample, mixer, spectrum, meter, gate, slice, loudness, edit, wav, flac, export or disk
+    char name[40];
+    uint32_t threads;
+    uint64_t frames;
+    double audioSeconds;
+    double seconds;
+    uint64_t bytes;               // Disk runs only: file bytes streamed
+    double worstWriteSeconds;     // Longest single write to the file
+    double worstAppendSeconds;    // Longest the streaming thread was held in one append
+    double worstAlignSeconds;     // Mixer runs only: furthest an input strayed from its true position
+    double driftErrorPpm;         // Drift the mixer corrected for, against the true clock skew
+    double maxError;              // Live spectrum runs: worst magnitude error against a direct DFT
+    double worstOnsetSeconds;     // Slice runs only: furthest a found onset was from the true one
+    uint32_t onsetsMissed;
+    uint32_t onsetsExtra;         // Slices cut where there was no onset
+    double loudness;              // Loudness runs only: integrated LUFS measured
+    double loudnessError;         // LU off the reference; 0 where there is none
+    double truePeak;              // dBTP measured
+    double truePeakError;         // dB over the reference, or over the ceiling when normalizing
+    uint32_t edits;               // Edit runs only: edits, undos and redos behind the audio checked
+    uint64_t framesDropped;       // Ring overrun run only: frames the full ring turned away
+    uint64_t peakResident;        // Storage memory runs only: most the resident set grew by
+    uint64_t peakPrivate;         // The part of it no file backs
+    uint64_t bytesCopied;         // Stored audio moved to make room for more
+    double rippleDb;              // Resampler sweeps only: furthest the passband gain strayed from unity
+    double rejectionDb;           // Least that images, aliases or stopband tones were down by
+} BenchResult;
+
+typedef struct {
+    double takeSeconds[BENCH_MAX_TAKES];  // Lengths for the file writing and export runs
+    uint32_t takeCount;
+    uint32_t threads;             // Worker threads for FLAC and export
+    const char *resultsPath;      // NULL: table only; .csv selects CSV, anything else JSON
+} BenchConfig;
+
+typedef struct {
+    BenchResult results[BENCH_MAX_RESULTS];
+    uint32_t count;
+} BenchResults;
+
+// Times the audio core on synthetic 48 kHz stereo: conversion kernels and round
+// trips through every sample type and layout, ring buffer throughput and
+// overruns against a throttled consumer, pre-roll committed after the ring
+// wraps, take storage appends, walks and the memory 1 h and 8 h takes hold
+// against a realloc-grown buffer, resampling and sine sweeps through it, mixing
+// inputs with drifting clocks, spectrum analysis checked against a direct DFT,
+// level metering and the waveform overview checked against brute force, the
+// silence gate on bursts of tone, hiss and silence, slicing synthetic
+// percussion checked against its known onsets, loudness metering checked
+// against the EBU Tech 3341 reference levels, normalized export, edit lists
+// rendered, played and exported against the same edits applied eagerly, WAV
+// writing read back byte for byte (odd data chunks and RF64 past 4 GiB
+// included), FLAC writing, take export, export of a
+// BENCH_EXPORT_SCALING_SECONDS take spilled to a file on each thread count from
+// 1 to N, and streaming BENCH_DISK_MEGABYTES through stdio and the disk writer.
+// File runs write to BENCH_SCRATCH_BASE files in the working directory and
+// delete them.
+// Prints a table and writes the results file. Returns 0 if every run completed,
+// the conversion kernels matched the scalar reference, every round trip came
+// back exact or within one LSB, channel masks survived WAV files and export,
+// the ring counted every packet it dropped, every committed pre-roll held the
+// source's audio from exactly the pre-roll before the commit, the resampler
+// kept its passband flat to 0.0001 dB and everything else RESAMPLER_STOPBAND_DB
+// down, take storage slices, iterators and reuse after a reset matched a flat
+// copy, the mixer stayed locked, the spectrum matched the DFT, meter readings
+// and overview columns matched the samples behind them, the gate cut where its
+// hangover and minimum gap put the cuts, every onset was sliced, every loudness
+// reading was within tolerance, every edit rendered as its reference and every
+// WAV file read back as written.
+int RunBenchmarks(const BenchConfig *config);
+
+void BenchResultsPrint(const BenchResults *results, FILE *out);
+int BenchResultsWrite(const BenchResults *results, const char *path);
+
+#endif // BENCH_H
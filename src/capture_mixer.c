@@ -0,0 +1,613 @@
+// capture_mixer.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture_mixer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MIXER_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define MIXER_PASSBAND 0.9            // Of the lower Nyquist frequency
+#define MIXER_MAX_PERIOD_ERROR 0.01   // Clocks further off than this are not believed
+
+static void LerpScalar(float *dst, const float *a, const float *b, float t, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) dst[i] = a[i] + t * (b[i] - a[i]);
+}
+
+static void AddScalar(float *dst, const float *src, float gain, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) dst[i] += gain * src[i];
+}
+
+#ifdef MIXER_HAVE_X86
+
+__attribute__((target("sse2")))
+static void LerpSse2(float *dst, const float *a, const float *b, float t, uint32_t count) {
+    __m128 vt = _mm_set1_ps(t);
+
+    for (uint32_t i = 0; i < count; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(va, _mm_mul_ps(vt, _mm_sub_ps(_mm_loadu_ps(b + i), va))));
+    }
+}
+
+__attribute__((target("sse2")))
+static void AddSse2(float *dst, const float *src, float gain, uint32_t count) {
+    __m128 g = _mm_set1_ps(gain);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+    }
+    for (; i < count; ++i) dst[i] += gain * src[i];
+}
+
+__attribute__((target("avx2")))
+static void LerpAvx2(float *dst, const float *a, const float *b, float t, uint32_t count) {
+    __m256 vt = _mm256_set1_ps(t);
+
+    for (uint32_t i = 0; i < count; i += 8) {
+        __m256 va = _mm256_loadu_ps(a + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(va, _mm256_mul_ps(vt, _mm256_sub_ps(_mm256_loadu_ps(b + i), va))));
+    }
+}
+
+__attribute__((target("avx2")))
+static void AddAvx2(float *dst, const float *src, float gain, uint32_t count) {
+    __m256 g = _mm256_set1_ps(gain);
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(g, _mm256_loadu_ps(src + i))));
+    }
+    for (; i < count; ++i) dst[i] += gain * src[i];
+}
+
+#endif // MIXER_HAVE_X86
+
+static void PickKernels(CaptureMixer *m) {
+    m->dot = ResamplerBestDot();
+    m->lerp = LerpScalar;
+    m->add = AddScalar;
+#ifdef MIXER_HAVE_X86
+    switch (ConvertBestKernel()) {
+    case CONVERT_KERNEL_AVX2:
+        m->lerp = LerpAvx2;
+        m->add = AddAvx2;
+        break;
+    case CONVERT_KERNEL_SSE2:
+        m->lerp = LerpSse2;
+        m->add = AddSse2;
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
+// Blackman-windowed sinc at MIXER_PHASES + 1 fractional offsets, the last one
+// a whole frame on so every offset has a neighbour to interpolate towards.
+// Tap k of offset f weighs frame (whole - MIXER_TAPS / 2 + 1 + k).
+static void BuildFilters(float *filters, double ratio) {
+    double cutoff = 0.5 * MIXER_PASSBAND * (ratio > 1.0 ? 1.0 / ratio : 1.0);
+    double half = MIXER_TAPS / 2.0;
+
+    for (uint32_t p = 0; p <= MIXER_PHASES; ++p) {
+        float *h = filters + (size_t)p * MIXER_TAPS;
+        double offset = (double)p / MIXER_PHASES;
+        double sum = 0.0;
+
+        for (uint32_t k = 0; k < MIXER_TAPS; ++k) {
+            double t = k - (half - 1.0) - offset;
+            double x = t / half;
+            double arg = 2.0 * M_PI * cutoff * t;
+            double sinc = t == 0.0 ? 1.0 : sin(arg) / arg;
+            double window = fabs(x) < 1.0 ? 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2.0 * M_PI * x) : 0.0;
+
+            h[k] = (float)(sinc * window);
+            sum += h[k];
+        }
+        // Unity gain at DC for every offset
+        for (uint32_t k = 0; k < MIXER_TAPS; ++k) h[k] = (float)(h[k] / sum);
+    }
+}
+
+static void FreeInput(MixerInput *in) {
+    RingBufferFree(&in->ring);
+    free(in->convertBuffer);
+    free(in->staging);
+    free(in->window[0]);
+    free(in->resampled[0]);
+    free(in->filters);
+    memset(in->window, 0, sizeof(in->window));
+    memset(in->resampled, 0, sizeof(in->resampled));
+    in->convertBuffer = NULL;
+    in->staging = NULL;
+    in->filters = NULL;
+}
+
+static int InitInput(CaptureMixer *m, MixerInput *in, const WavFormat *format, uint16_t outOffset) {
+    SampleFormat inFormat;
+    SampleFormat floatFormat = { SAMPLE_F32, format->channels, 0 };
+    size_t frameBytes = (size_t)format->channels * sizeof(float);
+
+    in->format = *format;
+    in->channels = format->channels;
+    in->outOffset = outOffset;
+    in->gain = 1.0f;
+    atomic_init(&in->anchorHead, 0);
+    atomic_init(&in->anchorTail, 0);
+    atomic_init(&in->framesPushed, 0);
+    atomic_init(&in->overruns, 0);
+    atomic_init(&in->ended, 0);
+
+    if (!format->sampleRate || !format->channels || format->channels > MIXER_MAX_CHANNELS) return -1;
+    if (format->sampleRate > (uint64_t)m->sampleRate * MIXER_MAX_RATIO) return -1;
+    if (SampleFormatFromWav(format, &inFormat) != 0) return -1;
+    if (SampleConverterInit(&in->toFloat, &inFormat, &floatFormat) != 0) return -1;
+    if (RingBufferInit(&in->ring, (size_t)format->sampleRate * MIXER_RING_SECONDS * frameBytes) != 0) return -1;
+
+    in->convertBuffer = (float *)malloc(MIXER_CONVERT_FRAMES * frameBytes);
+    in->staging = (float *)malloc(MIXER_CONVERT_FRAMES * frameBytes);
+    in->window[0] = (float *)malloc(MIXER_WINDOW_FRAMES * frameBytes);
+    in->resampled[0] = (float *)malloc(MIXER_BLOCK_FRAMES * frameBytes);
+    in->filters = (float *)malloc((size_t)(MIXER_PHASES + 1) * MIXER_TAPS * sizeof(float));
+    if (!in->convertBuffer || !in->staging || !in->window[0] || !in->resampled[0] || !in->filters) return -1;
+
+    for (uint16_t c = 1; c < in->channels; ++c) {
+        in->window[c] = in->window[0] + (size_t)c * MIXER_WINDOW_FRAMES;
+        in->resampled[c] = in->resampled[0] + (size_t)c * MIXER_BLOCK_FRAMES;
+    }
+
+    in->nominalRatio = (double)format->sampleRate / m->sampleRate;
+    in->ratio = in->nominalRatio;
+    in->clock.nominalNsPerFrame = 1e9 / format->sampleRate;
+    in->clock.nsPerFrame = in->clock.nominalNsPerFrame;
+    BuildFilters(in->filters, in->nominalRatio);
+    return 0;
+}
+
+int CaptureMixerInit(CaptureMixer *m, const WavFormat *formats, uint32_t count, const CaptureMixerConfig *config) {
+    uint32_t channels = 0;
+    uint16_t offset = 0;
+
+    memset(m, 0, sizeof(*m));
+    if (count == 0 || count > MIXER_MAX_INPUTS || !formats[0].sampleRate) return -1;
+
+    m->config = *config;
+    if (!m->config.latencyMs) m->config.latencyMs = MIXER_LATENCY_MS;
+    m->sampleRate = formats[0].sampleRate;
+    m->latencyFrames = (uint32_t)((uint64_t)m->sampleRate * m->config.latencyMs / 1000);
+    PickKernels(m);
+
+    for (uint32_t i = 0; i < count; ++i) channels += formats[i].channels;
+    if (config->layout == MIXER_LAYOUT_SUM) channels = formats[0].channels;
+    if (channels == 0 || channels > MIXER_MAX_CHANNELS) return -1;
+    m->channels = (uint16_t)channels;
+
+    m->mix[0] = (float *)malloc((size_t)channels * MIXER_BLOCK_FRAMES * sizeof(float));
+    if (!m->mix[0]) return -1;
+    for (uint16_t c = 1; c < m->channels; ++c) m->mix[c] = m->mix[0] + (size_t)c * MIXER_BLOCK_FRAMES;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        m->inputCount = i + 1;
+        if (InitInput(m, &m->inputs[i], &formats[i], offset) != 0) {
+            CaptureMixerClose(m);
+            return -1;
+        }
+        offset += formats[i].channels;
+    }
+
+    // The master is read frame for frame and locked from the start
+    m->inputs[0].locked = 1;
+    return 0;
+}
+
+void CaptureMixerClose(CaptureMixer *m) {
+    for (uint32_t i = 0; i < m->inputCount; ++i) FreeInput(&m->inputs[i]);
+    free(m->mix[0]);
+    m->mix[0] = NULL;
+    m->inputCount = 0;
+}
+
+void CaptureMixerSetGain(CaptureMixer *m, uint32_t input, float gain) {
+    if (input < m->inputCount) m->inputs[input].gain = gain;
+}
+
+void CaptureMixerOutputFormat(const CaptureMixer *m, WavFormat *format) {
+    format->formatTag = WAV_FORMAT_IEEE_FLOAT;
+    format->channels = m->channels;
+    format->sampleRate = m->sampleRate;
+    format->bitsPerSample = 32;
+    format->channelMask = 0;
+}
+
+// Input side
+
+static void PushAnchor(MixerInput *in, uint64_t frame, uint64_t timestampNs) {
+    unsigned head = atomic_load_explicit(&in->anchorHead, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&in->anchorTail, memory_order_acquire);
+    MixerAnchor *a;
+
+    // A full queue only means the clock is updated less often
+    if (head - tail >= MIXER_ANCHORS) return;
+
+    a = &in->anchors[head % MIXER_ANCHORS];
+    a->frame = frame;
+    a->timestampNs = timestampNs;
+    a->restart = in->restartClock;
+    in->restartClock = 0;
+    atomic_store_explicit(&in->anchorHead, head + 1, memory_order_release);
+}
+
+int CaptureMixerPush(CaptureMixer *m, uint32_t input, const CapturePacket *packet) {
+    MixerInput *in = &m->inputs[input];
+    size_t frameBytes = (size_t)in->channels * sizeof(float);
+    uint32_t srcFrameBytes = SampleFormatFrameBytes(&in->toFloat.in);
+    uint64_t position = atomic_load_explicit(&in->framesPushed, memory_order_relaxed);
+    const uint8_t *src = packet->data;
+    uint32_t left = packet->frames;
+
+    // A packet goes in whole or not at all, so stream positions stay exact
+    // and the gap can be reported with the next timestamp
+    if (RingBufferWritable(&in->ring) < left * frameBytes) {
+        atomic_fetch_add_explicit(&in->overruns, 1, memory_order_relaxed);
+        in->restartClock = 1;
+        return -1;
+    }
+
+    if (packet->flags & CAPTURE_PACKET_DISCONTINUITY) in->restartClock = 1;
+    if (packet->timestampNs && !(packet->flags & CAPTURE_PACKET_TIMESTAMP_ERROR)) {
+        PushAnchor(in, position, packet->timestampNs);
+    }
+
+    if (!src) {
+        RingBufferWriteZeros(&in->ring, left * frameBytes);
+    } else {
+        while (left > 0) {
+            uint32_t n = left < MIXER_CONVERT_FRAMES ? left : MIXER_CONVERT_FRAMES;
+            SampleConverterRun(&in->toFloat, in->convertBuffer, src, n, NULL);
+            RingBufferWrite(&in->ring, in->convertBuffer, n * frameBytes);
+            src += (size_t)n * srcFrameBytes;
+            left -= n;
+        }
+    }
+    atomic_store_explicit(&in->framesPushed, position + packet->frames, memory_order_release);
+    return 0;
+}
+
+void CaptureMixerEndInput(CaptureMixer *m, uint32_t input) {
+    atomic_store(&m->inputs[input].ended, 1);
+}
+
+// Mixer side
+
+// One step of the loop. Errors beyond MIXER_RESYNC_MS, or a gap the input
+// reported, restart the clock at the new timestamp instead of bending it.
+static void ClockUpdate(MixerClock *c, double frame, double timeNs, int restart) {
+    if (c->valid && !restart) {
+        double frames = frame - c->frame;
+        double predicted = c->timeNs + frames * c->nsPerFrame;
+        double error = timeNs - predicted;
+        double limit = c->nominalNsPerFrame * MIXER_MAX_PERIOD_ERROR;
+
+        if (frames <= 0.0) return;
+        if (fabs(error) <= MIXER_RESYNC_MS * 1e6) {
+            // Gains for the interval since the last timestamp, kept stable for sparse ones
+            double omega = 2.0 * M_PI * MIXER_DLL_BANDWIDTH_HZ * frames * c->nominalNsPerFrame * 1e-9;
+            if (omega > 0.5) omega = 0.5;
+
+            c->frame = frame;
+            c->timeNs = predicted + sqrt(2.0) * omega * error;
+            c->nsPerFrame += omega * omega * error / frames;
+            if (c->nsPerFrame > c->nominalNsPerFrame + limit) c->nsPerFrame = c->nominalNsPerFrame + limit;
+            if (c->nsPerFrame < c->nominalNsPerFrame - limit) c->nsPerFrame = c->nominalNsPerFrame - limit;
+            return;
+        }
+    }
+
+    if (c->valid) c->jumped = 1;
+    c->valid = 1;
+    c->frame = frame;
+    c->timeNs = timeNs;
+}
+
+static void DrainAnchors(CaptureMixer *m, MixerInput *in) {
+    unsigned tail = atomic_load_explicit(&in->anchorTail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&in->anchorHead, memory_order_acquire);
+
+    for (; tail != head; ++tail) {
+        const MixerAnchor *a = &in->anchors[tail % MIXER_ANCHORS];
+
+        if (!m->baseSet) {
+            m->baseNs = a->timestampNs;
+            m->baseSet = 1;
+        }
+        ClockUpdate(&in->clock, (double)a->frame, (double)(int64_t)(a->timestampNs - m->baseNs), a->restart);
+    }
+    atomic_store_explicit(&in->anchorTail, tail, memory_order_release);
+}
+
+// Drops history the interpolator has passed and moves queued frames into the
+// planar window. Frames an input delivered too late to be mixed are skipped.
+static void Refill(MixerInput *in) {
+    size_t frameBytes = (size_t)in->channels * sizeof(float);
+    int64_t keep = (int64_t)floor(in->readPos) - (MIXER_TAPS / 2 - 1);
+
+    if (keep > in->windowStart) {
+        uint64_t drop = (uint64_t)(keep - in->windowStart);
+
+        if (drop >= in->windowFrames) {
+            in->windowStart += in->windowFrames;
+            in->windowFrames = 0;
+        } else {
+            in->windowFrames -= (uint32_t)drop;
+            for (uint16_t c = 0; c < in->channels; ++c) {
+                memmove(in->window[c], in->window[c] + drop, (size_t)in->windowFrames * sizeof(float));
+            }
+            in->windowStart += (int64_t)drop;
+        }
+    }
+
+    if (in->windowFrames == 0 && keep > in->windowStart) {
+        uint64_t queued = RingBufferReadable(&in->ring) / frameBytes;
+        uint64_t skip = (uint64_t)(keep - in->windowStart);
+
+        if (skip > queued) skip = queued;
+        RingBufferConsume(&in->ring, (size_t)skip * frameBytes);
+        in->windowStart += (int64_t)skip;
+        in->stats.framesIn += skip;
+    }
+
+    while (in->windowFrames < MIXER_WINDOW_FRAMES) {
+        size_t n = RingBufferReadable(&in->ring) / frameBytes;
+        const float *src = in->staging;
+
+        if (n == 0) break;
+        if (n > MIXER_WINDOW_FRAMES - in->windowFrames) n = MIXER_WINDOW_FRAMES - in->windowFrames;
+        if (n > MIXER_CONVERT_FRAMES) n = MIXER_CONVERT_FRAMES;
+
+        RingBufferRead(&in->ring, in->staging, n * frameBytes);
+        for (size_t i = 0; i < n; ++i) {
+            for (uint16_t c = 0; c < in->channels; ++c) in->window[c][in->windowFrames + i] = *src++;
+        }
+        in->windowFrames += (uint32_t)n;
+        in->stats.framesIn += n;
+    }
+}
+
+// Where the input should be read for the master's next frame, by the two clocks
+static double DesiredPosition(const CaptureMixer *m, const MixerInput *in) {
+    const MixerInput *master = &m->inputs[0];
+    double t = master->clock.timeNs + (master->readPos - master->clock.frame) * master->clock.nsPerFrame;
+
+    return in->clock.frame + (t - in->clock.timeNs) / in->clock.nsPerFrame;
+}
+
+static void Lock(CaptureMixer *m, MixerInput *in, int timed) {
+    if (in->locked) in->stats.relocks++;
+    in->locked = 1;
+    in->timed = timed;
+    in->lockedAt = m->outFrames;
+    in->clock.jumped = 0;
+    in->ratio = in->nominalRatio;
+    in->readPos = timed ? DesiredPosition(m, in) : m->inputs[0].readPos * in->nominalRatio;
+}
+
+// Sets the input's ratio for the next block: the measured clock ratio, plus
+// a correction that steers out the remaining alignment error
+static void Steer(CaptureMixer *m, MixerInput *in, int masterJumped) {
+    const MixerInput *master = &m->inputs[0];
+    int timed = master->clock.valid && in->clock.valid;
+    double base;
+    double error;
+    double correction;
+    double limit;
+
+    if (!in->locked) {
+        // Inputs lock once they deliver, so one that starts late is not padded meanwhile
+        if (in->windowFrames == 0) return;
+        Lock(m, in, timed);
+    } else if (timed != in->timed || in->clock.jumped || masterJumped) {
+        Lock(m, in, timed);
+    }
+
+    if (!in->timed) {
+        in->ratio = in->nominalRatio;
+        return;
+    }
+
+    base = master->clock.nsPerFrame / in->clock.nsPerFrame;
+    error = in->readPos - DesiredPosition(m, in);
+    if (fabs(error) > MIXER_RESYNC_MS * in->format.sampleRate / 1000.0) {
+        Lock(m, in, 1);
+        error = 0.0;
+    }
+
+    correction = -error / (MIXER_CORRECTION_SECONDS * m->sampleRate);
+    limit = base * MIXER_MAX_CORRECTION_PPM * 1e-6;
+    if (correction > limit) correction = limit;
+    if (correction < -limit) correction = -limit;
+    in->ratio = base + correction;
+
+    in->stats.driftPpm = (base / in->nominalRatio - 1.0) * 1e6;
+    in->stats.errorFrames = error;
+    if (m->outFrames - in->lockedAt >= (uint64_t)(MIXER_SETTLE_SECONDS * m->sampleRate) &&
+        fabs(error) > in->stats.maxErrorFrames) {
+        in->stats.maxErrorFrames = fabs(error);
+    }
+}
+
+// Output frames the window can produce before it runs out of input
+static uint32_t Ready(const MixerInput *in) {
+    double limit = (double)(in->windowStart + in->windowFrames) - MIXER_TAPS / 2;
+    double frames;
+
+    if (limit <= in->readPos) return 0;
+    frames = ceil((limit - in->readPos) / in->ratio);
+    return frames > MIXER_BLOCK_FRAMES ? MIXER_BLOCK_FRAMES : (uint32_t)frames;
+}
+
+static void Resample(CaptureMixer *m, MixerInput *in, uint32_t frames) {
+    int64_t windowEnd = in->windowStart + in->windowFrames;
+    int ended = atomic_load_explicit(&in->ended, memory_order_relaxed);
+
+    for (uint32_t j = 0; j < frames; ++j) {
+        double x = in->readPos + j * in->ratio;
+        double whole = floor(x);
+        double position = (x - whole) * MIXER_PHASES;
+        uint32_t phase = (uint32_t)position;
+        int64_t first = (int64_t)whole - (MIXER_TAPS / 2 - 1);
+        const float *h = in->filters + (size_t)phase * MIXER_TAPS;
+
+        m->lerp(m->coeffs, h, h + MIXER_TAPS, (float)(position - phase), MIXER_TAPS);
+
+        if (first >= in->windowStart && first + MIXER_TAPS <= windowEnd) {
+            size_t offset = (size_t)(first - in->windowStart);
+            for (uint16_t c = 0; c < in->channels; ++c) {
+                in->resampled[c][j] = m->dot(in->window[c] + offset, m->coeffs, MIXER_TAPS);
+            }
+            continue;
+        }
+
+        // Before the stream or not arrived yet: the missing frames are silence
+        for (uint16_t c = 0; c < in->channels; ++c) {
+            float acc = 0.0f;
+            for (int64_t k = 0; k < MIXER_TAPS; ++k) {
+                if (first + k >= in->windowStart && first + k < windowEnd) {
+                    acc += in->window[c][first + k - in->windowStart] * m->coeffs[k];
+                }
+            }
+            in->resampled[c][j] = acc;
+        }
+        if (first + MIXER_TAPS > windowEnd && !ended) in->stats.underrunFrames++;
+    }
+    in->readPos += frames * in->ratio;
+}
+
+static void MixInto(CaptureMixer *m, const MixerInput *in, float *const *src, uint32_t frames) {
+    if (m->config.layout == MIXER_LAYOUT_MULTITRACK) {
+        for (uint16_t c = 0; c < in->channels; ++c) m->add(m->mix[in->outOffset + c], src[c], in->gain, frames);
+    } else if (in->channels == 1) {
+        for (uint16_t c = 0; c < m->channels; ++c) m->add(m->mix[c], src[0], in->gain, frames);
+    } else if (m->channels == 1) {
+        for (uint16_t c = 0; c < in->channels; ++c) m->add(m->mix[0], src[c], in->gain / in->channels, frames);
+    } else {
+        // Channels the output lacks are left out
+        for (uint16_t c = 0; c < in->channels && c < m->channels; ++c) m->add(m->mix[c], src[c], in->gain, frames);
+    }
+}
+
+uint32_t CaptureMixerPull(CaptureMixer *m, float *out, uint32_t maxFrames) {
+    uint64_t startNs = PlatformNowNs();
+    MixerInput *master = &m->inputs[0];
+    float *rows[MIXER_MAX_CHANNELS];
+    uint32_t available;
+    uint32_t frames;
+    int masterJumped;
+
+    for (uint32_t i = 0; i < m->inputCount; ++i) {
+        // Anchors are queued before their frames, so every frame read here has its timestamp
+        Refill(&m->inputs[i]);
+        DrainAnchors(m, &m->inputs[i]);
+    }
+    masterJumped = master->clock.jumped;
+    master->clock.jumped = 0;
+
+    available = (uint32_t)(master->windowStart + master->windowFrames - (int64_t)master->readPos);
+    frames = available;
+    if (frames > maxFrames) frames = maxFrames;
+    if (frames > MIXER_BLOCK_FRAMES) frames = MIXER_BLOCK_FRAMES;
+
+    // Late inputs are waited for while the master has less than the latency queued
+    for (uint32_t i = 1; i < m->inputCount && frames > 0; ++i) {
+        MixerInput *in = &m->inputs[i];
+        int ended = atomic_load(&in->ended);
+        uint32_t ready;
+
+        Steer(m, in, masterJumped);
+        if (ended) continue;
+
+        ready = in->locked ? Ready(in) : 0;
+        if (ready < frames && (m->config.waitForInputs || available < m->latencyFrames)) frames = ready;
+    }
+
+    if (frames > 0) {
+        for (uint16_t c = 0; c < m->channels; ++c) memset(m->mix[c], 0, frames * sizeof(float));
+
+        for (uint16_t c = 0; c < master->channels; ++c) {
+            rows[c] = master->window[c] + ((int64_t)master->readPos - master->windowStart);
+        }
+        MixInto(m, master, rows, frames);
+        master->readPos += frames;
+
+        for (uint32_t i = 1; i < m->inputCount; ++i) {
+            MixerInput *in = &m->inputs[i];
+            if (!in->locked) continue;
+            Resample(m, in, frames);
+            MixInto(m, in, in->resampled, frames);
+        }
+
+        for (uint32_t j = 0; j < frames; ++j) {
+            for (uint16_t c = 0; c < m->channels; ++c) *out++ = m->mix[c][j];
+        }
+        m->outFrames += frames;
+    }
+
+    m->mixNs += PlatformNowNs() - startNs;
+    return frames;
+}
+
+uint64_t CaptureMixerTimestamp(const CaptureMixer *m) {
+    const MixerInput *master = &m->inputs[0];
+    double t;
+
+    if (!master->clock.valid) return 0;
+    t = master->clock.timeNs + (master->readPos - master->clock.frame) * master->clock.nsPerFrame;
+    if (t < -(double)m->baseNs) return 0;
+    return (uint64_t)((int64_t)m->baseNs + (int64_t)t);
+}
+
+int CaptureMixerFinished(CaptureMixer *m) {
+    MixerInput *master = &m->inputs[0];
+
+    // ended is set after the input's last push, so checking it first sees every frame
+    if (!atomic_load(&master->ended)) return 0;
+    return RingBufferReadable(&master->ring) == 0 &&
+           master->readPos >= (double)(master->windowStart + master->windowFrames);
+}
+
+void CaptureMixerPrintStats(const CaptureMixer *m, FILE *out) {
+    double audioSeconds = (double)m->outFrames / m->sampleRate;
+
+    fprintf(out, "Mixer: %u inputs %s into %u channels, %.1f s mixed in %.1f ms (%.2f%% of real time)\n",
+            m->inputCount, m->config.layout == MIXER_LAYOUT_MULTITRACK ? "side by side" : "summed", m->channels,
+            audioSeconds, m->mixNs / 1e6, audioSeconds > 0 ? m->mixNs / 1e7 / audioSeconds : 0.0);
+
+    for (uint32_t i = 0; i < m->inputCount; ++i) {
+        const MixerInput *in = &m->inputs[i];
+        const MixerInputStats *s = &in->stats;
+        double msPerFrame = 1e3 / in->format.sampleRate;
+
+        fprintf(out, "  input %u: %u Hz, %u ch, ", i, in->format.sampleRate, in->channels);
+        if (i == 0) {
+            fprintf(out, "master%s", in->clock.valid ? "" : ", untimed");
+        } else if (!in->locked) {
+            fprintf(out, "never delivered");
+        } else if (!in->timed) {
+            fprintf(out, "untimed, aligned by frame count, %llu frames padded",
+                    (unsigned long long)s->underrunFrames);
+        } else {
+            fprintf(out, "drift %+.1f ppm, error %.3f ms (worst %.3f ms settled), %llu frames padded, %llu relocks",
+                    s->driftPpm, s->errorFrames * msPerFrame, s->maxErrorFrames * msPerFrame,
+                    (unsigned long long)s->underrunFrames, (unsigned long long)s->relocks);
+        }
+        fprintf(out, ", %llu overruns\n", (unsigned long long)atomic_load(&in->overruns));
+    }
+}
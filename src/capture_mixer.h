@@ -0,0 +1,169 @@
+// capture_mixer.h
+#ifndef CAPTURE_MIXER_H
+#define CAPTURE_MIXER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "capture_source.h"
+#include "ring_buffer.h"
+#include "resampler.h"
+#include "sample_convert.h"
+#include "platform.h"
+
+#define MIXER_MAX_INPUTS 4
+#define MIXER_MAX_CHANNELS 8
+#define MIXER_RING_SECONDS 2          // Per input queue
+#define MIXER_ANCHORS 256             // Packet timestamps in flight per input
+#define MIXER_TAPS 32                 // Interpolation filter length, a multiple of 8
+#define MIXER_PHASES 256              // Filter table resolution; coefficients are interpolated between
+#define MIXER_BLOCK_FRAMES 1024       // Most output frames mixed per step
+#define MIXER_WINDOW_FRAMES 8192      // Per input history the interpolator reads from
+#define MIXER_CONVERT_FRAMES 1024
+#define MIXER_LATENCY_MS 40           // How long the first input waits for late ones before padding them
+#define MIXER_DLL_BANDWIDTH_HZ 0.5    // Timestamp smoothing
+#define MIXER_CORRECTION_SECONDS 2.0  // Alignment errors are steered out over this long
+#define MIXER_MAX_CORRECTION_PPM 2000.0
+#define MIXER_RESYNC_MS 20.0          // Errors beyond this restart the clock and re-align
+#define MIXER_SETTLE_SECONDS 10.0     // Alignment errors count toward the worst after this long locked
+#define MIXER_MAX_RATIO 4             // Highest input rate, as a multiple of the master's
+
+typedef enum {
+    MIXER_LAYOUT_SUM = 0,         // Every input summed into the first input's channels
+    MIXER_LAYOUT_MULTITRACK       // Inputs side by side, their channels in input order
+} MixerLayout;
+
+typedef struct {
+    MixerLayout layout;
+    uint32_t latencyMs;           // 0: MIXER_LATENCY_MS
+    int waitForInputs;            // Never pad a live input; for sources faster than real time
+} CaptureMixerConfig;
+
+typedef void (*MixerLerpFn)(float *dst, const float *a, const float *b, float t, uint32_t count);
+typedef void (*MixerAddFn)(float *dst, const float *src, float gain, uint32_t count);
+
+// Maps an input's stream frames to PlatformNowNs time. A second-order
+// delay-locked loop smooths the packet timestamps, so their jitter never
+// reaches the resampling ratio while the clock's true rate is tracked.
+typedef struct {
+    int valid;
+    double frame;                 // Frame of the last update
+    double timeNs;                // Its smoothed time, from the mixer's base
+    double nsPerFrame;            // Measured period
+    double nominalNsPerFrame;
+    int jumped;                   // Restarted since the consumer last looked
+} MixerClock;
+
+typedef struct {
+    uint64_t frame;
+    uint64_t timestampNs;
+    int restart;                  // Frames were lost before this packet
+} MixerAnchor;
+
+typedef struct {
+    double driftPpm;              // Clock rate against the first input, as measured
+    double errorFrames;           // Read position against the timestamps, last step
+    double maxErrorFrames;        // Worst once settled
+    uint64_t overruns;            // Packets dropped because the queue was full
+    uint64_t underrunFrames;      // Output frames padded because the input was late
+    uint64_t relocks;
+    uint64_t framesIn;
+} MixerInputStats;
+
+typedef struct {
+    WavFormat format;
+    uint16_t channels;
+    uint16_t outOffset;           // First output channel in multitrack layout
+    float gain;
+    SampleConverter toFloat;
+    float *convertBuffer;         // Producer side, MIXER_CONVERT_FRAMES
+    int restartClock;             // Producer side: the next anchor follows a gap
+
+    // Shared between the input's capture thread and the mixer
+    RingBuffer ring;              // Interleaved float frames
+    MixerAnchor anchors[MIXER_ANCHORS];
+    atomic_uint anchorHead;
+    atomic_uint anchorTail;
+    atomic_uint_fast64_t framesPushed;
+    atomic_uint_fast64_t overruns;
+    atomic_int ended;
+
+    // Mixer side
+    float *window[MIXER_MAX_CHANNELS];    // Planar, MIXER_WINDOW_FRAMES each
+    int64_t windowStart;          // Stream frame of window[c][0]
+    uint32_t windowFrames;
+    float *staging;               // Ring to window
+    float *resampled[MIXER_MAX_CHANNELS]; // One block, before mixing
+    float *filters;               // (MIXER_PHASES + 1) * MIXER_TAPS, phase-major
+    MixerClock clock;
+    int locked;
+    int timed;                    // Locked by timestamps rather than frame count
+    uint64_t lockedAt;            // Output frame
+    double readPos;               // Stream frame of the next output frame
+    double ratio;                 // Input frames per output frame, last step
+    double nominalRatio;
+    MixerInputStats stats;
+} MixerInput;
+
+// Mixes several capture streams into one. Each input is pushed from its own
+// capture thread into a lock-free queue and never blocks; the mixer pulls on
+// one thread, driven by the first input, whose clock the output runs on.
+// Every other input is resampled with a windowed sinc whose ratio follows
+// the input's clock: packet timestamps give each input a frame -> time map,
+// the ratio of their periods is the drift, and the remaining difference
+// between where an input is read and where its timestamps say it should be
+// is steered out over MIXER_CORRECTION_SECONDS. Inputs without timestamps
+// (offline sources running free) are aligned by frame count at their nominal
+// rate. Output is interleaved float at the first input's rate.
+typedef struct {
+    CaptureMixerConfig config;
+    uint32_t sampleRate;
+    uint16_t channels;
+    uint32_t inputCount;
+    MixerInput inputs[MIXER_MAX_INPUTS];
+    uint32_t latencyFrames;
+    ResamplerDotFn dot;
+    MixerLerpFn lerp;
+    MixerAddFn add;
+    float *mix[MIXER_MAX_CHANNELS];
+    float coeffs[MIXER_TAPS];
+    uint64_t baseNs;              // First timestamp seen; clocks count from here
+    int baseSet;
+    uint64_t outFrames;
+    uint64_t mixNs;               // Time spent in CaptureMixerPull
+} CaptureMixer;
+
+// formats[0] is the master. Returns -1 for unsupported formats, rates above
+// MIXER_MAX_RATIO times the master's or layouts needing more than
+// MIXER_MAX_CHANNELS.
+int CaptureMixerInit(CaptureMixer *m, const WavFormat *formats, uint32_t count, const CaptureMixerConfig *config);
+void CaptureMixerClose(CaptureMixer *m);
+void CaptureMixerSetGain(CaptureMixer *m, uint32_t input, float gain);
+// 32-bit float at the master's rate, with the layout's channel count.
+void CaptureMixerOutputFormat(const CaptureMixer *m, WavFormat *format);
+
+// Input side, one thread per input. Returns -1 if the packet was dropped.
+int CaptureMixerPush(CaptureMixer *m, uint32_t input, const CapturePacket *packet);
+// The input delivers nothing more; the mixer stops waiting for it.
+void CaptureMixerEndInput(CaptureMixer *m, uint32_t input);
+
+// Mixer side. Returns the frames written to out, 0 if the master has none yet.
+uint32_t CaptureMixerPull(CaptureMixer *m, float *out, uint32_t maxFrames);
+// PlatformNowNs time of the next output frame, or 0 if the master is untimed.
+uint64_t CaptureMixerTimestamp(const CaptureMixer *m);
+// The master has ended and everything it delivered was mixed.
+int CaptureMixerFinished(CaptureMixer *m);
+void CaptureMixerPrintStats(const CaptureMixer *m, FILE *out);
+
+// Captures every input on its own thread and hands out the mix as one
+// source, so the pipeline records it like any other. Once it succeeds it owns
+// the inputs, which are started, stopped and destroyed with it. If the first
+// input runs free, so does the mix, waiting for every input rather than
+// padding the slow ones.
+int CreateMixerCaptureSource(CaptureSource *const *inputs, uint32_t count, const CaptureMixerConfig *config,
+                             CaptureSource **out);
+// The mixer behind a source made by CreateMixerCaptureSource, for its
+// statistics; NULL for any other source.
+const CaptureMixer *MixerCaptureSourceMixer(const CaptureSource *src);
+
+#endif // CAPTURE_MIXER_H
@@ -0,0 +1,632 @@
+// capture_pipeline.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "capture_pipeline.h"
+#include "instrument.h"
+
+#define DITHER_SEED 0x5EED1234u
+
+// Works out the file format for the requested output and picks the converter for it
+static int ResolveOutputFormat(CapturePipeline *p, const WavFormat *in, OutputSampleFormat requested) {
+    SampleFormat inSamples;
+    SampleFormat outSamples;
+
+    if (SampleFormatFromWav(in, &inSamples) != 0) return -1;
+    outSamples = inSamples;
+
+    switch (requested) {
+    case OUTPUT_FORMAT_NATIVE: break;
+    case OUTPUT_FORMAT_S16: outSamples.type = SAMPLE_S16; break;
+    case OUTPUT_FORMAT_S24: outSamples.type = SAMPLE_S24; break;
+    case OUTPUT_FORMAT_S32: outSamples.type = SAMPLE_S32; break;
+    case OUTPUT_FORMAT_F32: outSamples.type = SAMPLE_F32; break;
+    default: return -1;
+    }
+
+    if (p->config.container == OUTPUT_CONTAINER_FLAC &&
+        outSamples.type != SAMPLE_S16 && outSamples.type != SAMPLE_S24) {
+        return -1;
+    }
+
+    SampleFormatToWav(&outSamples, in->sampleRate, &p->outFormat);
+    p->outFormat.channelMask = in->channelMask;
+
+    // Resampling runs on float, so the source is widened first and narrowed after
+    if (p->config.outRate && p->config.outRate != in->sampleRate) {
+        SampleFormat floatSamples = inSamples;
+        floatSamples.type = SAMPLE_F32;
+
+        if (ResamplerInit(&p->resampler, in->sampleRate, p->config.outRate, in->channels) != 0) return -1;
+        p->resampling = 1;
+        p->outFormat.sampleRate = p->config.outRate;
+        SampleConverterInit(&p->toFloat, &inSamples, &floatSamples);
+        inSamples = floatSamples;
+    }
+    return SampleConverterInit(&p->converter, &inSamples, &outSamples);
+}
+
+static const char *ContainerExtension(OutputContainer container) {
+    return container == OUTPUT_CONTAINER_FLAC ? ".flac" : ".wav";
+}
+
+static int OpenOutputFile(CapturePipeline *p) {
+    char path[PIPELINE_MAX_PATH + 16];
+    int result;
+
+    if (p->numberFiles) {
+        snprintf(path, sizeof(path), "%s_%03u%s", p->outBase, p->stats.filesWritten + 1,
+                 ContainerExtension(p->config.container));
+    } else {
+        snprintf(path, sizeof(path), "%s", p->config.outPath);
+    }
+
+    if (p->config.container == OUTPUT_CONTAINER_FLAC) {
+        result = p->config.bufferedOutput ? FlacEncoderOpen(&p->flac, path, &p->outFormat, p->config.encoderThreads)
+                                          : FlacEncoderOpenDirect(&p->flac, path, &p->outFormat, p->config.encoderThreads);
+    } else {
+        result = p->config.bufferedOutput ? WavWriterOpen(&p->writer, path, &p->outFormat)
+                                          : WavWriterOpenDirect(&p->writer, path, &p->outFormat);
+    }
+    if (result != 0) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return -1;
+    }
+    p->fileOpen = 1;
+    p->framesInFile = 0;
+    return 0;
+}
+
+static int AppendToOutputFile(CapturePipeline *p, const void *frames, uint32_t frameCount) {
+    if (p->config.container == OUTPUT_CONTAINER_FLAC) return FlacEncoderAppend(&p->flac, frames, frameCount);
+    return WavWriterAppend(&p->writer, frames, frameCount);
+}
+
+static int CloseOutputFile(CapturePipeline *p) {
+    int result;
+
+    if (!p->fileOpen) return 0;
+
+    p->stats.pcmBytes += p->framesInFile * p->outFormat.channels * (p->outFormat.bitsPerSample / 8);
+    if (p->config.container == OUTPUT_CONTAINER_FLAC) {
+        result = FlacEncoderFinalize(&p->flac);
+        p->stats.bytesWritten += p->flac.bytesWritten;
+        p->stats.encodeNs += p->flac.encodeNs;
+        if (!p->config.bufferedOutput) DiskWriterStatsAdd(&p->stats.disk, &p->flac.disk.stats);
+    } else {
+        p->stats.bytesWritten += p->writer.dataBytes;
+        result = WavWriterFinalize(&p->writer);
+        if (!p->config.bufferedOutput) DiskWriterStatsAdd(&p->stats.disk, &p->writer.disk.stats);
+    }
+    p->fileOpen = 0;
+    p->stats.filesWritten++;
+    return result;
+}
+
+// Converts (and resamples) to the output format; frames = NULL flushes the
+// resampler's tail. Returns a pointer to *outCount output frames.
+static const void *ConvertFrames(CapturePipeline *p, const uint8_t *frames, uint32_t frameCount, uint32_t *outCount) {
+    DitherState *dither = p->config.dither ? &p->ditherState : NULL;
+    const void *src = frames;
+
+    *outCount = frameCount;
+    if (p->resampling) {
+        uint64_t startNs = PlatformNowNs();
+
+        if (!frames) {
+            *outCount = ResamplerFlush(&p->resampler, p->floatOut);
+        } else {
+            if (p->toFloat.in.type != SAMPLE_F32) {
+                SampleConverterRun(&p->toFloat, p->floatIn, frames, frameCount, NULL);
+                src = p->floatIn;
+            }
+            *outCount = ResamplerProcess(&p->resampler, (const float *)src, frameCount, p->floatOut);
+        }
+        p->stats.resampleNs += PlatformNowNs() - startNs;
+        src = p->floatOut;
+    }
+
+    if (p->converter.in.type == p->converter.out.type) return src;
+
+    SampleConverterRun(&p->converter, p->converted, src, *outCount, dither);
+    return p->converted;
+}
+
+static int WriteFrames(CapturePipeline *p, const uint8_t *frames, uint32_t frameCount) {
+    uint32_t outAlign = SampleFormatFrameBytes(&p->converter.out);
+    INSTR_TIMER(convertStartNs);
+    const uint8_t *out = (const uint8_t *)ConvertFrames(p, frames, frameCount, &frameCount);
+    INSTR_ELAPSED(INSTR_CONVERT_NS, convertStartNs);
+    INSTR_TIMER(writeStartNs);
+
+    while (frameCount > 0) {
+        // The next split file is opened only once there is audio for it
+        if (!p->fileOpen && OpenOutputFile(p) != 0) return -1;
+
+        uint32_t n = frameCount;
+        if (p->splitFrames && p->splitFrames - p->framesInFile < n) {
+            n = (uint32_t)(p->splitFrames - p->framesInFile);
+        }
+
+        if (AppendToOutputFile(p, out, n) != 0) return -1;
+        p->framesInFile += n;
+        p->stats.framesWritten += n;
+        out += (size_t)n * outAlign;
+        frameCount -= n;
+
+        if (p->splitFrames && p->framesInFile == p->splitFrames) {
+            if (CloseOutputFile(p) != 0) return -1;
+        }
+    }
+    INSTR_ELAPSED(INSTR_WRITE_NS, writeStartNs);
+    return 0;
+}
+
+// Splits off the leading frames from position on that are all flagged silent
+// or all not, dropping spans the storage thread has passed
+static uint32_t NextSilentRun(CapturePipeline *p, uint64_t position, uint32_t frameCount, int *silent) {
+    unsigned tail = atomic_load_explicit(&p->silentTail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&p->silentHead, memory_order_acquire);
+
+    *silent = 0;
+    for (; tail != head; ++tail) {
+        const SilentSpan *span = &p->silentSpans[tail % PIPELINE_SILENT_SPANS];
+        uint64_t end = span->start + span->frames;
+
+        if (end <= position) continue;
+        atomic_store_explicit(&p->silentTail, tail, memory_order_release);
+        if (span->start <= position) {
+            *silent = 1;
+            return end - position < frameCount ? (uint32_t)(end - position) : frameCount;
+        }
+        return span->start - position < frameCount ? (uint32_t)(span->start - position) : frameCount;
+    }
+    atomic_store_explicit(&p->silentTail, tail, memory_order_release);
+    return frameCount;
+}
+
+// The resampler's tail belongs to the file the gate closes, and the next
+// file starts from a fresh filter rather than from the audio before the gap
+static int EndGatedFile(CapturePipeline *p) {
+    if (p->resampling && p->resampler.inFrames > 0) {
+        if (p->fileOpen && WriteFrames(p, NULL, 0) != 0) return -1;
+        ResamplerReset(&p->resampler);
+    }
+    return CloseOutputFile(p);
+}
+
+static int GateFrames(CapturePipeline *p, const uint8_t *frames, uint32_t frameCount, uint64_t position) {
+    uint16_t blockAlign = p->source->blockAlign;
+
+    while (frameCount > 0) {
+        int silent;
+        int keep;
+        uint32_t n = NextSilentRun(p, position, frameCount, &silent);
+
+        n = SilenceGateStep(&p->gate, silent ? NULL : frames, n, &keep);
+        if (keep) {
+            if (WriteFrames(p, frames, n) != 0) return -1;
+        } else if (p->config.gate.mode == SILENCE_GATE_SPLIT) {
+            // The next file opens with the next kept frame
+            if (EndGatedFile(p) != 0) return -1;
+        }
+        frames += (size_t)n * blockAlign;
+        position += n;
+        frameCount -= n;
+    }
+    return 0;
+}
+
+// position is where frames start in the stream, counting pre-roll that was trimmed
+static void StoreFrames(CapturePipeline *p, const uint8_t *frames, uint32_t frameCount, uint64_t position) {
+    int result = 0;
+
+    if (atomic_load(&p->stats.error)) return;
+
+    if (p->durationFrames) {
+        uint64_t left = p->durationFrames - p->stats.framesStored;
+        if (left == 0) return;
+        if (frameCount > left) frameCount = (uint32_t)left;
+    }
+
+    p->stats.framesStored += frameCount;
+    if (p->config.overview) WaveformOverviewAppend(p->config.overview, frames, frameCount);
+    if (p->config.loudness) LoudnessMeterProcess(p->config.loudness, frames, frameCount);
+
+    if (p->config.tap && p->config.tap(p->config.tapUser, frames, frameCount) != 0) {
+        atomic_store(&p->stats.error, 1);
+    } else if (p->config.outPath) {
+        result = p->gating ? GateFrames(p, frames, frameCount, position) : WriteFrames(p, frames, frameCount);
+        if (result != 0) {
+            fprintf(stderr, "Write to output file failed\n");
+            atomic_store(&p->stats.error, 1);
+        }
+    }
+
+    if (atomic_load(&p->stats.error) || (p->durationFrames && p->stats.framesStored >= p->durationFrames)) {
+        atomic_store(&p->stopRequested, 1);
+    }
+}
+
+// Runs on the capture thread for every packet; must not block or allocate
+static void QueuePacket(void *user, const CapturePacket *packet) {
+    CapturePipeline *p = (CapturePipeline *)user;
+    size_t bytes = (size_t)packet->frames * p->source->blockAlign;
+    uint64_t queued = atomic_load_explicit(&p->framesQueued, memory_order_relaxed);
+
+    if (p->config.meter) LevelMeterProcess(p->config.meter, packet->data, packet->frames);
+    if (p->config.spectrogram) SpectrogramProcess(p->config.spectrogram, packet->data, packet->frames);
+
+    // Never blocks: a packet that does not fit is dropped and counted as an overrun
+    if (packet->data) {
+        if (RingBufferWrite(&p->ring, packet->data, bytes) == 0) {
+            INSTR_COUNT(INSTR_OVERRUNS);
+            return;
+        }
+    } else {
+        if (RingBufferWriteZeros(&p->ring, bytes) == 0) {
+            INSTR_COUNT(INSTR_OVERRUNS);
+            return;
+        }
+        // With the span ring full the frames are simply measured
+        if (p->gating) {
+            unsigned head = atomic_load_explicit(&p->silentHead, memory_order_relaxed);
+            if (head - atomic_load_explicit(&p->silentTail, memory_order_acquire) < PIPELINE_SILENT_SPANS) {
+                p->silentSpans[head % PIPELINE_SILENT_SPANS].start = queued;
+                p->silentSpans[head % PIPELINE_SILENT_SPANS].frames = packet->frames;
+                atomic_store_explicit(&p->silentHead, head + 1, memory_order_release);
+            }
+        }
+    }
+    atomic_store_explicit(&p->framesQueued, queued + packet->frames, memory_order_release);
+    INSTR_RECORD(INSTR_QUEUE_DEPTH_FRAMES, RingBufferReadable(&p->ring) / p->source->blockAlign);
+}
+
+static int CaptureThreadMain(void *arg) {
+    CapturePipeline *p = (CapturePipeline *)arg;
+    CaptureSource *src = p->source;
+
+    while (!atomic_load(&p->stopRequested) && !src->endOfStream) {
+        // Offline sources have no deadline, so let them wait for room instead of dropping
+        if (src->mode == CAPTURE_MODE_FREERUN && RingBufferWritable(&p->ring) < p->ring.capacity / 2) {
+            PlatformEventSignal(&p->dataEvent);
+            PlatformSleepMs(1);
+            continue;
+        }
+
+        if (CaptureSourcePump(src, PIPELINE_WAIT_MS, QueuePacket, p) < 0) {
+            fprintf(stderr, "Capture source %s failed\n", src->lpVtbl->name);
+            atomic_store(&p->stats.error, 1);
+            break;
+        }
+        PlatformEventSignal(&p->dataEvent);
+    }
+
+    src->lpVtbl->Stop(src);
+    atomic_store(&p->captureDone, 1);
+    PlatformEventSignal(&p->dataEvent);
+    return 0;
+}
+
+// Drops ring contents before stream position keepFrom. Armed, that is the
+// pre-roll before now or before a scheduled commit; on commit, the pre-roll before the commit.
+static void DiscardBefore(CapturePipeline *p, uint64_t keepFrom) {
+    uint16_t blockAlign = p->source->blockAlign;
+    uint64_t queued = p->framesDequeued + RingBufferReadable(&p->ring) / blockAlign;
+
+    if (keepFrom > queued) keepFrom = queued;
+    if (keepFrom <= p->framesDequeued) return;
+
+    RingBufferConsume(&p->ring, (size_t)(keepFrom - p->framesDequeued) * blockAlign);
+    p->framesDequeued = keepFrom;
+
+    // Lets go of silent spans that were trimmed, so the capture thread can keep flagging
+    if (p->gating) {
+        int silent;
+        NextSilentRun(p, keepFrom, 0, &silent);
+    }
+}
+
+static uint64_t PreRollStart(CapturePipeline *p, uint64_t end) {
+    return end > p->preRollFrames ? end - p->preRollFrames : 0;
+}
+
+// Drains the ring until the capture thread is done and everything it queued is stored
+static int StorageThreadMain(void *arg) {
+    CapturePipeline *p = (CapturePipeline *)arg;
+    uint16_t blockAlign = p->source->blockAlign;
+    int armed = atomic_load(&p->armed);
+    uint64_t commit;
+
+    for (;;) {
+        int done = atomic_load(&p->captureDone);
+        size_t readable;
+
+        if (armed) {
+            uint64_t queued = p->framesDequeued + RingBufferReadable(&p->ring) / blockAlign;
+            commit = atomic_load(&p->commitFrame);
+            if (atomic_load(&p->armed) && queued < commit) {
+                DiscardBefore(p, PreRollStart(p, queued));
+                if (done) break;
+                PlatformEventWait(&p->dataEvent, PIPELINE_WAIT_MS);
+                continue;
+            }
+            // The source reached a commit set by CapturePipelineCommitAt
+            if (atomic_load(&p->armed)) {
+                p->stats.startNs = PlatformNowNs();
+                atomic_store(&p->armed, 0);
+            }
+            armed = 0;
+            commit = atomic_load(&p->commitFrame);
+            DiscardBefore(p, PreRollStart(p, commit));
+            p->stats.preRollFrames = commit > p->framesDequeued ? commit - p->framesDequeued : 0;
+        }
+
+        while ((readable = RingBufferReadable(&p->ring)) >= blockAlign) {
+            uint32_t frames = (uint32_t)(readable / blockAlign);
+            if (frames > p->stageFrames) frames = p->stageFrames;
+
+            RingBufferRead(&p->ring, p->stage, (size_t)frames * blockAlign);
+            INSTR_RECORD(INSTR_STORE_FRAMES, frames);
+            StoreFrames(p, p->stage, frames, p->framesDequeued);
+            p->framesDequeued += frames;
+        }
+
+        if (done) break;
+        PlatformEventWait(&p->dataEvent, PIPELINE_WAIT_MS);
+    }
+
+    atomic_store(&p->running, 0);
+    return 0;
+}
+
+static int HasExtension(const char *path, size_t len, const char *ext) {
+    size_t extLen = strlen(ext);
+
+    if (len < extLen) return 0;
+    for (size_t i = 0; i < extLen; ++i) {
+        if (tolower((unsigned char)path[len - extLen + i]) != ext[i]) return 0;
+    }
+    return 1;
+}
+
+static void SplitOutputPath(CapturePipeline *p) {
+    size_t len = strlen(p->config.outPath);
+    const char *ext = ContainerExtension(p->config.container);
+
+    if (len >= sizeof(p->outBase)) len = sizeof(p->outBase) - 1;
+    memcpy(p->outBase, p->config.outPath, len);
+    p->outBase[len] = '\0';
+
+    if (HasExtension(p->outBase, len, ext)) p->outBase[len - strlen(ext)] = '\0';
+}
+
+static void FreeBuffers(CapturePipeline *p) {
+    RingBufferFree(&p->ring);
+    SilenceGateClose(&p->gate);
+    ResamplerClose(&p->resampler);
+    free(p->stage);
+    free(p->converted);
+    free(p->floatIn);
+    free(p->floatOut);
+    p->stage = NULL;
+    p->converted = NULL;
+    p->floatIn = NULL;
+    p->floatOut = NULL;
+}
+
+static void ReleaseResources(CapturePipeline *p) {
+    PlatformEventDestroy(&p->dataEvent);
+    FreeBuffers(p);
+}
+
+int CapturePipelineStart(CapturePipeline *p, CaptureSource *source, const CapturePipelineConfig *config) {
+    const WavFormat *in = &source->format;
+
+    memset(p, 0, sizeof(*p));
+    p->source = source;
+    p->config = *config;
+
+    if (ResolveOutputFormat(p, in, config->outFormat) != 0) {
+        fprintf(stderr, "No converter from %u-bit %u Hz source (format 0x%04x) to %s %s output at %u Hz\n",
+                in->bitsPerSample, in->sampleRate, in->formatTag, OutputSampleFormatName(config->outFormat),
+                OutputContainerName(config->container), config->outRate ? config->outRate : in->sampleRate);
+        return -1;
+    }
+
+    p->durationFrames = (uint64_t)llround(config->durationSeconds * in->sampleRate);
+    if (config->outPath) {
+        SplitOutputPath(p);
+        p->splitFrames = (uint64_t)llround(config->splitEverySeconds * p->outFormat.sampleRate);
+        p->numberFiles = p->splitFrames || config->gate.mode == SILENCE_GATE_SPLIT;
+    }
+    if (config->dither) DitherInit(&p->ditherState, DITHER_SEED);
+
+    p->stageFrames = PIPELINE_STAGE_BYTES / source->blockAlign;
+    p->convertedFrames = p->stageFrames;
+    if (p->resampling) {
+        uint32_t tail = ResamplerMaxOutput(&p->resampler, p->resampler.taps / 2);
+        p->convertedFrames = ResamplerMaxOutput(&p->resampler, p->stageFrames);
+        if (p->convertedFrames < tail) p->convertedFrames = tail;
+        p->floatIn = (float *)malloc((size_t)p->stageFrames * in->channels * sizeof(float));
+        p->floatOut = (float *)malloc((size_t)p->convertedFrames * in->channels * sizeof(float));
+    }
+    p->stage = (uint8_t *)malloc((size_t)p->stageFrames * source->blockAlign);
+    p->converted = (uint8_t *)malloc((size_t)p->convertedFrames * SampleFormatFrameBytes(&p->converter.out));
+    if (!p->stage || !p->converted || (p->resampling && (!p->floatIn || !p->floatOut)) ||
+        RingBufferInit(&p->ring, (size_t)(in->sampleRate * (PIPELINE_RING_SECONDS + p->config.preRollSeconds)) *
+                                 source->blockAlign) != 0) {
+        FreeBuffers(p);
+        return -1;
+    }
+
+    if (config->outPath && config->gate.mode != SILENCE_GATE_OFF) {
+        if (SilenceGateInit(&p->gate, in, &config->gate) != 0) {
+            fprintf(stderr, "Invalid silence gate settings\n");
+            FreeBuffers(p);
+            return -1;
+        }
+        p->gating = 1;
+    }
+
+    if (PlatformEventInit(&p->dataEvent) != 0) {
+        FreeBuffers(p);
+        return -1;
+    }
+
+    // A gated recording opens its first file at the first sound, an armed one on commit
+    if (config->outPath && !p->gating && !config->armed && OpenOutputFile(p) != 0) {
+        ReleaseResources(p);
+        return -1;
+    }
+
+    if (source->lpVtbl->Start(source) != 0) {
+        fprintf(stderr, "Failed to start capture source %s\n", source->lpVtbl->name);
+        CloseOutputFile(p);
+        ReleaseResources(p);
+        return -1;
+    }
+
+    p->preRollFrames = (uint64_t)llround(config->preRollSeconds * in->sampleRate);
+    atomic_store(&p->armed, config->armed);
+    atomic_store(&p->commitFrame, UINT64_MAX);
+    p->stats.startNs = PlatformNowNs();
+    atomic_store(&p->running, 1);
+
+    if (PlatformThreadCreate(&p->storageThread, StorageThreadMain, p) != 0) {
+        source->lpVtbl->Stop(source);
+        CloseOutputFile(p);
+        ReleaseResources(p);
+        return -1;
+    }
+    if (PlatformThreadCreate(&p->captureThread, CaptureThreadMain, p) != 0) {
+        source->lpVtbl->Stop(source);
+        atomic_store(&p->captureDone, 1);
+        PlatformEventSignal(&p->dataEvent);
+        PlatformThreadJoin(p->storageThread);
+        CloseOutputFile(p);
+        ReleaseResources(p);
+        return -1;
+    }
+    return 0;
+}
+
+void CapturePipelineCommit(CapturePipeline *p) {
+    p->stats.startNs = PlatformNowNs();
+    atomic_store(&p->commitFrame, atomic_load(&p->framesQueued));
+    atomic_store(&p->armed, 0);
+    PlatformEventSignal(&p->dataEvent);
+}
+
+void CapturePipelineCommitAt(CapturePipeline *p, uint64_t frame) {
+    atomic_store(&p->commitFrame, frame);
+    PlatformEventSignal(&p->dataEvent);
+}
+
+int CapturePipelineIsArmed(CapturePipeline *p) {
+    return atomic_load(&p->armed);
+}
+
+void CapturePipelineRequestStop(CapturePipeline *p) {
+    atomic_store(&p->stopRequested, 1);
+}
+
+int CapturePipelineIsRunning(CapturePipeline *p) {
+    return atomic_load(&p->running);
+}
+
+int CapturePipelineWait(CapturePipeline *p) {
+    PlatformThreadJoin(p->captureThread);
+    PlatformThreadJoin(p->storageThread);
+    p->stats.endNs = PlatformNowNs();
+
+    // Both threads are done, so the resampler's tail can be written from here
+    // With no file open (split gate in a gap, never committed) there is nothing to add the tail to
+    if (p->resampling && p->fileOpen && !atomic_load(&p->stats.error) && WriteFrames(p, NULL, 0) != 0) {
+        atomic_store(&p->stats.error, 1);
+    }
+    if (CloseOutputFile(p) != 0) atomic_store(&p->stats.error, 1);
+
+    p->stats.overruns = atomic_load(&p->ring.overrunCount);
+    p->stats.framesDropped = atomic_load(&p->ring.overrunBytes) / p->source->blockAlign;
+    p->stats.ringHighWater = atomic_load(&p->ring.highWater);
+    p->stats.ringCapacity = p->ring.capacity;
+    ReleaseResources(p);
+
+    return atomic_load(&p->stats.error) ? -1 : 0;
+}
+
+void CapturePipelinePrintStats(const CapturePipeline *p, FILE *out) {
+    const CapturePipelineStats *s = &p->stats;
+    double wall = (s->endNs - s->startNs) / 1e9;
+    double audio = (double)s->framesStored / p->source->format.sampleRate;
+
+    fprintf(out, "Captured %.2f s of audio (%llu frames) in %.2f s wall time (%.1fx real time)\n",
+            audio, (unsigned long long)s->framesStored, wall, wall > 0 ? audio / wall : 0.0);
+    if (p->config.outPath) {
+        fprintf(out, "Wrote %u %s file(s) as %s at %u Hz, %.1f MB (%.1f MB/s)\n",
+                s->filesWritten, OutputContainerName(p->config.container),
+                OutputSampleFormatName(p->config.outFormat), p->outFormat.sampleRate,
+                s->bytesWritten / 1e6, wall > 0 ? s->bytesWritten / 1e6 / wall : 0.0);
+    }
+    if (p->resampling && s->resampleNs > 0) {
+        double seconds = s->resampleNs / 1e9;
+        fprintf(out, "Resampler: %u -> %u Hz, %u taps x %u phases, %.1f M samples/s per channel (%.0fx real time)\n",
+                p->resampler.inRate, p->resampler.outRate, p->resampler.taps, p->resampler.upFactor,
+                s->framesStored / seconds / 1e6, audio / seconds);
+    }
+    if (p->config.armed) {
+        fprintf(out, "Pre-roll: %.2f s of %.2f s committed\n", (double)s->preRollFrames / p->source->format.sampleRate,
+                p->config.preRollSeconds);
+    }
+    if (p->gating) {
+        const SilenceGateStats *g = &p->gate.stats;
+        double rate = p->source->format.sampleRate;
+        fprintf(out, "Silence gate (%s, %.0f dBFS): kept %.2f s, dropped %.2f s in %llu gap(s), %.2f s flagged silent by the source\n",
+                SilenceGateModeName(p->config.gate.mode), p->config.gate.thresholdDb, g->framesKept / rate,
+                g->framesDropped / rate, (unsigned long long)g->gaps, g->framesFlagged / rate);
+    }
+    if (p->config.container == OUTPUT_CONTAINER_FLAC && s->bytesWritten > 0) {
+        double encodeSeconds = s->encodeNs / 1e9;
+        double written = (double)s->framesWritten / p->outFormat.sampleRate;
+        fprintf(out, "FLAC: ratio %.3f (%.1f MB of PCM), encode %.1fx real time per core on %u thread(s)\n",
+                (double)s->bytesWritten / (s->pcmBytes ? s->pcmBytes : 1), s->pcmBytes / 1e6,
+                encodeSeconds > 0 ? written / encodeSeconds : 0.0, p->config.encoderThreads);
+    }
+    if (s->disk.writes > 0) DiskWriterStatsPrint(&s->disk, out);
+    fprintf(out, "Dropouts: %llu overruns (%llu frames dropped), ring high water %zu of %zu bytes\n",
+            (unsigned long long)s->overruns, (unsigned long long)s->framesDropped,
+            s->ringHighWater, s->ringCapacity);
+    CaptureStatsPrint(&p->source->stats, out);
+}
+
+const char *OutputSampleFormatName(OutputSampleFormat format) {
+    switch (format) {
+    case OUTPUT_FORMAT_NATIVE: return "native";
+    case OUTPUT_FORMAT_S16: return "s16";
+    case OUTPUT_FORMAT_S24: return "s24";
+    case OUTPUT_FORMAT_S32: return "s32";
+    case OUTPUT_FORMAT_F32: return "f32";
+    }
+    return "unknown";
+}
+
+const char *OutputContainerName(OutputContainer container) {
+    return container == OUTPUT_CONTAINER_FLAC ? "flac" : "wav";
+}
+
+OutputContainer OutputContainerForPath(const char *path) {
+    return HasExtension(path, strlen(path), ".flac") ? OUTPUT_CONTAINER_FLAC : OUTPUT_CONTAINER_WAV;
+}
+
+int ParseOutputSampleFormat(const char *name, OutputSampleFormat *format) {
+    for (int f = OUTPUT_FORMAT_NATIVE; f <= OUTPUT_FORMAT_F32; ++f) {
+        if (strcmp(name, OutputSampleFormatName((OutputSampleFormat)f)) == 0) {
+            *format = (OutputSampleFormat)f;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,168 @@
+// capture_pipeline.h
+#ifndef CAPTURE_PIPELINE_H
+#define CAPTURE_PIPELINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "capture_source.h"
+#include "ring_buffer.h"
+#include "sample_convert.h"
+#include "wav_writer.h"
+#include "flac_encoder.h"
+#include "disk_writer.h"
+#include "resampler.h"
+#include "level_meter.h"
+#include "waveform_overview.h"
+#include "spectrum.h"
+#include "loudness.h"
+#include "silence_gate.h"
+#include "platform.h"
+
+#define PIPELINE_RING_SECONDS 2
+#define PIPELINE_WAIT_MS 200
+#define PIPELINE_STAGE_BYTES (256 * 1024)
+#define PIPELINE_MAX_PATH 512
+#define PIPELINE_SILENT_SPANS 256     // Covers the ring at 10 ms packets
+
+typedef enum {
+    OUTPUT_FORMAT_NATIVE = 0,  // Whatever the source delivers
+    OUTPUT_FORMAT_S16,
+    OUTPUT_FORMAT_S24,
+    OUTPUT_FORMAT_S32,
+    OUTPUT_FORMAT_F32
+} OutputSampleFormat;
+
+typedef enum {
+    OUTPUT_CONTAINER_WAV = 0,
+    OUTPUT_CONTAINER_FLAC         // Integer formats only; blocks are encoded on worker threads
+} OutputContainer;
+
+// Called on the storage thread with source-format frames, before conversion.
+// Returning nonzero stops the pipeline.
+typedef int (*PipelineTapFn)(void *user, const void *frames, uint32_t frameCount);
+
+typedef struct {
+    const char *outPath;          // NULL: no file output
+    OutputSampleFormat outFormat;
+    OutputContainer container;
+    uint32_t outRate;             // 0 keeps the source rate
+    uint32_t encoderThreads;      // FLAC worker threads; 0 encodes on the storage thread
+    double splitEverySeconds;     // 0: one file
+    double durationSeconds;       // 0: until stopped or the source ends
+    int dither;                   // TPDF dither when reducing to integer formats
+    PipelineTapFn tap;
+    void *tapUser;
+    LevelMeter *meter;            // Fed on the capture thread, in the source format
+    WaveformOverview *overview;   // Fed on the storage thread, in the source format
+    Spectrogram *spectrogram;     // Fed on the capture thread, in the source format
+    LoudnessMeter *loudness;      // Fed on the storage thread with the stored frames only
+    SilenceGateConfig gate;       // Applies to the file output only, not the tap
+    int armed;                    // Keep only a pre-roll until CapturePipelineCommit
+    double preRollSeconds;        // History an armed pipeline commits along with live audio
+    int bufferedOutput;           // Write through stdio instead of the disk writer
+} CapturePipelineConfig;
+
+typedef struct {
+    uint64_t framesStored;
+    uint64_t framesWritten;
+    uint64_t bytesWritten;
+    uint64_t pcmBytes;            // What the written audio would take uncompressed
+    uint64_t encodeNs;            // FLAC encoding time summed over worker threads
+    uint64_t resampleNs;
+    uint64_t preRollFrames;       // Stored from before the commit
+    uint64_t overruns;
+    uint64_t framesDropped;
+    size_t ringHighWater;
+    size_t ringCapacity;
+    uint32_t filesWritten;
+    DiskWriterStats disk;         // Summed over the files written through the disk writer
+    uint64_t startNs;
+    uint64_t endNs;
+    atomic_int error;             // Set by the capture thread as well as the storage thread
+} CapturePipelineStats;
+
+// Frames the source flagged silent. They travel beside the ring, from the
+// capture thread to the storage thread, so the gate can skip measuring them.
+typedef struct {
+    uint64_t start;               // Stream position in frames
+    uint32_t frames;
+} SilentSpan;
+
+// Source -> capture thread -> SPSC ring -> storage thread -> convert (and
+// resample through float) -> WAV writer or FLAC encoder -> disk writer thread.
+// An armed pipeline runs the source but stores nothing: the ring itself is
+// the pre-roll, trimmed by the storage thread to the last preRollSeconds.
+// Committing drains it from there like live audio, so the history is never
+// copied aside.
+// The capture thread only pumps the source into the ring and meters it;
+// everything that can block (tap, overview, conversion, disk) runs on the
+// storage thread.
+typedef struct {
+    CaptureSource *source;
+    CapturePipelineConfig config;
+    char outBase[PIPELINE_MAX_PATH];
+    WavFormat outFormat;
+    uint64_t durationFrames;
+    uint64_t splitFrames;
+    int numberFiles;              // Split by time or by the gate
+
+    RingBuffer ring;
+    PlatformEvent dataEvent;
+    PlatformThread captureThread;
+    PlatformThread storageThread;
+    atomic_int stopRequested;
+    atomic_int captureDone;
+    atomic_int running;
+
+    WavWriter writer;
+    FlacEncoder flac;
+    int fileOpen;
+    uint64_t framesInFile;
+    SampleConverter converter;    // To the output format; from float when resampling
+    SampleConverter toFloat;
+    Resampler resampler;
+    int resampling;
+    DitherState ditherState;
+    uint8_t *stage;
+    uint8_t *converted;
+    float *floatIn;
+    float *floatOut;
+    uint32_t stageFrames;
+    uint32_t convertedFrames;
+
+    SilenceGate gate;
+    int gating;
+    SilentSpan silentSpans[PIPELINE_SILENT_SPANS];
+    atomic_uint silentHead;       // Advanced by the capture thread
+    atomic_uint silentTail;       // Advanced by the storage thread
+    atomic_uint_fast64_t framesQueued;    // Capture thread's stream position
+    uint64_t framesDequeued;      // Storage thread's stream position
+    uint64_t preRollFrames;
+    atomic_int armed;
+    atomic_uint_fast64_t commitFrame;     // Stream position of the commit; UINT64_MAX until one is made
+
+    CapturePipelineStats stats;
+} CapturePipeline;
+
+int CapturePipelineStart(CapturePipeline *p, CaptureSource *source, const CapturePipelineConfig *config);
+// Starts storing an armed pipeline, from preRollSeconds before the call.
+void CapturePipelineCommit(CapturePipeline *p);
+// Commits once the source reaches stream position frame, from preRollSeconds
+// before it, however far the storage thread lags. Use instead of Commit, not with it.
+void CapturePipelineCommitAt(CapturePipeline *p, uint64_t frame);
+int CapturePipelineIsArmed(CapturePipeline *p);
+// Safe to call from a signal or console control handler.
+void CapturePipelineRequestStop(CapturePipeline *p);
+int CapturePipelineIsRunning(CapturePipeline *p);
+// Joins both threads and finalizes the output. Returns 0 if everything was written.
+int CapturePipelineWait(CapturePipeline *p);
+void CapturePipelinePrintStats(const CapturePipeline *p, FILE *out);
+
+const char *OutputSampleFormatName(OutputSampleFormat format);
+const char *OutputContainerName(OutputContainer container);
+// Picks the container from the file extension (.flac, otherwise WAV).
+OutputContainer OutputContainerForPath(const char *path);
+int ParseOutputSampleFormat(const char *name, OutputSampleFormat *format);
+
+#endif // CAPTURE_PIPELINE_H
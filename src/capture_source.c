@@ -0,0 +1,157 @@
+// capture_source.c
+#include <string.h>
+
+#include "capture_source.h"
+#include "instrument.h"
+#include "platform.h"
+
+#define PACER_POLL_INTERVAL_MS 10
+
+void CaptureSourceInitBase(CaptureSource *src, const CaptureSourceVtbl *vtbl,
+                           const WavFormat *format, CaptureMode mode) {
+    memset(src, 0, sizeof(*src));
+    src->lpVtbl = vtbl;
+    src->format = *format;
+    src->blockAlign = format->channels * (format->bitsPerSample / 8);
+    src->mode = mode;
+    src->stats.latencyMinNs = UINT64_MAX;
+}
+
+static void RecordPacket(CaptureStats *stats, const CapturePacket *packet, uint64_t now) {
+    stats->packets++;
+    stats->frames += packet->frames;
+    if (packet->flags & CAPTURE_PACKET_SILENT) stats->silentPackets++;
+    if (packet->flags & CAPTURE_PACKET_DISCONTINUITY) stats->discontinuities++;
+
+    if (packet->flags & CAPTURE_PACKET_SILENT) INSTR_COUNT(INSTR_SILENT_PACKETS);
+    if (packet->flags & CAPTURE_PACKET_DISCONTINUITY) INSTR_COUNT(INSTR_DISCONTINUITIES);
+    if (packet->flags & CAPTURE_PACKET_TIMESTAMP_ERROR) INSTR_COUNT(INSTR_TIMESTAMP_ERRORS);
+    INSTR_RECORD(INSTR_PACKET_FRAMES, packet->frames);
+    if (stats->lastPacketNs) INSTR_RECORD(INSTR_PACKET_INTERVAL_NS, now - stats->lastPacketNs);
+    stats->lastPacketNs = now;
+
+    if (packet->timestampNs && packet->timestampNs <= now) {
+        uint64_t latency = now - packet->timestampNs;
+        stats->latencySamples++;
+        stats->latencyTotalNs += latency;
+        if (latency < stats->latencyMinNs) stats->latencyMinNs = latency;
+        if (latency > stats->latencyMaxNs) stats->latencyMaxNs = latency;
+        INSTR_RECORD(INSTR_PACKET_LATENCY_NS, latency);
+    }
+}
+
+int CaptureSourcePump(CaptureSource *src, uint32_t timeoutMs, CapturePacketFn fn, void *user) {
+    CaptureStats *stats = &src->stats;
+    CapturePacket packet;
+    int delivered = 0;
+    int r;
+
+    r = src->lpVtbl->Wait(src, timeoutMs);
+    if (r < 0) return -1;
+
+    uint64_t now = PlatformNowNs();
+    stats->wakeups++;
+    if (r == 0) stats->timeouts++;
+    if (stats->lastWakeNs && now - stats->lastWakeNs > stats->wakeIntervalMaxNs) {
+        stats->wakeIntervalMaxNs = now - stats->lastWakeNs;
+    }
+    stats->lastWakeNs = now;
+
+    // Drain even after a timeout: some endpoints deliver data without signalling
+    while ((r = src->lpVtbl->ReadPacket(src, &packet)) > 0) {
+        RecordPacket(stats, &packet, PlatformNowNs());
+        fn(user, &packet);
+        if (src->lpVtbl->ReleasePacket(src, &packet) != 0) return -1;
+        delivered++;
+    }
+    if (r < 0) return -1;
+
+    if (delivered == 0) stats->emptyWakeups++;
+    return delivered;
+}
+
+void CaptureStatsPrint(const CaptureStats *stats, FILE *out) {
+    fprintf(out, "Wakeups: %llu (%llu empty, %llu timeouts), longest interval %.2f ms\n",
+            (unsigned long long)stats->wakeups, (unsigned long long)stats->emptyWakeups,
+            (unsigned long long)stats->timeouts, stats->wakeIntervalMaxNs / 1e6);
+    fprintf(out, "Packets: %llu (%llu frames, %llu silent, %llu discontinuities)\n",
+            (unsigned long long)stats->packets, (unsigned long long)stats->frames,
+            (unsigned long long)stats->silentPackets, (unsigned long long)stats->discontinuities);
+    if (stats->latencySamples) {
+        fprintf(out, "Packet latency: min %.2f ms, avg %.2f ms, max %.2f ms\n",
+                stats->latencyMinNs / 1e6,
+                (double)stats->latencyTotalNs / stats->latencySamples / 1e6,
+                stats->latencyMaxNs / 1e6);
+    }
+}
+
+void CapturePacerInit(CapturePacer *pacer, CaptureMode mode, uint32_t sampleRate, uint32_t packetFrames) {
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->mode = mode;
+    pacer->sampleRate = sampleRate;
+    pacer->packetFrames = packetFrames;
+}
+
+void CapturePacerStart(CapturePacer *pacer) {
+    pacer->startNs = PlatformNowNs();
+    pacer->framesDelivered = 0;
+    pacer->pending = 0;
+}
+
+void CapturePacerSetClockSkew(CapturePacer *pacer, double ppm) {
+    pacer->clockSkewPpm = ppm;
+}
+
+// Wall-clock time at which a device would have captured the given frame
+static uint64_t PacerFrameTimeNs(const CapturePacer *pacer, uint64_t frame) {
+    uint64_t rate = pacer->sampleRate;
+
+    if (pacer->clockSkewPpm != 0.0) {
+        return pacer->startNs + (uint64_t)(frame * 1e9 / (rate * (1.0 + pacer->clockSkewPpm * 1e-6)));
+    }
+    return pacer->startNs + (frame / rate) * 1000000000ull + (frame % rate) * 1000000000ull / rate;
+}
+
+static uint64_t PacerNextDueNs(const CapturePacer *pacer) {
+    return PacerFrameTimeNs(pacer, pacer->framesDelivered + pacer->packetFrames);
+}
+
+int CapturePacerWait(CapturePacer *pacer, uint32_t timeoutMs) {
+    switch (pacer->mode) {
+    case CAPTURE_MODE_FREERUN:
+        pacer->pending = 1;
+        return 1;
+
+    case CAPTURE_MODE_POLL:
+        PlatformSleepMs(PACER_POLL_INTERVAL_MS);
+        return 1;
+
+    default: {
+        // Sleep exactly until the next packet is complete, as a device event would
+        uint64_t due = PacerNextDueNs(pacer);
+        uint64_t limit = PlatformNowNs() + (uint64_t)timeoutMs * 1000000ull;
+        if (due > limit) {
+            PlatformSleepUntilNs(limit);
+            return 0;
+        }
+        PlatformSleepUntilNs(due);
+        return 1;
+    }
+    }
+}
+
+int CapturePacerReady(const CapturePacer *pacer) {
+    if (pacer->mode == CAPTURE_MODE_FREERUN) return pacer->pending;
+    return PlatformNowNs() >= PacerNextDueNs(pacer);
+}
+
+// Free-running packets have no meaningful capture time
+uint64_t CapturePacerTimestamp(const CapturePacer *pacer) {
+    if (pacer->mode == CAPTURE_MODE_FREERUN) return 0;
+    return PacerFrameTimeNs(pacer, pacer->framesDelivered);
+}
+
+void CapturePacerAdvance(CapturePacer *pacer, uint32_t frames) {
+    pacer->framesDelivered += frames;
+    pacer->pending = 0;
+}
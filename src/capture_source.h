@@ -0,0 +1,139 @@
+// capture_source.h
+#ifndef CAPTURE_SOURCE_H
+#define CAPTURE_SOURCE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "wav_writer.h"
+
+#define CAPTURE_PACKET_SILENT 0x1
+#define CAPTURE_PACKET_DISCONTINUITY 0x2
+#define CAPTURE_PACKET_TIMESTAMP_ERROR 0x4    // The device could not time the packet; timestampNs is 0
+
+typedef enum {
+    CAPTURE_MODE_EVENT = 0,  // Wake when the source signals a packet
+    CAPTURE_MODE_POLL,       // Wake on a fixed timer
+    CAPTURE_MODE_FREERUN     // Offline sources only: one packet per wait, no pacing
+} CaptureMode;
+
+// One packet as handed out by ReadPacket. data is NULL for silent packets.
+// timestampNs is the PlatformNowNs time of the first frame, or 0 if unknown.
+typedef struct {
+    const uint8_t *data;
+    uint32_t frames;
+    uint32_t flags;
+    uint64_t timestampNs;
+} CapturePacket;
+
+typedef struct {
+    uint64_t wakeups;
+    uint64_t emptyWakeups;
+    uint64_t timeouts;
+    uint64_t packets;
+    uint64_t frames;
+    uint64_t silentPackets;
+    uint64_t discontinuities;
+    uint64_t latencySamples;
+    uint64_t latencyTotalNs;
+    uint64_t latencyMinNs;
+    uint64_t latencyMaxNs;
+    uint64_t wakeIntervalMaxNs;
+    uint64_t lastWakeNs;
+    uint64_t lastPacketNs;
+} CaptureStats;
+
+typedef struct CaptureSource CaptureSource;
+
+typedef struct {
+    const char *name;
+    int (*Start)(CaptureSource *src);
+    // Blocks until a packet may be ready. Returns 1 on signal, 0 on timeout, -1 on error.
+    int (*Wait)(CaptureSource *src, uint32_t timeoutMs);
+    // Returns 1 with a packet, 0 if none is pending, -1 on error.
+    int (*ReadPacket)(CaptureSource *src, CapturePacket *packet);
+    int (*ReleasePacket)(CaptureSource *src, CapturePacket *packet);
+    void (*Stop)(CaptureSource *src);
+    void (*Destroy)(CaptureSource *src);
+} CaptureSourceVtbl;
+
+// Implementations embed this as their first member.
+// Finite sources set endOfStream once their last packet has been released.
+struct CaptureSource {
+    const CaptureSourceVtbl *lpVtbl;
+    WavFormat format;
+    uint16_t blockAlign;
+    CaptureMode mode;
+    int endOfStream;
+    CaptureStats stats;
+};
+
+typedef void (*CapturePacketFn)(void *user, const CapturePacket *packet);
+
+void CaptureSourceInitBase(CaptureSource *src, const CaptureSourceVtbl *vtbl,
+                           const WavFormat *format, CaptureMode mode);
+
+// One scheduling step: wait for the source, then hand every pending packet to fn.
+// Wake-up and latency statistics are accumulated in src->stats.
+// Returns the number of packets delivered, or -1 on error.
+int CaptureSourcePump(CaptureSource *src, uint32_t timeoutMs, CapturePacketFn fn, void *user);
+
+void CaptureStatsPrint(const CaptureStats *stats, FILE *out);
+
+// Packet scheduling shared by the offline sources: emulates a device clock in
+// event/poll mode and hands out one packet per wait in free-run mode.
+typedef struct {
+    CaptureMode mode;
+    uint32_t sampleRate;
+    uint32_t packetFrames;
+    uint64_t startNs;
+    uint64_t framesDelivered;
+    int pending;
+    double clockSkewPpm;
+} CapturePacer;
+
+void CapturePacerInit(CapturePacer *pacer, CaptureMode mode, uint32_t sampleRate, uint32_t packetFrames);
+void CapturePacerStart(CapturePacer *pacer);
+// Runs the emulated device clock fast (positive) or slow by ppm, as a real
+// converter's crystal would; timestamps stay on the PlatformNowNs clock.
+void CapturePacerSetClockSkew(CapturePacer *pacer, double ppm);
+int CapturePacerWait(CapturePacer *pacer, uint32_t timeoutMs);
+int CapturePacerReady(const CapturePacer *pacer);
+uint64_t CapturePacerTimestamp(const CapturePacer *pacer);
+void CapturePacerAdvance(CapturePacer *pacer, uint32_t frames);
+
+typedef enum {
+    SYNTHETIC_SINE = 0,
+    SYNTHETIC_NOISE,
+    SYNTHETIC_SILENCE,
+    SYNTHETIC_BURSTS              // Tone bursts between flagged silence and quiet hiss
+} SyntheticWaveform;
+
+// Signal generator producing float32 packets of packetFrames. In event or poll
+// mode it is clock driven, delivering a packet every packetFrames / sampleRate
+// seconds like a real device; in CAPTURE_MODE_FREERUN it runs as fast as it is
+// drained. durationFrames = 0 generates forever. clockSkewPpm detunes the
+// emulated clock, for exercising drift compensation.
+typedef struct {
+    uint32_t sampleRate;
+    uint16_t channels;
+    uint32_t packetFrames;
+    double frequencyHz;
+    float amplitude;
+    SyntheticWaveform waveform;
+    uint64_t durationFrames;
+    double clockSkewPpm;
+} SyntheticSourceConfig;
+
+int CreateSyntheticCaptureSource(const SyntheticSourceConfig *config, CaptureMode mode, CaptureSource **out);
+
+// Replays a WAV/RF64 file in packets of packetFrames, paced like the synthetic
+// source or free running. With loop set it restarts at the end instead of finishing.
+typedef struct {
+    const char *path;
+    uint32_t packetFrames;
+    int loop;
+} FileSourceConfig;
+
+int CreateFileCaptureSource(const FileSourceConfig *config, CaptureMode mode, CaptureSource **out);
+
+#endif // CAPTURE_SOURCE_H
@@ -0,0 +1,978 @@
+// cli.c
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include "audio_capture.h"
+#endif
+
+#include "cli.h"
+#include "bench.h"
+#include "capture_mixer.h"
+#include "capture_pipeline.h"
+#include "edit_list.h"
+#include "instrument.h"
+#include "level_meter.h"
+#include "loudness.h"
+#include "platform.h"
+#include "silence_gate.h"
+#include "onset_slicer.h"
+#include "spectrum.h"
+#include "playback.h"
+#include "take_export.h"
+#include "take_storage.h"
+#include "waveform_overview.h"
+#include "wav_reader.h"
+
+#define CLI_DEFAULT_OUT "capture.wav"
+#define CLI_POLL_MS 100
+#define SYNTH_SAMPLE_RATE 48000
+#define SYNTH_CHANNELS 2
+#define SYNTH_PACKET_FRAMES 480
+#define SYNTH_FREQUENCY 440.0
+#define SYNTH_AMPLITUDE 0.5f
+#define MIX_FREQUENCY_STEP 1.5        // Each mixed synthetic input a fifth above the last
+#define PLAY_LOAD_FRAMES 4096
+#define CLI_MAX_EDITS 32
+
+#ifdef _WIN32
+#define CLI_DEFAULT_SOURCE "loopback"
+#else
+#define CLI_DEFAULT_SOURCE "sine"
+#endif
+
+typedef enum {
+    CLI_EDIT_TRIM = 0,
+    CLI_EDIT_CUT,
+    CLI_EDIT_GAIN,
+    CLI_EDIT_FADE_IN,
+    CLI_EDIT_FADE_OUT,
+    CLI_EDIT_UNDO,
+    CLI_EDIT_REDO
+} CliEditType;
+
+// Seconds into the edit as it stands when the edit is applied
+typedef struct {
+    CliEditType type;
+    double start;
+    double end;                   // The fade length for fades
+    double gainDb;
+} CliEdit;
+
+typedef struct {
+    const char *source;
+    const char *mix[MIXER_MAX_INPUTS - 1];
+    uint32_t mixCount;
+    double mixSkewPpm;
+    int multitrack;
+    const char *outPath;
+    const char *playPath;
+    const char *exportPath;
+    const char *instrumentPath;
+    const char *benchPath;
+    const char *slicePrefix;
+    double sliceThreshold;
+    int normalize;
+    double targetLufs;
+    double ceilingDbtp;
+    CliEdit edits[CLI_MAX_EDITS];
+    uint32_t editCount;
+    OutputSampleFormat format;
+    double startSeconds;
+    double durationSeconds;
+    double splitEverySeconds;
+    double preRollSeconds;
+    double commitAfterSeconds;
+    uint32_t threads;
+    uint32_t rate;
+    SilenceGateConfig gate;
+    int fast;
+    int dither;
+    int bufferedIo;
+    int outGiven;
+} CliOptions;
+
+static CapturePipeline *activePipeline = NULL;
+static PlaybackStream *activePlayback = NULL;
+static TakeExport *activeExport = NULL;
+
+#ifdef _WIN32
+static BOOL WINAPI ConsoleCtrlHandler(DWORD ctrlType) {
+    if (ctrlType == CTRL_C_EVENT || ctrlType == CTRL_BREAK_EVENT || ctrlType == CTRL_CLOSE_EVENT) {
+        if (activePipeline) CapturePipelineRequestStop(activePipeline);
+        if (activePlayback) PlaybackStreamRequestStop(activePlayback);
+        if (activeExport) TakeExportCancel(activeExport);
+        return TRUE;
+    }
+    return FALSE;
+}
+#else
+static void InterruptHandler(int sig) {
+    (void)sig;
+    if (activePipeline) CapturePipelineRequestStop(activePipeline);
+    if (activePlayback) PlaybackStreamRequestStop(activePlayback);
+    if (activeExport) TakeExportCancel(activeExport);
+}
+#endif
+
+static void InstallStopHandler(void) {
+#ifdef _WIN32
+    SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
+#else
+    signal(SIGINT, InterruptHandler);
+    signal(SIGTERM, InterruptHandler);
+#endif
+}
+
+static void PrintUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --source NAME       loopback, mic, sine, noise, silence, bursts or a .wav file\n"
+            "                      (default %s)\n"
+            "  --mix NAME          capture NAME alongside the source and mix it in, aligned\n"
+            "                      by timestamp and drift corrected; repeat for up to %d\n"
+            "  --mix-skew PPM      run the mixed synthetic sources' clocks PPM fast (or slow,\n"
+            "                      if negative), to exercise drift correction\n"
+            "  --multitrack        keep each mixed source on its own channels\n"
+            "  --out PATH          output file; a .flac extension selects FLAC (default %s)\n"
+            "  --format FMT        s16, s24, s32, f32 or native (default s16)\n"
+            "  --duration SEC      stop after SEC seconds of audio (default: until Ctrl+C)\n"
+            "  --split-every SEC   start a new numbered file every SEC seconds\n"
+            "  --pre-roll SEC      run armed, keeping the last SEC seconds, and start storing\n"
+            "                      them with live audio after --commit-after seconds\n"
+            "  --commit-after SEC  source time to stay armed (default: the pre-roll)\n"
+            "  --rate HZ           resample the output to HZ (default: the source rate)\n"
+            "  --threads N         FLAC encoder or export threads, 0 to work inline\n"
+            "                      (default: one per CPU)\n"
+            "  --fast              run synthetic and file sources faster than real time\n"
+            "  --dither            add TPDF dither when converting float to integer\n"
+            "  --buffered-io       write the recording through stdio instead of the direct\n"
+            "                      disk writer thread\n"
+            "  --gate MODE         off, drop (leave long silences out) or split (start a new\n"
+            "                      numbered file after each long silence) (default off)\n"
+            "  --gate-threshold DB level below which audio counts as silent (default %.0f)\n"
+            "  --gate-hangover SEC audio kept after the level falls (default %.1f)\n"
+            "  --gate-min-gap SEC  silence after the hangover that makes a gap (default %.1f)\n"
+            "  --slice PREFIX      cut the recording at each onset into PREFIX_001.wav, ...\n"
+            "                      with short fades, listing the slices in PREFIX.json\n"
+            "  --slice-threshold F spectral flux over the recent median that makes an onset\n"
+            "                      (default %.2f)\n"
+            "  --play PATH         play a .wav file through the null output sink instead of\n"
+            "                      recording; with --out the played audio is written there\n"
+            "  --start SEC         start playback SEC seconds into the file\n"
+            "  --export PATH       load a .wav file as a take and export it to --out in\n"
+            "                      --format on --threads workers, reporting throughput\n"
+            "  --normalize         export at the target loudness measured as the take loads,\n"
+            "                      limiting true peaks to the ceiling\n"
+            "  --target-lufs LUFS  integrated loudness to export at (default %.0f); implies\n"
+            "                      --normalize\n"
+            "  --ceiling-dbtp DB   true peak ceiling when normalizing (default %.0f)\n"
+            "  --trim A:B          keep only seconds A to B of the take for --play and\n"
+            "                      --export; edits apply in order, each to the result of\n"
+            "                      the ones before it, without touching the take\n"
+            "  --cut A:B           leave out seconds A to B\n"
+            "  --gain A:B:DB       change the level of seconds A to B by DB\n"
+            "  --fade-in SEC       fade in over the first SEC seconds\n"
+            "  --fade-out SEC      fade out over the last SEC seconds\n"
+            "  --undo, --redo      undo the edit before, or redo the last one undone\n"
+            "  --instrument PATH   write per-stage histograms and counters to PATH at the\n"
+            "                      end of the run, as CSV for .csv and JSON otherwise\n"
+            "                      (needs a build with make INSTRUMENT=1)\n"
+            "  --bench PATH        time conversion, the ring buffer, resampling, mixing\n"
+            "                      drifting inputs, spectrum analysis, onset slicing,\n"
+            "                      loudness metering and normalization, rendering edit\n"
+            "                      lists, WAV and FLAC writing, export and disk streaming\n"
+            "                      on synthetic audio, writing the results to PATH as CSV\n"
+            "                      for .csv and JSON otherwise; --duration sets the take\n"
+            "                      length\n"
+            "                      (default 5, 30 and 120 s)\n",
+            program, CLI_DEFAULT_SOURCE, MIXER_MAX_INPUTS - 1, CLI_DEFAULT_OUT, GATE_DEFAULT_THRESHOLD_DB,
+            GATE_DEFAULT_HANGOVER_SECONDS, GATE_DEFAULT_MIN_GAP_SECONDS, SLICER_DEFAULT_THRESHOLD,
+            LOUDNESS_DEFAULT_TARGET_LUFS, LOUDNESS_DEFAULT_CEILING_DBTP);
+}
+
+static int ParseSeconds(const char *text, double *out) {
+    char *end;
+    double v = strtod(text, &end);
+
+    if (end == text || *end != '\0' || v < 0) return -1;
+    *out = v;
+    return 0;
+}
+
+static int TakesValue(const char *arg) {
+    static const char *const options[] = { "--source", "--out", "--format", "--duration", "--split-every",
+                                            "--play", "--start", "--threads", "--export", "--rate",
+                                            "--gate", "--gate-threshold", "--gate-hangover", "--gate-min-gap",
+                                            "--pre-roll", "--commit-after", "--instrument", "--bench",
+                                            "--mix", "--mix-skew", "--slice", "--slice-threshold",
+                                            "--target-lufs", "--ceiling-dbtp", "--trim", "--cut", "--gain",
+                                            "--fade-in", "--fade-out" };
+
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); ++i) {
+        if (strcmp(arg, options[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// Parses A:B for trims and cuts, A:B:DB for gains and SEC for fades
+static int ParseEdit(const char *text, CliEdit *edit) {
+    char *end;
+
+    if (edit->type == CLI_EDIT_FADE_IN || edit->type == CLI_EDIT_FADE_OUT) return ParseSeconds(text, &edit->end);
+
+    edit->start = strtod(text, &end);
+    if (end == text || *end != ':' || edit->start < 0) return -1;
+    text = end + 1;
+    edit->end = strtod(text, &end);
+    if (end == text || edit->end <= edit->start) return -1;
+    if (edit->type != CLI_EDIT_GAIN) return *end == '\0' ? 0 : -1;
+
+    if (*end != ':') return -1;
+    text = end + 1;
+    edit->gainDb = strtod(text, &end);
+    return end == text || *end != '\0' ? -1 : 0;
+}
+
+// value is NULL for undo and redo
+static int AddEdit(CliOptions *opt, CliEditType type, const char *arg, const char *value) {
+    CliEdit *edit = &opt->edits[opt->editCount];
+
+    if (opt->editCount == CLI_MAX_EDITS) {
+        fprintf(stderr, "At most %d edits can be given\n", CLI_MAX_EDITS);
+        return -1;
+    }
+    memset(edit, 0, sizeof(*edit));
+    edit->type = type;
+    if (value && ParseEdit(value, edit) != 0) {
+        fprintf(stderr, "Invalid %s %s\n", arg, value);
+        return -1;
+    }
+    opt->editCount++;
+    return 0;
+}
+
+static int ParseOptions(int argc, char **argv, CliOptions *opt) {
+    memset(opt, 0, sizeof(*opt));
+    opt->source = CLI_DEFAULT_SOURCE;
+    opt->outPath = CLI_DEFAULT_OUT;
+    opt->format = OUTPUT_FORMAT_S16;
+    opt->threads = PlatformCpuCount();
+    opt->gate.thresholdDb = GATE_DEFAULT_THRESHOLD_DB;
+    opt->gate.hangoverSeconds = GATE_DEFAULT_HANGOVER_SECONDS;
+    opt->gate.minGapSeconds = GATE_DEFAULT_MIN_GAP_SECONDS;
+    opt->targetLufs = LOUDNESS_DEFAULT_TARGET_LUFS;
+    opt->ceilingDbtp = LOUDNESS_DEFAULT_CEILING_DBTP;
+    opt->commitAfterSeconds = -1.0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--fast") == 0) {
+            opt->fast = 1;
+        } else if (strcmp(arg, "--dither") == 0) {
+            opt->dither = 1;
+        } else if (strcmp(arg, "--normalize") == 0) {
+            opt->normalize = 1;
+        } else if (strcmp(arg, "--buffered-io") == 0) {
+            opt->bufferedIo = 1;
+        } else if (strcmp(arg, "--multitrack") == 0) {
+            opt->multitrack = 1;
+        } else if (strcmp(arg, "--undo") == 0 || strcmp(arg, "--redo") == 0) {
+            if (AddEdit(opt, strcmp(arg, "--undo") == 0 ? CLI_EDIT_UNDO : CLI_EDIT_REDO, arg, NULL) != 0) return -1;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            return -1;
+        } else if (!TakesValue(arg)) {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return -1;
+        } else if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return -1;
+        } else if (strcmp(arg, "--source") == 0) {
+            opt->source = value;
+            ++i;
+        } else if (strcmp(arg, "--mix") == 0) {
+            if (opt->mixCount == MIXER_MAX_INPUTS - 1) {
+                fprintf(stderr, "At most %d sources can be mixed in\n", MIXER_MAX_INPUTS - 1);
+                return -1;
+            }
+            opt->mix[opt->mixCount++] = value;
+            ++i;
+        } else if (strcmp(arg, "--mix-skew") == 0) {
+            char *end;
+            double ppm = strtod(value, &end);
+            if (end == value || *end != '\0' || ppm < -MIXER_MAX_CORRECTION_PPM || ppm > MIXER_MAX_CORRECTION_PPM) {
+                fprintf(stderr, "Invalid clock skew %s (%.0f to %.0f ppm)\n", value, -MIXER_MAX_CORRECTION_PPM,
+                        MIXER_MAX_CORRECTION_PPM);
+                return -1;
+            }
+            opt->mixSkewPpm = ppm;
+            ++i;
+        } else if (strcmp(arg, "--out") == 0) {
+            opt->outPath = value;
+            opt->outGiven = 1;
+            ++i;
+        } else if (strcmp(arg, "--play") == 0) {
+            opt->playPath = value;
+            ++i;
+        } else if (strcmp(arg, "--export") == 0) {
+            opt->exportPath = value;
+            ++i;
+        } else if (strcmp(arg, "--start") == 0) {
+            if (ParseSeconds(value, &opt->startSeconds) != 0) {
+                fprintf(stderr, "Invalid start offset %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--format") == 0) {
+            if (ParseOutputSampleFormat(value, &opt->format) != 0) {
+                fprintf(stderr, "Unknown format %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--duration") == 0) {
+            if (ParseSeconds(value, &opt->durationSeconds) != 0) {
+                fprintf(stderr, "Invalid duration %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--threads") == 0) {
+            char *end;
+            unsigned long n = strtoul(value, &end, 10);
+            if (end == value || *end != '\0' || n > FLAC_MAX_THREADS) {
+                fprintf(stderr, "Invalid thread count %s (0-%d)\n", value, FLAC_MAX_THREADS);
+                return -1;
+            }
+            opt->threads = (uint32_t)n;
+            ++i;
+        } else if (strcmp(arg, "--rate") == 0) {
+            char *end;
+            unsigned long n = strtoul(value, &end, 10);
+            if (end == value || *end != '\0' || n == 0 || n > 768000) {
+                fprintf(stderr, "Invalid sample rate %s\n", value);
+                return -1;
+            }
+            opt->rate = (uint32_t)n;
+            ++i;
+        } else if (strcmp(arg, "--gate") == 0) {
+            if (ParseSilenceGateMode(value, &opt->gate.mode) != 0) {
+                fprintf(stderr, "Unknown gate mode %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--gate-threshold") == 0) {
+            char *end;
+            double db = strtod(value, &end);
+            if (end == value || *end != '\0' || db > 0.0 || db < -140.0) {
+                fprintf(stderr, "Invalid gate threshold %s (-140 to 0 dBFS)\n", value);
+                return -1;
+            }
+            opt->gate.thresholdDb = db;
+            ++i;
+        } else if (strcmp(arg, "--target-lufs") == 0) {
+            char *end;
+            double lufs = strtod(value, &end);
+            if (end == value || *end != '\0' || lufs >= 0.0 || lufs < LOUDNESS_ABSOLUTE_GATE) {
+                fprintf(stderr, "Invalid target loudness %s (%.0f to 0 LUFS)\n", value, LOUDNESS_ABSOLUTE_GATE);
+                return -1;
+            }
+            opt->targetLufs = lufs;
+            opt->normalize = 1;
+            ++i;
+        } else if (strcmp(arg, "--ceiling-dbtp") == 0) {
+            char *end;
+            double db = strtod(value, &end);
+            if (end == value || *end != '\0' || db >= 0.0 || db < -20.0) {
+                fprintf(stderr, "Invalid true peak ceiling %s (-20 to 0 dBTP)\n", value);
+                return -1;
+            }
+            opt->ceilingDbtp = db;
+            ++i;
+        } else if (strcmp(arg, "--gate-hangover") == 0) {
+            if (ParseSeconds(value, &opt->gate.hangoverSeconds) != 0) {
+                fprintf(stderr, "Invalid gate hangover %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--gate-min-gap") == 0) {
+            if (ParseSeconds(value, &opt->gate.minGapSeconds) != 0) {
+                fprintf(stderr, "Invalid gate gap %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--pre-roll") == 0) {
+            if (ParseSeconds(value, &opt->preRollSeconds) != 0 || opt->preRollSeconds == 0.0) {
+                fprintf(stderr, "Invalid pre-roll %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--commit-after") == 0) {
+            if (ParseSeconds(value, &opt->commitAfterSeconds) != 0) {
+                fprintf(stderr, "Invalid commit time %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--instrument") == 0) {
+            if (!INSTRUMENT_ENABLED) {
+                fprintf(stderr, "--instrument needs a build with make INSTRUMENT=1\n");
+                return -1;
+            }
+            opt->instrumentPath = value;
+            ++i;
+        } else if (strcmp(arg, "--bench") == 0) {
+            opt->benchPath = value;
+            ++i;
+        } else if (strcmp(arg, "--slice") == 0) {
+            opt->slicePrefix = value;
+            ++i;
+        } else if (strcmp(arg, "--slice-threshold") == 0) {
+            if (ParseSeconds(value, &opt->sliceThreshold) != 0 || opt->sliceThreshold == 0.0) {
+                fprintf(stderr, "Invalid slice threshold %s\n", value);
+                return -1;
+            }
+            ++i;
+        } else if (strcmp(arg, "--trim") == 0 || strcmp(arg, "--cut") == 0 || strcmp(arg, "--gain") == 0 ||
+                   strcmp(arg, "--fade-in") == 0 || strcmp(arg, "--fade-out") == 0) {
+            CliEditType type = strcmp(arg, "--trim") == 0      ? CLI_EDIT_TRIM
+                               : strcmp(arg, "--cut") == 0     ? CLI_EDIT_CUT
+                               : strcmp(arg, "--gain") == 0    ? CLI_EDIT_GAIN
+                               : strcmp(arg, "--fade-in") == 0 ? CLI_EDIT_FADE_IN
+                                                               : CLI_EDIT_FADE_OUT;
+            if (AddEdit(opt, type, arg, value) != 0) return -1;
+            ++i;
+        } else if (strcmp(arg, "--split-every") == 0) {
+            if (ParseSeconds(value, &opt->splitEverySeconds) != 0) {
+                fprintf(stderr, "Invalid split interval %s\n", value);
+                return -1;
+            }
+            ++i;
+        }
+    }
+    return 0;
+}
+
+// mixIndex 0 is the source itself; mixed-in synthetic sources get their own
+// tone and the --mix-skew clock
+static int CreateNamedSource(const CliOptions *opt, const char *name, uint32_t mixIndex, CaptureSource **out) {
+    CaptureMode offlineMode = opt->fast ? CAPTURE_MODE_FREERUN : CAPTURE_MODE_EVENT;
+    SyntheticSourceConfig synth = {
+        SYNTH_SAMPLE_RATE, SYNTH_CHANNELS, SYNTH_PACKET_FRAMES, SYNTH_FREQUENCY, SYNTH_AMPLITUDE,
+        SYNTHETIC_SINE, 0, 0.0
+    };
+
+    if (strcmp(name, "loopback") == 0 || strcmp(name, "mic") == 0) {
+#ifdef _WIN32
+        HRESULT hr = strcmp(name, "mic") == 0 ? CreateWasapiMicrophoneSource(CAPTURE_MODE_EVENT, out)
+                                              : CreateWasapiCaptureSource(CAPTURE_MODE_EVENT, out);
+        return FAILED(hr) ? -1 : 0;
+#else
+        fprintf(stderr, "Device capture is only available on Windows\n");
+        return -1;
+#endif
+    }
+
+    if (strcmp(name, "sine") == 0) {
+        synth.waveform = SYNTHETIC_SINE;
+    } else if (strcmp(name, "noise") == 0) {
+        synth.waveform = SYNTHETIC_NOISE;
+    } else if (strcmp(name, "silence") == 0) {
+        synth.waveform = SYNTHETIC_SILENCE;
+    } else if (strcmp(name, "bursts") == 0) {
+        synth.waveform = SYNTHETIC_BURSTS;
+    } else {
+        FileSourceConfig file = { name, SYNTH_PACKET_FRAMES, 0 };
+        return CreateFileCaptureSource(&file, offlineMode, out);
+    }
+
+    if (mixIndex > 0) {
+        synth.frequencyHz = SYNTH_FREQUENCY * pow(MIX_FREQUENCY_STEP, mixIndex);
+        synth.clockSkewPpm = opt->mixSkewPpm;
+    }
+    return CreateSyntheticCaptureSource(&synth, offlineMode, out);
+}
+
+// The source, or with --mix a mixer over it and the mixed-in sources
+static int CreateSource(const CliOptions *opt, CaptureSource **out) {
+    CaptureSource *inputs[MIXER_MAX_INPUTS];
+    CaptureMixerConfig mixer = {0};
+    uint32_t count = 0;
+    int result = 0;
+
+    if (opt->mixCount == 0) return CreateNamedSource(opt, opt->source, 0, out);
+
+    for (; count <= opt->mixCount && result == 0; ++count) {
+        const char *name = count == 0 ? opt->source : opt->mix[count - 1];
+        result = CreateNamedSource(opt, name, count, &inputs[count]);
+        if (result != 0) fprintf(stderr, "Failed to open capture source %s\n", name);
+    }
+    if (result != 0) count--;
+
+    mixer.layout = opt->multitrack ? MIXER_LAYOUT_MULTITRACK : MIXER_LAYOUT_SUM;
+    if (result == 0 && CreateMixerCaptureSource(inputs, count, &mixer, out) != 0) {
+        fprintf(stderr, "These sources cannot be mixed (formats, rates or too many channels)\n");
+        result = -1;
+    }
+    if (result != 0) {
+        for (uint32_t i = 0; i < count; ++i) inputs[i]->lpVtbl->Destroy(inputs[i]);
+    }
+    return result;
+}
+
+// Loads the whole file into heap-backed take storage, as the GUI holds a take.
+// With loudness set, the take is measured as it loads, as a recording is
+// measured as it is stored.
+static int LoadTake(const char *path, TakeStorage *take, WavFormat *format, LoudnessSummary *loudness) {
+    WavReader reader;
+    LoudnessMeter meter;
+    int metering = 0;
+    uint8_t *buffer;
+    uint32_t frames;
+    int result = 0;
+
+    if (WavReaderOpen(&reader, path) != 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+
+    buffer = (uint8_t *)malloc((size_t)PLAY_LOAD_FRAMES * reader.blockAlign);
+    if (!buffer || TakeStorageOpen(take, NULL, reader.blockAlign) != 0) {
+        free(buffer);
+        WavReaderClose(&reader);
+        return -1;
+    }
+
+    if (loudness) metering = LoudnessMeterInit(&meter, &reader.format) == 0;
+    while (result == 0 && (frames = WavReaderRead(&reader, buffer, PLAY_LOAD_FRAMES)) != 0) {
+        result = TakeStorageAppend(take, buffer, (size_t)frames * reader.blockAlign);
+        if (metering) LoudnessMeterProcess(&meter, buffer, frames);
+    }
+
+    if (loudness && !metering) fprintf(stderr, "Cannot measure the loudness of %s\n", path);
+    if (metering) {
+        LoudnessMeterRead(&meter, loudness);
+        LoudnessMeterClose(&meter);
+    }
+    *format = reader.format;
+    free(buffer);
+    WavReaderClose(&reader);
+    if (result != 0) TakeStorageClose(take);
+    return result;
+}
+
+// Builds the edit list of the options over the whole take.
+static int OpenEdits(const CliOptions *opt, const TakeSlice *slice, const WavFormat *format, EditList *edits) {
+    if (EditListOpen(edits, slice, format) != 0) return -1;
+
+    for (uint32_t i = 0; i < opt->editCount; ++i) {
+        const CliEdit *edit = &opt->edits[i];
+        uint64_t total = EditListFrames(edits);
+        // Both ends rounded to a frame, so ranges that meet in seconds meet in frames; fades start at 0
+        uint64_t start = (uint64_t)llround(edit->start * format->sampleRate);
+        uint64_t frames = (uint64_t)llround(edit->end * format->sampleRate) - start;
+        int result = 0;
+
+        switch (edit->type) {
+        case CLI_EDIT_TRIM: result = EditListTrim(edits, start, frames); break;
+        case CLI_EDIT_CUT: result = EditListCut(edits, start, frames); break;
+        case CLI_EDIT_GAIN: result = EditListGain(edits, start, frames, edit->gainDb); break;
+        case CLI_EDIT_FADE_IN: result = EditListFadeIn(edits, 0, frames); break;
+        case CLI_EDIT_FADE_OUT:
+            if (frames > total) frames = total;
+            result = EditListFadeOut(edits, total - frames, frames);
+            break;
+        case CLI_EDIT_UNDO:
+            result = EditListUndo(edits);
+            if (result != 0) fprintf(stderr, "Nothing to undo\n");
+            break;
+        case CLI_EDIT_REDO:
+            result = EditListRedo(edits);
+            if (result != 0) fprintf(stderr, "Nothing to redo\n");
+            break;
+        }
+        if (result != 0) {
+            EditListClose(edits);
+            return -1;
+        }
+    }
+    if (opt->editCount > 0) {
+        printf("Edited to %.3f s in %u regions\n", (double)EditListFrames(edits) / format->sampleRate,
+               edits->count);
+    }
+    return 0;
+}
+
+// Measures what an edited export will write, since the loudness measured as
+// the take loaded no longer describes it.
+static int MeasureEdits(const EditList *edits, const WavFormat *format, LoudnessSummary *loudness) {
+    SampleFormat floatSamples = { SAMPLE_F32, format->channels, 0 };
+    WavFormat floatFormat;
+    LoudnessMeter meter;
+    float *buffer;
+    uint32_t frames;
+    uint64_t frame = 0;
+
+    SampleFormatToWav(&floatSamples, format->sampleRate, &floatFormat);
+    floatFormat.channelMask = format->channelMask;
+    buffer = (float *)malloc((size_t)PLAY_LOAD_FRAMES * format->channels * sizeof(float));
+    if (!buffer || LoudnessMeterInit(&meter, &floatFormat) != 0) {
+        fprintf(stderr, "Cannot measure the loudness of the edit\n");
+        free(buffer);
+        return -1;
+    }
+
+    while ((frames = EditListRender(edits, frame, PLAY_LOAD_FRAMES, buffer)) != 0) {
+        LoudnessMeterProcess(&meter, buffer, frames);
+        frame += frames;
+    }
+    LoudnessMeterRead(&meter, loudness);
+    LoudnessMeterClose(&meter);
+    free(buffer);
+    return 0;
+}
+
+// Streams a file through the playback scheduler to a sink without a device, so
+// time to first block, refill cost and underruns can be measured headless.
+static int RunPlayback(const CliOptions *opt) {
+    TakeStorage take = {0};
+    WavFormat format;
+    OutputSink *sink = NULL;
+    PlaybackStream stream;
+    EditList edits;
+    int realtime = !opt->fast;
+    int result;
+
+    if (LoadTake(opt->playPath, &take, &format, NULL) != 0) return 1;
+
+    TakeSlice slice = TakeStorageSlice(&take, 0, TakeStorageFrames(&take));
+    if (OpenEdits(opt, &slice, &format, &edits) != 0) {
+        TakeStorageClose(&take);
+        return 1;
+    }
+    if (CreateFileOutputSink(opt->outGiven ? opt->outPath : NULL, realtime, &sink) != 0) {
+        EditListClose(&edits);
+        TakeStorageClose(&take);
+        return 1;
+    }
+
+    uint64_t startFrame = (uint64_t)llround(opt->startSeconds * format.sampleRate);
+
+    printf("Playing %s (%u Hz, %u channels, %u-bit) from %.3f s to the %s sink%s\n",
+           opt->playPath, format.sampleRate, format.channels, format.bitsPerSample,
+           opt->startSeconds, sink->lpVtbl->name, realtime ? "" : " (fast)");
+
+    if (PlaybackStreamOpen(&stream, sink, &slice, &edits, &format, startFrame) != 0) {
+        sink->lpVtbl->Destroy(sink);
+        EditListClose(&edits);
+        TakeStorageClose(&take);
+        return 1;
+    }
+
+    activePlayback = &stream;
+    InstallStopHandler();
+
+    while ((result = PlaybackStreamPump(&stream, PLAYBACK_WAIT_MS)) > 0) {
+    }
+    activePlayback = NULL;
+
+    PlaybackStatsPrint(&stream.stats, stdout);
+    PlaybackStreamClose(&stream);
+    sink->lpVtbl->Destroy(sink);
+    EditListClose(&edits);
+    TakeStorageClose(&take);
+
+    return result == 0 ? 0 : 1;
+}
+
+static SampleType ExportSampleType(OutputSampleFormat format, const WavFormat *in) {
+    SampleFormat inSamples;
+
+    switch (format) {
+    case OUTPUT_FORMAT_S16: return SAMPLE_S16;
+    case OUTPUT_FORMAT_S24: return SAMPLE_S24;
+    case OUTPUT_FORMAT_S32: return SAMPLE_S32;
+    case OUTPUT_FORMAT_F32: return SAMPLE_F32;
+    default: break;
+    }
+    return SampleFormatFromWav(in, &inSamples) == 0 ? inSamples.type : SAMPLE_S16;
+}
+
+// Exports a file the way the GUI saves a take, so export throughput can be
+// compared across thread counts headless. The take is loaded first and not timed.
+static int RunExport(const CliOptions *opt) {
+    TakeStorage take = {0};
+    WavFormat format;
+    TakeExport exporter;
+    TakeExportConfig config = {0};
+    EditList edits;
+    int measured = opt->normalize && opt->editCount == 0;
+    int lastPercent = -1;
+    int result;
+
+    if (LoadTake(opt->exportPath, &take, &format, measured ? &config.loudness : NULL) != 0) return 1;
+
+    uint64_t frameTotal = TakeStorageFrames(&take);
+    TakeSlice slice = TakeStorageSlice(&take, 0, frameTotal);
+    if (OpenEdits(opt, &slice, &format, &edits) != 0) {
+        TakeStorageClose(&take);
+        return 1;
+    }
+    if (opt->normalize && !measured && MeasureEdits(&edits, &format, &config.loudness) != 0) {
+        EditListClose(&edits);
+        TakeStorageClose(&take);
+        return 1;
+    }
+    frameTotal = EditListFrames(&edits);
+
+    config.path = opt->outPath;
+    config.outType = ExportSampleType(opt->format, &format);
+    config.outRate = opt->rate;
+    config.threads = opt->threads;
+    config.dither = opt->dither;
+    config.normalize = opt->normalize;
+    config.targetLufs = opt->targetLufs;
+    config.ceilingDbtp = opt->ceilingDbtp;
+    config.edits = &edits;
+
+    printf("Exporting %s (%u Hz, %u channels, %u-bit, %llu frames) to %s as %s at %u Hz\n",
+           opt->exportPath, format.sampleRate, format.channels, format.bitsPerSample,
+           (unsigned long long)frameTotal, opt->outPath, SampleTypeName(config.outType),
+           opt->rate ? opt->rate : format.sampleRate);
+    if (opt->normalize) {
+        LoudnessSummaryPrint(&config.loudness, stdout);
+        printf("Normalizing to %.1f LUFS under %.1f dBTP\n", opt->targetLufs, opt->ceilingDbtp);
+    }
+
+    if (TakeExportStart(&exporter, &slice, &format, &config) != 0) {
+        EditListClose(&edits);
+        TakeStorageClose(&take);
+        return 1;
+    }
+
+    activeExport = &exporter;
+    InstallStopHandler();
+
+    while (TakeExportIsRunning(&exporter)) {
+        int percent = frameTotal ? (int)(TakeExportFramesDone(&exporter) * 100 / frameTotal) : 100;
+        if (percent != lastPercent) {
+            fprintf(stderr, "\rExporting... %d%%", percent);
+            lastPercent = percent;
+        }
+        PlatformSleepMs(CLI_POLL_MS);
+    }
+    fprintf(stderr, "\n");
+
+    result = TakeExportWait(&exporter);
+    activeExport = NULL;
+
+    TakeExportPrintStats(&exporter, stdout);
+    EditListClose(&edits);
+    TakeStorageClose(&take);
+
+    return result == 0 ? 0 : 1;
+}
+
+static void PrintLevels(LevelMeter *meter, WaveformOverview *overview, Spectrogram *spectrogram,
+                        LoudnessMeter *loudness) {
+    LevelReading reading;
+    LoudnessSummary summary;
+    float lo, hi;
+    uint64_t columns = spectrogram ? SpectrogramColumns(spectrogram) : 0;
+
+    if (LevelMeterRead(meter, &reading)) {
+        printf("Levels over the last %u ms:\n", 1000u / METER_BLOCKS_PER_SECOND);
+        LevelReadingPrint(&reading, stdout);
+    }
+    if (WaveformOverviewColumns(overview, 0, WaveformOverviewFrames(overview), 1, &lo, &hi) == 1) {
+        printf("Overview: %llu frames, range %.3f to %.3f\n",
+               (unsigned long long)WaveformOverviewFrames(overview), lo, hi);
+    }
+    if (columns > 0) {
+        float *magnitudes = (float *)malloc(spectrogram->plan.bins * sizeof(float));
+        float level;
+
+        if (magnitudes && SpectrogramReadColumn(spectrogram, columns - 1, magnitudes)) {
+            double hz = SpectrumPeakFrequency(magnitudes, spectrogram->plan.bins, spectrogram->sampleRate, &level);
+            printf("Spectrum: %llu columns of %u bins, last strongest at %.1f Hz (%.1f dBFS)\n",
+                   (unsigned long long)columns, spectrogram->plan.bins, hz,
+                   level > 0.0f ? 20.0 * log10(level) : -INFINITY);
+        }
+        free(magnitudes);
+    }
+    if (loudness && LoudnessMeterRead(loudness, &summary)) LoudnessSummaryPrint(&summary, stdout);
+}
+
+// Slices on the storage thread, from the frames as they are stored
+static int SliceTap(void *user, const void *frames, uint32_t frameCount) {
+    return OnsetSlicerProcess((OnsetSlicer *)user, frames, frameCount);
+}
+
+static int RunRecording(const CliOptions *opt) {
+    CaptureSource *source = NULL;
+    CapturePipeline pipeline;
+    CapturePipelineConfig config = {0};
+    LevelMeter meter;
+    WaveformOverview overview;
+    Spectrogram spectrogram;
+    LoudnessMeter loudness;
+    OnsetSlicer *slicer = NULL;
+
+    if (CreateSource(opt, &source) != 0) {
+        fprintf(stderr, "Failed to open capture source %s\n", opt->source);
+        return 1;
+    }
+
+    printf("Recording from %s (%u Hz, %u channels, %u-bit) to %s as %s %s\n",
+           source->lpVtbl->name, source->format.sampleRate, source->format.channels,
+           source->format.bitsPerSample, opt->outPath, OutputSampleFormatName(opt->format),
+           OutputContainerName(OutputContainerForPath(opt->outPath)));
+
+    config.outPath = opt->outPath;
+    config.outFormat = opt->format;
+    config.container = OutputContainerForPath(opt->outPath);
+    config.encoderThreads = opt->threads;
+    config.outRate = opt->rate;
+    config.durationSeconds = opt->durationSeconds;
+    config.splitEverySeconds = opt->splitEverySeconds;
+    config.dither = opt->dither;
+    config.bufferedOutput = opt->bufferedIo;
+    config.gate = opt->gate;
+    config.armed = opt->preRollSeconds > 0.0;
+    config.preRollSeconds = opt->preRollSeconds;
+
+    if (LevelMeterInit(&meter, &source->format, source->format.sampleRate / METER_BLOCKS_PER_SECOND) == 0) {
+        config.meter = &meter;
+    }
+    if (WaveformOverviewInit(&overview, &source->format) == 0) {
+        config.overview = &overview;
+    }
+    if (SpectrogramInit(&spectrogram, &source->format, NULL) == 0) {
+        config.spectrogram = &spectrogram;
+    }
+    if (LoudnessMeterInit(&loudness, &source->format) == 0) {
+        config.loudness = &loudness;
+    }
+    if (opt->slicePrefix) {
+        OnsetSlicerConfig sliceConfig = {0};
+
+        sliceConfig.prefix = opt->slicePrefix;
+        sliceConfig.detector.threshold = opt->sliceThreshold;
+        slicer = (OnsetSlicer *)malloc(sizeof(*slicer));
+        if (!slicer || OnsetSlicerInit(slicer, &source->format, &sliceConfig) != 0) {
+            fprintf(stderr, "Failed to start slicing to %s\n", opt->slicePrefix);
+            free(slicer);
+            slicer = NULL;
+        } else {
+            config.tap = SliceTap;
+            config.tapUser = slicer;
+        }
+    }
+
+    if ((opt->slicePrefix && !slicer) || CapturePipelineStart(&pipeline, source, &config) != 0) {
+        LevelMeterClose(&meter);
+        WaveformOverviewClose(&overview);
+        SpectrogramClose(&spectrogram);
+        LoudnessMeterClose(&loudness);
+        if (slicer) OnsetSlicerClose(slicer);
+        free(slicer);
+        source->lpVtbl->Destroy(source);
+        return 1;
+    }
+
+    activePipeline = &pipeline;
+    InstallStopHandler();
+
+    // The pipeline commits at this frame of the source itself, so --fast commits at the same point
+    int armed = config.armed;
+    if (armed) {
+        CapturePipelineCommitAt(&pipeline, (uint64_t)llround((opt->commitAfterSeconds < 0.0 ? opt->preRollSeconds
+                                                                                            : opt->commitAfterSeconds) *
+                                                              source->format.sampleRate));
+    }
+    while (CapturePipelineIsRunning(&pipeline)) {
+        if (armed && !CapturePipelineIsArmed(&pipeline)) {
+            printf("Committed after %.2f s armed\n",
+                   (double)atomic_load(&pipeline.commitFrame) / source->format.sampleRate);
+            armed = 0;
+        }
+        PlatformSleepMs(CLI_POLL_MS);
+    }
+
+    int result = CapturePipelineWait(&pipeline);
+    activePipeline = NULL;
+    if (armed && !CapturePipelineIsArmed(&pipeline)) {
+        printf("Committed after %.2f s armed\n", (double)atomic_load(&pipeline.commitFrame) / source->format.sampleRate);
+    }
+
+    CapturePipelinePrintStats(&pipeline, stdout);
+    if (MixerCaptureSourceMixer(source)) CaptureMixerPrintStats(MixerCaptureSourceMixer(source), stdout);
+    if (config.meter && config.overview) PrintLevels(&meter, &overview, config.spectrogram, config.loudness);
+    if (slicer) {
+        if (OnsetSlicerFinish(slicer) != 0) {
+            fprintf(stderr, "Slicing to %s failed\n", opt->slicePrefix);
+            result = -1;
+        }
+        OnsetSlicerPrintStats(slicer, stdout);
+        OnsetSlicerClose(slicer);
+        free(slicer);
+    }
+    LevelMeterClose(&meter);
+    WaveformOverviewClose(&overview);
+    SpectrogramClose(&spectrogram);
+    LoudnessMeterClose(&loudness);
+    source->lpVtbl->Destroy(source);
+
+    return result == 0 ? 0 : 1;
+}
+
+static int RunBench(const CliOptions *opt) {
+    static const double defaultTakes[] = { 5.0, 30.0, 120.0 };
+    BenchConfig config = {0};
+
+    if (opt->durationSeconds > 0.0) {
+        config.takeSeconds[config.takeCount++] = opt->durationSeconds;
+    } else {
+        for (size_t i = 0; i < sizeof(defaultTakes) / sizeof(defaultTakes[0]); ++i) {
+            config.takeSeconds[config.takeCount++] = defaultTakes[i];
+        }
+    }
+    config.threads = opt->threads;
+    config.resultsPath = opt->benchPath;
+
+    return RunBenchmarks(&config) == 0 ? 0 : 1;
+}
+
+int RunCommandLine(int argc, char **argv) {
+    CliOptions opt;
+    int result;
+
+    if (ParseOptions(argc, argv, &opt) != 0) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    if (opt.benchPath) {
+        result = RunBench(&opt);
+    } else if (opt.playPath) {
+        result = RunPlayback(&opt);
+    } else if (opt.exportPath) {
+        result = RunExport(&opt);
+    } else {
+        result = RunRecording(&opt);
+    }
+
+    if (opt.instrumentPath) {
+        InstrumentPrint(stdout);
+        if (InstrumentWriteFile(opt.instrumentPath) != 0) {
+            fprintf(stderr, "Failed to write %s\n", opt.instrumentPath);
+            result = 1;
+        } else {
+            printf("Instrumentation written to %s\n", opt.instrumentPath);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,10 @@
+// cli.h
+#ifndef CLI_H
+#define CLI_H
+
+// Headless recorder: runs the capture pipeline without a window, or with
+// --play streams a file through the playback scheduler to a null/file sink.
+// Returns the process exit code.
+int RunCommandLine(int argc, char **argv);
+
+#endif // CLI_H
@@ -0,0 +1,7 @@
+// cli_main.c
+// Entry point for the headless recorder on platforms without the GUI.
+#include "cli.h"
+
+int main(int argc, char **argv) {
+    return RunCommandLine(argc, argv);
+}
@@ -0,0 +1,241 @@
+// disk_writer.c
+#include <string.h>
+
+#include "disk_writer.h"
+#include "instrument.h"
+
+#define ALIGN_MASK ((uint64_t)PLATFORM_DIRECT_ALIGN - 1)
+
+static uint64_t AlignUp(uint64_t value) {
+    return (value + ALIGN_MASK) & ~ALIGN_MASK;
+}
+
+static int TimedWrite(DiskWriter *d, uint64_t offset, const void *data, size_t bytes) {
+    uint64_t startNs = PlatformNowNs();
+    int result = PlatformDirectWrite(&d->file, offset, data, bytes);
+    uint64_t elapsed = PlatformNowNs() - startNs;
+
+    INSTR_RECORD(INSTR_DISK_WRITE_NS, elapsed);
+    d->stats.writes++;
+    d->stats.bytes += bytes;
+    d->stats.writeNs += elapsed;
+    if (elapsed > d->stats.maxWriteNs) d->stats.maxWriteNs = elapsed;
+    return result;
+}
+
+static void WriteBuffer(DiskWriter *d, const DiskWriterBuffer *b) {
+    uint64_t length = AlignUp(b->bytes);
+    uint64_t end = b->offset + length;
+
+    if (atomic_load(&d->error)) return;
+
+    // Reserving in large steps keeps block allocation out of the individual writes
+    if (end > d->reserved) {
+        d->reserved = end + DISK_WRITER_RESERVE_BYTES;
+        if (PlatformDirectReserve(&d->file, d->reserved) != 0) d->reserved = UINT64_MAX;
+    }
+
+    if ((length && TimedWrite(d, b->offset, b->data, (size_t)length) != 0) ||
+        (b->writeHead && TimedWrite(d, 0, b->head, DISK_WRITER_HEAD_BYTES) != 0)) {
+        atomic_store(&d->error, 1);
+    }
+}
+
+static int WriterMain(void *arg) {
+    DiskWriter *d = (DiskWriter *)arg;
+
+    for (;;) {
+        // stop is set after the last submit, so reading it first sees every buffer
+        int stopping = atomic_load(&d->stop);
+        unsigned done = atomic_load_explicit(&d->completed, memory_order_relaxed);
+        unsigned queued = atomic_load_explicit(&d->submitted, memory_order_acquire);
+
+        if (done == queued) {
+            if (stopping) break;
+            PlatformEventWait(&d->workEvent, DISK_WRITER_WAIT_MS);
+            continue;
+        }
+        WriteBuffer(d, &d->buffers[done % DISK_WRITER_BUFFERS]);
+        atomic_store_explicit(&d->completed, done + 1, memory_order_release);
+        PlatformEventSignal(&d->doneEvent);
+    }
+    return 0;
+}
+
+static DiskWriterBuffer *FillBuffer(DiskWriter *d) {
+    return &d->buffers[atomic_load_explicit(&d->submitted, memory_order_relaxed) % DISK_WRITER_BUFFERS];
+}
+
+// Hands the fill buffer to the writer thread and readies the next one, which
+// starts with the partial block at the end of this one, if any
+static void Submit(DiskWriter *d) {
+    DiskWriterBuffer *b = FillBuffer(d);
+    size_t tail = b->bytes & ALIGN_MASK;
+    size_t whole = b->bytes - tail;
+    unsigned queued;
+    unsigned depth;
+
+    if (tail) memset(b->data + b->bytes, 0, PLATFORM_DIRECT_ALIGN - tail);
+    b->writeHead = d->headDirty && b->offset > 0;
+    if (b->writeHead) memcpy(b->head, d->head, DISK_WRITER_HEAD_BYTES);
+    d->headDirty = 0;
+
+    if (!d->threaded) {
+        WriteBuffer(d, b);
+        atomic_fetch_add_explicit(&d->completed, 1, memory_order_relaxed);
+    }
+    queued = atomic_fetch_add_explicit(&d->submitted, 1, memory_order_release) + 1;
+    if (d->threaded) PlatformEventSignal(&d->workEvent);
+
+    depth = queued - atomic_load_explicit(&d->completed, memory_order_acquire);
+    if (depth > d->stats.maxQueued) d->stats.maxQueued = depth;
+
+    // The ring is full only if the disk has fallen DISK_WRITER_BUFFERS behind
+    if (depth >= DISK_WRITER_BUFFERS) {
+        uint64_t startNs = PlatformNowNs();
+
+        d->stats.stalls++;
+        INSTR_COUNT(INSTR_DISK_STALLS);
+        while (queued - atomic_load_explicit(&d->completed, memory_order_acquire) >= DISK_WRITER_BUFFERS) {
+            PlatformEventWait(&d->doneEvent, DISK_WRITER_WAIT_MS);
+        }
+        d->stats.stallNs += PlatformNowNs() - startNs;
+    }
+
+    DiskWriterBuffer *next = FillBuffer(d);
+    next->offset = b->offset + whole;
+    next->bytes = tail;
+    if (tail) memcpy(next->data, b->data + whole, tail);
+}
+
+int DiskWriterOpen(DiskWriter *d, const char *path) {
+    size_t stride = DISK_WRITER_BUFFER_BYTES + DISK_WRITER_HEAD_BYTES;
+
+    memset(d, 0, sizeof(*d));
+    d->memory = (uint8_t *)PlatformAlignedAlloc(stride * DISK_WRITER_BUFFERS + DISK_WRITER_HEAD_BYTES);
+    if (!d->memory) return -1;
+
+    for (uint32_t i = 0; i < DISK_WRITER_BUFFERS; ++i) {
+        d->buffers[i].data = d->memory + stride * i;
+        d->buffers[i].head = d->buffers[i].data + DISK_WRITER_BUFFER_BYTES;
+    }
+    d->head = d->memory + stride * DISK_WRITER_BUFFERS;
+    memset(d->head, 0, DISK_WRITER_HEAD_BYTES);
+
+    atomic_init(&d->submitted, 0);
+    atomic_init(&d->completed, 0);
+    atomic_init(&d->stop, 0);
+    atomic_init(&d->error, 0);
+
+    if (PlatformDirectOpen(&d->file, path) != 0) {
+        PlatformAlignedFree(d->memory);
+        return -1;
+    }
+    d->stats.direct = d->file.direct;
+
+    // Without a writer thread the buffers are written as they are queued
+    if (PlatformEventInit(&d->workEvent) == 0) {
+        if (PlatformEventInit(&d->doneEvent) == 0) {
+            d->threaded = PlatformThreadCreate(&d->thread, WriterMain, d) == 0;
+            if (!d->threaded) PlatformEventDestroy(&d->doneEvent);
+        }
+        if (!d->threaded) PlatformEventDestroy(&d->workEvent);
+    }
+
+    d->open = 1;
+    return 0;
+}
+
+int DiskWriterAppend(DiskWriter *d, const void *data, size_t bytes) {
+    const uint8_t *p = (const uint8_t *)data;
+
+    if (atomic_load_explicit(&d->error, memory_order_relaxed)) return -1;
+
+    if (d->size < DISK_WRITER_HEAD_BYTES) {
+        size_t n = DISK_WRITER_HEAD_BYTES - (size_t)d->size;
+        memcpy(d->head + d->size, p, n < bytes ? n : bytes);
+    }
+    d->size += bytes;
+
+    while (bytes > 0) {
+        DiskWriterBuffer *b = FillBuffer(d);
+        size_t n = DISK_WRITER_BUFFER_BYTES - b->bytes;
+
+        if (n > bytes) n = bytes;
+        memcpy(b->data + b->bytes, p, n);
+        b->bytes += n;
+        p += n;
+        bytes -= n;
+        if (b->bytes == DISK_WRITER_BUFFER_BYTES) Submit(d);
+    }
+    return 0;
+}
+
+int DiskWriterPatch(DiskWriter *d, uint64_t offset, const void *data, size_t bytes) {
+    DiskWriterBuffer *b = FillBuffer(d);
+
+    if (offset + bytes > DISK_WRITER_HEAD_BYTES || offset + bytes > d->size) return -1;
+
+    memcpy(d->head + offset, data, bytes);
+    if (b->offset == 0) {
+        // Still in the fill buffer, which will carry it out
+        memcpy(b->data + offset, data, bytes);
+    } else {
+        d->headDirty = 1;
+    }
+    return 0;
+}
+
+int DiskWriterFlush(DiskWriter *d) {
+    if (atomic_load_explicit(&d->error, memory_order_relaxed)) return -1;
+
+    DiskWriterBuffer *b = FillBuffer(d);
+    if (b->bytes > 0 || d->headDirty) Submit(d);
+    return 0;
+}
+
+int DiskWriterClose(DiskWriter *d) {
+    int result;
+
+    if (!d->open) return -1;
+
+    DiskWriterFlush(d);
+    if (d->threaded) {
+        atomic_store(&d->stop, 1);
+        PlatformEventSignal(&d->workEvent);
+        PlatformThreadJoin(d->thread);
+        PlatformEventDestroy(&d->workEvent);
+        PlatformEventDestroy(&d->doneEvent);
+    }
+
+    result = atomic_load(&d->error) ? -1 : 0;
+    if (PlatformDirectTruncate(&d->file, d->size) != 0) result = -1;
+    if (PlatformDirectClose(&d->file) != 0) result = -1;
+    d->stats.direct = d->file.direct;
+
+    PlatformAlignedFree(d->memory);
+    d->memory = NULL;
+    d->open = 0;
+    return result;
+}
+
+void DiskWriterStatsAdd(DiskWriterStats *total, const DiskWriterStats *s) {
+    total->bytes += s->bytes;
+    total->writes += s->writes;
+    total->writeNs += s->writeNs;
+    if (s->maxWriteNs > total->maxWriteNs) total->maxWriteNs = s->maxWriteNs;
+    total->stalls += s->stalls;
+    total->stallNs += s->stallNs;
+    if (s->maxQueued > total->maxQueued) total->maxQueued = s->maxQueued;
+    total->direct = s->direct;
+}
+
+void DiskWriterStatsPrint(const DiskWriterStats *s, FILE *out) {
+    double writeSeconds = s->writeNs / 1e9;
+
+    fprintf(out, "Disk writer (%s): %.1f MB in %llu writes, %.1f MB/s sustained, worst write %.2f ms, "
+                 "queue peak %u of %u, %llu stall(s) for %.2f ms\n",
+            s->direct ? "direct" : "cached", s->bytes / 1e6, (unsigned long long)s->writes,
+            writeSeconds > 0 ? s->bytes / 1e6 / writeSeconds : 0.0, s->maxWriteNs / 1e6, s->maxQueued,
+            DISK_WRITER_BUFFERS, (unsigned long long)s->stalls, s->stallNs / 1e6);
+}
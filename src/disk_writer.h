@@ -0,0 +1,81 @@
+// disk_writer.h
+#ifndef DISK_WRITER_H
+#define DISK_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "platform.h"
+
+#define DISK_WRITER_BUFFER_BYTES (1024 * 1024)          // One write; a multiple of PLATFORM_DIRECT_ALIGN
+#define DISK_WRITER_BUFFERS 16                          // Audio that can wait on a stalled disk
+#define DISK_WRITER_RESERVE_BYTES (64ull * 1024 * 1024) // Disk space reserved ahead of the writes
+#define DISK_WRITER_HEAD_BYTES PLATFORM_DIRECT_ALIGN    // Patchable prefix, room for any header
+#define DISK_WRITER_WAIT_MS 50
+
+typedef struct {
+    uint64_t bytes;               // Written to the file, counting partial blocks written again
+    uint64_t writes;
+    uint64_t writeNs;             // Summed over writes, on the writer thread
+    uint64_t maxWriteNs;          // Worst single write
+    uint64_t stalls;              // Times the appending thread found every buffer queued
+    uint64_t stallNs;             // Time it waited for one
+    uint32_t maxQueued;           // Deepest the queue got, in buffers
+    int direct;                   // The OS cache was bypassed
+} DiskWriterStats;
+
+typedef struct {
+    uint8_t *data;                // DISK_WRITER_BUFFER_BYTES, aligned
+    uint64_t offset;              // File position of data[0], block aligned
+    size_t bytes;
+    uint8_t *head;                // Snapshot of the patched head, written after the data
+    int writeHead;
+} DiskWriterBuffer;
+
+// Streams one file through a ring of large aligned buffers that a writer
+// thread writes in order, bypassing the OS cache where the filesystem allows.
+// Append only copies and blocks only once every buffer is waiting on the disk,
+// so a stall reaches the appending thread after DISK_WRITER_BUFFERS buffers,
+// and the capture thread never. Disk space is reserved ahead on the writer
+// thread. The first DISK_WRITER_HEAD_BYTES can be patched at any time for
+// headers whose sizes are known later; a patch reaches the disk with the next
+// queued buffer, after its data, so the header never claims unwritten audio.
+// One thread appends; the writer thread only ever touches queued buffers.
+typedef struct {
+    PlatformDirectFile file;
+    uint8_t *memory;
+    DiskWriterBuffer buffers[DISK_WRITER_BUFFERS];
+    uint8_t *head;                // The head as the appending thread sees it
+    int headDirty;                // Patched since the block was last queued
+    uint64_t size;                // Bytes appended
+    uint64_t reserved;            // End of the reservation, writer thread only
+
+    PlatformThread thread;
+    PlatformEvent workEvent;
+    PlatformEvent doneEvent;
+    atomic_uint submitted;        // Buffers queued; submitted % DISK_WRITER_BUFFERS is being filled
+    atomic_uint completed;        // Buffers written
+    atomic_int stop;
+    atomic_int error;
+    int threaded;
+
+    DiskWriterStats stats;
+    int open;
+} DiskWriter;
+
+int DiskWriterOpen(DiskWriter *d, const char *path);
+int DiskWriterAppend(DiskWriter *d, const void *data, size_t bytes);
+// offset + bytes must lie within DISK_WRITER_HEAD_BYTES and what was appended.
+int DiskWriterPatch(DiskWriter *d, uint64_t offset, const void *data, size_t bytes);
+// Queues everything appended so far, padding the last block; it is written
+// again once the rest of it arrives.
+int DiskWriterFlush(DiskWriter *d);
+// Flushes, waits for the writer thread and trims the file to what was appended.
+// Returns 0 if every byte was written.
+int DiskWriterClose(DiskWriter *d);
+
+void DiskWriterStatsAdd(DiskWriterStats *total, const DiskWriterStats *s);
+// One line: volume, sustained rate while writing, worst write and stalls.
+void DiskWriterStatsPrint(const DiskWriterStats *s, FILE *out);
+
+#endif // DISK_WRITER_H
@@ -0,0 +1,301 @@
+// edit_list.c
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edit_list.h"
+
+static int Reserve(EditList *e, uint32_t count) {
+    if (count <= e->capacity) return 0;
+
+    uint32_t capacity = e->capacity ? e->capacity * 2 : 8;
+    while (capacity < count) capacity *= 2;
+    EditRegion *regions = (EditRegion *)realloc(e->regions, capacity * sizeof(EditRegion));
+    if (!regions) return -1;
+    e->regions = regions;
+    e->capacity = capacity;
+    return 0;
+}
+
+static void Renumber(EditList *e) {
+    uint64_t position = 0;
+
+    for (uint32_t i = 0; i < e->count; ++i) {
+        e->regions[i].position = position;
+        position += e->regions[i].frames;
+    }
+    e->frames = position;
+}
+
+// Index of the region holding frame, which must be inside the edit.
+static uint32_t FindRegion(const EditList *e, uint64_t frame) {
+    uint32_t lo = 0;
+    uint32_t hi = e->count - 1;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (e->regions[mid].position <= frame) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+// Makes a region start at frame and returns its index, or count at the end of the edit.
+static int SplitAt(EditList *e, uint64_t frame, uint32_t *index) {
+    if (frame >= e->frames) {
+        *index = e->count;
+        return 0;
+    }
+
+    uint32_t i = FindRegion(e, frame);
+    uint64_t offset = frame - e->regions[i].position;
+    if (offset == 0) {
+        *index = i;
+        return 0;
+    }
+    if (Reserve(e, e->count + 1) != 0) return -1;
+
+    memmove(&e->regions[i + 2], &e->regions[i + 1], (e->count - i - 1) * sizeof(EditRegion));
+    e->count++;
+
+    EditRegion *left = &e->regions[i];
+    EditRegion *right = &e->regions[i + 1];
+    *right = *left;
+    left->frames = offset;
+    left->fadeOutOffset += right->frames - offset;
+    right->sourceStart += offset;
+    right->position += offset;
+    right->frames -= offset;
+    right->fadeInOffset += offset;
+    *index = i + 1;
+    return 0;
+}
+
+static int TakeSnapshot(const EditList *e, EditSnapshot *s) {
+    s->regions = (EditRegion *)malloc((e->count ? e->count : 1) * sizeof(EditRegion));
+    if (!s->regions) return -1;
+    memcpy(s->regions, e->regions, e->count * sizeof(EditRegion));
+    s->count = e->count;
+    return 0;
+}
+
+// Drops the oldest step when the stack is full.
+static void PushSnapshot(EditSnapshot *stack, uint32_t *depth, const EditSnapshot *s) {
+    if (*depth == EDIT_UNDO_DEPTH) {
+        free(stack[0].regions);
+        memmove(&stack[0], &stack[1], (EDIT_UNDO_DEPTH - 1) * sizeof(EditSnapshot));
+        (*depth)--;
+    }
+    stack[(*depth)++] = *s;
+}
+
+static void ClearSnapshots(EditSnapshot *stack, uint32_t *depth) {
+    while (*depth > 0) free(stack[--(*depth)].regions);
+}
+
+// Takes ownership of the snapshot's regions.
+static void RestoreSnapshot(EditList *e, const EditSnapshot *s) {
+    free(e->regions);
+    e->regions = s->regions;
+    e->count = s->count;
+    e->capacity = s->count ? s->count : 1;
+    Renumber(e);
+}
+
+// Clamps the range, records the undo step and splits regions so that
+// [*first, *end) covers the range exactly. Returns 1 to go ahead with the
+// edit, 0 for an empty range and -1 on error.
+static int BeginEdit(EditList *e, uint64_t *start, uint64_t *frames, uint32_t *first, uint32_t *end) {
+    EditSnapshot before;
+
+    if (*start >= e->frames || *frames == 0) return 0;
+    if (*frames > e->frames - *start) *frames = e->frames - *start;
+
+    if (TakeSnapshot(e, &before) != 0) return -1;
+    if (SplitAt(e, *start, first) != 0 || SplitAt(e, *start + *frames, end) != 0) {
+        free(before.regions);
+        return -1;
+    }
+    // The second split inserts after first, so first still holds
+    PushSnapshot(e->undo, &e->undoCount, &before);
+    ClearSnapshots(e->redo, &e->redoCount);
+    return 1;
+}
+
+int EditListOpen(EditList *e, const TakeSlice *source, const WavFormat *format) {
+    SampleFormat inSamples;
+    SampleFormat outSamples;
+
+    memset(e, 0, sizeof(*e));
+    if (SampleFormatFromWav(format, &inSamples) != 0) {
+        fprintf(stderr, "No edit converter for %u-bit input (format 0x%04x)\n",
+                format->bitsPerSample, format->formatTag);
+        return -1;
+    }
+    outSamples = inSamples;
+    outSamples.type = SAMPLE_F32;
+    SampleConverterInit(&e->toFloat, &inSamples, &outSamples);
+
+    e->source = *source;
+    e->channels = format->channels;
+    if (Reserve(e, 1) != 0) return -1;
+    if (source->frameCount > 0) {
+        memset(&e->regions[0], 0, sizeof(EditRegion));
+        e->regions[0].frames = source->frameCount;
+        e->regions[0].gain = 1.0f;
+        e->count = 1;
+    }
+    Renumber(e);
+    return 0;
+}
+
+void EditListClose(EditList *e) {
+    ClearSnapshots(e->undo, &e->undoCount);
+    ClearSnapshots(e->redo, &e->redoCount);
+    free(e->regions);
+    e->regions = NULL;
+    e->count = 0;
+    e->capacity = 0;
+    e->frames = 0;
+}
+
+uint64_t EditListFrames(const EditList *e) {
+    return e->frames;
+}
+
+int EditListIsIdentity(const EditList *e) {
+    if (e->count == 0) return e->source.frameCount == 0;
+
+    const EditRegion *r = &e->regions[0];
+    return e->count == 1 && r->sourceStart == 0 && r->frames == e->source.frameCount &&
+           r->gain == 1.0f && r->fadeIn == 0 && r->fadeOut == 0;
+}
+
+int EditListTrim(EditList *e, uint64_t start, uint64_t frames) {
+    uint32_t first, end;
+    int result = BeginEdit(e, &start, &frames, &first, &end);
+    if (result <= 0) return result;
+
+    memmove(&e->regions[0], &e->regions[first], (end - first) * sizeof(EditRegion));
+    e->count = end - first;
+    Renumber(e);
+    return 0;
+}
+
+int EditListCut(EditList *e, uint64_t start, uint64_t frames) {
+    uint32_t first, end;
+    int result = BeginEdit(e, &start, &frames, &first, &end);
+    if (result <= 0) return result;
+
+    memmove(&e->regions[first], &e->regions[end], (e->count - end) * sizeof(EditRegion));
+    e->count -= end - first;
+    Renumber(e);
+    return 0;
+}
+
+int EditListGain(EditList *e, uint64_t start, uint64_t frames, double gainDb) {
+    uint32_t first, end;
+    int result = BeginEdit(e, &start, &frames, &first, &end);
+    if (result <= 0) return result;
+
+    float gain = (float)pow(10.0, gainDb / 20.0);
+    for (uint32_t i = first; i < end; ++i) e->regions[i].gain *= gain;
+    return 0;
+}
+
+int EditListFadeIn(EditList *e, uint64_t start, uint64_t frames) {
+    uint32_t first, end;
+    int result = BeginEdit(e, &start, &frames, &first, &end);
+    if (result <= 0) return result;
+
+    for (uint32_t i = first; i < end; ++i) {
+        e->regions[i].fadeIn = frames;
+        e->regions[i].fadeInOffset = e->regions[i].position - start;
+    }
+    return 0;
+}
+
+int EditListFadeOut(EditList *e, uint64_t start, uint64_t frames) {
+    uint32_t first, end;
+    int result = BeginEdit(e, &start, &frames, &first, &end);
+    if (result <= 0) return result;
+
+    for (uint32_t i = first; i < end; ++i) {
+        EditRegion *r = &e->regions[i];
+        r->fadeOut = frames;
+        r->fadeOutOffset = start + frames - (r->position + r->frames);
+    }
+    return 0;
+}
+
+int EditListUndo(EditList *e) {
+    EditSnapshot current;
+
+    if (e->undoCount == 0) return -1;
+    if (TakeSnapshot(e, &current) != 0) return -1;
+    PushSnapshot(e->redo, &e->redoCount, &current);
+    RestoreSnapshot(e, &e->undo[--e->undoCount]);
+    return 0;
+}
+
+int EditListRedo(EditList *e) {
+    EditSnapshot current;
+
+    if (e->redoCount == 0) return -1;
+    if (TakeSnapshot(e, &current) != 0) return -1;
+    PushSnapshot(e->undo, &e->undoCount, &current);
+    RestoreSnapshot(e, &e->redo[--e->redoCount]);
+    return 0;
+}
+
+// Applies the region's gain and fades to frameCount rendered frames from
+// frame offset of the region on. Fade levels sit at frame centres, so a fade
+// of n frames never reaches exactly 0 or 1.
+static void ApplyEnvelope(const EditRegion *r, uint16_t channels, uint64_t offset,
+                          uint32_t frameCount, float *frames) {
+    if (r->fadeIn == 0 && r->fadeOut == 0) {
+        if (r->gain == 1.0f) return;
+        for (size_t i = 0; i < (size_t)frameCount * channels; ++i) frames[i] *= r->gain;
+        return;
+    }
+
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        uint64_t p = offset + i;
+        float fadeIn = 1.0f;
+        float fadeOut = 1.0f;
+
+        if (r->fadeIn) fadeIn = (float)((r->fadeInOffset + p + 0.5) / r->fadeIn);
+        if (r->fadeOut) fadeOut = (float)((r->fadeOutOffset + (r->frames - p) - 0.5) / r->fadeOut);
+
+        float gain = r->gain * fadeIn * fadeOut;
+        for (uint16_t ch = 0; ch < channels; ++ch) frames[(size_t)i * channels + ch] *= gain;
+    }
+}
+
+uint32_t EditListRender(const EditList *e, uint64_t frame, uint32_t frameCount, float *out) {
+    uint32_t rendered = 0;
+
+    if (frame >= e->frames) return 0;
+
+    for (uint32_t i = FindRegion(e, frame); i < e->count && rendered < frameCount; ++i) {
+        const EditRegion *r = &e->regions[i];
+        uint64_t offset = frame + rendered - r->position;
+        uint64_t left = r->frames - offset;
+        uint32_t count = frameCount - rendered < left ? frameCount - rendered : (uint32_t)left;
+        float *dst = out + (size_t)rendered * e->channels;
+        TakeSlice run = TakeSliceSub(&e->source, r->sourceStart + offset, count);
+        TakeIterator it;
+        const void *src;
+        uint32_t n;
+
+        TakeIteratorInit(&it, &run);
+        while ((n = TakeIteratorNext(&it, &src, UINT32_MAX)) != 0) {
+            SampleConverterRun(&e->toFloat, dst, src, n, NULL);
+            dst += (size_t)n * e->channels;
+        }
+        ApplyEnvelope(r, e->channels, offset, count, out + (size_t)rendered * e->channels);
+        rendered += count;
+    }
+    return rendered;
+}
@@ -0,0 +1,80 @@
+// edit_list.h
+#ifndef EDIT_LIST_H
+#define EDIT_LIST_H
+
+#include <stdint.h>
+#include "sample_convert.h"
+#include "take_storage.h"
+#include "wav_writer.h"
+
+#define EDIT_UNDO_DEPTH 64
+
+// A run of take frames played in order with a gain. Fades are linear ramps
+// that may span several regions: each region remembers the length of the fade
+// it belongs to and where it sits in it, so splitting a region never changes
+// what it sounds like.
+typedef struct {
+    uint64_t sourceStart;         // Take frame the region starts at
+    uint64_t frames;
+    uint64_t position;            // Edit frame it starts at, kept up to date by every edit
+    float gain;                   // Linear
+    uint64_t fadeIn;              // Length of the fade-in it is part of; 0 for none
+    uint64_t fadeInOffset;        // Frames of that fade before the region starts
+    uint64_t fadeOut;
+    uint64_t fadeOutOffset;       // Frames of that fade after the region ends
+} EditRegion;
+
+typedef struct {
+    EditRegion *regions;
+    uint32_t count;
+} EditSnapshot;
+
+// Non-destructive edit of a take: an ordered list of source regions that is
+// rendered on demand, block by block, by playback and export. Edits only
+// rewrite the region list, so trimming a take of any length takes as long as
+// trimming a short one and no audio is copied. Every edit can be undone and
+// redone; the oldest steps are dropped past EDIT_UNDO_DEPTH.
+//
+// Edit positions and lengths are in frames of the edit as it stands, and are
+// clamped to it; an empty range changes nothing. The take must not change
+// while the list refers to it, and nothing may render while it is edited.
+typedef struct {
+    TakeSlice source;
+    uint16_t channels;
+    SampleConverter toFloat;
+    EditRegion *regions;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t frames;
+    EditSnapshot undo[EDIT_UNDO_DEPTH];
+    uint32_t undoCount;
+    EditSnapshot redo[EDIT_UNDO_DEPTH];
+    uint32_t redoCount;
+} EditList;
+
+// Starts with the whole slice at unity gain. Accepts any format with a sample converter.
+int EditListOpen(EditList *e, const TakeSlice *source, const WavFormat *format);
+void EditListClose(EditList *e);
+uint64_t EditListFrames(const EditList *e);
+// 1 if the list renders the source unchanged.
+int EditListIsIdentity(const EditList *e);
+
+// Keeps only the given range.
+int EditListTrim(EditList *e, uint64_t start, uint64_t frames);
+// Removes the range and closes the gap.
+int EditListCut(EditList *e, uint64_t start, uint64_t frames);
+int EditListGain(EditList *e, uint64_t start, uint64_t frames, double gainDb);
+// The fade rises from silence over the range, or falls to it. A new fade
+// replaces any fade of the same direction where the two overlap.
+int EditListFadeIn(EditList *e, uint64_t start, uint64_t frames);
+int EditListFadeOut(EditList *e, uint64_t start, uint64_t frames);
+
+// Return -1 when there is nothing to undo or redo.
+int EditListUndo(EditList *e);
+int EditListRedo(EditList *e);
+
+// Renders frames of the edit from frame on as interleaved float. Returns the
+// number of frames rendered, which is short only at the end of the edit.
+uint32_t EditListRender(const EditList *e, uint64_t frame, uint32_t frameCount, float *out);
+
+#endif // EDIT_LIST_H
@@ -0,0 +1,109 @@
+// file_source.c
+#include <stdlib.h>
+
+#include "capture_source.h"
+#include "wav_reader.h"
+
+typedef struct {
+    CaptureSource base;
+    FileSourceConfig config;
+    CapturePacer pacer;
+    WavReader reader;
+    uint8_t *packetBuffer;
+    int running;
+} FileCaptureSource;
+
+static int FileStart(CaptureSource *src) {
+    FileCaptureSource *f = (FileCaptureSource *)src;
+
+    if (WavReaderSeek(&f->reader, 0) != 0) return -1;
+    CapturePacerStart(&f->pacer);
+    src->endOfStream = 0;
+    f->running = 1;
+    return 0;
+}
+
+static int FileWait(CaptureSource *src, uint32_t timeoutMs) {
+    FileCaptureSource *f = (FileCaptureSource *)src;
+    return CapturePacerWait(&f->pacer, timeoutMs);
+}
+
+static int FileReadPacket(CaptureSource *src, CapturePacket *packet) {
+    FileCaptureSource *f = (FileCaptureSource *)src;
+    uint32_t frames;
+
+    if (!f->running || src->endOfStream || !CapturePacerReady(&f->pacer)) return 0;
+
+    frames = WavReaderRead(&f->reader, f->packetBuffer, f->config.packetFrames);
+    if (frames == 0 && f->config.loop && f->reader.totalFrames > 0) {
+        if (WavReaderSeek(&f->reader, 0) != 0) return -1;
+        frames = WavReaderRead(&f->reader, f->packetBuffer, f->config.packetFrames);
+    }
+    if (frames == 0) {
+        src->endOfStream = 1;
+        return 0;
+    }
+
+    packet->data = f->packetBuffer;
+    packet->frames = frames;
+    packet->flags = 0;
+    packet->timestampNs = CapturePacerTimestamp(&f->pacer);
+    return 1;
+}
+
+static int FileReleasePacket(CaptureSource *src, CapturePacket *packet) {
+    FileCaptureSource *f = (FileCaptureSource *)src;
+
+    CapturePacerAdvance(&f->pacer, packet->frames);
+    if (!f->config.loop && f->reader.framePos >= f->reader.totalFrames) src->endOfStream = 1;
+    return 0;
+}
+
+static void FileStop(CaptureSource *src) {
+    ((FileCaptureSource *)src)->running = 0;
+}
+
+static void FileDestroy(CaptureSource *src) {
+    FileCaptureSource *f = (FileCaptureSource *)src;
+
+    WavReaderClose(&f->reader);
+    free(f->packetBuffer);
+    free(f);
+}
+
+static const CaptureSourceVtbl FileVtbl = {
+    "file",
+    FileStart,
+    FileWait,
+    FileReadPacket,
+    FileReleasePacket,
+    FileStop,
+    FileDestroy
+};
+
+int CreateFileCaptureSource(const FileSourceConfig *config, CaptureMode mode, CaptureSource **out) {
+    FileCaptureSource *f;
+
+    if (!config->path || !config->packetFrames) return -1;
+
+    f = (FileCaptureSource *)calloc(1, sizeof(*f));
+    if (!f) return -1;
+
+    if (WavReaderOpen(&f->reader, config->path) != 0) {
+        free(f);
+        return -1;
+    }
+
+    CaptureSourceInitBase(&f->base, &FileVtbl, &f->reader.format, mode);
+    CapturePacerInit(&f->pacer, mode, f->reader.format.sampleRate, config->packetFrames);
+    f->config = *config;
+    f->packetBuffer = (uint8_t *)malloc((size_t)config->packetFrames * f->reader.blockAlign);
+    if (!f->packetBuffer) {
+        WavReaderClose(&f->reader);
+        free(f);
+        return -1;
+    }
+
+    *out = &f->base;
+    return 0;
+}
@@ -0,0 +1,654 @@
+// flac_encoder.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "flac_encoder.h"
+#include "instrument.h"
+
+#define STREAMINFO_OFFSET 8       // After "fLaC" and the metadata block header
+#define STREAMINFO_LENGTH 34
+#define STREAMINFO_MD5_OFFSET 18
+#define FRAME_HEADER_MAX 16
+#define FRAME_SYNC 0xFFF8         // Sync code with the fixed-blocksize strategy bit clear
+#define SUBFRAME_CONSTANT 0x00
+#define SUBFRAME_VERBATIM 0x01
+#define SUBFRAME_FIXED 0x08
+#define MAX_FIXED_ORDER 4
+#define RICE_PARAM_MAX 14         // 4-bit parameters; 15 is the escape code
+#define RICE2_PARAM_MAX 30        // 5-bit parameters; 31 is the escape code
+#define BLOCK_SIZE_CODE_16BIT 7
+
+typedef enum {
+    CHANNELS_LEFT_SIDE = 8,
+    CHANNELS_SIDE_RIGHT = 9,
+    CHANNELS_MID_SIDE = 10
+} ChannelAssignment;
+
+typedef struct {
+    uint8_t *buf;
+    size_t pos;
+    uint64_t acc;
+    uint32_t bits;                // Bits in acc not yet stored
+} BitWriter;
+
+typedef struct {
+    uint32_t partitionOrder;
+    uint32_t paramBits;
+    uint32_t params[1 << FLAC_MAX_PARTITION_ORDER];
+    uint64_t bits;
+} RicePlan;
+
+static uint8_t Crc8Table[256];
+static uint16_t Crc16Table[256];
+
+// Filled before any worker starts; every caller writes the same values
+static void InitCrcTables(void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c8 = i;
+        uint32_t c16 = i << 8;
+        for (int b = 0; b < 8; ++b) {
+            c8 = (c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1;
+            c16 = (c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1;
+        }
+        Crc8Table[i] = (uint8_t)c8;
+        Crc16Table[i] = (uint16_t)c16;
+    }
+}
+
+static uint8_t Crc8(const uint8_t *data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; ++i) crc = Crc8Table[crc ^ data[i]];
+    return crc;
+}
+
+static uint16_t Crc16(const uint8_t *data, size_t length) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; ++i) crc = (uint16_t)((crc << 8) ^ Crc16Table[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+// n <= 32; value is masked to n bits
+static inline void PutBits(BitWriter *w, uint32_t value, uint32_t n) {
+    uint64_t mask = ((uint64_t)1 << n) - 1;
+
+    w->acc = (w->acc << n) | (value & mask);
+    w->bits += n;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        w->buf[w->pos++] = (uint8_t)(w->acc >> w->bits);
+    }
+}
+
+static inline void PutRice(BitWriter *w, uint32_t u, uint32_t k) {
+    uint32_t q = u >> k;
+    uint32_t low = u & ((1u << k) - 1);
+
+    if (q + 1 + k <= 32) {
+        PutBits(w, (1u << k) | low, q + 1 + k);
+        return;
+    }
+    while (q > 31) {
+        PutBits(w, 0, 31);
+        q -= 31;
+    }
+    PutBits(w, 1, q + 1);
+    if (k) PutBits(w, low, k);
+}
+
+static void AlignToByte(BitWriter *w) {
+    if (w->bits) PutBits(w, 0, 8 - w->bits);
+}
+
+// Frame numbers use the extended UTF-8 coding, up to 36 bits in 7 bytes
+static void PutUtf8(BitWriter *w, uint64_t v) {
+    uint32_t bytes = 2;
+    int shift;
+
+    if (v < 0x80) {
+        PutBits(w, (uint32_t)v, 8);
+        return;
+    }
+    while (bytes < 7 && v >= ((uint64_t)1 << (5 * bytes + 1))) bytes++;
+
+    shift = 6 * (int)(bytes - 1);
+    PutBits(w, ((0xFF00u >> bytes) & 0xFF) | (uint32_t)(v >> shift), 8);
+    for (shift -= 6; shift >= 0; shift -= 6) {
+        PutBits(w, 0x80 | (uint32_t)((v >> shift) & 0x3F), 8);
+    }
+}
+
+static inline uint32_t Zigzag(int32_t r) {
+    return ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+}
+
+static uint32_t BlockSizeCode(uint32_t n) {
+    for (uint32_t k = 0; k < 8; ++k) {
+        if (n == (256u << k)) return 8 + k;
+    }
+    return BLOCK_SIZE_CODE_16BIT;
+}
+
+static uint32_t SampleRateCode(uint32_t rate) {
+    switch (rate) {
+    case 88200: return 1;
+    case 176400: return 2;
+    case 192000: return 3;
+    case 8000: return 4;
+    case 16000: return 5;
+    case 22050: return 6;
+    case 24000: return 7;
+    case 32000: return 8;
+    case 44100: return 9;
+    case 48000: return 10;
+    case 96000: return 11;
+    default: return 0;        // Taken from STREAMINFO
+    }
+}
+
+static uint32_t SampleSizeCode(uint32_t bits) {
+    switch (bits) {
+    case 8: return 1;
+    case 12: return 2;
+    case 16: return 4;
+    case 20: return 5;
+    case 24: return 6;
+    default: return 0;
+    }
+}
+
+// Sum of absolute residuals for each fixed predictor; returns the cheapest order
+static uint32_t BestFixedOrder(const int32_t *x, uint32_t n, uint64_t *bestSum) {
+    uint64_t sum[MAX_FIXED_ORDER + 1] = {0};
+    uint32_t best = 0;
+
+    for (uint32_t i = MAX_FIXED_ORDER; i < n; ++i) {
+        int32_t e0 = x[i];
+        int32_t e1 = e0 - x[i - 1];
+        int32_t e2 = e1 - (x[i - 1] - x[i - 2]);
+        int32_t e3 = e2 - (x[i - 1] - 2 * x[i - 2] + x[i - 3]);
+        int32_t e4 = e3 - (x[i - 1] - 3 * x[i - 2] + 3 * x[i - 3] - x[i - 4]);
+        sum[0] += (uint32_t)(e0 < 0 ? -e0 : e0);
+        sum[1] += (uint32_t)(e1 < 0 ? -e1 : e1);
+        sum[2] += (uint32_t)(e2 < 0 ? -e2 : e2);
+        sum[3] += (uint32_t)(e3 < 0 ? -e3 : e3);
+        sum[4] += (uint32_t)(e4 < 0 ? -e4 : e4);
+    }
+
+    for (uint32_t o = 1; o <= MAX_FIXED_ORDER; ++o) {
+        if (sum[o] < sum[best]) best = o;
+    }
+    if (bestSum) *bestSum = sum[best];
+    return best;
+}
+
+static void FixedResidual(const int32_t *x, uint32_t n, uint32_t order, int32_t *res) {
+    uint32_t i = order;
+
+    switch (order) {
+    case 0:
+        for (; i < n; ++i) res[i] = x[i];
+        break;
+    case 1:
+        for (; i < n; ++i) res[i] = x[i] - x[i - 1];
+        break;
+    case 2:
+        for (; i < n; ++i) res[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+        break;
+    case 3:
+        for (; i < n; ++i) res[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        break;
+    default:
+        for (; i < n; ++i) res[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        break;
+    }
+}
+
+static uint32_t RiceParam(uint64_t sum, uint32_t count) {
+    uint32_t k = 0;
+    while (k < RICE2_PARAM_MAX && ((uint64_t)count << (k + 1)) < sum) k++;
+    return k;
+}
+
+// Chooses the partition order and per-partition parameters with the smallest
+// estimated size. Partition sums are taken at the finest order and merged pairwise.
+static void PlanRice(const int32_t *residual, uint32_t n, uint32_t order, RicePlan *plan) {
+    uint64_t sums[1 << FLAC_MAX_PARTITION_ORDER];
+    uint32_t maxOrder = 0;
+
+    while (maxOrder < FLAC_MAX_PARTITION_ORDER && n % (2u << maxOrder) == 0 &&
+           (n >> (maxOrder + 1)) > order) {
+        maxOrder++;
+    }
+
+    uint32_t size = n >> maxOrder;
+    for (uint32_t p = 0; p < (1u << maxOrder); ++p) {
+        uint64_t sum = 0;
+        for (uint32_t i = p == 0 ? order : p * size; i < (p + 1) * size; ++i) sum += Zigzag(residual[i]);
+        sums[p] = sum;
+    }
+
+    plan->bits = UINT64_MAX;
+    for (int po = (int)maxOrder; po >= 0; --po) {
+        uint32_t count = 1u << po;
+        uint32_t params[1 << FLAC_MAX_PARTITION_ORDER];
+        uint32_t maxParam = 0;
+        uint64_t bits = 0;
+
+        size = n >> po;
+        for (uint32_t p = 0; p < count; ++p) {
+            uint32_t samples = size - (p == 0 ? order : 0);
+            uint32_t k = RiceParam(sums[p], samples);
+            params[p] = k;
+            if (k > maxParam) maxParam = k;
+            bits += (uint64_t)samples * (k + 1) + (sums[p] >> k);
+        }
+
+        uint32_t paramBits = maxParam > RICE_PARAM_MAX ? 5 : 4;
+        bits += 2 + 4 + (uint64_t)count * paramBits;
+        if (bits < plan->bits) {
+            plan->bits = bits;
+            plan->partitionOrder = (uint32_t)po;
+            plan->paramBits = paramBits;
+            memcpy(plan->params, params, count * sizeof(params[0]));
+        }
+
+        for (uint32_t p = 0; p < count / 2; ++p) sums[p] = sums[2 * p] + sums[2 * p + 1];
+    }
+}
+
+static void PutResidual(BitWriter *w, const int32_t *residual, uint32_t n, uint32_t order, const RicePlan *plan) {
+    uint32_t count = 1u << plan->partitionOrder;
+    uint32_t size = n >> plan->partitionOrder;
+
+    PutBits(w, plan->paramBits == 5 ? 1 : 0, 2);
+    PutBits(w, plan->partitionOrder, 4);
+    for (uint32_t p = 0; p < count; ++p) {
+        uint32_t k = plan->params[p];
+        PutBits(w, k, plan->paramBits);
+        for (uint32_t i = p == 0 ? order : p * size; i < (p + 1) * size; ++i) PutRice(w, Zigzag(residual[i]), k);
+    }
+}
+
+// Constant, fixed-predictor or verbatim, whichever is smallest
+static void PutSubframe(BitWriter *w, const int32_t *x, uint32_t n, uint32_t bps, int32_t *residual) {
+    uint32_t i;
+
+    for (i = 1; i < n && x[i] == x[0]; ++i) {
+    }
+    if (i == n) {
+        PutBits(w, SUBFRAME_CONSTANT << 1, 8);
+        PutBits(w, (uint32_t)x[0], bps);
+        return;
+    }
+
+    if (n > MAX_FIXED_ORDER) {
+        uint32_t order = BestFixedOrder(x, n, NULL);
+        RicePlan plan;
+
+        FixedResidual(x, n, order, residual);
+        PlanRice(residual, n, order, &plan);
+
+        if ((uint64_t)order * bps + plan.bits < (uint64_t)n * bps) {
+            PutBits(w, (SUBFRAME_FIXED | order) << 1, 8);
+            for (i = 0; i < order; ++i) PutBits(w, (uint32_t)x[i], bps);
+            PutResidual(w, residual, n, order, &plan);
+            return;
+        }
+    }
+
+    PutBits(w, SUBFRAME_VERBATIM << 1, 8);
+    for (i = 0; i < n; ++i) PutBits(w, (uint32_t)x[i], bps);
+}
+
+static size_t EncodeFrame(const FlacEncoder *e, FlacJob *job) {
+    BitWriter w = { job->out, 0, 0, 0 };
+    uint32_t n = job->frames;
+    uint32_t channels = e->format.channels;
+    uint32_t bps = e->format.bitsPerSample;
+    uint32_t blockSizeCode = BlockSizeCode(n);
+    uint32_t assignment = channels - 1;
+    int32_t *mid = job->scratch;
+    int32_t *side = mid + FLAC_BLOCK_SIZE;
+    int32_t *residual = side + FLAC_BLOCK_SIZE;
+    const int32_t *sub[FLAC_MAX_CHANNELS];
+    uint32_t subBps[FLAC_MAX_CHANNELS];
+
+    for (uint32_t c = 0; c < channels; ++c) {
+        sub[c] = job->samples + (size_t)c * FLAC_BLOCK_SIZE;
+        subBps[c] = bps;
+    }
+
+    // Stereo: code whichever pair of left, right, mid and side predicts best
+    if (channels == 2) {
+        const int32_t *left = sub[0];
+        const int32_t *right = sub[1];
+        uint64_t l, r, m, s;
+
+        for (uint32_t i = 0; i < n; ++i) {
+            mid[i] = (left[i] + right[i]) >> 1;
+            side[i] = left[i] - right[i];
+        }
+        BestFixedOrder(left, n, &l);
+        BestFixedOrder(right, n, &r);
+        BestFixedOrder(mid, n, &m);
+        BestFixedOrder(side, n, &s);
+
+        uint64_t best = l + r;
+        if (l + s < best) {
+            best = l + s;
+            assignment = CHANNELS_LEFT_SIDE;
+        }
+        if (s + r < best) {
+            best = s + r;
+            assignment = CHANNELS_SIDE_RIGHT;
+        }
+        if (m + s < best) assignment = CHANNELS_MID_SIDE;
+
+        switch (assignment) {
+        case CHANNELS_LEFT_SIDE:
+            sub[1] = side;
+            subBps[1] = bps + 1;
+            break;
+        case CHANNELS_SIDE_RIGHT:
+            sub[0] = side;
+            subBps[0] = bps + 1;
+            break;
+        case CHANNELS_MID_SIDE:
+            sub[0] = mid;
+            sub[1] = side;
+            subBps[1] = bps + 1;
+            break;
+        }
+    }
+
+    PutBits(&w, FRAME_SYNC, 16);
+    PutBits(&w, blockSizeCode, 4);
+    PutBits(&w, SampleRateCode(e->format.sampleRate), 4);
+    PutBits(&w, assignment, 4);
+    PutBits(&w, SampleSizeCode(bps), 3);
+    PutBits(&w, 0, 1);
+    PutUtf8(&w, job->frameNumber);
+    if (blockSizeCode == BLOCK_SIZE_CODE_16BIT) PutBits(&w, n - 1, 16);
+    PutBits(&w, Crc8(job->out, w.pos), 8);
+
+    for (uint32_t c = 0; c < channels; ++c) PutSubframe(&w, sub[c], n, subBps[c], residual);
+
+    AlignToByte(&w);
+    PutBits(&w, Crc16(job->out, w.pos), 16);
+    return w.pos;
+}
+
+static void EncodeJob(const FlacEncoder *e, FlacJob *job) {
+    uint64_t startNs = PlatformNowNs();
+    job->outBytes = EncodeFrame(e, job);
+    job->encodeNs = PlatformNowNs() - startNs;
+    INSTR_RECORD(INSTR_FLAC_ENCODE_NS, job->encodeNs);
+}
+
+static int WorkerMain(void *arg) {
+    FlacEncoder *e = (FlacEncoder *)arg;
+
+    while (!atomic_load(&e->stopWorkers)) {
+        int found = 0;
+
+        for (uint32_t i = 0; i < e->jobCount; ++i) {
+            FlacJob *job = &e->jobs[i];
+            int expected = FLAC_JOB_READY;
+
+            if (atomic_compare_exchange_strong(&job->state, &expected, FLAC_JOB_BUSY)) {
+                EncodeJob(e, job);
+                atomic_store(&job->state, FLAC_JOB_DONE);
+                PlatformEventSignal(&e->doneEvent);
+                found = 1;
+            }
+        }
+        if (!found) PlatformEventWait(&e->workEvent, FLAC_WAIT_MS);
+    }
+    return 0;
+}
+
+static int WriteBytes(FlacEncoder *e, const void *bytes, size_t length) {
+    if (e->direct) return DiskWriterAppend(&e->disk, bytes, length);
+    return fwrite(bytes, 1, length, e->file) == length ? 0 : -1;
+}
+
+// Writes the oldest outstanding frame once it is encoded; with wait set, waits for it.
+// Returns 1 if a frame was written, 0 if none was ready or outstanding, -1 on error.
+static int WriteOldest(FlacEncoder *e, int wait) {
+    FlacJob *job = &e->jobs[e->writeJob];
+    int state;
+
+    while ((state = atomic_load(&job->state)) != FLAC_JOB_DONE) {
+        if (state == FLAC_JOB_IDLE || !wait) return 0;
+        PlatformEventWait(&e->doneEvent, FLAC_WAIT_MS);
+    }
+
+    if (!e->error && WriteBytes(e, job->out, job->outBytes) != 0) e->error = 1;
+    e->bytesWritten += job->outBytes;
+    e->encodeNs += job->encodeNs;
+    if (job->outBytes < e->minFrameBytes) e->minFrameBytes = (uint32_t)job->outBytes;
+    if (job->outBytes > e->maxFrameBytes) e->maxFrameBytes = (uint32_t)job->outBytes;
+
+    job->frames = 0;
+    atomic_store(&job->state, FLAC_JOB_IDLE);
+    e->writeJob = (e->writeJob + 1) % e->jobCount;
+    return e->error ? -1 : 1;
+}
+
+static void SubmitJob(FlacEncoder *e) {
+    FlacJob *job = &e->jobs[e->fillJob];
+
+    job->frameNumber = e->nextFrameNumber++;
+    if (e->threadCount == 0) {
+        EncodeJob(e, job);
+        atomic_store(&job->state, FLAC_JOB_DONE);
+    } else {
+        atomic_store(&job->state, FLAC_JOB_READY);
+        PlatformEventSignal(&e->workEvent);
+    }
+    e->fillJob = (e->fillJob + 1) % e->jobCount;
+}
+
+static void Deinterleave(const FlacEncoder *e, FlacJob *job, const uint8_t *src, uint32_t frameCount) {
+    uint32_t channels = e->format.channels;
+
+    for (uint32_t c = 0; c < channels; ++c) {
+        int32_t *dst = job->samples + (size_t)c * FLAC_BLOCK_SIZE + job->frames;
+
+        if (e->format.bitsPerSample == 16) {
+            const uint8_t *p = src + c * 2;
+            for (uint32_t i = 0; i < frameCount; ++i, p += e->blockAlign) {
+                dst[i] = (int16_t)(p[0] | (p[1] << 8));
+            }
+        } else {
+            const uint8_t *p = src + c * 3;
+            for (uint32_t i = 0; i < frameCount; ++i, p += e->blockAlign) {
+                dst[i] = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+            }
+        }
+    }
+}
+
+// STREAMINFO; frame sizes and the sample count are filled in by Finalize, MD5 is left unset
+static void BuildStreamInfo(const FlacEncoder *e, uint8_t *p) {
+    BitWriter w = { p, 0, 0, 0 };
+    uint32_t minFrame = e->minFrameBytes <= e->maxFrameBytes ? e->minFrameBytes : 0;
+
+    PutBits(&w, FLAC_BLOCK_SIZE, 16);
+    PutBits(&w, FLAC_BLOCK_SIZE, 16);
+    PutBits(&w, minFrame, 24);
+    PutBits(&w, e->maxFrameBytes, 24);
+    PutBits(&w, e->format.sampleRate, 20);
+    PutBits(&w, e->format.channels - 1u, 3);
+    PutBits(&w, e->format.bitsPerSample - 1u, 5);
+    PutBits(&w, (uint32_t)(e->totalFrames >> 32), 4);
+    PutBits(&w, (uint32_t)e->totalFrames, 32);
+    memset(p + STREAMINFO_MD5_OFFSET, 0, STREAMINFO_LENGTH - STREAMINFO_MD5_OFFSET);
+}
+
+static void FreeJobs(FlacEncoder *e) {
+    for (uint32_t i = 0; i < FLAC_MAX_JOBS; ++i) {
+        free(e->jobs[i].samples);
+        free(e->jobs[i].scratch);
+        free(e->jobs[i].out);
+        e->jobs[i].samples = NULL;
+        e->jobs[i].scratch = NULL;
+        e->jobs[i].out = NULL;
+    }
+}
+
+static void StopWorkers(FlacEncoder *e) {
+    atomic_store(&e->stopWorkers, 1);
+    for (uint32_t i = 0; i < e->threadCount; ++i) PlatformEventSignal(&e->workEvent);
+    for (uint32_t i = 0; i < e->threadCount; ++i) PlatformThreadJoin(e->threads[i]);
+    e->threadCount = 0;
+    PlatformEventDestroy(&e->workEvent);
+    PlatformEventDestroy(&e->doneEvent);
+}
+
+static int OpenEncoder(FlacEncoder *e, const char *path, const WavFormat *format, uint32_t threads, int direct) {
+    uint8_t header[8 + STREAMINFO_LENGTH] = { 'f', 'L', 'a', 'C', 0x80, 0, 0, STREAMINFO_LENGTH };
+    uint32_t channels = format->channels;
+    size_t outBytes;
+
+    memset(e, 0, sizeof(*e));
+    if (format->formatTag != WAV_FORMAT_PCM || (format->bitsPerSample != 16 && format->bitsPerSample != 24) ||
+        channels == 0 || channels > FLAC_MAX_CHANNELS || format->sampleRate == 0 || format->sampleRate >= (1u << 20)) {
+        fprintf(stderr, "FLAC output needs 16- or 24-bit PCM with 1-%d channels\n", FLAC_MAX_CHANNELS);
+        return -1;
+    }
+
+    InitCrcTables();
+    e->format = *format;
+    e->blockAlign = (uint16_t)(channels * (format->bitsPerSample / 8));
+    e->minFrameBytes = UINT32_MAX;
+    if (threads > FLAC_MAX_THREADS) threads = FLAC_MAX_THREADS;
+    e->jobCount = (threads ? threads : 1) * FLAC_JOBS_PER_THREAD;
+
+    // Verbatim subframes with side-channel samples bound the frame size
+    outBytes = FRAME_HEADER_MAX + (size_t)channels * (FLAC_BLOCK_SIZE * 4 + 2) + 2;
+    for (uint32_t i = 0; i < e->jobCount; ++i) {
+        FlacJob *job = &e->jobs[i];
+        job->samples = (int32_t *)malloc((size_t)channels * FLAC_BLOCK_SIZE * sizeof(int32_t));
+        job->scratch = (int32_t *)malloc(3 * FLAC_BLOCK_SIZE * sizeof(int32_t));
+        job->out = (uint8_t *)malloc(outBytes);
+        atomic_init(&job->state, FLAC_JOB_IDLE);
+        if (!job->samples || !job->scratch || !job->out) {
+            FreeJobs(e);
+            return -1;
+        }
+    }
+
+    if (direct) {
+        e->direct = DiskWriterOpen(&e->disk, path) == 0;
+    } else {
+        e->file = fopen(path, "wb");
+    }
+    if (!e->file && !e->direct) {
+        FreeJobs(e);
+        return -1;
+    }
+
+    BuildStreamInfo(e, header + STREAMINFO_OFFSET);
+    if (WriteBytes(e, header, sizeof(header)) != 0) {
+        if (e->direct) {
+            DiskWriterClose(&e->disk);
+        } else {
+            fclose(e->file);
+        }
+        e->file = NULL;
+        e->direct = 0;
+        FreeJobs(e);
+        return -1;
+    }
+    e->bytesWritten = sizeof(header);
+
+    atomic_init(&e->stopWorkers, 0);
+    if (threads && PlatformEventInit(&e->workEvent) != 0) threads = 0;
+    if (threads && PlatformEventInit(&e->doneEvent) != 0) {
+        PlatformEventDestroy(&e->workEvent);
+        threads = 0;
+    }
+    for (uint32_t i = 0; i < threads; ++i) {
+        if (PlatformThreadCreate(&e->threads[i], WorkerMain, e) != 0) break;
+        e->threadCount++;
+    }
+    // Without a single worker, blocks are encoded inline
+    if (threads && e->threadCount == 0) {
+        PlatformEventDestroy(&e->workEvent);
+        PlatformEventDestroy(&e->doneEvent);
+    }
+    return 0;
+}
+
+int FlacEncoderAppend(FlacEncoder *e, const void *frames, uint32_t frameCount) {
+    const uint8_t *src = (const uint8_t *)frames;
+
+    if (e->error) return -1;
+
+    while (frameCount > 0) {
+        FlacJob *job = &e->jobs[e->fillJob];
+
+        // A slot is refilled only after its previous frame has been written
+        while (atomic_load(&job->state) != FLAC_JOB_IDLE) {
+            if (WriteOldest(e, 1) < 0) return -1;
+        }
+
+        uint32_t n = FLAC_BLOCK_SIZE - job->frames;
+        if (n > frameCount) n = frameCount;
+
+        Deinterleave(e, job, src, n);
+        job->frames += n;
+        e->totalFrames += n;
+        src += (size_t)n * e->blockAlign;
+        frameCount -= n;
+
+        if (job->frames == FLAC_BLOCK_SIZE) {
+            SubmitJob(e);
+            int result;
+            while ((result = WriteOldest(e, 0)) > 0) {
+            }
+            if (result < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+int FlacEncoderOpen(FlacEncoder *e, const char *path, const WavFormat *format, uint32_t threads) {
+    return OpenEncoder(e, path, format, threads, 0);
+}
+
+int FlacEncoderOpenDirect(FlacEncoder *e, const char *path, const WavFormat *format, uint32_t threads) {
+    return OpenEncoder(e, path, format, threads, 1);
+}
+
+int FlacEncoderFinalize(FlacEncoder *e) {
+    uint8_t streamInfo[STREAMINFO_LENGTH];
+    int result;
+
+    if (!e->file && !e->direct) return -1;
+
+    if (e->jobs[e->fillJob].frames > 0) SubmitJob(e);
+    while ((result = WriteOldest(e, 1)) > 0) {
+    }
+    if (result < 0) e->error = 1;
+
+    if (e->threadCount) StopWorkers(e);
+
+    BuildStreamInfo(e, streamInfo);
+    if (e->direct) {
+        if (DiskWriterPatch(&e->disk, STREAMINFO_OFFSET, streamInfo, sizeof(streamInfo)) != 0) e->error = 1;
+        if (DiskWriterClose(&e->disk) != 0) e->error = 1;
+        e->direct = 0;
+    } else {
+        if (PlatformFileSeek(e->file, STREAMINFO_OFFSET, SEEK_SET) != 0 ||
+            fwrite(streamInfo, 1, sizeof(streamInfo), e->file) != sizeof(streamInfo)) {
+            e->error = 1;
+        }
+        if (fclose(e->file) != 0) e->error = 1;
+    }
+    e->file = NULL;
+    FreeJobs(e);
+
+    return e->error ? -1 : 0;
+}
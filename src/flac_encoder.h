@@ -0,0 +1,78 @@
+// flac_encoder.h
+#ifndef FLAC_ENCODER_H
+#define FLAC_ENCODER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "wav_writer.h"
+#include "disk_writer.h"
+#include "platform.h"
+
+#define FLAC_BLOCK_SIZE 4096
+#define FLAC_MAX_CHANNELS 8
+#define FLAC_MAX_THREADS 16
+#define FLAC_JOBS_PER_THREAD 2
+#define FLAC_MAX_JOBS (FLAC_MAX_THREADS * FLAC_JOBS_PER_THREAD)
+#define FLAC_MAX_PARTITION_ORDER 6
+#define FLAC_WAIT_MS 50
+
+typedef enum {
+    FLAC_JOB_IDLE = 0,
+    FLAC_JOB_READY,               // Filled, waiting for a worker
+    FLAC_JOB_BUSY,
+    FLAC_JOB_DONE                 // Encoded, waiting to be written in order
+} FlacJobState;
+
+// One block of audio and the frame it encodes to.
+typedef struct {
+    int32_t *samples;             // Planar, FLAC_BLOCK_SIZE per channel
+    int32_t *scratch;             // Mid, side and residual for the encoder
+    uint32_t frames;
+    uint64_t frameNumber;
+    uint8_t *out;
+    size_t outBytes;
+    uint64_t encodeNs;
+    atomic_int state;
+} FlacJob;
+
+// Streaming FLAC writer for 16- or 24-bit integer PCM. Every block is a
+// self-contained frame (fixed predictors, partitioned Rice residuals, stereo
+// decorrelation), so blocks are encoded in parallel on worker threads and
+// written strictly in order. Append only blocks when every job slot is waiting
+// to be written. With threads = 0 blocks are encoded on the calling thread.
+// FlacEncoderOpenDirect writes the frames through a DiskWriter instead of stdio.
+typedef struct {
+    FILE *file;
+    DiskWriter disk;
+    int direct;
+    WavFormat format;
+    uint16_t blockAlign;
+    uint32_t jobCount;
+    FlacJob jobs[FLAC_MAX_JOBS];
+    uint32_t fillJob;             // Slot being filled by Append
+    uint32_t writeJob;            // Oldest slot not yet written
+    uint64_t nextFrameNumber;
+
+    uint32_t threadCount;
+    PlatformThread threads[FLAC_MAX_THREADS];
+    PlatformEvent workEvent;
+    PlatformEvent doneEvent;
+    atomic_int stopWorkers;
+
+    uint64_t totalFrames;
+    uint64_t bytesWritten;
+    uint64_t encodeNs;            // Encoding time summed over all threads
+    uint32_t minFrameBytes;
+    uint32_t maxFrameBytes;
+    int error;
+} FlacEncoder;
+
+int FlacEncoderOpen(FlacEncoder *e, const char *path, const WavFormat *format, uint32_t threads);
+int FlacEncoderOpenDirect(FlacEncoder *e, const char *path, const WavFormat *format, uint32_t threads);
+// frames are interleaved samples in format.
+int FlacEncoderAppend(FlacEncoder *e, const void *frames, uint32_t frameCount);
+// Encodes the last partial block, waits for every frame and fills in STREAMINFO.
+int FlacEncoderFinalize(FlacEncoder *e);
+
+#endif // FLAC_ENCODER_H
@@ -1,12 +1,180 @@
 // gui.c
 #include "gui.h"
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 
 #define WINDOW_CLASS_NAME "AudioSamplerClass"
 
-extern BOOL isPlaying;
+#define VIEW_LEFT 10
+#define VIEW_WIDTH 310
+#define METER_TOP 120
+#define METER_HEIGHT 30
+#define WAVE_TOP 160
+#define WAVE_HEIGHT 110
+#define METER_FLOOR_DB -60.0
+#define WAVE_SECONDS 5        // Visible while recording; the whole take is shown when stopped
+#define SPECTRUM_TOP 280
+#define SPECTRUM_HEIGHT 80
+#define SPECTRUM_FLOOR_DB -90.0
+#define SPECTRUM_LOW_HZ 20.0  // Left edge of the log frequency axis; the right one is Nyquist
+#define LOUDNESS_TOP 370
+#define EDIT_TOP 400
 
-HWND hStatus, hPlayButton, hSaveButton;
+HWND hStatus, hPlayButton, hSaveButton, hLoudness;
+
+// x offset of a linear level on the dBFS meter scale
+static int MeterPosition(float level)
+{
+    double db = level > 0.0f ? 20.0 * log10(level) : METER_FLOOR_DB;
+    if (db < METER_FLOOR_DB) db = METER_FLOOR_DB;
+    if (db > 0.0) db = 0.0;
+    return (int)((db - METER_FLOOR_DB) / -METER_FLOOR_DB * VIEW_WIDTH);
+}
+
+// One bar per channel: RMS filled, peak as a tick, red once the channel has clipped
+static void DrawMeter(HDC hdc)
+{
+    LevelReading reading;
+    HBRUSH rmsBrush, clipBrush, peakBrush;
+
+    if (!LevelMeterRead(&levelMeter, &reading)) return;
+
+    rmsBrush = CreateSolidBrush(RGB(0, 192, 0));
+    clipBrush = CreateSolidBrush(RGB(224, 0, 0));
+    peakBrush = CreateSolidBrush(RGB(255, 255, 0));
+    for (uint16_t ch = 0; ch < reading.channels; ++ch)
+    {
+        int top = ch * METER_HEIGHT / reading.channels;
+        int bottom = (ch + 1) * METER_HEIGHT / reading.channels - 1;
+        int peak = MeterPosition(reading.peak[ch]);
+        RECT bar = { 0, top, MeterPosition(reading.rms[ch]), bottom };
+        RECT tick = { peak > 2 ? peak - 2 : 0, top, peak, bottom };
+
+        FillRect(hdc, &bar, reading.clips[ch] ? clipBrush : rmsBrush);
+        FillRect(hdc, &tick, peakBrush);
+    }
+    DeleteObject(rmsBrush);
+    DeleteObject(clipBrush);
+    DeleteObject(peakBrush);
+}
+
+// The last WAVE_SECONDS scrolling while recording, otherwise the whole take
+static void DrawWaveform(HDC hdc)
+{
+    static float mins[VIEW_WIDTH], maxs[VIEW_WIDTH];
+    uint64_t frames = WaveformOverviewFrames(&waveformOverview);
+    uint64_t start = 0;
+    uint64_t span = frames;
+    int center = WAVE_TOP - METER_TOP + WAVE_HEIGHT / 2;
+    uint32_t columns;
+    HPEN pen, oldPen;
+
+    if (isRecording)
+    {
+        span = (uint64_t)waveformOverview.sampleRate * WAVE_SECONDS;
+        if (frames > span) start = frames - span;
+    }
+    columns = WaveformOverviewColumns(&waveformOverview, start, span, VIEW_WIDTH, mins, maxs);
+
+    pen = CreatePen(PS_SOLID, 1, RGB(96, 160, 255));
+    oldPen = (HPEN)SelectObject(hdc, pen);
+    for (uint32_t x = 0; x < columns; ++x)
+    {
+        MoveToEx(hdc, x, center - (int)(maxs[x] * (WAVE_HEIGHT / 2)), NULL);
+        LineTo(hdc, x, center - (int)(mins[x] * (WAVE_HEIGHT / 2)) + 1);
+    }
+    SelectObject(hdc, oldPen);
+    DeleteObject(pen);
+}
+
+// The latest spectrum column as bars on a log frequency axis, each the
+// loudest bin under its pixel column
+static void DrawSpectrum(HDC hdc)
+{
+    static float magnitudes[SPECTRUM_MAX_SIZE / 2 + 1];
+    uint64_t columns = SpectrogramColumns(&spectrogram);
+    uint32_t bins = spectrogram.plan.bins;
+    double binHz = (double)spectrogram.sampleRate / spectrogram.plan.size;
+    double span = log(spectrogram.sampleRate / 2.0 / SPECTRUM_LOW_HZ);
+    int bottom = SPECTRUM_TOP - METER_TOP + SPECTRUM_HEIGHT;
+    HBRUSH brush;
+
+    if (columns == 0 || !SpectrogramReadColumn(&spectrogram, columns - 1, magnitudes)) return;
+
+    brush = CreateSolidBrush(RGB(255, 160, 64));
+    for (int x = 0; x < VIEW_WIDTH; ++x)
+    {
+        uint32_t first = (uint32_t)(SPECTRUM_LOW_HZ * exp(span * x / VIEW_WIDTH) / binHz);
+        uint32_t last = (uint32_t)(SPECTRUM_LOW_HZ * exp(span * (x + 1) / VIEW_WIDTH) / binHz);
+        float level = 0.0f;
+        double db;
+
+        if (last >= bins) last = bins - 1;
+        for (uint32_t b = first; b <= last; ++b)
+        {
+            if (magnitudes[b] > level) level = magnitudes[b];
+        }
+        db = level > 0.0f ? 20.0 * log10(level) : SPECTRUM_FLOOR_DB;
+        if (db > SPECTRUM_FLOOR_DB)
+        {
+            if (db > 0.0) db = 0.0;
+            RECT bar = { x, bottom - (int)((db - SPECTRUM_FLOOR_DB) / -SPECTRUM_FLOOR_DB * SPECTRUM_HEIGHT), x + 1, bottom };
+            FillRect(hdc, &bar, brush);
+        }
+    }
+    DeleteObject(brush);
+}
+
+// Draws the meter, waveform and spectrum off screen and copies them in, so refreshes do not flicker
+static void PaintLevels(HDC hdc)
+{
+    int height = SPECTRUM_TOP - METER_TOP + SPECTRUM_HEIGHT;
+    RECT area = { 0, 0, VIEW_WIDTH, height };
+    RECT gap = { 0, METER_HEIGHT, VIEW_WIDTH, WAVE_TOP - METER_TOP };
+    RECT spectrumGap = { 0, WAVE_TOP - METER_TOP + WAVE_HEIGHT, VIEW_WIDTH, SPECTRUM_TOP - METER_TOP };
+    HDC memory = CreateCompatibleDC(hdc);
+    HBITMAP bitmap = CreateCompatibleBitmap(hdc, VIEW_WIDTH, height);
+    HGDIOBJ oldBitmap = SelectObject(memory, bitmap);
+
+    FillRect(memory, &area, (HBRUSH)GetStockObject(BLACK_BRUSH));
+    FillRect(memory, &gap, GetSysColorBrush(COLOR_BTNFACE));
+    FillRect(memory, &spectrumGap, GetSysColorBrush(COLOR_BTNFACE));
+
+    EnterCriticalSection(&levelsLock);
+    if (meterReady) DrawMeter(memory);
+    if (overviewReady) DrawWaveform(memory);
+    if (spectrumReady) DrawSpectrum(memory);
+    LeaveCriticalSection(&levelsLock);
+
+    BitBlt(hdc, VIEW_LEFT, METER_TOP, VIEW_WIDTH, height, memory, 0, 0, SRCCOPY);
+    SelectObject(memory, oldBitmap);
+    DeleteObject(bitmap);
+    DeleteDC(memory);
+}
+
+// Short-term and integrated loudness of the take being stored, and its true peak
+static void ShowLoudness(void)
+{
+    static char shown[64];
+    char text[64] = "";
+    LoudnessSummary summary;
+
+    EnterCriticalSection(&levelsLock);
+    if (loudnessReady && LoudnessMeterRead(&loudnessMeter, &summary))
+    {
+        snprintf(text, sizeof(text), "S %.1f  I %.1f LUFS  TP %.1f dBTP", summary.shortTerm, summary.integrated,
+                 summary.truePeak);
+    }
+    LeaveCriticalSection(&levelsLock);
+
+    // Only changed text is set, so the label does not flicker at the refresh rate
+    if (strcmp(text, shown) != 0)
+    {
+        SetWindowText(hLoudness, text);
+        snprintf(shown, sizeof(shown), "%s", text);
+    }
+}
 
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
@@ -34,10 +202,44 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
         case ID_SAVE_BUTTON:
             PostMessage(hwnd, WM_USER + 4, 0, 0);
             return 0;
+
+        case ID_PREROLL_CHECK:
+            PostMessage(hwnd, WM_USER + 8, IsDlgButtonChecked(hwnd, ID_PREROLL_CHECK) == BST_CHECKED, 0);
+            return 0;
+
+        case ID_NORMALIZE_CHECK:
+            normalizeEnabled = IsDlgButtonChecked(hwnd, ID_NORMALIZE_CHECK) == BST_CHECKED;
+            return 0;
+
+        case ID_TRIM_BUTTON:
+        case ID_UNDO_BUTTON:
+        case ID_REDO_BUTTON:
+            PostMessage(hwnd, WM_USER + 9, LOWORD(wParam), 0);
+            return 0;
+        }
+        break;
+
+    case WM_TIMER:
+        if (wParam == ID_LEVEL_TIMER)
+        {
+            RECT view = { VIEW_LEFT, METER_TOP, VIEW_LEFT + VIEW_WIDTH, SPECTRUM_TOP + SPECTRUM_HEIGHT };
+            InvalidateRect(hwnd, &view, FALSE);
+            ShowLoudness();
+            return 0;
         }
         break;
 
+    case WM_PAINT:
+    {
+        PAINTSTRUCT ps;
+        HDC hdc = BeginPaint(hwnd, &ps);
+        PaintLevels(hdc);
+        EndPaint(hwnd, &ps);
+        return 0;
+    }
+
     case WM_DESTROY:
+        KillTimer(hwnd, ID_LEVEL_TIMER);
         PostQuitMessage(0);
         return 0;
     }
@@ -50,10 +252,33 @@ void CreateGUIControls(HWND hwnd)
     CreateWindow("BUTTON", "Stop Recording", WS_VISIBLE | WS_CHILD, 170, 10, 150, 30, hwnd, (HMENU)ID_STOP_BUTTON, NULL, NULL);
     hPlayButton = CreateWindow("BUTTON", "Play", WS_VISIBLE | WS_CHILD, 10, 50, 150, 30, hwnd, (HMENU)ID_PLAY_BUTTON, NULL, NULL);
     hSaveButton = CreateWindow("BUTTON", "Save", WS_VISIBLE | WS_CHILD, 170, 50, 150, 30, hwnd, (HMENU)ID_SAVE_BUTTON, NULL, NULL);
-    hStatus = CreateWindow("STATIC", "Not Recording", WS_VISIBLE | WS_CHILD, 10, 90, 310, 20, hwnd, NULL, NULL, NULL);
+    hStatus = CreateWindow("STATIC", "Not Recording", WS_VISIBLE | WS_CHILD, 10, 90, 200, 20, hwnd, NULL, NULL, NULL);
+    CreateWindow("BUTTON", "Pre-roll", WS_VISIBLE | WS_CHILD | BS_AUTOCHECKBOX, 220, 90, 100, 20, hwnd, (HMENU)ID_PREROLL_CHECK, NULL, NULL);
+    CreateWindow("BUTTON", "Normalize", WS_VISIBLE | WS_CHILD | BS_AUTOCHECKBOX, 10, LOUDNESS_TOP, 90, 20, hwnd, (HMENU)ID_NORMALIZE_CHECK, NULL, NULL);
+    hLoudness = CreateWindow("STATIC", "", WS_VISIBLE | WS_CHILD, 100, LOUDNESS_TOP, 220, 20, hwnd, NULL, NULL, NULL);
+    CreateWindow("BUTTON", "Trim Start", WS_VISIBLE | WS_CHILD, 10, EDIT_TOP, 100, 30, hwnd, (HMENU)ID_TRIM_BUTTON, NULL, NULL);
+    CreateWindow("BUTTON", "Undo", WS_VISIBLE | WS_CHILD, 115, EDIT_TOP, 100, 30, hwnd, (HMENU)ID_UNDO_BUTTON, NULL, NULL);
+    CreateWindow("BUTTON", "Redo", WS_VISIBLE | WS_CHILD, 220, EDIT_TOP, 100, 30, hwnd, (HMENU)ID_REDO_BUTTON, NULL, NULL);
 
     EnableWindow(hPlayButton, FALSE);
     EnableWindow(hSaveButton, FALSE);
+
+    SetTimer(hwnd, ID_LEVEL_TIMER, LEVEL_REFRESH_MS, NULL);
+}
+
+static void ShowIdleStatus(void)
+{
+    char text[64];
+
+    if (preRollEnabled)
+    {
+        snprintf(text, sizeof(text), "Armed: keeping the last %d s", PRE_ROLL_SECONDS);
+        SetWindowText(hStatus, text);
+    }
+    else
+    {
+        SetWindowText(hStatus, "Not Recording");
+    }
 }
 
 void UpdateRecordingStatus(HWND hwnd, BOOL isRecording)
@@ -66,7 +291,7 @@ void UpdateRecordingStatus(HWND hwnd, BOOL isRecording)
     }
     else
     {
-        SetWindowText(hStatus, "Not Recording");
+        ShowIdleStatus();
         EnableWindow(hPlayButton, TRUE);
         EnableWindow(hSaveButton, TRUE);
     }
@@ -77,6 +302,22 @@ void UpdatePlayStatus(BOOL isPlaying)
     SetWindowText(hPlayButton, isPlaying ? "Stop" : "Play");
 }
 
+void UpdateSaveStatus(BOOL isSaving, int percent)
+{
+    char text[64];
+
+    SetWindowText(hSaveButton, isSaving ? "Cancel Save" : "Save");
+    if (isSaving)
+    {
+        snprintf(text, sizeof(text), "Saving... %d%%", percent);
+        SetWindowText(hStatus, text);
+    }
+    else
+    {
+        ShowIdleStatus();
+    }
+}
+
 HWND InitializeGUI(HINSTANCE hInstance, int nCmdShow)
 {
     WNDCLASS wc = {0};
@@ -91,7 +332,7 @@ HWND InitializeGUI(HINSTANCE hInstance, int nCmdShow)
         WINDOW_CLASS_NAME,
         "Audio Sampler",
         WS_OVERLAPPEDWINDOW,
-        CW_USEDEFAULT, CW_USEDEFAULT, 350, 160,
+        CW_USEDEFAULT, CW_USEDEFAULT, 350, 490,
         NULL,
         NULL,
         hInstance,
@@ -3,17 +3,48 @@
 #define GUI_H
 
 #include <windows.h>
+#include "level_meter.h"
+#include "waveform_overview.h"
+#include "spectrum.h"
+#include "loudness.h"
 
 #define ID_START_BUTTON 1001
 #define ID_STOP_BUTTON 1002
 #define ID_PLAY_BUTTON 1003
 #define ID_SAVE_BUTTON 1004
+#define ID_LEVEL_TIMER 1005
+#define ID_PREROLL_CHECK 1006
+#define ID_NORMALIZE_CHECK 1007
+#define ID_TRIM_BUTTON 1008
+#define ID_UNDO_BUTTON 1009
+#define ID_REDO_BUTTON 1010
+
+#define PRE_ROLL_SECONDS 5
+
+#define LEVEL_REFRESH_MS 33
 
 extern BOOL isPlaying;
+extern BOOL isRecording;
+extern BOOL preRollEnabled;
+extern BOOL normalizeEnabled;   // Save at the default target loudness and true peak ceiling
+
+// Input levels, spectrum, and the waveform and loudness of the current take.
+// Replaced or reset under levelsLock; the display only reads each while its
+// ready flag is set.
+extern LevelMeter levelMeter;
+extern WaveformOverview waveformOverview;
+extern Spectrogram spectrogram;
+extern LoudnessMeter loudnessMeter;
+extern BOOL meterReady;
+extern BOOL overviewReady;
+extern BOOL spectrumReady;
+extern BOOL loudnessReady;
+extern CRITICAL_SECTION levelsLock;
 
 HWND InitializeGUI(HINSTANCE hInstance, int nCmdShow);
 void CreateGUIControls(HWND hwnd);
 void UpdateRecordingStatus(HWND hwnd, BOOL isRecording);
 void UpdatePlayStatus(BOOL isPlaying);
+void UpdateSaveStatus(BOOL isSaving, int percent);
 
 #endif // GUI_H
\ No newline at end of file
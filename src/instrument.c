@@ -0,0 +1,255 @@
+// instrument.c
+#include "instrument.h"
+
+#ifdef BABYSAMPLER_INSTRUMENT
+
+#include <string.h>
+#include <stdatomic.h>
+
+typedef struct {
+    atomic_uint_fast64_t buckets[INSTR_BUCKETS];
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum;
+    atomic_uint_fast64_t min;
+    atomic_uint_fast64_t max;
+} Histogram;
+
+typedef struct {
+    const char *name;
+    const char *unit;
+} MetricInfo;
+
+static const MetricInfo histogramInfo[INSTR_HISTOGRAM_COUNT] = {
+    { "packet_interval", "ns" },
+    { "packet_frames", "frames" },
+    { "packet_latency", "ns" },
+    { "queue_depth", "frames" },
+    { "store_frames", "frames" },
+    { "convert_time", "ns" },
+    { "write_time", "ns" },
+    { "flac_encode_time", "ns" },
+    { "export_convert_time", "ns" },
+    { "export_write_time", "ns" },
+    { "playback_fill_time", "ns" },
+    { "disk_write_time", "ns" },
+};
+
+static const MetricInfo counterInfo[INSTR_COUNTER_COUNT] = {
+    { "silent_packets", "packets" },
+    { "discontinuities", "packets" },
+    { "timestamp_errors", "packets" },
+    { "overruns", "packets" },
+    { "take_grows", "regions" },
+    { "playback_underruns", "events" },
+    { "disk_stalls", "events" },
+};
+
+// Zero-initialized, which is also the reset state
+static Histogram histograms[INSTR_HISTOGRAM_COUNT];
+static atomic_uint_fast64_t counters[INSTR_COUNTER_COUNT];
+
+#define SUB_BUCKETS (1u << INSTR_SUB_BITS)
+
+// Values below SUB_BUCKETS get a bucket each; above, each octave is split
+// into SUB_BUCKETS equal parts, so a bucket is within 1 / SUB_BUCKETS of its values
+static uint32_t BucketOf(uint64_t value) {
+    uint32_t octave;
+
+    if (value < SUB_BUCKETS) return (uint32_t)value;
+    octave = 63 - (uint32_t)__builtin_clzll(value);
+    return (octave - INSTR_SUB_BITS + 1) * SUB_BUCKETS +
+           (uint32_t)(value >> (octave - INSTR_SUB_BITS)) - SUB_BUCKETS;
+}
+
+// Exclusive upper bound of bucket b
+static uint64_t BucketLimit(uint32_t b) {
+    uint32_t shift;
+
+    if (b < SUB_BUCKETS) return b + 1;
+    shift = b / SUB_BUCKETS - 1;
+    if (b + 1 == (64 - INSTR_SUB_BITS + 1) * SUB_BUCKETS) return UINT64_MAX;
+    return (uint64_t)(b % SUB_BUCKETS + SUB_BUCKETS + 1) << shift;
+}
+
+void InstrumentRecord(InstrHistogram id, uint64_t value) {
+    Histogram *h = &histograms[id];
+    uint64_t seen;
+
+    atomic_fetch_add_explicit(&h->buckets[BucketOf(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, value, memory_order_relaxed);
+
+    // The first value also sets min, so min needs no sentinel
+    if (atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed) == 0) {
+        atomic_store_explicit(&h->min, value, memory_order_relaxed);
+    } else {
+        seen = atomic_load_explicit(&h->min, memory_order_relaxed);
+        while (value < seen && !atomic_compare_exchange_weak_explicit(&h->min, &seen, value, memory_order_relaxed,
+                                                                      memory_order_relaxed)) {
+        }
+    }
+    seen = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (value > seen && !atomic_compare_exchange_weak_explicit(&h->max, &seen, value, memory_order_relaxed,
+                                                                  memory_order_relaxed)) {
+    }
+}
+
+void InstrumentCount(InstrCounter id, uint64_t n) {
+    atomic_fetch_add_explicit(&counters[id], n, memory_order_relaxed);
+}
+
+void InstrumentReset(void) {
+    for (int id = 0; id < INSTR_HISTOGRAM_COUNT; ++id) {
+        Histogram *h = &histograms[id];
+        for (uint32_t b = 0; b < INSTR_BUCKETS; ++b) atomic_store(&h->buckets[b], 0);
+        atomic_store(&h->count, 0);
+        atomic_store(&h->sum, 0);
+        atomic_store(&h->min, 0);
+        atomic_store(&h->max, 0);
+    }
+    for (int id = 0; id < INSTR_COUNTER_COUNT; ++id) atomic_store(&counters[id], 0);
+}
+
+// Plain copy of one histogram, read once so every figure in a dump agrees
+typedef struct {
+    uint64_t buckets[INSTR_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} HistogramSnapshot;
+
+static void Snapshot(InstrHistogram id, HistogramSnapshot *s) {
+    Histogram *h = &histograms[id];
+
+    s->count = 0;
+    for (uint32_t b = 0; b < INSTR_BUCKETS; ++b) {
+        s->buckets[b] = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+        s->count += s->buckets[b];
+    }
+    s->sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+    s->min = atomic_load_explicit(&h->min, memory_order_relaxed);
+    s->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+}
+
+// Upper bound of the bucket holding the q-th quantile, clamped to the observed range
+static uint64_t Percentile(const HistogramSnapshot *s, double q) {
+    uint64_t rank = (uint64_t)(q * s->count);
+    uint64_t seen = 0;
+    uint64_t value = s->max;
+
+    if (rank >= s->count) rank = s->count - 1;
+    for (uint32_t b = 0; b < INSTR_BUCKETS; ++b) {
+        seen += s->buckets[b];
+        if (seen > rank) {
+            value = BucketLimit(b) - 1;
+            break;
+        }
+    }
+    if (value < s->min) value = s->min;
+    if (value > s->max) value = s->max;
+    return value;
+}
+
+// Times print in microseconds, everything else as counted
+static double Scaled(const MetricInfo *info, uint64_t value) {
+    return strcmp(info->unit, "ns") == 0 ? value / 1e3 : (double)value;
+}
+
+void InstrumentPrint(FILE *out) {
+    HistogramSnapshot s;
+
+    fprintf(out, "Instrumentation:\n");
+    for (int id = 0; id < INSTR_COUNTER_COUNT; ++id) {
+        uint64_t n = atomic_load_explicit(&counters[id], memory_order_relaxed);
+        if (n) fprintf(out, "  %-20s %llu %s\n", counterInfo[id].name, (unsigned long long)n, counterInfo[id].unit);
+    }
+    for (int id = 0; id < INSTR_HISTOGRAM_COUNT; ++id) {
+        const MetricInfo *info = &histogramInfo[id];
+        const char *unit = strcmp(info->unit, "ns") == 0 ? "us" : info->unit;
+
+        Snapshot((InstrHistogram)id, &s);
+        if (s.count == 0) continue;
+        fprintf(out, "  %-20s n=%llu min %.1f, p50 %.1f, p99 %.1f, max %.1f, avg %.1f %s\n", info->name,
+                (unsigned long long)s.count, Scaled(info, s.min), Scaled(info, Percentile(&s, 0.5)),
+                Scaled(info, Percentile(&s, 0.99)), Scaled(info, s.max), Scaled(info, s.sum) / s.count, unit);
+    }
+}
+
+static void WriteJson(FILE *f) {
+    HistogramSnapshot s;
+
+    fprintf(f, "{\n  \"counters\": {");
+    for (int id = 0; id < INSTR_COUNTER_COUNT; ++id) {
+        fprintf(f, "%s\n    \"%s\": %llu", id ? "," : "", counterInfo[id].name,
+                (unsigned long long)atomic_load_explicit(&counters[id], memory_order_relaxed));
+    }
+    fprintf(f, "\n  },\n  \"histograms\": {");
+    for (int id = 0; id < INSTR_HISTOGRAM_COUNT; ++id) {
+        int first = 1;
+
+        Snapshot((InstrHistogram)id, &s);
+        fprintf(f, "%s\n    \"%s\": {\"unit\": \"%s\", \"count\": %llu, \"sum\": %llu", id ? "," : "",
+                histogramInfo[id].name, histogramInfo[id].unit, (unsigned long long)s.count,
+                (unsigned long long)s.sum);
+        if (s.count) {
+            fprintf(f, ", \"min\": %llu, \"max\": %llu, \"p50\": %llu, \"p99\": %llu", (unsigned long long)s.min,
+                    (unsigned long long)s.max, (unsigned long long)Percentile(&s, 0.5),
+                    (unsigned long long)Percentile(&s, 0.99));
+        }
+        // Only buckets that were hit, keyed by their exclusive upper bound
+        fprintf(f, ", \"buckets\": {");
+        for (uint32_t b = 0; b < INSTR_BUCKETS; ++b) {
+            if (!s.buckets[b]) continue;
+            fprintf(f, "%s\"%llu\": %llu", first ? "" : ", ", (unsigned long long)BucketLimit(b),
+                    (unsigned long long)s.buckets[b]);
+            first = 0;
+        }
+        fprintf(f, "}}");
+    }
+    fprintf(f, "\n  }\n}\n");
+}
+
+// One row per figure: metric,unit,stat,value, with a below_N stat per bucket
+static void WriteCsv(FILE *f) {
+    HistogramSnapshot s;
+
+    fprintf(f, "metric,unit,stat,value\n");
+    for (int id = 0; id < INSTR_COUNTER_COUNT; ++id) {
+        fprintf(f, "%s,%s,count,%llu\n", counterInfo[id].name, counterInfo[id].unit,
+                (unsigned long long)atomic_load_explicit(&counters[id], memory_order_relaxed));
+    }
+    for (int id = 0; id < INSTR_HISTOGRAM_COUNT; ++id) {
+        const char *name = histogramInfo[id].name;
+        const char *unit = histogramInfo[id].unit;
+
+        Snapshot((InstrHistogram)id, &s);
+        fprintf(f, "%s,%s,count,%llu\n", name, unit, (unsigned long long)s.count);
+        fprintf(f, "%s,%s,sum,%llu\n", name, unit, (unsigned long long)s.sum);
+        if (!s.count) continue;
+        fprintf(f, "%s,%s,min,%llu\n", name, unit, (unsigned long long)s.min);
+        fprintf(f, "%s,%s,max,%llu\n", name, unit, (unsigned long long)s.max);
+        fprintf(f, "%s,%s,p50,%llu\n", name, unit, (unsigned long long)Percentile(&s, 0.5));
+        fprintf(f, "%s,%s,p99,%llu\n", name, unit, (unsigned long long)Percentile(&s, 0.99));
+        for (uint32_t b = 0; b < INSTR_BUCKETS; ++b) {
+            if (!s.buckets[b]) continue;
+            fprintf(f, "%s,%s,below_%llu,%llu\n", name, unit, (unsigned long long)BucketLimit(b),
+                    (unsigned long long)s.buckets[b]);
+        }
+    }
+}
+
+int InstrumentWriteFile(const char *path) {
+    size_t len = strlen(path);
+    int csv = len >= 4 && (strcmp(path + len - 4, ".csv") == 0 || strcmp(path + len - 4, ".CSV") == 0);
+    FILE *f = fopen(path, "w");
+
+    if (!f) return -1;
+    if (csv) {
+        WriteCsv(f);
+    } else {
+        WriteJson(f);
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+#endif // BABYSAMPLER_INSTRUMENT
@@ -0,0 +1,79 @@
+// instrument.h
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Histograms and counters along the capture, save and playback paths. Built
+// only with make INSTRUMENT=1, which defines BABYSAMPLER_INSTRUMENT; otherwise
+// every INSTR_ macro expands to nothing and the dump functions fail.
+
+#define INSTR_SUB_BITS 2              // Each power of two is split into 2^INSTR_SUB_BITS buckets
+#define INSTR_BUCKETS 256             // Enough for every uint64_t at that resolution
+
+typedef enum {
+    INSTR_PACKET_INTERVAL_NS = 0, // Between packets handed out by a source
+    INSTR_PACKET_FRAMES,
+    INSTR_PACKET_LATENCY_NS,      // Packet timestamp to delivery
+    INSTR_QUEUE_DEPTH_FRAMES,     // Ring fill after each packet is queued
+    INSTR_STORE_FRAMES,           // Frames per storage thread block
+    INSTR_CONVERT_NS,             // Conversion and resampling per storage block
+    INSTR_WRITE_NS,               // WAV append or FLAC submit per storage block
+    INSTR_FLAC_ENCODE_NS,         // Per FLAC frame, on whichever thread encoded it
+    INSTR_EXPORT_CONVERT_NS,      // Per export block
+    INSTR_EXPORT_WRITE_NS,
+    INSTR_PLAYBACK_FILL_NS,       // Converting and queuing one playback block
+    INSTR_DISK_WRITE_NS,          // One disk writer write, on its writer thread
+    INSTR_HISTOGRAM_COUNT
+} InstrHistogram;
+
+typedef enum {
+    INSTR_SILENT_PACKETS = 0,
+    INSTR_DISCONTINUITIES,
+    INSTR_TIMESTAMP_ERRORS,
+    INSTR_OVERRUNS,               // Packets dropped because the ring was full
+    INSTR_TAKE_GROWS,             // Regions added to a take's pool
+    INSTR_PLAYBACK_UNDERRUNS,
+    INSTR_DISK_STALLS,            // Appends that waited on the disk writer's queue
+    INSTR_COUNTER_COUNT
+} InstrCounter;
+
+#ifdef BABYSAMPLER_INSTRUMENT
+
+#include "platform.h"
+
+#define INSTRUMENT_ENABLED 1
+
+// Safe from any thread; relaxed atomics only, no locks or allocation.
+void InstrumentRecord(InstrHistogram id, uint64_t value);
+void InstrumentCount(InstrCounter id, uint64_t n);
+
+#define INSTR_RECORD(id, value) InstrumentRecord((id), (uint64_t)(value))
+#define INSTR_COUNT(id) InstrumentCount((id), 1)
+#define INSTR_TIMER(name) uint64_t name = PlatformNowNs()
+#define INSTR_ELAPSED(id, name) InstrumentRecord((id), PlatformNowNs() - (name))
+
+void InstrumentReset(void);
+// Count, sum, min, max and p50/p99 estimated from the buckets.
+void InstrumentPrint(FILE *out);
+// Writes the counters and every histogram with its buckets; .csv selects CSV,
+// anything else JSON. Returns 0 on success.
+int InstrumentWriteFile(const char *path);
+
+#else
+
+#define INSTRUMENT_ENABLED 0
+
+#define INSTR_RECORD(id, value) ((void)0)
+#define INSTR_COUNT(id) ((void)0)
+#define INSTR_TIMER(name)
+#define INSTR_ELAPSED(id, name) ((void)0)
+
+static inline void InstrumentReset(void) {}
+static inline void InstrumentPrint(FILE *out) { (void)out; }
+static inline int InstrumentWriteFile(const char *path) { (void)path; return -1; }
+
+#endif // BABYSAMPLER_INSTRUMENT
+
+#endif // INSTRUMENT_H
@@ -0,0 +1,262 @@
+// level_meter.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "level_meter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define METER_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// Float lane sums are folded into the double totals this often
+#define MEASURE_CHUNK_SAMPLES 4096
+
+typedef void (*MeasureFn)(const float *x, size_t count, uint16_t channels,
+                          float *peak, double *sumSquares, uint64_t *clips);
+
+// x starts on channel 0
+static void MeasureScalar(const float *x, size_t count, uint16_t channels,
+                          float *peak, double *sumSquares, uint64_t *clips) {
+    uint16_t ch = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        float a = fabsf(x[i]);
+        if (a > peak[ch]) peak[ch] = a;
+        sumSquares[ch] += (double)x[i] * x[i];
+        if (a >= METER_CLIP_LEVEL) clips[ch]++;
+        if (++ch == channels) ch = 0;
+    }
+}
+
+#ifdef METER_HAVE_X86
+
+// Lane l of the accumulators holds channel l % channels, which only works when
+// the channel count divides the vector width.
+static void FoldLanes(const float *lanePeak, const float *laneSum, const int32_t *laneClips, uint32_t lanes,
+                      uint16_t channels, float *peak, double *sumSquares, uint64_t *clips) {
+    for (uint32_t l = 0; l < lanes; ++l) {
+        uint16_t ch = (uint16_t)(l % channels);
+        if (lanePeak[l] > peak[ch]) peak[ch] = lanePeak[l];
+        sumSquares[ch] += laneSum[l];
+        clips[ch] += (uint64_t)laneClips[l];
+    }
+}
+
+__attribute__((target("sse2")))
+static void MeasureSse2(const float *x, size_t count, uint16_t channels,
+                        float *peak, double *sumSquares, uint64_t *clips) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 clipLevel = _mm_set1_ps(METER_CLIP_LEVEL);
+    __m128 vpeak = _mm_setzero_ps();
+    __m128 vsum = _mm_setzero_ps();
+    __m128i vclips = _mm_setzero_si128();
+    float lanePeak[4], laneSum[4];
+    int32_t laneClips[4];
+    size_t i = 0;
+
+    if (4 % channels != 0) {
+        MeasureScalar(x, count, channels, peak, sumSquares, clips);
+        return;
+    }
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        __m128 a = _mm_and_ps(v, absMask);
+        vpeak = _mm_max_ps(vpeak, a);
+        vsum = _mm_add_ps(vsum, _mm_mul_ps(v, v));
+        // Compare masks are -1 per clipped lane
+        vclips = _mm_sub_epi32(vclips, _mm_castps_si128(_mm_cmpge_ps(a, clipLevel)));
+    }
+
+    _mm_storeu_ps(lanePeak, vpeak);
+    _mm_storeu_ps(laneSum, vsum);
+    _mm_storeu_si128((__m128i *)laneClips, vclips);
+    FoldLanes(lanePeak, laneSum, laneClips, 4, channels, peak, sumSquares, clips);
+    MeasureScalar(x + i, count - i, channels, peak, sumSquares, clips);
+}
+
+__attribute__((target("avx2")))
+static void MeasureAvx2(const float *x, size_t count, uint16_t channels,
+                        float *peak, double *sumSquares, uint64_t *clips) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 clipLevel = _mm256_set1_ps(METER_CLIP_LEVEL);
+    __m256 vpeak = _mm256_setzero_ps();
+    __m256 vsum = _mm256_setzero_ps();
+    __m256i vclips = _mm256_setzero_si256();
+    float lanePeak[8], laneSum[8];
+    int32_t laneClips[8];
+    size_t i = 0;
+
+    if (8 % channels != 0) {
+        MeasureSse2(x, count, channels, peak, sumSquares, clips);
+        return;
+    }
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256 a = _mm256_and_ps(v, absMask);
+        vpeak = _mm256_max_ps(vpeak, a);
+        vsum = _mm256_add_ps(vsum, _mm256_mul_ps(v, v));
+        vclips = _mm256_sub_epi32(vclips, _mm256_castps_si256(_mm256_cmp_ps(a, clipLevel, _CMP_GE_OQ)));
+    }
+
+    _mm256_storeu_ps(lanePeak, vpeak);
+    _mm256_storeu_ps(laneSum, vsum);
+    _mm256_storeu_si256((__m256i *)laneClips, vclips);
+    FoldLanes(lanePeak, laneSum, laneClips, 8, channels, peak, sumSquares, clips);
+    MeasureScalar(x + i, count - i, channels, peak, sumSquares, clips);
+}
+
+#endif // METER_HAVE_X86
+
+static MeasureFn BestMeasure(void) {
+#ifdef METER_HAVE_X86
+    switch (ConvertBestKernel()) {
+    case CONVERT_KERNEL_AVX2: return MeasureAvx2;
+    case CONVERT_KERNEL_SSE2: return MeasureSse2;
+    default: break;
+    }
+#endif
+    return MeasureScalar;
+}
+
+void MeasureLevels(const float *frames, uint32_t frameCount, uint16_t channels,
+                   float *peak, double *sumSquares, uint64_t *clips) {
+    static MeasureFn fn = NULL;
+    size_t count = (size_t)frameCount * channels;
+    // Whole frames per chunk, so every chunk starts on channel 0
+    size_t chunk = MEASURE_CHUNK_SAMPLES - MEASURE_CHUNK_SAMPLES % channels;
+
+    if (!fn) fn = BestMeasure();
+    for (size_t i = 0; i < count; i += chunk) {
+        size_t n = count - i < chunk ? count - i : chunk;
+        fn(frames + i, n, channels, peak, sumSquares, clips);
+    }
+}
+
+static uint32_t FloatBits(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static float BitsFloat(uint32_t bits) {
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static void PublishBlock(LevelMeter *m) {
+    unsigned sequence = atomic_load_explicit(&m->sequence, memory_order_relaxed);
+
+    m->blocks++;
+    atomic_store_explicit(&m->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (uint16_t ch = 0; ch < m->channels; ++ch) {
+        float rms = (float)sqrt(m->sumSquares[ch] / m->blockFrames);
+        if (m->peak[ch] > m->maxPeak[ch]) m->maxPeak[ch] = m->peak[ch];
+        atomic_store_explicit(&m->publishedMaxPeak[ch], FloatBits(m->maxPeak[ch]), memory_order_relaxed);
+        atomic_store_explicit(&m->publishedPeak[ch], FloatBits(m->peak[ch]), memory_order_relaxed);
+        atomic_store_explicit(&m->publishedRms[ch], FloatBits(rms), memory_order_relaxed);
+        atomic_store_explicit(&m->publishedClips[ch], m->clips[ch], memory_order_relaxed);
+        m->peak[ch] = 0.0f;
+        m->sumSquares[ch] = 0.0;
+    }
+    atomic_store_explicit(&m->publishedBlocks, m->blocks, memory_order_relaxed);
+    atomic_store_explicit(&m->sequence, sequence + 2, memory_order_release);
+    m->framesInBlock = 0;
+}
+
+int LevelMeterInit(LevelMeter *m, const WavFormat *format, uint32_t blockFrames) {
+    SampleFormat inSamples;
+    SampleFormat floatSamples;
+
+    memset(m, 0, sizeof(*m));
+    if (format->channels == 0 || format->channels > METER_MAX_CHANNELS || blockFrames == 0) return -1;
+    if (SampleFormatFromWav(format, &inSamples) != 0) return -1;
+
+    floatSamples = inSamples;
+    floatSamples.type = SAMPLE_F32;
+    SampleConverterInit(&m->toFloat, &inSamples, &floatSamples);
+    m->channels = format->channels;
+    m->blockFrames = blockFrames;
+
+    if (inSamples.type != SAMPLE_F32) {
+        m->scratch = (float *)malloc((size_t)METER_SCRATCH_FRAMES * m->channels * sizeof(float));
+        if (!m->scratch) return -1;
+    }
+
+    atomic_init(&m->sequence, 0);
+    atomic_init(&m->publishedBlocks, 0);
+    for (uint16_t ch = 0; ch < METER_MAX_CHANNELS; ++ch) {
+        atomic_init(&m->publishedPeak[ch], 0);
+        atomic_init(&m->publishedRms[ch], 0);
+        atomic_init(&m->publishedMaxPeak[ch], 0);
+        atomic_init(&m->publishedClips[ch], 0);
+    }
+    return 0;
+}
+
+void LevelMeterClose(LevelMeter *m) {
+    free(m->scratch);
+    m->scratch = NULL;
+}
+
+void LevelMeterProcess(LevelMeter *m, const void *frames, uint32_t frameCount) {
+    const uint8_t *src = (const uint8_t *)frames;
+    uint32_t frameBytes = SampleFormatFrameBytes(&m->toFloat.in);
+
+    while (frameCount > 0) {
+        uint32_t n = m->blockFrames - m->framesInBlock;
+        if (n > frameCount) n = frameCount;
+
+        // Silence adds frames to the block but nothing to the sums
+        if (src && m->scratch) {
+            if (n > METER_SCRATCH_FRAMES) n = METER_SCRATCH_FRAMES;
+            SampleConverterRun(&m->toFloat, m->scratch, src, n, NULL);
+            MeasureLevels(m->scratch, n, m->channels, m->peak, m->sumSquares, m->clips);
+        } else if (src) {
+            MeasureLevels((const float *)src, n, m->channels, m->peak, m->sumSquares, m->clips);
+        }
+
+        if (src) src += (size_t)n * frameBytes;
+        frameCount -= n;
+        m->framesInBlock += n;
+        if (m->framesInBlock == m->blockFrames) PublishBlock(m);
+    }
+}
+
+int LevelMeterRead(LevelMeter *m, LevelReading *out) {
+    unsigned before;
+    unsigned after;
+
+    do {
+        before = atomic_load_explicit(&m->sequence, memory_order_acquire);
+        for (uint16_t ch = 0; ch < m->channels; ++ch) {
+            out->peak[ch] = BitsFloat(atomic_load_explicit(&m->publishedPeak[ch], memory_order_relaxed));
+            out->rms[ch] = BitsFloat(atomic_load_explicit(&m->publishedRms[ch], memory_order_relaxed));
+            out->maxPeak[ch] = BitsFloat(atomic_load_explicit(&m->publishedMaxPeak[ch], memory_order_relaxed));
+            out->clips[ch] = atomic_load_explicit(&m->publishedClips[ch], memory_order_relaxed);
+        }
+        out->blocks = atomic_load_explicit(&m->publishedBlocks, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&m->sequence, memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+
+    out->channels = m->channels;
+    return out->blocks > 0;
+}
+
+static double ToDecibels(float level) {
+    return level > 0.0f ? 20.0 * log10(level) : -INFINITY;
+}
+
+void LevelReadingPrint(const LevelReading *reading, FILE *out) {
+    for (uint16_t ch = 0; ch < reading->channels; ++ch) {
+        fprintf(out, "Channel %u: peak %.1f dBFS (max %.1f), RMS %.1f dBFS, %llu clipped samples\n", ch + 1,
+                ToDecibels(reading->peak[ch]), ToDecibels(reading->maxPeak[ch]), ToDecibels(reading->rms[ch]),
+                (unsigned long long)reading->clips[ch]);
+    }
+}
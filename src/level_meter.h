@@ -0,0 +1,65 @@
+// level_meter.h
+#ifndef LEVEL_METER_H
+#define LEVEL_METER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "sample_convert.h"
+#include "wav_writer.h"
+
+#define METER_MAX_CHANNELS 8
+#define METER_SCRATCH_FRAMES 512
+#define METER_CLIP_LEVEL 0.999f       // Samples at or above this magnitude count as clipped
+#define METER_BLOCKS_PER_SECOND 20    // Block rate for displays
+
+// Levels of the latest metering block, linear with 1.0 = full scale.
+typedef struct {
+    uint16_t channels;
+    float peak[METER_MAX_CHANNELS];
+    float rms[METER_MAX_CHANNELS];
+    float maxPeak[METER_MAX_CHANNELS];    // These two since the meter was initialized
+    uint64_t clips[METER_MAX_CHANNELS];
+    uint64_t blocks;
+} LevelReading;
+
+// Peak, RMS and clip count per channel over fixed-size blocks. Process runs
+// on the capture thread without locking or allocating; integer sources are
+// widened through a small scratch buffer. Each finished block is published
+// under a sequence number that readers on any thread retry against, so the
+// GUI never sees a half-written block.
+typedef struct {
+    uint16_t channels;
+    uint32_t blockFrames;
+    SampleConverter toFloat;
+    float *scratch;
+
+    uint32_t framesInBlock;
+    float peak[METER_MAX_CHANNELS];
+    double sumSquares[METER_MAX_CHANNELS];
+    float maxPeak[METER_MAX_CHANNELS];
+    uint64_t clips[METER_MAX_CHANNELS];
+    uint64_t blocks;
+
+    atomic_uint sequence;         // Odd while a block is being published
+    atomic_uint publishedPeak[METER_MAX_CHANNELS];    // Float bit patterns
+    atomic_uint publishedRms[METER_MAX_CHANNELS];
+    atomic_uint publishedMaxPeak[METER_MAX_CHANNELS];
+    atomic_uint_fast64_t publishedClips[METER_MAX_CHANNELS];
+    atomic_uint_fast64_t publishedBlocks;
+} LevelMeter;
+
+int LevelMeterInit(LevelMeter *m, const WavFormat *format, uint32_t blockFrames);
+void LevelMeterClose(LevelMeter *m);
+// frames are interleaved samples in the format given to Init; NULL meters silence.
+void LevelMeterProcess(LevelMeter *m, const void *frames, uint32_t frameCount);
+// Returns 0 until the first block has been published.
+int LevelMeterRead(LevelMeter *m, LevelReading *out);
+void LevelReadingPrint(const LevelReading *reading, FILE *out);
+
+// Peak magnitude, sum of squares and clipped samples per channel, accumulated
+// into the arrays. frames are interleaved float.
+void MeasureLevels(const float *frames, uint32_t frameCount, uint16_t channels,
+                   float *peak, double *sumSquares, uint64_t *clips);
+
+#endif // LEVEL_METER_H
@@ -0,0 +1,385 @@
+// loudness.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "loudness.h"
+
+// Speaker bits from the WAVE channel mask that BS.1770 weights differently
+#define SPEAKER_LFE 0x8u
+#define SPEAKER_SURROUNDS (0x10u | 0x20u | 0x200u | 0x400u)
+#define SURROUND_WEIGHT 1.41
+#define DENORMAL_FLOOR 1e-30
+
+// Interpolation filter of BS.1770-4 Annex 2, one row per phase, applied to the
+// newest sample first
+static const float truePeakFilter[TRUE_PEAK_PHASES][TRUE_PEAK_TAPS] = {
+    { 0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f,
+      0.1373291015625f, 0.9721679687500f, -0.1022949218750f, 0.0476074218750f, -0.0266113281250f,
+      0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f,
+      0.4650878906250f, 0.7797851562500f, -0.2003173828125f, 0.1015625000000f, -0.0582275390625f,
+      0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f,
+      0.7797851562500f, 0.4650878906250f, -0.1665039062500f, 0.0891113281250f, -0.0517578125000f,
+      0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f,
+      0.9721679687500f, 0.1373291015625f, -0.0594482421875f, 0.0332031250000f, -0.0196533203125f,
+      0.0109863281250f, 0.0017089843750f },
+};
+
+void TruePeakDetectorInit(TruePeakDetector *d, uint16_t channels) {
+    memset(d, 0, sizeof(*d));
+    d->channels = channels;
+}
+
+float TruePeakDetectorPush(TruePeakDetector *d, const float *frame) {
+    float peak = 0.0f;
+
+    for (uint16_t ch = 0; ch < d->channels; ++ch) {
+        float *h = d->history[ch];
+        const float *window;
+
+        h[d->pos] = h[d->pos + TRUE_PEAK_TAPS] = frame ? frame[ch] : 0.0f;
+        // Oldest first, so the newest sample is window[TRUE_PEAK_TAPS - 1]
+        window = h + d->pos + 1;
+        for (uint32_t p = 0; p < TRUE_PEAK_PHASES; ++p) {
+            float sum = 0.0f;
+            for (uint32_t k = 0; k < TRUE_PEAK_TAPS; ++k) {
+                sum += truePeakFilter[p][k] * window[TRUE_PEAK_TAPS - 1 - k];
+            }
+            if (fabsf(sum) > peak) peak = fabsf(sum);
+        }
+        if (fabsf(window[TRUE_PEAK_TAPS - 1 - TRUE_PEAK_DELAY]) > peak) {
+            peak = fabsf(window[TRUE_PEAK_TAPS - 1 - TRUE_PEAK_DELAY]);
+        }
+    }
+    d->pos = (d->pos + 1) % TRUE_PEAK_TAPS;
+    return peak;
+}
+
+static uint64_t DoubleBits(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static double BitsDouble(uint64_t bits) {
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static double EnergyLoudness(double energy) {
+    return energy > 0.0 ? -0.691 + 10.0 * log10(energy) : -INFINITY;
+}
+
+static double ToDecibels(float level) {
+    return level > 0.0f ? 20.0 * log10(level) : -INFINITY;
+}
+
+// The two K-weighting stages of BS.1770, redesigned for the sample rate by
+// the bilinear transform from the analogue prototypes behind the 48 kHz
+// coefficients the standard lists
+static void DesignKWeighting(LoudnessMeter *m) {
+    double k = tan(M_PI * 1681.974450955533 / m->sampleRate);
+    double q = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+
+    m->shelf[0] = (vh + vb * k / q + k * k) / a0;
+    m->shelf[1] = 2.0 * (k * k - vh) / a0;
+    m->shelf[2] = (vh - vb * k / q + k * k) / a0;
+    m->shelf[3] = 2.0 * (k * k - 1.0) / a0;
+    m->shelf[4] = (1.0 - k / q + k * k) / a0;
+
+    k = tan(M_PI * 38.13547087602444 / m->sampleRate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    m->highpass[0] = 1.0;
+    m->highpass[1] = -2.0;
+    m->highpass[2] = 1.0;
+    m->highpass[3] = 2.0 * (k * k - 1.0) / a0;
+    m->highpass[4] = (1.0 - k / q + k * k) / a0;
+}
+
+// Surround channels count 1.41 times and the LFE not at all
+static void AssignWeights(LoudnessMeter *m, const WavFormat *format) {
+    static const uint32_t defaultMasks[] = { 0, 0, 0, 0, 0, 0x37, 0x3F, 0x13F, 0x63F };
+    uint32_t mask = format->channelMask;
+    uint32_t bit = 1;
+
+    if (mask == 0 && m->channels < sizeof(defaultMasks) / sizeof(defaultMasks[0])) mask = defaultMasks[m->channels];
+    for (uint16_t ch = 0; ch < m->channels; ++ch) {
+        m->weight[ch] = 1.0;
+        while (mask && bit && !(mask & bit)) bit <<= 1;
+        if (!mask || !bit) continue;
+        if (bit & SPEAKER_LFE) m->weight[ch] = 0.0;
+        if (bit & SPEAKER_SURROUNDS) m->weight[ch] = SURROUND_WEIGHT;
+        bit <<= 1;
+    }
+}
+
+// K-weights one channel of n interleaved frames and adds its weighted energy
+// to the sub-block
+static void FilterChannel(LoudnessMeter *m, const float *frames, uint32_t n, uint16_t ch) {
+    const double *s = m->shelf;
+    const double *h = m->highpass;
+    double *st = m->state[ch];
+    double s1 = st[0], s2 = st[1], h1 = st[2], h2 = st[3];
+    double sum = 0.0;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        double x = frames[(size_t)i * m->channels + ch];
+        double y = s[0] * x + s1;
+        double z;
+
+        s1 = s[1] * x - s[3] * y + s2;
+        s2 = s[2] * x - s[4] * y;
+        z = h[0] * y + h1;
+        h1 = h[1] * y - h[3] * z + h2;
+        h2 = h[2] * y - h[4] * z;
+        sum += z * z;
+    }
+
+    // Decaying state would otherwise sink into denormals over long silences
+    st[0] = fabs(s1) < DENORMAL_FLOOR ? 0.0 : s1;
+    st[1] = fabs(s2) < DENORMAL_FLOOR ? 0.0 : s2;
+    st[2] = fabs(h1) < DENORMAL_FLOOR ? 0.0 : h1;
+    st[3] = fabs(h2) < DENORMAL_FLOOR ? 0.0 : h2;
+    m->energy += m->weight[ch] * sum;
+}
+
+static void MeasureFrames(LoudnessMeter *m, const float *frames, uint32_t n) {
+    for (uint16_t ch = 0; ch < m->channels; ++ch) {
+        if (m->weight[ch] != 0.0) FilterChannel(m, frames, n, ch);
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        const float *frame = frames + (size_t)i * m->channels;
+        float peak = TruePeakDetectorPush(&m->truePeak, frame);
+
+        if (peak > m->peak) m->peak = peak;
+        for (uint16_t ch = 0; ch < m->channels; ++ch) {
+            if (fabsf(frame[ch]) > m->samplePeak) m->samplePeak = fabsf(frame[ch]);
+        }
+    }
+}
+
+// Silence leaves the filters ringing down, so it is filtered like any input
+static void MeasureSilence(LoudnessMeter *m, uint32_t n) {
+    memset(m->scratch, 0, (size_t)n * m->channels * sizeof(float));
+    for (uint16_t ch = 0; ch < m->channels; ++ch) {
+        if (m->weight[ch] != 0.0) FilterChannel(m, m->scratch, n, ch);
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        float peak = TruePeakDetectorPush(&m->truePeak, NULL);
+        if (peak > m->peak) m->peak = peak;
+    }
+}
+
+static double MeanEnergy(const LoudnessMeter *m, uint32_t subblocks) {
+    double sum = 0.0;
+
+    for (uint32_t i = 0; i < subblocks; ++i) {
+        sum += m->subblocks[(m->subblockCount - 1 - i) % LOUDNESS_SHORT_TERM_SUBBLOCKS];
+    }
+    return sum / subblocks;
+}
+
+// Blocks over the relative gate are those in its bin and above
+static void UpdateIntegrated(LoudnessMeter *m) {
+    double gate;
+    double energy = 0.0;
+    uint64_t count = 0;
+    uint32_t first = 0;
+
+    if (m->gatedBlocks == 0) return;
+    gate = EnergyLoudness(m->gatedEnergy / (double)m->gatedBlocks) + LOUDNESS_RELATIVE_GATE;
+    if (gate > LOUDNESS_ABSOLUTE_GATE) {
+        first = (uint32_t)((gate - LOUDNESS_ABSOLUTE_GATE) / LOUDNESS_HISTOGRAM_STEP);
+        if (first >= m->histogramBins) first = m->histogramBins - 1;
+    }
+    for (uint32_t i = first; i < m->histogramBins; ++i) {
+        count += m->histogramCount[i];
+        energy += m->histogramEnergy[i];
+    }
+    m->integrated = count ? EnergyLoudness(energy / (double)count) : -INFINITY;
+}
+
+static void FinishSubblock(LoudnessMeter *m) {
+    double momentary;
+    double shortTerm;
+
+    m->subblocks[m->subblockCount % LOUDNESS_SHORT_TERM_SUBBLOCKS] = m->energy / m->subblockFrames;
+    m->subblockCount++;
+    m->energy = 0.0;
+    m->framesInSubblock = 0;
+
+    // Windows reaching back before the stream count silence there
+    momentary = MeanEnergy(m, LOUDNESS_MOMENTARY_SUBBLOCKS);
+    shortTerm = MeanEnergy(m, LOUDNESS_SHORT_TERM_SUBBLOCKS);
+    m->momentary = EnergyLoudness(momentary);
+    m->shortTerm = EnergyLoudness(shortTerm);
+    if (m->subblockCount < LOUDNESS_MOMENTARY_SUBBLOCKS) return;
+
+    // Every momentary window is a gating block
+    if (m->momentary > m->maxMomentary) m->maxMomentary = m->momentary;
+    if (m->subblockCount >= LOUDNESS_SHORT_TERM_SUBBLOCKS && m->shortTerm > m->maxShortTerm) {
+        m->maxShortTerm = m->shortTerm;
+    }
+    if (m->momentary > LOUDNESS_ABSOLUTE_GATE) {
+        uint32_t bin = (uint32_t)((m->momentary - LOUDNESS_ABSOLUTE_GATE) / LOUDNESS_HISTOGRAM_STEP);
+
+        if (bin >= m->histogramBins) bin = m->histogramBins - 1;
+        m->histogramCount[bin]++;
+        m->histogramEnergy[bin] += momentary;
+        m->gatedBlocks++;
+        m->gatedEnergy += momentary;
+        UpdateIntegrated(m);
+    }
+}
+
+static void Publish(LoudnessMeter *m) {
+    unsigned sequence = atomic_load_explicit(&m->sequence, memory_order_relaxed);
+    double values[7];
+
+    values[0] = m->integrated;
+    values[1] = m->subblockCount ? m->momentary : -INFINITY;
+    values[2] = m->subblockCount ? m->shortTerm : -INFINITY;
+    values[3] = m->maxMomentary;
+    values[4] = m->maxShortTerm;
+    values[5] = ToDecibels(m->peak);
+    values[6] = ToDecibels(m->samplePeak);
+
+    atomic_store_explicit(&m->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int i = 0; i < 7; ++i) {
+        atomic_store_explicit(&m->published[i], DoubleBits(values[i]), memory_order_relaxed);
+    }
+    atomic_store_explicit(&m->publishedFrames, m->frames, memory_order_relaxed);
+    atomic_store_explicit(&m->sequence, sequence + 2, memory_order_release);
+}
+
+void LoudnessMeterReset(LoudnessMeter *m) {
+    memset(m->state, 0, sizeof(m->state));
+    TruePeakDetectorInit(&m->truePeak, m->channels);
+    m->framesInSubblock = 0;
+    m->energy = 0.0;
+    memset(m->subblocks, 0, sizeof(m->subblocks));
+    m->subblockCount = 0;
+    memset(m->histogramCount, 0, m->histogramBins * sizeof(*m->histogramCount));
+    memset(m->histogramEnergy, 0, m->histogramBins * sizeof(*m->histogramEnergy));
+    m->gatedBlocks = 0;
+    m->gatedEnergy = 0.0;
+    m->integrated = -INFINITY;
+    m->peak = 0.0f;
+    m->samplePeak = 0.0f;
+    m->maxMomentary = -INFINITY;
+    m->maxShortTerm = -INFINITY;
+    m->frames = 0;
+    Publish(m);
+}
+
+int LoudnessMeterInit(LoudnessMeter *m, const WavFormat *format) {
+    SampleFormat inSamples;
+    SampleFormat floatSamples;
+
+    memset(m, 0, sizeof(*m));
+    if (format->channels == 0 || format->channels > LOUDNESS_MAX_CHANNELS) return -1;
+    if (format->sampleRate < LOUDNESS_SUBBLOCKS_PER_SECOND) return -1;
+    if (SampleFormatFromWav(format, &inSamples) != 0) return -1;
+
+    floatSamples = inSamples;
+    floatSamples.type = SAMPLE_F32;
+    SampleConverterInit(&m->toFloat, &inSamples, &floatSamples);
+    m->channels = format->channels;
+    m->sampleRate = format->sampleRate;
+    m->subblockFrames = format->sampleRate / LOUDNESS_SUBBLOCKS_PER_SECOND;
+    DesignKWeighting(m);
+    AssignWeights(m, format);
+
+    m->histogramBins = (uint32_t)((LOUDNESS_HISTOGRAM_TOP - LOUDNESS_ABSOLUTE_GATE) / LOUDNESS_HISTOGRAM_STEP + 0.5);
+    m->histogramCount = (uint64_t *)calloc(m->histogramBins, sizeof(*m->histogramCount));
+    m->histogramEnergy = (double *)calloc(m->histogramBins, sizeof(*m->histogramEnergy));
+    m->scratch = (float *)malloc((size_t)LOUDNESS_SCRATCH_FRAMES * m->channels * sizeof(float));
+    if (!m->histogramCount || !m->histogramEnergy || !m->scratch) {
+        LoudnessMeterClose(m);
+        return -1;
+    }
+
+    atomic_init(&m->sequence, 0);
+    for (size_t i = 0; i < sizeof(m->published) / sizeof(m->published[0]); ++i) atomic_init(&m->published[i], 0);
+    atomic_init(&m->publishedFrames, 0);
+    LoudnessMeterReset(m);
+    return 0;
+}
+
+void LoudnessMeterClose(LoudnessMeter *m) {
+    free(m->scratch);
+    free(m->histogramCount);
+    free(m->histogramEnergy);
+    m->scratch = NULL;
+    m->histogramCount = NULL;
+    m->histogramEnergy = NULL;
+}
+
+void LoudnessMeterProcess(LoudnessMeter *m, const void *frames, uint32_t frameCount) {
+    const uint8_t *src = (const uint8_t *)frames;
+    uint32_t frameBytes = SampleFormatFrameBytes(&m->toFloat.in);
+
+    m->frames += frameCount;
+    while (frameCount > 0) {
+        uint32_t n = m->subblockFrames - m->framesInSubblock;
+        if (n > frameCount) n = frameCount;
+        if (n > LOUDNESS_SCRATCH_FRAMES) n = LOUDNESS_SCRATCH_FRAMES;
+
+        if (!src) {
+            MeasureSilence(m, n);
+        } else if (m->toFloat.in.type != SAMPLE_F32) {
+            SampleConverterRun(&m->toFloat, m->scratch, src, n, NULL);
+            MeasureFrames(m, m->scratch, n);
+        } else {
+            MeasureFrames(m, (const float *)src, n);
+        }
+
+        if (src) src += (size_t)n * frameBytes;
+        frameCount -= n;
+        m->framesInSubblock += n;
+        if (m->framesInSubblock == m->subblockFrames) FinishSubblock(m);
+    }
+    Publish(m);
+}
+
+int LoudnessMeterRead(LoudnessMeter *m, LoudnessSummary *out) {
+    double values[7];
+    unsigned before;
+    unsigned after;
+
+    do {
+        before = atomic_load_explicit(&m->sequence, memory_order_acquire);
+        for (int i = 0; i < 7; ++i) {
+            values[i] = BitsDouble(atomic_load_explicit(&m->published[i], memory_order_relaxed));
+        }
+        out->frames = atomic_load_explicit(&m->publishedFrames, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&m->sequence, memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+
+    out->integrated = values[0];
+    out->momentary = values[1];
+    out->shortTerm = values[2];
+    out->maxMomentary = values[3];
+    out->maxShortTerm = values[4];
+    out->truePeak = values[5];
+    out->samplePeak = values[6];
+    return out->frames >= m->subblockFrames;
+}
+
+void LoudnessSummaryPrint(const LoudnessSummary *summary, FILE *out) {
+    fprintf(out, "Loudness: integrated %.1f LUFS, short-term %.1f LUFS (max %.1f), momentary %.1f LUFS (max %.1f)\n",
+            summary->integrated, summary->shortTerm, summary->maxShortTerm, summary->momentary,
+            summary->maxMomentary);
+    fprintf(out, "  true peak %.1f dBTP, sample peak %.1f dBFS over %llu frames\n", summary->truePeak,
+            summary->samplePeak, (unsigned long long)summary->frames);
+}
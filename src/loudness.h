@@ -0,0 +1,111 @@
+// loudness.h
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "sample_convert.h"
+#include "wav_writer.h"
+
+#define LOUDNESS_MAX_CHANNELS 8
+#define LOUDNESS_SCRATCH_FRAMES 512
+#define LOUDNESS_SUBBLOCKS_PER_SECOND 10      // Gating blocks start every 100 ms
+#define LOUDNESS_MOMENTARY_SUBBLOCKS 4        // 400 ms, also the gating block length
+#define LOUDNESS_SHORT_TERM_SUBBLOCKS 30      // 3 s
+#define LOUDNESS_ABSOLUTE_GATE (-70.0)        // LUFS
+#define LOUDNESS_RELATIVE_GATE (-10.0)        // LU under the loudness of the blocks over the absolute gate
+#define LOUDNESS_HISTOGRAM_STEP 0.01          // LU per bin of gating block loudness
+#define LOUDNESS_HISTOGRAM_TOP 10.0           // LUFS; louder blocks share the top bin
+#define LOUDNESS_DEFAULT_TARGET_LUFS (-23.0)
+#define LOUDNESS_DEFAULT_CEILING_DBTP (-1.0)
+#define TRUE_PEAK_PHASES 4
+#define TRUE_PEAK_TAPS 12                     // Per phase
+#define TRUE_PEAK_DELAY 6                     // Input frames an interpolated peak trails its sample by
+
+// Loudness readings in LUFS and peaks in dB; -INFINITY until there is
+// anything to measure.
+typedef struct {
+    double integrated;            // Gated over everything measured
+    double momentary;             // Last 400 ms
+    double shortTerm;             // Last 3 s
+    double maxMomentary;
+    double maxShortTerm;
+    double truePeak;              // dBTP, over all channels
+    double samplePeak;            // dBFS
+    uint64_t frames;
+} LoudnessSummary;
+
+// 4x oversampling peak detector of ITU-R BS.1770-4 Annex 2. Each pushed frame
+// yields the largest interpolated magnitude over all channels between the
+// samples TRUE_PEAK_DELAY and TRUE_PEAK_DELAY - 1 frames before it, as if the
+// stream were preceded by silence.
+typedef struct {
+    uint16_t channels;
+    uint32_t pos;
+    float history[LOUDNESS_MAX_CHANNELS][2 * TRUE_PEAK_TAPS];   // Each sample twice, so windows are contiguous
+} TruePeakDetector;
+
+void TruePeakDetectorInit(TruePeakDetector *d, uint16_t channels);
+// frame is one interleaved float frame; NULL is silence.
+float TruePeakDetectorPush(TruePeakDetector *d, const float *frame);
+
+// Streaming EBU R128 / ITU-R BS.1770-4 loudness meter. Samples are K-weighted
+// per channel by the standard's two biquads, designed for the actual sample
+// rate, and their weighted energy is summed over 100 ms sub-blocks; a ring of
+// the last 30 sub-blocks gives momentary and short-term loudness. Each 400 ms
+// gating block goes into a histogram of 0.01 LU bins holding block counts and
+// energies, so integrated loudness with its absolute and relative gates is
+// found in a fixed amount of memory however long the stream. Process runs on
+// the thread that feeds it without locking or allocating, and publishes its
+// readings before returning under a sequence number readers retry against,
+// as the level meter does.
+typedef struct {
+    uint16_t channels;
+    uint32_t sampleRate;
+    SampleConverter toFloat;
+    float *scratch;
+
+    double shelf[5];              // b0 b1 b2 a1 a2 of the high shelf
+    double highpass[5];           // and of the RLB highpass
+    double state[LOUDNESS_MAX_CHANNELS][4];   // Transposed direct form II state of both stages
+    double weight[LOUDNESS_MAX_CHANNELS];
+    TruePeakDetector truePeak;
+
+    uint32_t subblockFrames;
+    uint32_t framesInSubblock;
+    double energy;                // Weighted energy of the sub-block so far
+    double subblocks[LOUDNESS_SHORT_TERM_SUBBLOCKS];   // Mean energies, by sub-block count modulo the size
+    uint64_t subblockCount;
+
+    uint64_t *histogramCount;
+    double *histogramEnergy;
+    uint32_t histogramBins;
+    uint64_t gatedBlocks;         // Over the absolute gate
+    double gatedEnergy;
+
+    double momentary;             // At the last sub-block
+    double shortTerm;
+    double integrated;
+    float peak;                   // Interpolated
+    float samplePeak;
+    double maxMomentary;
+    double maxShortTerm;
+    uint64_t frames;
+
+    atomic_uint sequence;         // Odd while readings are being published
+    atomic_uint_fast64_t published[7];    // The summary's doubles as bit patterns
+    atomic_uint_fast64_t publishedFrames;
+} LoudnessMeter;
+
+int LoudnessMeterInit(LoudnessMeter *m, const WavFormat *format);
+void LoudnessMeterClose(LoudnessMeter *m);
+// Starts measuring a new stream in the same format.
+void LoudnessMeterReset(LoudnessMeter *m);
+// frames are interleaved samples in the format given to Init; NULL is silence.
+void LoudnessMeterProcess(LoudnessMeter *m, const void *frames, uint32_t frameCount);
+// Returns 0 until the first sub-block has been measured.
+int LoudnessMeterRead(LoudnessMeter *m, LoudnessSummary *out);
+void LoudnessSummaryPrint(const LoudnessSummary *summary, FILE *out);
+
+#endif // LOUDNESS_H
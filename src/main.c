@@ -6,330 +6,516 @@
 #include "audio_capture.h"
 #include "audio_save.h"
 #include "gui.h"
-
-#define INITIAL_BUFFER_SIZE (1024 * 1024)  // Start with 1MB buffer
-#define BUFFER_GROWTH_FACTOR 2
-#define MAX_RETRY_COUNT 3
-#define RETRY_DELAY_MS 100
+#include "sample_convert.h"
+#include "capture_source.h"
+#include "capture_pipeline.h"
+#include "edit_list.h"
+#include "cli.h"
+#include "take_storage.h"
+#include "audio_playback.h"
+#include "playback.h"
+#include "take_export.h"
+#include "level_meter.h"
+#include "waveform_overview.h"
+#include "spectrum.h"
+#include "loudness.h"
+#include "instrument.h"
+#include "platform.h"
+
+#define CAPTURE_FILE_NAME "capture.wav"
+#define SAVE_FILE_NAME "output.wav"
+#define SAVE_SAMPLE_RATE 44100
+#define TAKE_SPILL_FILE_NAME "capture.take"
+#define INSTRUMENT_FILE_NAME "instrument.json"
+#define CAPTURE_WAIT_MS 200
+#define ARMED_WAIT_MS 10          // How soon an armed take commits after Start
 
 BOOL isRecording = FALSE;
 BOOL isPlaying = FALSE;
-AudioCaptureContext ctx = { 0 };
-HWAVEOUT hWaveOut = NULL;
-WAVEHDR waveHdr = {0};
-BYTE *audioBuffer = NULL;
-BYTE *playbackBuffer = NULL;
-DWORD bufferSize = 0;
-DWORD capturedBytes = 0;
-DWORD playbackBufferSize = 0;
-DWORD g_nSamplesPerSec = 0;
-WORD g_nChannels = 0;
+BOOL isSaving = FALSE;
+CaptureSource *captureSource = NULL;
+TakeStorage take = {0};
+EditList takeEdits;               // Owned by the UI thread
+BOOL editsReady = FALSE;
+OutputSink *playbackSink = NULL;
+PlaybackStream playbackStream;
+HANDLE hPlaybackThread = NULL;
+DWORD playbackThreadId = 0;
+UINT64 playbackStartFrame = 0;
+TakeExport takeExport;
+int exportPercent = 0;
+WavFormat g_captureFormat = {0};
+LevelMeter levelMeter;
+WaveformOverview waveformOverview;
+Spectrogram spectrogram;
+LoudnessMeter loudnessMeter;
+BOOL meterReady = FALSE;
+BOOL overviewReady = FALSE;
+BOOL spectrumReady = FALSE;
+BOOL loudnessReady = FALSE;
+CRITICAL_SECTION levelsLock;
+BOOL preRollEnabled = FALSE;
+BOOL normalizeEnabled = FALSE;
+HANDLE hRecordingThread = NULL; // Owned by the UI thread: set while a recording thread runs
+WavFormat overviewFormat = {0};
 
 // Function prototypes
 void PlayAudio(HWND hwnd);
 void StopAudio();
 void SaveAudio(HWND hwnd);
 
-DWORD WINAPI RecordingThread(LPVOID lpParam)
+static BOOL SameFormat(const WavFormat *a, const WavFormat *b)
 {
-    HWND hwnd = (HWND)lpParam;
-    HRESULT hr;
+    return a->formatTag == b->formatTag && a->channels == b->channels &&
+           a->sampleRate == b->sampleRate && a->bitsPerSample == b->bitsPerSample;
+}
 
-    printf("Starting recording thread\n");
+// Points the display at a newly opened source. The meter and spectrum are fed
+// on the capture thread as soon as the pipeline runs, armed or not; the
+// overview and loudness are fed on the storage thread and keep showing the
+// last take until ResetTakeLevels.
+static void StartLevels(const WavFormat *format, CapturePipelineConfig *config)
+{
+    EnterCriticalSection(&levelsLock);
+    if (meterReady) {
+        LevelMeterClose(&levelMeter);
+    }
+    meterReady = LevelMeterInit(&levelMeter, format, format->sampleRate / METER_BLOCKS_PER_SECOND) == 0;
+    if (spectrumReady) {
+        SpectrogramClose(&spectrogram);
+    }
+    spectrumReady = SpectrogramInit(&spectrogram, format, NULL) == 0;
+    if (!SameFormat(&overviewFormat, format)) {
+        if (overviewReady) WaveformOverviewClose(&waveformOverview);
+        if (loudnessReady) LoudnessMeterClose(&loudnessMeter);
+        overviewReady = FALSE;
+        loudnessReady = FALSE;
+    }
+    if (!overviewReady) overviewReady = WaveformOverviewInit(&waveformOverview, format) == 0;
+    if (!loudnessReady) loudnessReady = LoudnessMeterInit(&loudnessMeter, format) == 0;
+    overviewFormat = *format;
+    LeaveCriticalSection(&levelsLock);
+
+    if (meterReady) config->meter = &levelMeter;
+    if (overviewReady) config->overview = &waveformOverview;
+    if (spectrumReady) config->spectrogram = &spectrogram;
+    if (loudnessReady) config->loudness = &loudnessMeter;
+}
 
-    hr = InitializeAudioCapture(&ctx);
-    if (FAILED(hr)) {
-        MessageBox(hwnd, "Failed to initialize audio capture", "Error", MB_OK | MB_ICONERROR);
+static void ResetTakeLevels(void)
+{
+    EnterCriticalSection(&levelsLock);
+    if (overviewReady) WaveformOverviewReset(&waveformOverview);
+    if (loudnessReady) LoudnessMeterReset(&loudnessMeter);
+    LeaveCriticalSection(&levelsLock);
+}
+
+// Pipeline tap: keeps a copy of the take for playback and saving.
+// Runs on the pipeline's storage thread; appending never moves audio already stored.
+static int AppendToTake(void *user, const void *frames, uint32_t frameCount)
+{
+    HWND hwnd = (HWND)user;
+
+    if (TakeStorageAppend(&take, frames, (size_t)frameCount * captureSource->blockAlign) != 0) {
+        MessageBox(hwnd, "Failed to grow take storage", "Error", MB_OK | MB_ICONERROR);
         return 1;
     }
+    return 0;
+}
 
-    g_nSamplesPerSec = ctx.pwfx->nSamplesPerSec;
-    g_nChannels = ctx.pwfx->nChannels;
-    printf("Stored format: channels=%d, sample rate=%d\n", g_nChannels, g_nSamplesPerSec);
+// Empties the take for the source about to be stored and makes it current
+static int PrepareTake(HWND hwnd)
+{
+    // Cold audio lives in a mapped scratch file the OS can page out, not in the heap.
+    // A new take in the same format reuses the previous take's chunks.
+    playbackStartFrame = 0;
+    if (take.frameBytes == captureSource->blockAlign) {
+        TakeStorageReset(&take);
+    } else {
+        TakeStorageClose(&take);
+        if (TakeStorageOpen(&take, TAKE_SPILL_FILE_NAME, captureSource->blockAlign) != 0) {
+            take.frameBytes = 0;
+        }
+    }
+    if (take.frameBytes == 0) {
+        MessageBox(hwnd, "Failed to allocate take storage", "Error", MB_OK | MB_ICONERROR);
+        return -1;
+    }
 
-    bufferSize = INITIAL_BUFFER_SIZE;
-    audioBuffer = (BYTE*)malloc(bufferSize);
-    if (!audioBuffer) {
-        MessageBox(hwnd, "Failed to allocate memory for audio buffer", "Error", MB_OK | MB_ICONERROR);
-        CleanupAudioCapture(&ctx);
-        return 1;
+    g_captureFormat = captureSource->format;
+    printf("Stored format: channels=%d, sample rate=%d, bits per sample=%d, tag=0x%04x\n",
+           g_captureFormat.channels, (int)g_captureFormat.sampleRate,
+           g_captureFormat.bitsPerSample, g_captureFormat.formatTag);
+    ResetTakeLevels();
+    return 0;
+}
+
+static int FailRecording(HWND hwnd)
+{
+    if (captureSource) {
+        captureSource->lpVtbl->Destroy(captureSource);
+        captureSource = NULL;
     }
+    isRecording = FALSE;
+    UpdateRecordingStatus(hwnd, FALSE);
+    return 1;
+}
 
-    hr = StartAudioCapture(&ctx);
+// Opens the endpoint and records one take. Armed, the pipeline runs from the
+// start but keeps only the last PRE_ROLL_SECONDS until Start is pressed, so
+// device start-up latency no longer cuts off the beginning.
+static int RecordTake(HWND hwnd)
+{
+    HRESULT hr;
+    CapturePipeline pipeline;
+    CapturePipelineConfig config = {0};
+    BOOL armed = preRollEnabled && !isRecording;
+    BOOL committed = !armed;
+    BOOL stoppedByUser;
+    int result;
+
+    hr = CreateWasapiCaptureSource(CAPTURE_MODE_EVENT, &captureSource);
     if (FAILED(hr)) {
+        MessageBox(hwnd, "Failed to initialize audio capture", "Error", MB_OK | MB_ICONERROR);
+        return FailRecording(hwnd);
+    }
+    printf("Capture mode: %s\n", captureSource->mode == CAPTURE_MODE_EVENT ? "event" : "poll");
+
+    if (!armed && PrepareTake(hwnd) != 0) return FailRecording(hwnd);
+
+    // Stream the take to disk as captured, in the device format
+    config.outPath = CAPTURE_FILE_NAME;
+    config.outFormat = OUTPUT_FORMAT_NATIVE;
+    config.tap = AppendToTake;
+    config.tapUser = hwnd;
+    config.armed = armed;
+    config.preRollSeconds = PRE_ROLL_SECONDS;
+    StartLevels(&captureSource->format, &config);
+
+    if (CapturePipelineStart(&pipeline, captureSource, &config) != 0) {
         MessageBox(hwnd, "Failed to start audio capture", "Error", MB_OK | MB_ICONERROR);
-        CleanupAudioCapture(&ctx);
-        free(audioBuffer);
-        return 1;
+        return FailRecording(hwnd);
     }
 
-    printf("Audio capture started\n");
+    if (armed) {
+        printf("Armed with %d s of pre-roll\n", PRE_ROLL_SECONDS);
+        while (!isRecording && preRollEnabled && CapturePipelineIsRunning(&pipeline)) {
+            Sleep(ARMED_WAIT_MS);
+        }
+        // The take must be ready before the storage thread starts appending to it
+        if (isRecording && CapturePipelineIsRunning(&pipeline) && PrepareTake(hwnd) == 0) {
+            CapturePipelineCommit(&pipeline);
+            committed = TRUE;
+        }
+    }
+    if (committed) printf("Audio capture started\n");
 
-    capturedBytes = 0;
-    while (isRecording) {
-        Sleep(10);  // Sleep to prevent busy waiting
+    while (committed && isRecording && CapturePipelineIsRunning(&pipeline)) {
+        Sleep(CAPTURE_WAIT_MS);
+    }
+    stoppedByUser = !isRecording;
 
-        UINT32 packetLength = 0;
-        hr = ctx.pCaptureClient->lpVtbl->GetNextPacketSize(ctx.pCaptureClient, &packetLength);
-        if (FAILED(hr)) break;
+    CapturePipelineRequestStop(&pipeline);
+    result = CapturePipelineWait(&pipeline);
+    if (result != 0) {
+        printf("Recording stopped with errors\n");
+    }
 
-        while (packetLength != 0) {
-            BYTE *pData;
-            DWORD flags;
+    if (committed) {
+        printf("Recording stopped. Captured %llu bytes%s\n", (unsigned long long)take.length,
+               take.fileBacked ? " (file-backed)" : "");
+        CapturePipelinePrintStats(&pipeline, stdout);
+        InstrumentPrint(stdout);
+    }
 
-            hr = ctx.pCaptureClient->lpVtbl->GetBuffer(ctx.pCaptureClient, &pData, &packetLength, &flags, NULL, NULL);
-            if (FAILED(hr)) break;
+    captureSource->lpVtbl->Destroy(captureSource);
+    captureSource = NULL;
 
-            UINT32 frameCount = packetLength;
-            UINT32 bytesPerFrame = ctx.blockAlign;
-            UINT32 totalBytes = frameCount * bytesPerFrame;
+    // A Start pressed while this take was finishing is left for the next one
+    if (!stoppedByUser || !committed) isRecording = FALSE;
+    UpdateRecordingStatus(hwnd, isRecording);
 
-            if (capturedBytes + totalBytes > bufferSize) {
-                DWORD newBufferSize = bufferSize * BUFFER_GROWTH_FACTOR;
-                BYTE *newBuffer = (BYTE*)realloc(audioBuffer, newBufferSize);
-                if (!newBuffer) {
-                    MessageBox(hwnd, "Failed to grow audio buffer", "Error", MB_OK | MB_ICONERROR);
-                    isRecording = FALSE;
-                    break;
-                }
-                audioBuffer = newBuffer;
-                bufferSize = newBufferSize;
-                printf("Grew audio buffer to %u bytes\n", bufferSize);
-            }
+    return result == 0 ? 0 : 1;
+}
 
-            if (flags & AUDCLNT_BUFFERFLAGS_SILENT) {
-                memset(audioBuffer + capturedBytes, 0, totalBytes);
-            } else {
-                memcpy(audioBuffer + capturedBytes, pData, totalBytes);
-            }
-            capturedBytes += totalBytes;
+// Records takes back to back while pre-roll is on, re-arming after each one
+DWORD WINAPI RecordingThread(LPVOID lpParam)
+{
+    HWND hwnd = (HWND)lpParam;
+    int result;
 
-            hr = ctx.pCaptureClient->lpVtbl->ReleaseBuffer(ctx.pCaptureClient, frameCount);
-            if (FAILED(hr)) break;
+    printf("Starting recording thread\n");
+    do {
+        result = RecordTake(hwnd);
+    } while (result == 0 && (preRollEnabled || isRecording));
 
-            hr = ctx.pCaptureClient->lpVtbl->GetNextPacketSize(ctx.pCaptureClient, &packetLength);
-            if (FAILED(hr)) break;
-        }
+    // The UI thread joins this one and starts another if Start or pre-roll came in meanwhile
+    PostMessage(hwnd, WM_USER + 10, (WPARAM)result, 0);
+    return result;
+}
 
-        if (FAILED(hr)) break;
+static void StartRecordingThread(HWND hwnd)
+{
+    if (hRecordingThread) return;
+    hRecordingThread = CreateThread(NULL, 0, RecordingThread, hwnd, 0, NULL);
+    if (!hRecordingThread && isRecording) {
+        isRecording = FALSE;
+        UpdateRecordingStatus(hwnd, FALSE);
     }
+}
 
-    printf("Recording stopped. Captured %u bytes\n", capturedBytes);
+// Runs on the UI thread once the recording thread has posted that it is done
+static void FinishRecordingThread(HWND hwnd, int result)
+{
+    if (!hRecordingThread) return;
+    WaitForSingleObject(hRecordingThread, INFINITE);
+    CloseHandle(hRecordingThread);
+    hRecordingThread = NULL;
+
+    // A failed take already reported its error; retrying would only repeat it
+    if (result == 0 && (isRecording || preRollEnabled)) {
+        StartRecordingThread(hwnd);
+    } else {
+        UpdateRecordingStatus(hwnd, isRecording);
+    }
+}
 
-    ctx.pAudioClient->lpVtbl->Stop(ctx.pAudioClient);
-    CleanupAudioCapture(&ctx);
+// Keeps the waveOut ring topped up until the take ends or playback is stopped
+DWORD WINAPI PlaybackThread(LPVOID lpParam)
+{
+    HWND hwnd = (HWND)lpParam;
 
-    UpdateRecordingStatus(hwnd, FALSE);
-    isRecording = FALSE;
+    while (PlaybackStreamPump(&playbackStream, PLAYBACK_WAIT_MS) > 0) {
+    }
 
+    // Tag the message so a late one cannot end a newer playback
+    PostMessage(hwnd, WM_USER + 5, (WPARAM)GetCurrentThreadId(), 0);
     return 0;
 }
 
+// The edits are opened over the take once it is complete and dropped when the next one starts
+static BOOL OpenTakeEdits(void)
+{
+    if (!editsReady) {
+        TakeSlice slice = TakeStorageSlice(&take, 0, TakeStorageFrames(&take));
+        editsReady = EditListOpen(&takeEdits, &slice, &g_captureFormat) == 0;
+    }
+    return editsReady;
+}
+
+static void CloseTakeEdits(void)
+{
+    if (editsReady) EditListClose(&takeEdits);
+    editsReady = FALSE;
+}
+
 void PlayAudio(HWND hwnd)
 {
     printf("PlayAudio called\n");
 
-    if (!audioBuffer || capturedBytes == 0 || g_nChannels == 0 || g_nSamplesPerSec == 0) {
+    if (take.length == 0 || g_captureFormat.channels == 0 || g_captureFormat.sampleRate == 0) {
         MessageBox(hwnd, "No valid audio data to play", "Error", MB_OK | MB_ICONERROR);
         return;
     }
 
     StopAudio();
-    Sleep(RETRY_DELAY_MS);
-
-    int sampleCount = capturedBytes / sizeof(float);
-    short *convertedBuffer = (short *)malloc(sampleCount * sizeof(short));
-    if (!convertedBuffer) {
-        MessageBox(hwnd, "Failed to allocate memory for playback", "Error", MB_OK | MB_ICONERROR);
-        return;
-    }
-
-    float *floatData = (float *)audioBuffer;
-    for (int i = 0; i < sampleCount; ++i) {
-        float sample = floatData[i];
-        if (sample > 1.0f) sample = 1.0f;
-        if (sample < -1.0f) sample = -1.0f;
-        convertedBuffer[i] = (short)(sample * 32767);
-    }
-
-    playbackBufferSize = sampleCount * sizeof(short);
-    playbackBuffer = (BYTE *)convertedBuffer;
 
-    printf("Converted %d samples for playback\n", sampleCount);
-
-    WAVEFORMATEX wfx = {0};
-    wfx.wFormatTag = WAVE_FORMAT_PCM;
-    wfx.nChannels = g_nChannels;
-    wfx.nSamplesPerSec = g_nSamplesPerSec;
-    wfx.wBitsPerSample = 16;
-    wfx.nBlockAlign = (wfx.nChannels * wfx.wBitsPerSample) / 8;
-    wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * wfx.nBlockAlign;
-
-    printf("Attempting to open with format: channels=%d, sample rate=%d, bits per sample=%d\n",
-           wfx.nChannels, wfx.nSamplesPerSec, wfx.wBitsPerSample);
-
-    MMRESULT result;
-    int retryCount = 0;
-    do {
-        result = waveOutOpen(&hWaveOut, WAVE_MAPPER, &wfx, (DWORD_PTR)hwnd, 0, CALLBACK_WINDOW);
-        if (result != MMSYSERR_NOERROR) {
-            char errorMsg[256];
-            waveOutGetErrorTextA(result, errorMsg, sizeof(errorMsg));
-            printf("waveOutOpen failed. Error: %s (code %d), retrying...\n", errorMsg, result);
-            Sleep(RETRY_DELAY_MS);
-            retryCount++;
-        }
-    } while (result != MMSYSERR_NOERROR && retryCount < MAX_RETRY_COUNT);
-
-    if (result != MMSYSERR_NOERROR) {
-        char errorMsg[256];
-        waveOutGetErrorTextA(result, errorMsg, sizeof(errorMsg));
-        char fullErrorMsg[512];
-        snprintf(fullErrorMsg, sizeof(fullErrorMsg), "Failed to open audio output device.\nError: %s (code %d)", errorMsg, result);
-        MessageBox(hwnd, fullErrorMsg, "Error", MB_OK | MB_ICONERROR);
-        free(playbackBuffer);
-        playbackBuffer = NULL;
+    if (FAILED(CreateWaveOutSink(&playbackSink))) {
+        MessageBox(hwnd, "Failed to create audio output", "Error", MB_OK | MB_ICONERROR);
         return;
     }
 
-    printf("waveOutOpen succeeded\n");
+    // Blocks are converted, or rendered from the edits, just before they are queued,
+    // so playback starts immediately and uses the same memory for any length of take
+    TakeSlice slice = TakeStorageSlice(&take, 0, TakeStorageFrames(&take));
+    const EditList *edits = OpenTakeEdits() ? &takeEdits : NULL;
 
-    memset(&waveHdr, 0, sizeof(WAVEHDR));
-    waveHdr.lpData = (LPSTR)playbackBuffer;
-    waveHdr.dwBufferLength = playbackBufferSize;
-    waveHdr.dwFlags = 0;
-
-    result = waveOutPrepareHeader(hWaveOut, &waveHdr, sizeof(WAVEHDR));
-    if (result != MMSYSERR_NOERROR) {
-        char errorMsg[256];
-        waveOutGetErrorTextA(result, errorMsg, sizeof(errorMsg));
-        printf("Failed to prepare audio header. Error: %s (code %d)\n", errorMsg, result);
-        waveOutClose(hWaveOut);
-        free(playbackBuffer);
-        playbackBuffer = NULL;
-        hWaveOut = NULL;
+    if (PlaybackStreamOpen(&playbackStream, playbackSink, &slice, edits, &g_captureFormat, playbackStartFrame) != 0) {
+        MessageBox(hwnd, "Failed to open audio output device", "Error", MB_OK | MB_ICONERROR);
+        playbackSink->lpVtbl->Destroy(playbackSink);
+        playbackSink = NULL;
         return;
     }
 
-    printf("waveOutPrepareHeader succeeded\n");
-
-    result = waveOutWrite(hWaveOut, &waveHdr, sizeof(WAVEHDR));
-    if (result != MMSYSERR_NOERROR) {
-        char errorMsg[256];
-        waveOutGetErrorTextA(result, errorMsg, sizeof(errorMsg));
-        printf("Failed to write audio data. Error: %s (code %d)\n", errorMsg, result);
-        waveOutUnprepareHeader(hWaveOut, &waveHdr, sizeof(WAVEHDR));
-        waveOutClose(hWaveOut);
-        free(playbackBuffer);
-        playbackBuffer = NULL;
-        hWaveOut = NULL;
+    hPlaybackThread = CreateThread(NULL, 0, PlaybackThread, hwnd, 0, &playbackThreadId);
+    if (!hPlaybackThread) {
+        MessageBox(hwnd, "Failed to start playback thread", "Error", MB_OK | MB_ICONERROR);
+        PlaybackStreamClose(&playbackStream);
+        playbackSink->lpVtbl->Destroy(playbackSink);
+        playbackSink = NULL;
         return;
     }
 
-    printf("waveOutWrite succeeded\n");
-
+    printf("Playback started at frame %llu\n", (unsigned long long)playbackStartFrame);
     isPlaying = TRUE;
     UpdatePlayStatus(isPlaying);
 }
 
-void StopAudio()
+// Joins the playback thread and releases the output device
+static void FinishPlayback()
 {
-    printf("StopAudio called. isPlaying: %d, hWaveOut: %p\n", isPlaying, (void*)hWaveOut);
+    WaitForSingleObject(hPlaybackThread, INFINITE);
+    CloseHandle(hPlaybackThread);
+    hPlaybackThread = NULL;
+    playbackThreadId = 0;
 
-    if (isPlaying || hWaveOut) {
-        if (hWaveOut) {
-            MMRESULT result;
+    // Stopping early leaves the next Play resuming where this one left off
+    playbackStartFrame = PlaybackStreamPosition(&playbackStream);
+    if (playbackStartFrame >= playbackStream.frameCount) playbackStartFrame = 0;
 
-            result = waveOutReset(hWaveOut);
-            printf("waveOutReset result: %d\n", result);
+    PlaybackStatsPrint(&playbackStream.stats, stdout);
+    PlaybackStreamClose(&playbackStream);
+    playbackSink->lpVtbl->Destroy(playbackSink);
+    playbackSink = NULL;
 
-            result = waveOutUnprepareHeader(hWaveOut, &waveHdr, sizeof(WAVEHDR));
-            printf("waveOutUnprepareHeader result: %d\n", result);
-
-            result = waveOutClose(hWaveOut);
-            printf("waveOutClose result: %d\n", result);
+    isPlaying = FALSE;
+    UpdatePlayStatus(isPlaying);
+}
 
-            hWaveOut = NULL;
-        }
+void StopAudio()
+{
+    printf("StopAudio called. isPlaying: %d\n", isPlaying);
 
-        if (playbackBuffer) {
-            free(playbackBuffer);
-            playbackBuffer = NULL;
-            printf("Freed playback buffer\n");
-        }
+    if (hPlaybackThread) {
+        PlaybackStreamRequestStop(&playbackStream);
+        FinishPlayback();
+    }
+}
 
-        memset(&waveHdr, 0, sizeof(WAVEHDR));
+// Export callbacks run on the export thread; the UI only hears about them through
+// messages, and only when the percentage moves
+static void PostExportProgress(void *user, uint64_t framesDone, uint64_t framesTotal)
+{
+    int percent = (int)(framesDone * 100 / framesTotal);
 
-        isPlaying = FALSE;
-        UpdatePlayStatus(isPlaying);
+    if (percent != exportPercent) {
+        exportPercent = percent;
+        PostMessage((HWND)user, WM_USER + 6, (WPARAM)percent, 0);
     }
 }
 
+static void PostExportDone(void *user, int result)
+{
+    PostMessage((HWND)user, WM_USER + 7, (WPARAM)result, 0);
+}
+
+// Pressing Save again while an export runs cancels it
 void SaveAudio(HWND hwnd)
 {
-    printf("SaveAudio called\n");
+    printf("SaveAudio called. isSaving: %d\n", isSaving);
 
-    if (!audioBuffer || capturedBytes == 0 || g_nChannels == 0 || g_nSamplesPerSec == 0) {
+    if (isSaving) {
+        TakeExportCancel(&takeExport);
+        return;
+    }
+
+    if (take.length == 0 || g_captureFormat.channels == 0 || g_captureFormat.sampleRate == 0) {
         MessageBox(hwnd, "No valid audio data to save", "Error", MB_OK | MB_ICONERROR);
         return;
     }
 
     StopAudio();
 
-    FILE *file = fopen("output.wav", "wb");
-    if (!file) {
-        MessageBox(hwnd, "Failed to open output.wav for writing", "Error", MB_OK | MB_ICONERROR);
-        return;
+    // Blocks are converted (and resampled to the delivery rate) on a worker per CPU
+    // and written in order off the UI thread
+    TakeSlice slice = TakeStorageSlice(&take, 0, TakeStorageFrames(&take));
+    TakeExportConfig config = {0};
+
+    config.path = SAVE_FILE_NAME;
+    config.outType = SAMPLE_S16;
+    config.outRate = SAVE_SAMPLE_RATE;
+    config.threads = PlatformCpuCount();
+    config.progress = PostExportProgress;
+    config.done = PostExportDone;
+    config.user = hwnd;
+
+    config.edits = OpenTakeEdits() ? &takeEdits : NULL;
+
+    // The take was measured as it was stored, so normalizing needs no extra pass over it;
+    // that measurement does not describe an edited take
+    if (normalizeEnabled && config.edits && !EditListIsIdentity(config.edits)) {
+        printf("The take has been edited; saving it without normalizing\n");
+    } else if (normalizeEnabled) {
+        EnterCriticalSection(&levelsLock);
+        config.normalize = loudnessReady && LoudnessMeterRead(&loudnessMeter, &config.loudness);
+        LeaveCriticalSection(&levelsLock);
+        if (config.normalize) LoudnessSummaryPrint(&config.loudness, stdout);
     }
 
-    int sampleCount = capturedBytes / sizeof(float);
-    short *convertedBuffer = (short *)malloc(sampleCount * sizeof(short));
-    if (!convertedBuffer) {
-        MessageBox(hwnd, "Failed to allocate memory for saving", "Error", MB_OK | MB_ICONERROR);
-        fclose(file);
+    exportPercent = 0;
+    if (TakeExportStart(&takeExport, &slice, &g_captureFormat, &config) != 0) {
+        MessageBox(hwnd, "Failed to open " SAVE_FILE_NAME " for writing", "Error", MB_OK | MB_ICONERROR);
         return;
     }
 
-    float *floatData = (float *)audioBuffer;
-    for (int i = 0; i < sampleCount; ++i) {
-        float sample = floatData[i];
-        if (sample > 1.0f) sample = 1.0f;
-        if (sample < -1.0f) sample = -1.0f;
-        convertedBuffer[i] = (short)(sample * 32767);
-    }
-
-    DWORD dataSize = sampleCount * sizeof(short);
+    isSaving = TRUE;
+    UpdateSaveStatus(TRUE, 0);
+}
 
-    WAVEFORMATEX wfx = {0};
-    wfx.wFormatTag = WAVE_FORMAT_PCM;
-    wfx.nChannels = g_nChannels;
-    wfx.nSamplesPerSec = g_nSamplesPerSec;
-    wfx.wBitsPerSample = 16;
-    wfx.nBlockAlign = (wfx.nChannels * wfx.wBitsPerSample) / 8;
-    wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * wfx.nBlockAlign;
+// Trims off what comes before the point playback stopped at, or undoes or
+// redoes an edit. Nothing is copied, so this is instant for any length of take.
+static void EditTake(int command)
+{
+    int result = -1;
 
-    WriteWavHeader(file, &wfx, dataSize);
+    if (isRecording || isSaving || take.length == 0 || g_captureFormat.channels == 0) return;
+    if (command == ID_TRIM_BUTTON && playbackStartFrame == 0) {
+        printf("Nothing to trim: play the take and stop where it should start\n");
+        return;
+    }
 
-    size_t written = fwrite(convertedBuffer, 1, dataSize, file);
-    free(convertedBuffer);
+    // Playback renders from the edits, so it must not run while they change
+    StopAudio();
+    if (!OpenTakeEdits()) return;
 
-    if (written != dataSize) {
-        char errorMsg[256];
-        snprintf(errorMsg, sizeof(errorMsg), "Failed to write all audio data. Written: %zu, Expected: %lu", written, dataSize);
-        MessageBox(hwnd, errorMsg, "Write Error", MB_OK | MB_ICONERROR);
-        fclose(file);
+    switch (command) {
+    case ID_TRIM_BUTTON: result = EditListCut(&takeEdits, 0, playbackStartFrame); break;
+    case ID_UNDO_BUTTON: result = EditListUndo(&takeEdits); break;
+    case ID_REDO_BUTTON: result = EditListRedo(&takeEdits); break;
+    }
+    if (result != 0) {
+        if (command == ID_TRIM_BUTTON) {
+            printf("Trimming the take failed\n");
+        } else {
+            printf("Nothing to %s\n", command == ID_REDO_BUTTON ? "redo" : "undo");
+        }
         return;
     }
 
-    fclose(file);
+    playbackStartFrame = 0;
+    printf("Take edited to %.3f s in %u regions\n",
+           (double)EditListFrames(&takeEdits) / g_captureFormat.sampleRate, takeEdits.count);
+}
 
-    printf("Audio saved successfully\n");
-    MessageBox(hwnd, "Audio saved successfully", "Success", MB_OK | MB_ICONINFORMATION);
+// Joins the export thread once it has reported its result
+static void FinishSave(HWND hwnd)
+{
+    int result = TakeExportWait(&takeExport);
+
+    TakeExportPrintStats(&takeExport, stdout);
+    InstrumentPrint(stdout);
+    isSaving = FALSE;
+    UpdateSaveStatus(FALSE, 0);
+
+    if (result < 0) {
+        MessageBox(hwnd, "Failed to write all audio data to " SAVE_FILE_NAME, "Write Error", MB_OK | MB_ICONERROR);
+    } else if (result == 0) {
+        printf("Audio saved successfully\n");
+        MessageBox(hwnd, "Audio saved successfully", "Success", MB_OK | MB_ICONINFORMATION);
+    } else {
+        printf("Save cancelled\n");
+    }
 }
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
+    // Any arguments switch to the headless recorder
+    if (__argc > 1) {
+        return RunCommandLine(__argc, __argv);
+    }
+
     printf("Application started\n");
+    InitializeCriticalSection(&levelsLock);
 
     HWND hwnd = InitializeGUI(hInstance, nCmdShow);
     if (hwnd == NULL) {
@@ -343,11 +529,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         if (msg.message == WM_USER + 1) // Start recording
         {
             printf("Received Start Recording message\n");
-            if (!isRecording)
+            if (!isRecording && !isSaving)
             {
+                // The next take replaces this one and its edits
+                StopAudio();
+                CloseTakeEdits();
                 isRecording = TRUE;
                 UpdateRecordingStatus(hwnd, TRUE);
-                CreateThread(NULL, 0, RecordingThread, hwnd, 0, NULL);
+                // An armed thread commits its pre-roll as soon as it sees isRecording
+                StartRecordingThread(hwnd);
             }
         }
         else if (msg.message == WM_USER + 2) // Stop recording
@@ -375,28 +565,43 @@ if (!isPlaying)
             printf("Received Save Audio message\n");
             SaveAudio(hwnd);
         }
-        else if (msg.message == MM_WOM_DONE) // Audio playback finished
+        else if (msg.message == WM_USER + 5) // Playback finished
         {
-            printf("Received MM_WOM_DONE message. hWaveOut: %p\n", (void*)hWaveOut);
-            if (hWaveOut) {
-                MMRESULT result = waveOutUnprepareHeader(hWaveOut, &waveHdr, sizeof(WAVEHDR));
-                printf("waveOutUnprepareHeader result: %d\n", result);
-
-                result = waveOutClose(hWaveOut);
-                printf("waveOutClose result: %d\n", result);
-                hWaveOut = NULL;
+            printf("Received Playback Finished message\n");
+            if (hPlaybackThread && (DWORD)msg.wParam == playbackThreadId)
+            {
+                FinishPlayback();
             }
-
-            if (playbackBuffer) {
-                free(playbackBuffer);
-                playbackBuffer = NULL;
-                printf("Freed playback buffer\n");
+        }
+        else if (msg.message == WM_USER + 6) // Save progress
+        {
+            if (isSaving)
+            {
+                UpdateSaveStatus(TRUE, (int)msg.wParam);
             }
-
-            memset(&waveHdr, 0, sizeof(WAVEHDR));
-
-            isPlaying = FALSE;
-            UpdatePlayStatus(isPlaying);
+        }
+        else if (msg.message == WM_USER + 7) // Save finished
+        {
+            printf("Received Save Finished message\n");
+            if (isSaving)
+            {
+                FinishSave(hwnd);
+            }
+        }
+        else if (msg.message == WM_USER + 8) // Pre-roll on/off
+        {
+            preRollEnabled = (BOOL)msg.wParam;
+            printf("Pre-roll %s\n", preRollEnabled ? "on" : "off");
+            if (preRollEnabled) StartRecordingThread(hwnd);
+            UpdateRecordingStatus(hwnd, isRecording);
+        }
+        else if (msg.message == WM_USER + 9) // Trim, undo or redo
+        {
+            EditTake((int)msg.wParam);
+        }
+        else if (msg.message == WM_USER + 10) // Recording thread finished
+        {
+            FinishRecordingThread(hwnd, (int)msg.wParam);
         }
         else
         {
@@ -405,16 +610,29 @@ if (!isPlaying)
         }
     }
 
-    // Free resources before exiting
-    if (audioBuffer) {
-        free(audioBuffer);
-        audioBuffer = NULL;
-        printf("Freed audio buffer\n");
+    // Free resources before exiting; a save in progress is abandoned
+    preRollEnabled = FALSE;
+    isRecording = FALSE;
+    if (hRecordingThread) {
+        WaitForSingleObject(hRecordingThread, INFINITE);
+        CloseHandle(hRecordingThread);
+    }
+    StopAudio();
+    if (isSaving) {
+        TakeExportCancel(&takeExport);
+        TakeExportWait(&takeExport);
     }
-    if (playbackBuffer) {
-        free(playbackBuffer);
-        playbackBuffer = NULL;
-        printf("Freed playback buffer\n");
+    CloseTakeEdits();
+    TakeStorageClose(&take);
+    if (meterReady) LevelMeterClose(&levelMeter);
+    if (overviewReady) WaveformOverviewClose(&waveformOverview);
+    if (spectrumReady) SpectrogramClose(&spectrogram);
+    if (loudnessReady) LoudnessMeterClose(&loudnessMeter);
+    DeleteCriticalSection(&levelsLock);
+
+    // Everything the session recorded, saved and played, for builds made with INSTRUMENT=1
+    if (INSTRUMENT_ENABLED && InstrumentWriteFile(INSTRUMENT_FILE_NAME) == 0) {
+        printf("Instrumentation written to " INSTRUMENT_FILE_NAME "\n");
     }
 
     printf("Application exiting\n");
@@ -0,0 +1,207 @@
+// mixer_source.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture_mixer.h"
+
+#define MIXER_SOURCE_WAIT_MS 100
+
+typedef struct MixerCaptureSource MixerCaptureSource;
+
+typedef struct {
+    MixerCaptureSource *owner;
+    CaptureSource *source;
+    uint32_t index;
+    PlatformThread thread;
+    int started;
+    int threadStarted;
+} MixerSourceInput;
+
+struct MixerCaptureSource {
+    CaptureSource base;
+    CaptureMixer mixer;
+    MixerSourceInput inputs[MIXER_MAX_INPUTS];
+    uint32_t inputCount;
+    PlatformEvent dataEvent;
+    atomic_int stop;
+    atomic_int error;
+    float *packetBuffer;
+    int pending;                  // Free-run: one packet per wait, as the offline sources deliver
+};
+
+static void PushPacket(void *user, const CapturePacket *packet) {
+    MixerSourceInput *input = (MixerSourceInput *)user;
+    CaptureMixerPush(&input->owner->mixer, input->index, packet);
+}
+
+// One capture thread per input, pumping it into the mixer's queue
+static int InputMain(void *arg) {
+    MixerSourceInput *input = (MixerSourceInput *)arg;
+    MixerCaptureSource *s = input->owner;
+    CaptureSource *src = input->source;
+    RingBuffer *ring = &s->mixer.inputs[input->index].ring;
+
+    while (!atomic_load(&s->stop) && !src->endOfStream) {
+        // Free-running inputs are paced by the mixer instead of overrunning their queue
+        if (src->mode == CAPTURE_MODE_FREERUN && RingBufferWritable(ring) < ring->capacity / 2) {
+            PlatformSleepMs(1);
+            continue;
+        }
+        if (CaptureSourcePump(src, MIXER_SOURCE_WAIT_MS, PushPacket, input) < 0) {
+            atomic_store(&s->error, 1);
+            break;
+        }
+        PlatformEventSignal(&s->dataEvent);
+    }
+
+    CaptureMixerEndInput(&s->mixer, input->index);
+    PlatformEventSignal(&s->dataEvent);
+    return 0;
+}
+
+static void StopInputs(MixerCaptureSource *s) {
+    atomic_store(&s->stop, 1);
+    for (uint32_t i = 0; i < s->inputCount; ++i) {
+        MixerSourceInput *input = &s->inputs[i];
+
+        if (input->threadStarted) PlatformThreadJoin(input->thread);
+        if (input->started) input->source->lpVtbl->Stop(input->source);
+        input->threadStarted = 0;
+        input->started = 0;
+    }
+}
+
+static int MixerStart(CaptureSource *src) {
+    MixerCaptureSource *s = (MixerCaptureSource *)src;
+
+    atomic_store(&s->stop, 0);
+    for (uint32_t i = 0; i < s->inputCount; ++i) {
+        MixerSourceInput *input = &s->inputs[i];
+
+        if (input->source->lpVtbl->Start(input->source) != 0) {
+            StopInputs(s);
+            return -1;
+        }
+        input->started = 1;
+    }
+    for (uint32_t i = 0; i < s->inputCount; ++i) {
+        MixerSourceInput *input = &s->inputs[i];
+
+        if (PlatformThreadCreate(&input->thread, InputMain, input) != 0) {
+            StopInputs(s);
+            return -1;
+        }
+        input->threadStarted = 1;
+    }
+    return 0;
+}
+
+static int MixerWait(CaptureSource *src, uint32_t timeoutMs) {
+    MixerCaptureSource *s = (MixerCaptureSource *)src;
+    int r = PlatformEventWait(&s->dataEvent, timeoutMs);
+
+    s->pending = 1;
+    return r;
+}
+
+static int MixerReadPacket(CaptureSource *src, CapturePacket *packet) {
+    MixerCaptureSource *s = (MixerCaptureSource *)src;
+    uint64_t nextNs;
+    uint32_t frames;
+
+    if (atomic_load(&s->error)) return -1;
+    if (src->endOfStream) return 0;
+    if (src->mode == CAPTURE_MODE_FREERUN && !s->pending) return 0;
+
+    frames = CaptureMixerPull(&s->mixer, s->packetBuffer, MIXER_BLOCK_FRAMES);
+    if (frames == 0) {
+        if (CaptureMixerFinished(&s->mixer)) src->endOfStream = 1;
+        return 0;
+    }
+
+    // The packet starts where the mixer stood before the pull
+    s->pending = 0;
+    nextNs = CaptureMixerTimestamp(&s->mixer);
+    packet->data = (const uint8_t *)s->packetBuffer;
+    packet->frames = frames;
+    packet->flags = 0;
+    packet->timestampNs = nextNs ? nextNs - (uint64_t)frames * 1000000000ull / s->mixer.sampleRate : 0;
+    return 1;
+}
+
+static int MixerReleasePacket(CaptureSource *src, CapturePacket *packet) {
+    (void)src;
+    (void)packet;
+    return 0;
+}
+
+static void MixerStop(CaptureSource *src) {
+    StopInputs((MixerCaptureSource *)src);
+}
+
+static void MixerDestroy(CaptureSource *src) {
+    MixerCaptureSource *s = (MixerCaptureSource *)src;
+
+    StopInputs(s);
+    for (uint32_t i = 0; i < s->inputCount; ++i) s->inputs[i].source->lpVtbl->Destroy(s->inputs[i].source);
+    CaptureMixerClose(&s->mixer);
+    PlatformEventDestroy(&s->dataEvent);
+    free(s->packetBuffer);
+    free(s);
+}
+
+static const CaptureSourceVtbl MixerVtbl = {
+    "mixer",
+    MixerStart,
+    MixerWait,
+    MixerReadPacket,
+    MixerReleasePacket,
+    MixerStop,
+    MixerDestroy
+};
+
+int CreateMixerCaptureSource(CaptureSource *const *inputs, uint32_t count, const CaptureMixerConfig *config,
+                             CaptureSource **out) {
+    WavFormat formats[MIXER_MAX_INPUTS];
+    CaptureMixerConfig mixerConfig = *config;
+    MixerCaptureSource *s;
+    WavFormat format;
+
+    if (count == 0 || count > MIXER_MAX_INPUTS) return -1;
+    for (uint32_t i = 0; i < count; ++i) formats[i] = inputs[i]->format;
+    if (inputs[0]->mode == CAPTURE_MODE_FREERUN) mixerConfig.waitForInputs = 1;
+
+    s = (MixerCaptureSource *)calloc(1, sizeof(*s));
+    if (!s) return -1;
+
+    if (CaptureMixerInit(&s->mixer, formats, count, &mixerConfig) != 0) {
+        free(s);
+        return -1;
+    }
+    s->packetBuffer = (float *)malloc((size_t)MIXER_BLOCK_FRAMES * s->mixer.channels * sizeof(float));
+    if (!s->packetBuffer || PlatformEventInit(&s->dataEvent) != 0) {
+        CaptureMixerClose(&s->mixer);
+        free(s->packetBuffer);
+        free(s);
+        return -1;
+    }
+
+    CaptureMixerOutputFormat(&s->mixer, &format);
+    CaptureSourceInitBase(&s->base, &MixerVtbl, &format, inputs[0]->mode);
+    atomic_init(&s->stop, 0);
+    atomic_init(&s->error, 0);
+    for (uint32_t i = 0; i < count; ++i) {
+        s->inputs[i].owner = s;
+        s->inputs[i].source = inputs[i];
+        s->inputs[i].index = i;
+    }
+    s->inputCount = count;
+
+    *out = &s->base;
+    return 0;
+}
+
+const CaptureMixer *MixerCaptureSourceMixer(const CaptureSource *src) {
+    if (src->lpVtbl != &MixerVtbl) return NULL;
+    return &((const MixerCaptureSource *)src)->mixer;
+}
@@ -0,0 +1,564 @@
+// onset_slicer.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "onset_slicer.h"
+#include "platform.h"
+
+#define ONSET_FLUX_COLUMNS (ONSET_MEDIAN_COLUMNS + 2 * ONSET_LOOKAHEAD_COLUMNS + 1)
+#define ONSET_PEAK (ONSET_MEDIAN_COLUMNS + ONSET_LOOKAHEAD_COLUMNS)    // The candidate's place in flux
+#define ONSET_RISE 4.0f               // The onset sample stands this far over the baseline RMS
+
+int OnsetDetectorInit(OnsetDetector *d, uint32_t sampleRate, const OnsetDetectorConfig *config, OnsetFn onset,
+                      void *user) {
+    double minGap;
+    double binHz;
+    uint32_t edge;
+
+    memset(d, 0, sizeof(*d));
+    if (config) d->config = *config;
+    if (d->config.threshold <= 0) d->config.threshold = SLICER_DEFAULT_THRESHOLD;
+    if (d->config.floorDb == 0) d->config.floorDb = SLICER_DEFAULT_FLOOR_DB;
+    minGap = d->config.minGapSeconds == 0 ? SLICER_DEFAULT_MIN_GAP_SECONDS : d->config.minGapSeconds;
+    if (sampleRate == 0 || !onset) return -1;
+
+    d->sampleRate = sampleRate;
+    d->onset = onset;
+    d->user = user;
+    d->minGapFrames = minGap > 0 ? (uint64_t)(minGap * sampleRate) : 0;
+    d->floorEnergy = (float)(ONSET_BLOCK_FRAMES * pow(10.0, d->config.floorDb / 10.0));
+
+    if (SpectrumPlanInit(&d->plan, ONSET_FFT_SIZE) != 0) return -1;
+    if (SpectrumWorkInit(&d->work, &d->plan) != 0) {
+        SpectrumPlanClose(&d->plan);
+        return -1;
+    }
+    d->frame = (float *)calloc(d->plan.size, sizeof(float));
+    d->magnitudes = (float *)calloc(d->plan.bins, sizeof(float));
+    d->bandEdges = (uint32_t *)calloc(d->plan.bins + 1, sizeof(uint32_t));
+    d->lastLog = (float *)calloc(d->plan.bins, sizeof(float));
+    d->olderLog = (float *)calloc(d->plan.bins, sizeof(float));
+    d->reference = (float *)calloc(d->plan.bins, sizeof(float));
+    if (!d->frame || !d->magnitudes || !d->bandEdges || !d->lastLog || !d->olderLog || !d->reference) {
+        OnsetDetectorClose(d);
+        return -1;
+    }
+
+    // Bands from ONSET_LOWEST_HZ up, log-spaced, but never narrower than a bin
+    binHz = (double)sampleRate / d->plan.size;
+    edge = (uint32_t)(ONSET_LOWEST_HZ / binHz + 0.5);
+    if (edge < 1) edge = 1;
+    for (uint32_t i = 1; edge < d->plan.bins; ++i) {
+        uint32_t next = (uint32_t)(ONSET_LOWEST_HZ * pow(2.0, (double)i / ONSET_BANDS_PER_OCTAVE) / binHz + 0.5);
+
+        d->bandEdges[d->bands++] = edge;
+        edge = next > edge ? next : edge + 1;
+    }
+    d->bandEdges[d->bands] = d->plan.bins;
+    return 0;
+}
+
+void OnsetDetectorClose(OnsetDetector *d) {
+    SpectrumWorkClose(&d->work);
+    SpectrumPlanClose(&d->plan);
+    free(d->frame);
+    free(d->magnitudes);
+    free(d->bandEdges);
+    free(d->lastLog);
+    free(d->olderLog);
+    free(d->reference);
+    d->frame = NULL;
+    d->magnitudes = NULL;
+    d->bandEdges = NULL;
+    d->lastLog = NULL;
+    d->olderLog = NULL;
+    d->reference = NULL;
+}
+
+// Frames before the stream are silence
+static float HistorySample(const OnsetDetector *d, int64_t frame) {
+    return frame < 0 ? 0.0f : d->history[frame & (ONSET_HISTORY_FRAMES - 1)];
+}
+
+static float BlockEnergy(const OnsetDetector *d, int64_t start) {
+    float e = 0.0f;
+
+    for (int64_t f = start; f < start + ONSET_BLOCK_FRAMES; ++f) {
+        float x = HistorySample(d, f);
+        e += x * x;
+    }
+    return e;
+}
+
+// The loudest of the blocks before, so a low tone's ripple does not read as a rise
+static float BaselineEnergy(const OnsetDetector *d, int64_t block) {
+    float e = 0.0f;
+
+    for (int j = 1; j <= ONSET_BASELINE_BLOCKS; ++j) {
+        float b = BlockEnergy(d, block - (int64_t)j * ONSET_BLOCK_FRAMES);
+        if (b > e) e = b;
+    }
+    return e;
+}
+
+// Finds the onset inside the window starting at start: the block rising most
+// over the ones before it, then the first sample in or just before that block
+// standing clear of what preceded it. Returns 0 if nothing reaches the floor.
+static int LocateOnset(const OnsetDetector *d, int64_t start, uint64_t *onset) {
+    int64_t end = start + d->plan.size;
+    int64_t lo = start;
+    int64_t oldest = (int64_t)d->frames - ONSET_HISTORY_FRAMES + (ONSET_BASELINE_BLOCKS + 1) * ONSET_BLOCK_FRAMES;
+    float eps = d->floorEnergy * 0.01f;
+    float floorAmp = sqrtf(d->floorEnergy / ONSET_BLOCK_FRAMES);
+    float bestScore = 0.0f;
+    int64_t best = -1;
+    float amp;
+
+    if (d->haveOnset && lo < (int64_t)(d->lastOnset + d->minGapFrames)) lo = (int64_t)(d->lastOnset + d->minGapFrames);
+    if (lo < oldest) lo = oldest;
+
+    for (int64_t b = lo; b + ONSET_BLOCK_FRAMES <= end; b += ONSET_BLOCK_FRAMES) {
+        float e = BlockEnergy(d, b);
+        float score;
+
+        if (e < d->floorEnergy) continue;
+        score = e / (BaselineEnergy(d, b) + eps);
+        if (score > bestScore) {
+            bestScore = score;
+            best = b;
+        }
+    }
+    if (best < 0) return 0;
+
+    // The attack may start in the block before; measure against the blocks before that
+    amp = ONSET_RISE * sqrtf(BaselineEnergy(d, best - ONSET_BLOCK_FRAMES) / ONSET_BLOCK_FRAMES);
+    if (amp < floorAmp) amp = floorAmp;
+    *onset = (uint64_t)best;
+    for (int64_t f = best - ONSET_BLOCK_FRAMES > lo ? best - ONSET_BLOCK_FRAMES : lo; f < best + ONSET_BLOCK_FRAMES;
+         ++f) {
+        if (f >= 0 && fabsf(HistorySample(d, f)) >= amp) {
+            *onset = (uint64_t)f;
+            break;
+        }
+    }
+    return 1;
+}
+
+// Median of the ONSET_MEDIAN_COLUMNS before the candidate, so a loud hit
+// just before does not raise the threshold over a quiet one after it
+static float MedianFlux(const float *flux) {
+    float sorted[ONSET_MEDIAN_COLUMNS];
+
+    for (int i = 0; i < ONSET_MEDIAN_COLUMNS; ++i) {
+        float x = flux[ONSET_PEAK - ONSET_MEDIAN_COLUMNS + i];
+        int j = i;
+
+        for (; j > 0 && sorted[j - 1] > x; --j) sorted[j] = sorted[j - 1];
+        sorted[j] = x;
+    }
+    return 0.5f * (sorted[(ONSET_MEDIAN_COLUMNS - 1) / 2] + sorted[ONSET_MEDIAN_COLUMNS / 2]);
+}
+
+static void AnalyzeColumn(OnsetDetector *d) {
+    float flux = 0.0f;
+    float peak;
+    float median;
+    uint64_t column;
+    uint64_t onset;
+
+    SpectrumTransform(&d->plan, &d->work, d->frame, d->magnitudes);
+    for (uint32_t band = 0; band < d->bands; ++band) {
+        uint32_t lo = band > 0 ? band - 1 : band;
+        uint32_t hi = band + 1 < d->bands ? band + 1 : band;
+        float ref = 0.0f;
+
+        for (uint32_t b = lo; b <= hi; ++b) {
+            if (d->lastLog[b] > ref) ref = d->lastLog[b];
+            if (d->olderLog[b] > ref) ref = d->olderLog[b];
+        }
+        d->reference[band] = ref;
+    }
+    for (uint32_t band = 0; band < d->bands; ++band) {
+        float sum = 0.0f;
+        float level;
+        float rise;
+
+        for (uint32_t k = d->bandEdges[band]; k < d->bandEdges[band + 1]; ++k) sum += d->magnitudes[k];
+        level = log1pf(ONSET_COMPRESSION * sum);
+        rise = level - d->reference[band];
+        if (rise > 0) flux += rise;
+        d->olderLog[band] = d->lastLog[band];
+        d->lastLog[band] = level;
+    }
+    memmove(d->flux, d->flux + 1, (ONSET_FLUX_COLUMNS - 1) * sizeof(float));
+    d->flux[ONSET_FLUX_COLUMNS - 1] = flux / d->bands;
+    if (++d->columns <= ONSET_LOOKAHEAD_COLUMNS) return;
+
+    // Peak-pick the column ONSET_LOOKAHEAD_COLUMNS back, now its neighbours are known
+    peak = d->flux[ONSET_PEAK];
+    for (int j = 1; j <= ONSET_LOOKAHEAD_COLUMNS; ++j) {
+        if (d->flux[ONSET_PEAK - j] >= peak || d->flux[ONSET_PEAK + j] > peak) return;
+    }
+    median = MedianFlux(d->flux);
+    if (peak - median < d->config.threshold) return;
+
+    column = d->columns - 1 - ONSET_LOOKAHEAD_COLUMNS;
+    if (!LocateOnset(d, (int64_t)(column * ONSET_HOP), &onset)) return;
+    d->lastOnset = onset;
+    d->haveOnset = 1;
+    d->onset(d->user, onset, peak - median);
+}
+
+void OnsetDetectorPush(OnsetDetector *d, const float *mono, uint32_t frameCount) {
+    uint32_t size = d->plan.size;
+
+    while (frameCount > 0) {
+        uint32_t n = size - d->filled;
+
+        if (n > frameCount) n = frameCount;
+        for (uint32_t i = 0; i < n; ++i) d->history[(d->frames + i) & (ONSET_HISTORY_FRAMES - 1)] = mono[i];
+        memcpy(d->frame + d->filled, mono, n * sizeof(float));
+        d->frames += n;
+        d->filled += n;
+        mono += n;
+        frameCount -= n;
+
+        if (d->filled == size) {
+            AnalyzeColumn(d);
+            memmove(d->frame, d->frame + ONSET_HOP, (size - ONSET_HOP) * sizeof(float));
+            d->filled = size - ONSET_HOP;
+        }
+    }
+}
+
+void OnsetDetectorFinish(OnsetDetector *d) {
+    static const float silence[ONSET_HOP];
+    uint32_t remaining = d->plan.size + ONSET_LOOKAHEAD_COLUMNS * ONSET_HOP;
+
+    while (remaining > 0) {
+        uint32_t n = remaining < ONSET_HOP ? remaining : ONSET_HOP;
+
+        OnsetDetectorPush(d, silence, n);
+        remaining -= n;
+    }
+}
+
+static uint32_t MsToFrames(double ms, double fallback, uint32_t sampleRate) {
+    if (ms < 0) return 0;
+    if (ms == 0) ms = fallback;
+    return (uint32_t)(ms * sampleRate / 1000.0 + 0.5);
+}
+
+// The mono mix of a frame still in the delay line
+static float DelayMono(const OnsetSlicer *s, uint64_t frame) {
+    const float *x = s->delay + (size_t)(frame % s->delayFrames) * s->channels;
+    float sum = 0.0f;
+
+    for (uint16_t c = 0; c < s->channels; ++c) sum += x[c];
+    return sum;
+}
+
+static void OnOnset(void *user, uint64_t onset, float strength) {
+    OnsetSlicer *s = (OnsetSlicer *)user;
+    uint64_t oldest = s->stats.framesIn > s->delayFrames ? s->stats.framesIn - s->delayFrames : 0;
+    uint64_t target = onset > s->fadeInFrames ? onset - s->fadeInFrames : 0;
+    uint64_t cut = target;
+    SlicerCut *next;
+
+    if (onset >= s->stats.framesIn) return;
+    s->stats.onsets++;
+
+    // Back to the nearest zero crossing of the mono mix, if one is close enough
+    for (uint32_t i = 0; i <= s->snapFrames && target > i && target - i - 1 >= oldest; ++i) {
+        float before = DelayMono(s, target - i - 1);
+        float at = DelayMono(s, target - i);
+
+        if (at == 0.0f || (before < 0.0f) != (at < 0.0f)) {
+            cut = target - i;
+            s->stats.snapped++;
+            break;
+        }
+    }
+
+    if (cut < s->written) return;
+    if ((s->sliceOpen || s->cutCount > 0) && cut <= s->lastCut) return;
+    if (s->cutCount == SLICER_MAX_PENDING) return;
+
+    next = &s->cuts[(s->cutHead + s->cutCount) % SLICER_MAX_PENDING];
+    next->frame = cut;
+    next->onset = onset;
+    next->strength = strength;
+    s->cutCount++;
+    s->lastCut = cut;
+}
+
+int OnsetSlicerInit(OnsetSlicer *s, const WavFormat *format, const OnsetSlicerConfig *config) {
+    SampleFormat inSamples;
+    SampleFormat floatSamples;
+    char path[SLICER_MAX_PATH + 16];
+    size_t len;
+
+    memset(s, 0, sizeof(*s));
+    if (!config->prefix) return -1;
+    len = strlen(config->prefix);
+    if (len == 0 || len >= sizeof(s->prefix)) return -1;
+    if (SampleFormatFromWav(format, &inSamples) != 0) return -1;
+
+    s->config = *config;
+    memcpy(s->prefix, config->prefix, len + 1);
+    s->config.prefix = s->prefix;
+    s->format = *format;
+    s->channels = format->channels;
+    s->frameBytes = SampleFormatFrameBytes(&inSamples);
+    floatSamples = inSamples;
+    floatSamples.type = SAMPLE_F32;
+    SampleConverterInit(&s->toFloat, &inSamples, &floatSamples);
+    SampleConverterInit(&s->fromFloat, &floatSamples, &inSamples);
+
+    s->snapFrames = MsToFrames(config->snapMs, SLICER_DEFAULT_SNAP_MS, format->sampleRate);
+    s->fadeInFrames = MsToFrames(config->fadeInMs, SLICER_DEFAULT_FADE_IN_MS, format->sampleRate);
+    s->fadeOutFrames = MsToFrames(config->fadeOutMs, SLICER_DEFAULT_FADE_OUT_MS, format->sampleRate);
+
+    // Long enough that no cut can land before the writer once the detector reports it
+    s->lagFrames = ONSET_FFT_SIZE + ONSET_LOOKAHEAD_COLUMNS * ONSET_HOP + ONSET_BLOCK_FRAMES + s->snapFrames +
+                   s->fadeInFrames + s->fadeOutFrames;
+    s->delayFrames = s->lagFrames + SLICER_CHUNK_FRAMES + ONSET_BLOCK_FRAMES;
+
+    if (OnsetDetectorInit(&s->detector, format->sampleRate, &config->detector, OnOnset, s) != 0) return -1;
+    s->config.detector = s->detector.config;
+
+    s->delay = (float *)calloc((size_t)s->delayFrames * s->channels, sizeof(float));
+    s->floats = (float *)malloc((size_t)SLICER_CHUNK_FRAMES * s->channels * sizeof(float));
+    s->mono = (float *)malloc(SLICER_CHUNK_FRAMES * sizeof(float));
+    s->out = (uint8_t *)malloc((size_t)SLICER_CHUNK_FRAMES * s->frameBytes);
+    if (!s->delay || !s->floats || !s->mono || !s->out) {
+        OnsetSlicerClose(s);
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s.json", s->prefix);
+    s->map = fopen(path, "w");
+    if (!s->map) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        OnsetSlicerClose(s);
+        return -1;
+    }
+    fprintf(s->map, "{\n  \"sample_rate\": %u,\n  \"channels\": %u,\n  \"slices\": [", format->sampleRate,
+            format->channels);
+    s->stats.startNs = PlatformNowNs();
+    return 0;
+}
+
+static int OpenSlice(OnsetSlicer *s, const SlicerCut *cut) {
+    char path[SLICER_MAX_PATH + 16];
+
+    snprintf(path, sizeof(path), "%s_%03u.wav", s->prefix, (unsigned)s->stats.slices + 1);
+    if (WavWriterOpen(&s->writer, path, &s->format) != 0) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return -1;
+    }
+    s->sliceOpen = 1;
+    s->slice = *cut;
+    s->stats.slices++;
+    return 0;
+}
+
+// Writes text as the inside of a JSON string
+static void WriteJsonText(FILE *f, const char *text) {
+    for (const unsigned char *c = (const unsigned char *)text; *c; ++c) {
+        if (*c == '"' || *c == '\\') fprintf(f, "\\%c", *c);
+        else if (*c < 0x20) fprintf(f, "\\u%04x", *c);
+        else fputc(*c, f);
+    }
+}
+
+// Ends the open slice at the writer's position and adds it to the map
+static int CloseSlice(OnsetSlicer *s) {
+    const char *name = s->prefix;
+    int result;
+
+    if (!s->sliceOpen) return 0;
+    s->sliceOpen = 0;
+    result = WavWriterFinalize(&s->writer);
+
+    // The map sits beside the slices, so it names them without the directory
+    for (const char *p = s->prefix; *p; ++p) {
+        if (*p == '/' || *p == '\\') name = p + 1;
+    }
+    fprintf(s->map, "%s\n    {\"index\": %u, \"file\": \"", s->stats.slices > 1 ? "," : "",
+            (unsigned)s->stats.slices);
+    WriteJsonText(s->map, name);
+    fprintf(s->map,
+            "_%03u.wav\", \"start_frame\": %llu, \"frames\": %llu, \"onset_frame\": %llu, \"strength\": %.3f}",
+            (unsigned)s->stats.slices, (unsigned long long)s->slice.frame,
+            (unsigned long long)(s->written - s->slice.frame), (unsigned long long)s->slice.onset,
+            s->slice.strength);
+    return result;
+}
+
+// Writes frameCount frames from the delay line into the open slice, fading
+// in from its cut and out towards end (UINT64_MAX while it is not known).
+static int WriteFrames(OnsetSlicer *s, uint64_t from, uint32_t frameCount, uint64_t end) {
+    uint32_t pos = (uint32_t)(from % s->delayFrames);
+    uint32_t first = s->delayFrames - pos < frameCount ? s->delayFrames - pos : frameCount;
+    uint16_t channels = s->channels;
+
+    memcpy(s->floats, s->delay + (size_t)pos * channels, (size_t)first * channels * sizeof(float));
+    memcpy(s->floats + (size_t)first * channels, s->delay, (size_t)(frameCount - first) * channels * sizeof(float));
+
+    for (uint64_t f = from; f < from + frameCount && f < s->slice.frame + s->fadeInFrames; ++f) {
+        float gain = (float)(f - s->slice.frame) / s->fadeInFrames;
+        float *x = s->floats + (size_t)(f - from) * channels;
+
+        for (uint16_t c = 0; c < channels; ++c) x[c] *= gain;
+    }
+    if (end != UINT64_MAX && s->fadeOutFrames > 0) {
+        uint64_t fadeStart = end > s->fadeOutFrames ? end - s->fadeOutFrames : 0;
+
+        for (uint64_t f = from > fadeStart ? from : fadeStart; f < from + frameCount; ++f) {
+            float gain = (float)(end - 1 - f) / s->fadeOutFrames;
+            float *x = s->floats + (size_t)(f - from) * channels;
+
+            for (uint16_t c = 0; c < channels; ++c) x[c] *= gain;
+        }
+    }
+
+    SampleConverterRun(&s->fromFloat, s->out, s->floats, frameCount, NULL);
+    if (WavWriterAppend(&s->writer, s->out, frameCount) != 0) return -1;
+    s->stats.framesWritten += frameCount;
+    return 0;
+}
+
+// Moves the writer up to limit, opening a slice at each cut it reaches
+static int Drain(OnsetSlicer *s, uint64_t limit) {
+    while (s->written < limit) {
+        const SlicerCut *cut = s->cutCount > 0 ? &s->cuts[s->cutHead] : NULL;
+        uint64_t end = s->finishing ? s->stats.framesIn : UINT64_MAX;
+        uint64_t stop = limit;
+        uint32_t n;
+
+        if (cut && cut->frame <= s->written) {
+            if (CloseSlice(s) != 0 || OpenSlice(s, cut) != 0) return -1;
+            s->cutHead = (s->cutHead + 1) % SLICER_MAX_PENDING;
+            s->cutCount--;
+            continue;
+        }
+        if (cut) {
+            end = cut->frame;
+            if (end < stop) stop = end;
+        }
+        n = stop - s->written < SLICER_CHUNK_FRAMES ? (uint32_t)(stop - s->written) : SLICER_CHUNK_FRAMES;
+        if (s->sliceOpen && WriteFrames(s, s->written, n, end) != 0) return -1;
+        s->written += n;
+    }
+    return 0;
+}
+
+int OnsetSlicerProcess(OnsetSlicer *s, const void *frames, uint32_t frameCount) {
+    const uint8_t *src = (const uint8_t *)frames;
+    uint16_t channels = s->channels;
+    float gain = 1.0f / channels;
+
+    if (s->stats.error || s->finishing) return -1;
+    while (frameCount > 0) {
+        uint32_t n = frameCount < SLICER_CHUNK_FRAMES ? frameCount : SLICER_CHUNK_FRAMES;
+        uint32_t pos = (uint32_t)(s->stats.framesIn % s->delayFrames);
+        uint32_t first = s->delayFrames - pos < n ? s->delayFrames - pos : n;
+
+        if (src) {
+            SampleConverterRun(&s->toFloat, s->floats, src, n, NULL);
+            src += (size_t)n * s->frameBytes;
+        } else {
+            memset(s->floats, 0, (size_t)n * channels * sizeof(float));
+        }
+        memcpy(s->delay + (size_t)pos * channels, s->floats, (size_t)first * channels * sizeof(float));
+        memcpy(s->delay, s->floats + (size_t)first * channels, (size_t)(n - first) * channels * sizeof(float));
+        for (uint32_t i = 0; i < n; ++i) {
+            float sum = 0.0f;
+
+            for (uint16_t c = 0; c < channels; ++c) sum += s->floats[(size_t)i * channels + c];
+            s->mono[i] = sum * gain;
+        }
+
+        // Counted first, so the onset callback can read these frames back from the delay line
+        s->stats.framesIn += n;
+        OnsetDetectorPush(&s->detector, s->mono, n);
+        if (Drain(s, s->stats.framesIn > s->lagFrames ? s->stats.framesIn - s->lagFrames : 0) != 0) {
+            s->stats.error = 1;
+            return -1;
+        }
+        frameCount -= n;
+    }
+    return 0;
+}
+
+int OnsetSlicerFinish(OnsetSlicer *s) {
+    if (s->finishing) return s->stats.error ? -1 : 0;
+    if (!s->stats.error) {
+        OnsetDetectorFinish(&s->detector);
+        s->finishing = 1;
+        if (Drain(s, s->stats.framesIn) != 0 || CloseSlice(s) != 0) s->stats.error = 1;
+    }
+    s->finishing = 1;
+    fprintf(s->map, "\n  ],\n  \"frames\": %llu,\n  \"onsets\": %llu\n}\n", (unsigned long long)s->stats.framesIn,
+            (unsigned long long)s->stats.onsets);
+    if (fclose(s->map) != 0) s->stats.error = 1;
+    s->map = NULL;
+    s->stats.endNs = PlatformNowNs();
+    return s->stats.error ? -1 : 0;
+}
+
+void OnsetSlicerClose(OnsetSlicer *s) {
+    if (s->sliceOpen) WavWriterFinalize(&s->writer);
+    s->sliceOpen = 0;
+    if (s->map) fclose(s->map);
+    s->map = NULL;
+    OnsetDetectorClose(&s->detector);
+    free(s->delay);
+    free(s->floats);
+    free(s->mono);
+    free(s->out);
+    s->delay = NULL;
+    s->floats = NULL;
+    s->mono = NULL;
+    s->out = NULL;
+}
+
+void OnsetSlicerPrintStats(const OnsetSlicer *s, FILE *out) {
+    const OnsetSlicerStats *st = &s->stats;
+    double audio = (double)st->framesIn / s->format.sampleRate;
+    double wall = st->endNs > st->startNs ? (st->endNs - st->startNs) / 1e9 : 0.0;
+
+    fprintf(out, "Sliced %.2f s of audio at %llu onset(s) into %llu file(s) as %s_NNN.wav, %llu cut(s) snapped to "
+                 "a zero crossing\n",
+            audio, (unsigned long long)st->onsets, (unsigned long long)st->slices, s->prefix,
+            (unsigned long long)st->snapped);
+    fprintf(out, "Slice map: %s.json, %.2f s kept in slices", s->prefix, (double)st->framesWritten / s->format.sampleRate);
+    if (wall > 0) fprintf(out, ", %.0fx real time", audio / wall);
+    fprintf(out, "\n");
+}
+
+int SliceTake(const TakeSlice *slice, const WavFormat *format, const OnsetSlicerConfig *config,
+              OnsetSlicerStats *stats) {
+    OnsetSlicer *s = (OnsetSlicer *)malloc(sizeof(*s));
+    TakeIterator it;
+    const void *ptr;
+    uint32_t n;
+    int result = 0;
+
+    if (!s) return -1;
+    if (OnsetSlicerInit(s, format, config) != 0) {
+        free(s);
+        return -1;
+    }
+    TakeIteratorInit(&it, slice);
+    while (result == 0 && (n = TakeIteratorNext(&it, &ptr, SLICER_CHUNK_FRAMES)) > 0) {
+        result = OnsetSlicerProcess(s, ptr, n);
+    }
+    if (OnsetSlicerFinish(s) != 0) result = -1;
+    if (stats) *stats = s->stats;
+    OnsetSlicerClose(s);
+    free(s);
+    return result;
+}
@@ -0,0 +1,163 @@
+// onset_slicer.h
+#ifndef ONSET_SLICER_H
+#define ONSET_SLICER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "spectrum.h"
+#include "sample_convert.h"
+#include "take_storage.h"
+#include "wav_writer.h"
+
+#define ONSET_FFT_SIZE 1024
+#define ONSET_HOP 256                 // 5.3 ms at 48 kHz
+#define ONSET_MEDIAN_COLUMNS 16       // Flux before a column whose median its threshold is raised by
+#define ONSET_LOOKAHEAD_COLUMNS 2     // A peak must be the largest this many columns either side
+#define ONSET_COMPRESSION 1000.0f     // Magnitudes are compared as log(1 + C * magnitude)
+#define ONSET_BANDS_PER_OCTAVE 6      // Bins are summed into bands this wide, at least one bin each
+#define ONSET_LOWEST_HZ 40.0
+#define ONSET_BLOCK_FRAMES 32         // Energy blocks the onset is located with inside its column
+#define ONSET_BASELINE_BLOCKS 8       // Blocks before each one it is measured against
+#define ONSET_HISTORY_FRAMES 4096     // Mono samples kept for locating onsets, a power of two
+#define SLICER_CHUNK_FRAMES 1024
+#define SLICER_MAX_PENDING 64         // Cuts found but not reached by the writer yet
+#define SLICER_MAX_PATH 512
+#define SLICER_DEFAULT_THRESHOLD 0.05
+#define SLICER_DEFAULT_MIN_GAP_SECONDS 0.05
+#define SLICER_DEFAULT_FLOOR_DB -50.0
+#define SLICER_DEFAULT_SNAP_MS 5.0
+#define SLICER_DEFAULT_FADE_IN_MS 1.0
+#define SLICER_DEFAULT_FADE_OUT_MS 5.0
+
+// frame counts from the start of the stream; strength is the column's flux.
+typedef void (*OnsetFn)(void *user, uint64_t frame, float strength);
+
+typedef struct {
+    double threshold;             // Flux over the recent median that makes an onset; 0: default
+    double minGapSeconds;         // Onsets closer than this to the last one are ignored; 0: default, <0: none
+    double floorDb;               // Onsets quieter than this are ignored; 0: default
+} OnsetDetectorConfig;
+
+// Spectral flux onset detector over a mono stream, as if preceded by
+// silence. Each ONSET_HOP frames a windowed spectrum is taken and summed into
+// log-spaced bands, so a kick weighs as much as a cymbal. Each band's rise in
+// log magnitude over the loudest of it and its neighbours in the two columns
+// before, averaged over the bands, is the flux, which noise flickering
+// between bins and columns hardly moves. A
+// column whose flux is the largest within ONSET_LOOKAHEAD_COLUMNS either side
+// and exceeds the median of the columns before it by the threshold is an onset.
+// The frame is then found inside that column's window from short energy
+// blocks, as the sharpest rise over the blocks before it. Onsets are reported
+// through the callback about fftSize + lookahead * hop frames late.
+typedef struct {
+    OnsetDetectorConfig config;
+    uint32_t sampleRate;
+    OnsetFn onset;
+    void *user;
+    SpectrumPlan plan;
+    SpectrumWork work;
+    float *frame;                 // Mono input for the next column
+    uint32_t filled;
+    float *magnitudes;
+    uint32_t *bandEdges;          // First bin of each band, then the end of the last
+    uint32_t bands;
+    float *lastLog;               // Log band magnitudes of the previous column
+    float *olderLog;              // And of the one before it
+    float *reference;             // What each band's rise is measured from
+    float flux[ONSET_MEDIAN_COLUMNS + 2 * ONSET_LOOKAHEAD_COLUMNS + 1];     // Newest last
+    uint64_t columns;
+    float history[ONSET_HISTORY_FRAMES];  // Mono samples by stream frame, modulo the size
+    uint64_t frames;
+    float floorEnergy;            // Block energy at the floor
+    uint64_t minGapFrames;
+    uint64_t lastOnset;
+    int haveOnset;
+} OnsetDetector;
+
+int OnsetDetectorInit(OnsetDetector *d, uint32_t sampleRate, const OnsetDetectorConfig *config, OnsetFn onset,
+                      void *user);
+void OnsetDetectorClose(OnsetDetector *d);
+void OnsetDetectorPush(OnsetDetector *d, const float *mono, uint32_t frameCount);
+// Runs silence through, so onsets in the last frames are reported too.
+void OnsetDetectorFinish(OnsetDetector *d);
+
+typedef struct {
+    const char *prefix;           // Slices go to PREFIX_001.wav, ... and the map to PREFIX.json
+    OnsetDetectorConfig detector;
+    double snapMs;                // Cuts move back to a zero crossing at most this far; 0: default, <0: off
+    double fadeInMs;              // 0: default, <0: none
+    double fadeOutMs;
+} OnsetSlicerConfig;
+
+typedef struct {
+    uint64_t frame;               // Where the slice starts
+    uint64_t onset;               // The onset it was cut for
+    float strength;
+} SlicerCut;
+
+typedef struct {
+    uint64_t framesIn;
+    uint64_t framesWritten;       // Into slices; audio before the first onset is not kept
+    uint64_t onsets;
+    uint64_t slices;
+    uint64_t snapped;             // Cuts moved to a zero crossing
+    uint64_t startNs;
+    uint64_t endNs;
+    int error;
+} OnsetSlicerStats;
+
+// Cuts a stream into one sample file per onset, in one pass. Audio waits in
+// a delay line long enough for the detector to report an onset before it is
+// written, so each cut is known while the frames on both sides of it are
+// still held: the cut moves back to the nearest zero crossing of the mono
+// mix within snapMs before the onset, less the fade-in, the slice before it
+// fades out into the cut and the slice after it fades in from it. Slices are
+// written in the stream's own format, and each is added to the JSON map as
+// it closes, so memory use does not grow with the stream.
+typedef struct {
+    OnsetSlicerConfig config;
+    char prefix[SLICER_MAX_PATH];
+    WavFormat format;
+    uint16_t channels;
+    uint32_t frameBytes;
+    SampleConverter toFloat;
+    SampleConverter fromFloat;
+    OnsetDetector detector;
+    float *delay;                 // Interleaved float frames by stream frame, modulo delayFrames
+    uint32_t delayFrames;
+    uint32_t lagFrames;           // How far writing trails the input
+    float *floats;                // One chunk, interleaved
+    float *mono;                  // The same chunk for the detector
+    uint8_t *out;                 // One chunk in the stream's format
+
+    SlicerCut cuts[SLICER_MAX_PENDING];   // Oldest first, from cutHead
+    uint32_t cutHead;
+    uint32_t cutCount;
+    uint64_t lastCut;
+    uint32_t snapFrames;
+    uint32_t fadeInFrames;
+    uint32_t fadeOutFrames;
+
+    uint64_t written;             // Stream frames already written or skipped
+    WavWriter writer;
+    int sliceOpen;
+    SlicerCut slice;              // The open slice's cut
+    int finishing;                // The stream has ended at framesIn
+    FILE *map;
+    OnsetSlicerStats stats;
+} OnsetSlicer;
+
+int OnsetSlicerInit(OnsetSlicer *s, const WavFormat *format, const OnsetSlicerConfig *config);
+// frames are interleaved samples in the format given to Init; NULL is silence.
+int OnsetSlicerProcess(OnsetSlicer *s, const void *frames, uint32_t frameCount);
+// Writes the rest of the stream into the last slice and closes the map.
+int OnsetSlicerFinish(OnsetSlicer *s);
+// Frees everything; a slicer that was not finished leaves its files incomplete.
+void OnsetSlicerClose(OnsetSlicer *s);
+void OnsetSlicerPrintStats(const OnsetSlicer *s, FILE *out);
+
+// Slices a stored take in one pass on the calling thread.
+int SliceTake(const TakeSlice *slice, const WavFormat *format, const OnsetSlicerConfig *config,
+              OnsetSlicerStats *stats);
+
+#endif // ONSET_SLICER_H
@@ -0,0 +1,167 @@
+// output_sink.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "output_sink.h"
+#include "platform.h"
+
+#define NS_PER_SEC 1000000000ull
+#define NS_PER_MS 1000000ull
+
+void SinkQueueClear(SinkQueue *q) {
+    q->head = 0;
+    q->count = 0;
+}
+
+int SinkQueuePush(SinkQueue *q, PlaybackBlock *block, uint64_t deadlineNs) {
+    if (q->count == OUTPUT_SINK_MAX_BLOCKS) return -1;
+
+    uint32_t tail = (q->head + q->count) % OUTPUT_SINK_MAX_BLOCKS;
+    q->blocks[tail] = block;
+    q->deadlineNs[tail] = deadlineNs;
+    q->count++;
+    return 0;
+}
+
+PlaybackBlock *SinkQueuePeek(const SinkQueue *q, uint64_t *deadlineNs) {
+    if (q->count == 0) return NULL;
+    if (deadlineNs) *deadlineNs = q->deadlineNs[q->head];
+    return q->blocks[q->head];
+}
+
+PlaybackBlock *SinkQueuePop(SinkQueue *q) {
+    if (q->count == 0) return NULL;
+
+    PlaybackBlock *block = q->blocks[q->head];
+    q->head = (q->head + 1) % OUTPUT_SINK_MAX_BLOCKS;
+    q->count--;
+    return block;
+}
+
+typedef struct {
+    OutputSink base;
+    char *path;
+    int realtime;
+    WavWriter writer;
+    SinkQueue queue;
+    uint64_t playEndNs;           // When the last queued block finishes on the simulated clock
+} FileOutputSink;
+
+static int FileSinkOpen(OutputSink *sink, const WavFormat *format, PlaybackBlock *blocks, uint32_t blockCount) {
+    FileOutputSink *f = (FileOutputSink *)sink;
+    (void)blocks;
+
+    if (blockCount > OUTPUT_SINK_MAX_BLOCKS) return -1;
+
+    sink->format = *format;
+    sink->blockAlign = (uint16_t)(format->channels * (format->bitsPerSample / 8));
+    SinkQueueClear(&f->queue);
+    f->playEndNs = 0;
+
+    if (f->path && WavWriterOpen(&f->writer, f->path, format) != 0) {
+        fprintf(stderr, "Failed to open %s for writing\n", f->path);
+        return -1;
+    }
+    return 0;
+}
+
+static int FileSinkSubmit(OutputSink *sink, PlaybackBlock *block) {
+    FileOutputSink *f = (FileOutputSink *)sink;
+    uint64_t deadline = 0;
+
+    // Blocks play back to back; a block submitted after the queue ran dry starts now
+    if (f->realtime) {
+        uint64_t now = PlatformNowNs();
+        uint64_t start = f->playEndNs > now ? f->playEndNs : now;
+        deadline = start + (uint64_t)block->frames * NS_PER_SEC / sink->format.sampleRate;
+        f->playEndNs = deadline;
+    }
+    return SinkQueuePush(&f->queue, block, deadline);
+}
+
+static int FileSinkWaitDone(OutputSink *sink, uint32_t timeoutMs, PlaybackBlock **done) {
+    FileOutputSink *f = (FileOutputSink *)sink;
+    uint64_t deadline;
+    PlaybackBlock *block = SinkQueuePeek(&f->queue, &deadline);
+
+    if (!block) {
+        PlatformSleepMs(timeoutMs);
+        return 0;
+    }
+
+    if (f->realtime) {
+        uint64_t limit = PlatformNowNs() + (uint64_t)timeoutMs * NS_PER_MS;
+        if (deadline > limit) {
+            PlatformSleepUntilNs(limit);
+            return 0;
+        }
+        PlatformSleepUntilNs(deadline);
+    }
+
+    SinkQueuePop(&f->queue);
+    if (f->writer.file && WavWriterAppend(&f->writer, block->data, block->frames) != 0) return -1;
+
+    *done = block;
+    return 1;
+}
+
+static void FileSinkReset(OutputSink *sink) {
+    FileOutputSink *f = (FileOutputSink *)sink;
+    SinkQueueClear(&f->queue);
+    f->playEndNs = 0;
+}
+
+static void FileSinkClose(OutputSink *sink) {
+    FileOutputSink *f = (FileOutputSink *)sink;
+    FileSinkReset(sink);
+    if (f->writer.file) WavWriterFinalize(&f->writer);
+}
+
+static void FileSinkDestroy(OutputSink *sink) {
+    FileOutputSink *f = (FileOutputSink *)sink;
+    free(f->path);
+    free(f);
+}
+
+static const OutputSinkVtbl FileSinkVtbl = {
+    "file",
+    FileSinkOpen,
+    FileSinkSubmit,
+    FileSinkWaitDone,
+    FileSinkReset,
+    FileSinkClose,
+    FileSinkDestroy
+};
+
+static const OutputSinkVtbl NullSinkVtbl = {
+    "null",
+    FileSinkOpen,
+    FileSinkSubmit,
+    FileSinkWaitDone,
+    FileSinkReset,
+    FileSinkClose,
+    FileSinkDestroy
+};
+
+int CreateFileOutputSink(const char *path, int realtime, OutputSink **out) {
+    FileOutputSink *f = (FileOutputSink *)calloc(1, sizeof(*f));
+    if (!f) return -1;
+
+    if (path) {
+        f->path = (char *)malloc(strlen(path) + 1);
+        if (!f->path) {
+            free(f);
+            return -1;
+        }
+        strcpy(f->path, path);
+    }
+
+    f->base.lpVtbl = path ? &FileSinkVtbl : &NullSinkVtbl;
+    f->realtime = realtime;
+    *out = &f->base;
+    return 0;
+}
+
+int CreateNullOutputSink(int realtime, OutputSink **out) {
+    return CreateFileOutputSink(NULL, realtime, out);
+}
@@ -0,0 +1,64 @@
+// output_sink.h
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "wav_writer.h"
+
+#define OUTPUT_SINK_MAX_BLOCKS 8
+
+// One buffer of playback audio, owned by the playback scheduler and lent to the
+// sink between Submit and WaitDone.
+typedef struct {
+    uint8_t *data;
+    uint32_t capacityFrames;
+    uint32_t frames;              // Frames filled
+    uint64_t startFrame;          // Position of the first frame in what is being played
+    void *sinkData;               // Per-block sink state (the WAVEHDR for waveOut)
+} PlaybackBlock;
+
+typedef struct OutputSink OutputSink;
+
+typedef struct {
+    const char *name;
+    // Prepares the output for format and the given blocks; no block is queued yet.
+    int (*Open)(OutputSink *sink, const WavFormat *format, PlaybackBlock *blocks, uint32_t blockCount);
+    int (*Submit)(OutputSink *sink, PlaybackBlock *block);
+    // Waits for the oldest submitted block to finish playing.
+    // Returns 1 and sets *done, 0 on timeout, -1 on error.
+    int (*WaitDone)(OutputSink *sink, uint32_t timeoutMs, PlaybackBlock **done);
+    // Drops every submitted block; none of them is reported by WaitDone.
+    void (*Reset)(OutputSink *sink);
+    void (*Close)(OutputSink *sink);
+    void (*Destroy)(OutputSink *sink);
+} OutputSinkVtbl;
+
+// Implementations embed this as their first member.
+struct OutputSink {
+    const OutputSinkVtbl *lpVtbl;
+    WavFormat format;
+    uint16_t blockAlign;
+};
+
+// Submitted blocks in order. Sinks complete blocks strictly in submission order.
+typedef struct {
+    PlaybackBlock *blocks[OUTPUT_SINK_MAX_BLOCKS];
+    uint64_t deadlineNs[OUTPUT_SINK_MAX_BLOCKS];
+    uint32_t head;
+    uint32_t count;
+} SinkQueue;
+
+void SinkQueueClear(SinkQueue *q);
+int SinkQueuePush(SinkQueue *q, PlaybackBlock *block, uint64_t deadlineNs);
+PlaybackBlock *SinkQueuePeek(const SinkQueue *q, uint64_t *deadlineNs);
+PlaybackBlock *SinkQueuePop(SinkQueue *q);
+
+// Sink without a device. With a path every block is written to a WAV file as it
+// completes. With realtime set, blocks complete on a simulated device clock, so
+// refill timing and underruns behave as they would on hardware; otherwise every
+// block completes as soon as it is waited for.
+int CreateFileOutputSink(const char *path, int realtime, OutputSink **out);
+int CreateNullOutputSink(int realtime, OutputSink **out);
+
+#endif // OUTPUT_SINK_H
@@ -0,0 +1,457 @@
+// platform.c
+#ifdef _WIN32
+#include <windows.h>
+#define PSAPI_VERSION 2           // GetProcessMemoryInfo from kernel32, no psapi.lib
+#include <psapi.h>
+#else
+#define _GNU_SOURCE               // O_DIRECT and fallocate
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <stdlib.h>
+
+#include "platform.h"
+
+typedef struct {
+    PlatformThreadFn fn;
+    void *arg;
+} ThreadStart;
+
+#define NS_PER_SEC 1000000000ull
+#define NS_PER_MS 1000000ull
+
+#ifdef _WIN32
+
+uint64_t PlatformNowNs(void) {
+    static LARGE_INTEGER freq = {0};
+    LARGE_INTEGER counter;
+
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+
+    // Split to avoid overflowing counter * 1e9
+    uint64_t ticks = (uint64_t)counter.QuadPart;
+    uint64_t f = (uint64_t)freq.QuadPart;
+    return (ticks / f) * NS_PER_SEC + (ticks % f) * NS_PER_SEC / f;
+}
+
+void PlatformSleepMs(uint32_t ms) {
+    Sleep(ms);
+}
+
+void PlatformSleepUntilNs(uint64_t deadlineNs) {
+    uint64_t now = PlatformNowNs();
+    if (deadlineNs > now) Sleep((DWORD)((deadlineNs - now + NS_PER_MS - 1) / NS_PER_MS));
+}
+
+uint32_t PlatformCpuCount(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors : 1;
+}
+
+static DWORD WINAPI ThreadTrampoline(LPVOID param) {
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    return (DWORD)start.fn(start.arg);
+}
+
+int PlatformThreadCreate(PlatformThread *thread, PlatformThreadFn fn, void *arg) {
+    ThreadStart *start = (ThreadStart *)malloc(sizeof(*start));
+    if (!start) return -1;
+
+    start->fn = fn;
+    start->arg = arg;
+    *thread = CreateThread(NULL, 0, ThreadTrampoline, start, 0, NULL);
+    if (!*thread) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+int PlatformThreadJoin(PlatformThread thread) {
+    DWORD code = 0;
+
+    WaitForSingleObject(thread, INFINITE);
+    GetExitCodeThread(thread, &code);
+    CloseHandle(thread);
+    return (int)code;
+}
+
+int PlatformEventInit(PlatformEvent *event) {
+    event->handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+    return event->handle ? 0 : -1;
+}
+
+void PlatformEventDestroy(PlatformEvent *event) {
+    if (event->handle) CloseHandle(event->handle);
+    event->handle = NULL;
+}
+
+void PlatformEventSignal(PlatformEvent *event) {
+    SetEvent(event->handle);
+}
+
+int PlatformEventWait(PlatformEvent *event, uint32_t timeoutMs) {
+    return WaitForSingleObject(event->handle, timeoutMs) == WAIT_OBJECT_0;
+}
+
+int PlatformFileSeek(FILE *file, int64_t offset, int whence) {
+    return _fseeki64(file, offset, whence);
+}
+
+int64_t PlatformFileTell(FILE *file) {
+    return _ftelli64(file);
+}
+
+int PlatformMapFileOpen(PlatformMappedFile *file, const char *path) {
+    HANDLE h = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (h == INVALID_HANDLE_VALUE) return -1;
+
+    file->handle = h;
+    file->size = 0;
+    return 0;
+}
+
+void *PlatformMapFileView(PlatformMappedFile *file, uint64_t offset, size_t bytes) {
+    uint64_t end = offset + bytes;
+
+    // Creating a section larger than the file extends the file
+    HANDLE mapping = CreateFileMappingA((HANDLE)file->handle, NULL, PAGE_READWRITE,
+                                        (DWORD)(end >> 32), (DWORD)end, NULL);
+    if (!mapping) return NULL;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset, bytes);
+    // The view keeps the section alive
+    CloseHandle(mapping);
+    if (!view) return NULL;
+
+    if (end > file->size) file->size = end;
+    return view;
+}
+
+void PlatformMapFileUnview(void *view, size_t bytes) {
+    (void)bytes;
+    UnmapViewOfFile(view);
+}
+
+void PlatformMapFileClose(PlatformMappedFile *file) {
+    if (file->handle) CloseHandle((HANDLE)file->handle);
+    file->handle = NULL;
+    file->size = 0;
+}
+
+int PlatformDirectOpen(PlatformDirectFile *file, const char *path) {
+    HANDLE h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, NULL);
+    file->direct = h != INVALID_HANDLE_VALUE;
+    if (!file->direct) {
+        h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (h == INVALID_HANDLE_VALUE) return -1;
+    }
+    file->handle = h;
+    return 0;
+}
+
+int PlatformDirectWrite(PlatformDirectFile *file, uint64_t offset, const void *data, size_t bytes) {
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (bytes > 0) {
+        // On a synchronous handle the OVERLAPPED only carries the position
+        OVERLAPPED at = {0};
+        DWORD chunk = bytes > 0x40000000u ? 0x40000000u : (DWORD)bytes;
+        DWORD written = 0;
+
+        at.Offset = (DWORD)offset;
+        at.OffsetHigh = (DWORD)(offset >> 32);
+        if (!WriteFile((HANDLE)file->handle, p, chunk, &written, &at) || written == 0) return -1;
+        p += written;
+        offset += written;
+        bytes -= written;
+    }
+    return 0;
+}
+
+int PlatformDirectReserve(PlatformDirectFile *file, uint64_t size) {
+    FILE_ALLOCATION_INFO info;
+
+    info.AllocationSize.QuadPart = (LONGLONG)size;
+    return SetFileInformationByHandle((HANDLE)file->handle, FileAllocationInfo, &info, sizeof(info)) ? 0 : -1;
+}
+
+int PlatformDirectTruncate(PlatformDirectFile *file, uint64_t size) {
+    FILE_END_OF_FILE_INFO info;
+
+    info.EndOfFile.QuadPart = (LONGLONG)size;
+    return SetFileInformationByHandle((HANDLE)file->handle, FileEndOfFileInfo, &info, sizeof(info)) ? 0 : -1;
+}
+
+int PlatformDirectClose(PlatformDirectFile *file) {
+    int result = 0;
+
+    if (file->handle && !CloseHandle((HANDLE)file->handle)) result = -1;
+    file->handle = NULL;
+    return result;
+}
+
+void *PlatformAlignedAlloc(size_t bytes) {
+    return VirtualAlloc(NULL, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+void PlatformAlignedFree(void *memory) {
+    if (memory) VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+int PlatformProcessMemory(uint64_t *residentBytes, uint64_t *privateBytes) {
+    PROCESS_MEMORY_COUNTERS_EX counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS *)&counters, sizeof(counters))) {
+        return -1;
+    }
+    *residentBytes = counters.WorkingSetSize;
+    *privateBytes = counters.PrivateUsage;
+    return 0;
+}
+
+#else
+
+uint64_t PlatformNowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+void PlatformSleepMs(uint32_t ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+void PlatformSleepUntilNs(uint64_t deadlineNs) {
+    struct timespec ts = { (time_t)(deadlineNs / NS_PER_SEC), (long)(deadlineNs % NS_PER_SEC) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+uint32_t PlatformCpuCount(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (uint32_t)n : 1;
+}
+
+static void *ThreadTrampoline(void *param) {
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    return (void *)(intptr_t)start.fn(start.arg);
+}
+
+int PlatformThreadCreate(PlatformThread *thread, PlatformThreadFn fn, void *arg) {
+    ThreadStart *start = (ThreadStart *)malloc(sizeof(*start));
+    if (!start) return -1;
+
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(thread, NULL, ThreadTrampoline, start) != 0) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+int PlatformThreadJoin(PlatformThread thread) {
+    void *result = NULL;
+
+    pthread_join(thread, &result);
+    return (int)(intptr_t)result;
+}
+
+int PlatformEventInit(PlatformEvent *event) {
+    pthread_condattr_t attr;
+
+    event->signaled = 0;
+    if (pthread_mutex_init(&event->mutex, NULL) != 0) return -1;
+
+    // Timed waits measure against the monotonic clock, like PlatformNowNs
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int r = pthread_cond_init(&event->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (r != 0) {
+        pthread_mutex_destroy(&event->mutex);
+        return -1;
+    }
+    return 0;
+}
+
+void PlatformEventDestroy(PlatformEvent *event) {
+    pthread_cond_destroy(&event->cond);
+    pthread_mutex_destroy(&event->mutex);
+}
+
+void PlatformEventSignal(PlatformEvent *event) {
+    pthread_mutex_lock(&event->mutex);
+    event->signaled = 1;
+    pthread_cond_signal(&event->cond);
+    pthread_mutex_unlock(&event->mutex);
+}
+
+int PlatformEventWait(PlatformEvent *event, uint32_t timeoutMs) {
+    uint64_t deadline = PlatformNowNs() + (uint64_t)timeoutMs * NS_PER_MS;
+    struct timespec ts = { (time_t)(deadline / NS_PER_SEC), (long)(deadline % NS_PER_SEC) };
+    int signaled;
+
+    pthread_mutex_lock(&event->mutex);
+    while (!event->signaled) {
+        if (pthread_cond_timedwait(&event->cond, &event->mutex, &ts) == ETIMEDOUT) break;
+    }
+    signaled = event->signaled;
+    event->signaled = 0;
+    pthread_mutex_unlock(&event->mutex);
+    return signaled;
+}
+
+int PlatformFileSeek(FILE *file, int64_t offset, int whence) {
+    return fseeko(file, (off_t)offset, whence);
+}
+
+int64_t PlatformFileTell(FILE *file) {
+    return (int64_t)ftello(file);
+}
+
+int PlatformMapFileOpen(PlatformMappedFile *file, const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return -1;
+
+    // Unlinked right away so the file disappears with the last descriptor
+    unlink(path);
+    file->fd = fd;
+    file->size = 0;
+    return 0;
+}
+
+void *PlatformMapFileView(PlatformMappedFile *file, uint64_t offset, size_t bytes) {
+    uint64_t end = offset + bytes;
+
+    // Allocate the blocks up front: a sparse hole that cannot be filled later would
+    // fault inside the capture path instead of failing here
+    if (end > file->size) {
+        if (posix_fallocate(file->fd, (off_t)file->size, (off_t)(end - file->size)) != 0) return NULL;
+        file->size = end;
+    }
+
+    void *view = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, (off_t)offset);
+    return view == MAP_FAILED ? NULL : view;
+}
+
+void PlatformMapFileUnview(void *view, size_t bytes) {
+    munmap(view, bytes);
+}
+
+void PlatformMapFileClose(PlatformMappedFile *file) {
+    if (file->fd >= 0) close(file->fd);
+    file->fd = -1;
+    file->size = 0;
+}
+
+int PlatformDirectOpen(PlatformDirectFile *file, const char *path) {
+    int fd = -1;
+
+    file->direct = 0;
+#ifdef O_DIRECT
+    // tmpfs and some network filesystems refuse O_DIRECT at open
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+    file->direct = fd >= 0;
+#endif
+    if (fd < 0) fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) return -1;
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    file->direct = fcntl(fd, F_NOCACHE, 1) == 0;
+#endif
+    file->fd = fd;
+    return 0;
+}
+
+int PlatformDirectWrite(PlatformDirectFile *file, uint64_t offset, const void *data, size_t bytes) {
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (bytes > 0) {
+        ssize_t written = pwrite(file->fd, p, bytes, (off_t)offset);
+
+        if (written < 0) {
+            if (errno == EINTR) continue;
+#ifdef O_DIRECT
+            // Others accept the flag and only reject the writes; carry on cached
+            if (errno == EINVAL && file->direct) {
+                int flags = fcntl(file->fd, F_GETFL);
+                if (flags >= 0 && fcntl(file->fd, F_SETFL, flags & ~O_DIRECT) == 0) {
+                    file->direct = 0;
+                    continue;
+                }
+            }
+#endif
+            return -1;
+        }
+        p += written;
+        offset += (uint64_t)written;
+        bytes -= (size_t)written;
+    }
+    return 0;
+}
+
+int PlatformDirectReserve(PlatformDirectFile *file, uint64_t size) {
+#ifdef __linux__
+    // Unlike posix_fallocate this never falls back to writing zeros
+    return fallocate(file->fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)size) == 0 ? 0 : -1;
+#else
+    (void)file;
+    (void)size;
+    return -1;
+#endif
+}
+
+int PlatformDirectTruncate(PlatformDirectFile *file, uint64_t size) {
+    return ftruncate(file->fd, (off_t)size) == 0 ? 0 : -1;
+}
+
+int PlatformDirectClose(PlatformDirectFile *file) {
+    int result = 0;
+
+    if (file->fd >= 0 && close(file->fd) != 0) result = -1;
+    file->fd = -1;
+    return result;
+}
+
+void *PlatformAlignedAlloc(size_t bytes) {
+    void *memory = NULL;
+
+    if (posix_memalign(&memory, PLATFORM_DIRECT_ALIGN, bytes) != 0) return NULL;
+    return memory;
+}
+
+void PlatformAlignedFree(void *memory) {
+    free(memory);
+}
+
+int PlatformProcessMemory(uint64_t *residentBytes, uint64_t *privateBytes) {
+#ifdef __linux__
+    unsigned long long size, resident, shared;
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    FILE *f = fopen("/proc/self/statm", "r");
+    int fields = f ? fscanf(f, "%llu %llu %llu", &size, &resident, &shared) : 0;
+
+    if (f) fclose(f);
+    if (fields != 3) return -1;
+    // shared counts the resident pages backed by files
+    *residentBytes = resident * page;
+    *privateBytes = (resident - shared) * page;
+    return 0;
+#else
+    (void)residentBytes;
+    (void)privateBytes;
+    return -1;
+#endif
+}
+
+#endif
@@ -0,0 +1,109 @@
+// platform.h
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+typedef void *PlatformThread;
+#else
+typedef pthread_t PlatformThread;
+#endif
+
+// Auto-reset event: one Signal wakes one Wait, and a Signal with no waiter is remembered.
+typedef struct {
+#ifdef _WIN32
+    void *handle;
+#else
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int signaled;
+#endif
+} PlatformEvent;
+
+typedef int (*PlatformThreadFn)(void *arg);
+
+// Scratch file for memory-mapped storage; deleted when closed (or when the process dies).
+typedef struct {
+#ifdef _WIN32
+    void *handle;
+#else
+    int fd;
+#endif
+    uint64_t size;
+} PlatformMappedFile;
+
+// Mapping offsets must be a multiple of this (the Windows allocation granularity).
+#define PLATFORM_MAP_ALIGN (64 * 1024)
+
+// Output file written around the OS cache (O_DIRECT, FILE_FLAG_NO_BUFFERING)
+// where the filesystem allows it; direct is 0 when it fell back to cached I/O.
+// Direct writes need offsets, lengths and buffers that are multiples of
+// PLATFORM_DIRECT_ALIGN, which covers 512-byte and 4K sectors.
+typedef struct {
+#ifdef _WIN32
+    void *handle;
+#else
+    int fd;
+#endif
+    int direct;
+} PlatformDirectFile;
+
+#define PLATFORM_DIRECT_ALIGN 4096
+
+// Monotonic clock in nanoseconds. On Windows this is QueryPerformanceCounter,
+// the same timebase WASAPI uses for its QPC packet positions.
+uint64_t PlatformNowNs(void);
+
+void PlatformSleepMs(uint32_t ms);
+void PlatformSleepUntilNs(uint64_t deadlineNs);
+
+// Logical processors available to the process; at least 1.
+uint32_t PlatformCpuCount(void);
+
+int PlatformThreadCreate(PlatformThread *thread, PlatformThreadFn fn, void *arg);
+int PlatformThreadJoin(PlatformThread thread);
+
+int PlatformEventInit(PlatformEvent *event);
+void PlatformEventDestroy(PlatformEvent *event);
+void PlatformEventSignal(PlatformEvent *event);
+// Returns 1 if signalled, 0 on timeout.
+int PlatformEventWait(PlatformEvent *event, uint32_t timeoutMs);
+
+// 64-bit file positioning; plain fseek/ftell stop at 2 GiB on Windows.
+int PlatformFileSeek(FILE *file, int64_t offset, int whence);
+int64_t PlatformFileTell(FILE *file);
+
+int PlatformMapFileOpen(PlatformMappedFile *file, const char *path);
+// Maps bytes at offset read/write, growing the file first if needed. Returns NULL on failure.
+void *PlatformMapFileView(PlatformMappedFile *file, uint64_t offset, size_t bytes);
+void PlatformMapFileUnview(void *view, size_t bytes);
+void PlatformMapFileClose(PlatformMappedFile *file);
+
+// Creates or truncates path for writing.
+int PlatformDirectOpen(PlatformDirectFile *file, const char *path);
+// Writes all bytes at offset. Returns 0 on success.
+int PlatformDirectWrite(PlatformDirectFile *file, uint64_t offset, const void *data, size_t bytes);
+// Reserves disk space up to size without changing the file's length. Returns -1
+// where the filesystem cannot.
+int PlatformDirectReserve(PlatformDirectFile *file, uint64_t size);
+// Sets the length, dropping any padding and reservation past it.
+int PlatformDirectTruncate(PlatformDirectFile *file, uint64_t size);
+int PlatformDirectClose(PlatformDirectFile *file);
+
+// Page-aligned memory, as direct writes need.
+void *PlatformAlignedAlloc(size_t bytes);
+void PlatformAlignedFree(void *memory);
+
+// What the process holds right now: its resident set (working set on
+// Windows), and the part of it no file backs, such as heap but not a mapped
+// take. Windows reports the private commit charge for the latter. Returns -1
+// where the OS does not say.
+int PlatformProcessMemory(uint64_t *residentBytes, uint64_t *privateBytes);
+
+#endif // PLATFORM_H
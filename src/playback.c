@@ -0,0 +1,206 @@
+// playback.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "playback.h"
+#include "instrument.h"
+#include "platform.h"
+#include "sample_convert.h"
+
+// Renders the next run of the edit into block.
+static uint32_t FillEditedBlock(PlaybackStream *ps, PlaybackBlock *block) {
+    block->startFrame = ps->nextFrame;
+    block->frames = EditListRender(ps->edits, ps->nextFrame, block->capacityFrames, ps->editFrames);
+    SampleConverterRun(&ps->converter, block->data, ps->editFrames, block->frames, NULL);
+    ps->nextFrame += block->frames;
+    return block->frames;
+}
+
+// Converts the next run of the slice into block. Returns the number of frames filled.
+static uint32_t FillBlock(PlaybackStream *ps, PlaybackBlock *block) {
+    if (ps->edits) return FillEditedBlock(ps, block);
+
+    size_t outFrameBytes = SampleFormatFrameBytes(&ps->converter.out);
+    TakeSlice rest = TakeSliceSub(&ps->slice, ps->nextFrame, block->capacityFrames);
+    TakeIterator it;
+    const void *frames;
+    uint32_t frameCount;
+    uint8_t *out = block->data;
+
+    block->startFrame = ps->nextFrame;
+    block->frames = 0;
+
+    TakeIteratorInit(&it, &rest);
+    while ((frameCount = TakeIteratorNext(&it, &frames, UINT32_MAX)) != 0) {
+        SampleConverterRun(&ps->converter, out, frames, frameCount, NULL);
+        out += (size_t)frameCount * outFrameBytes;
+        block->frames += frameCount;
+    }
+
+    ps->nextFrame += block->frames;
+    return block->frames;
+}
+
+// Fills and queues one block. Returns 1 if queued, 0 at the end of the slice, -1 on error.
+static int QueueBlock(PlaybackStream *ps, PlaybackBlock *block) {
+    uint64_t startNs = PlatformNowNs();
+
+    if (FillBlock(ps, block) == 0) return 0;
+    if (ps->sink->lpVtbl->Submit(ps->sink, block) != 0) return -1;
+    ps->queued++;
+
+    uint64_t elapsed = PlatformNowNs() - startNs;
+    ps->stats.refills++;
+    ps->stats.refillTotalNs += elapsed;
+    if (elapsed > ps->stats.refillMaxNs) ps->stats.refillMaxNs = elapsed;
+    INSTR_RECORD(INSTR_PLAYBACK_FILL_NS, elapsed);
+    return 1;
+}
+
+// Queues every block from nextFrame on; the first one goes out as soon as it is converted.
+static int PrimeBlocks(PlaybackStream *ps) {
+    for (uint32_t i = 0; i < PLAYBACK_BLOCK_COUNT; ++i) {
+        int result = QueueBlock(ps, &ps->blocks[i]);
+        if (result <= 0) return result;
+    }
+    return 0;
+}
+
+int PlaybackStreamOpen(PlaybackStream *ps, OutputSink *sink, const TakeSlice *slice,
+                       const EditList *edits, const WavFormat *format, uint64_t startFrame) {
+    uint64_t openNs = PlatformNowNs();
+    SampleFormat inSamples;
+    SampleFormat outSamples;
+
+    memset(ps, 0, sizeof(*ps));
+    if (SampleFormatFromWav(format, &inSamples) != 0) {
+        fprintf(stderr, "No playback converter for %u-bit input (format 0x%04x)\n",
+                format->bitsPerSample, format->formatTag);
+        return -1;
+    }
+    outSamples = inSamples;
+    outSamples.type = SAMPLE_S16;
+
+    ps->sink = sink;
+    ps->slice = *slice;
+    ps->frameCount = slice->frameCount;
+    // An edit that changes nothing plays faster straight from the slice
+    if (edits && !EditListIsIdentity(edits)) {
+        ps->edits = edits;
+        ps->frameCount = EditListFrames(edits);
+        inSamples.type = SAMPLE_F32;
+    }
+    SampleConverterInit(&ps->converter, &inSamples, &outSamples);
+    ps->inFormat = *format;
+    SampleFormatToWav(&outSamples, format->sampleRate, &ps->outFormat);
+    ps->blockFrames = format->sampleRate * PLAYBACK_BLOCK_MS / 1000;
+    ps->nextFrame = startFrame < ps->frameCount ? startFrame : ps->frameCount;
+    atomic_init(&ps->seekRequest, PLAYBACK_NO_SEEK);
+    atomic_init(&ps->position, ps->nextFrame);
+    atomic_init(&ps->stopRequested, 0);
+
+    size_t blockBytes = (size_t)ps->blockFrames * format->channels * sizeof(int16_t);
+    ps->blockMemory = (uint8_t *)malloc(blockBytes * PLAYBACK_BLOCK_COUNT);
+    if (!ps->blockMemory) return -1;
+    if (ps->edits) {
+        ps->editFrames = (float *)malloc((size_t)ps->blockFrames * format->channels * sizeof(float));
+        if (!ps->editFrames) {
+            free(ps->blockMemory);
+            ps->blockMemory = NULL;
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < PLAYBACK_BLOCK_COUNT; ++i) {
+        ps->blocks[i].data = ps->blockMemory + i * blockBytes;
+        ps->blocks[i].capacityFrames = ps->blockFrames;
+    }
+
+    if (sink->lpVtbl->Open(sink, &ps->outFormat, ps->blocks, PLAYBACK_BLOCK_COUNT) != 0) {
+        free(ps->blockMemory);
+        free(ps->editFrames);
+        ps->blockMemory = NULL;
+        ps->editFrames = NULL;
+        return -1;
+    }
+
+    if (PrimeBlocks(ps) < 0) {
+        PlaybackStreamClose(ps);
+        return -1;
+    }
+    ps->stats.firstBlockNs = PlatformNowNs() - openNs;
+    return 0;
+}
+
+int PlaybackStreamPump(PlaybackStream *ps, uint32_t timeoutMs) {
+    OutputSink *sink = ps->sink;
+    PlaybackBlock *done;
+    uint64_t seek;
+
+    if (atomic_load(&ps->stopRequested)) return 0;
+
+    seek = atomic_exchange(&ps->seekRequest, PLAYBACK_NO_SEEK);
+    if (seek != PLAYBACK_NO_SEEK) {
+        sink->lpVtbl->Reset(sink);
+        ps->queued = 0;
+        ps->nextFrame = seek < ps->frameCount ? seek : ps->frameCount;
+        atomic_store(&ps->position, ps->nextFrame);
+        ps->stats.seeks++;
+        if (PrimeBlocks(ps) < 0) return -1;
+    }
+
+    if (ps->queued == 0) return 0;
+
+    int result = sink->lpVtbl->WaitDone(sink, timeoutMs, &done);
+    if (result <= 0) return result < 0 ? -1 : 1;
+
+    ps->queued--;
+    ps->stats.blocksPlayed++;
+    ps->stats.framesPlayed += done->frames;
+    atomic_store(&ps->position, done->startFrame + done->frames);
+
+    // Everything queued has played but there is more to come: the output went silent
+    if (ps->queued == 0 && ps->nextFrame < ps->frameCount) {
+        ps->stats.underruns++;
+        INSTR_COUNT(INSTR_PLAYBACK_UNDERRUNS);
+    }
+
+    if (QueueBlock(ps, done) < 0) return -1;
+    return ps->queued > 0;
+}
+
+void PlaybackStreamSeek(PlaybackStream *ps, uint64_t frame) {
+    atomic_store(&ps->seekRequest, frame);
+}
+
+void PlaybackStreamRequestStop(PlaybackStream *ps) {
+    atomic_store(&ps->stopRequested, 1);
+}
+
+uint64_t PlaybackStreamPosition(PlaybackStream *ps) {
+    return atomic_load(&ps->position);
+}
+
+void PlaybackStreamClose(PlaybackStream *ps) {
+    if (ps->sink) {
+        ps->sink->lpVtbl->Reset(ps->sink);
+        ps->sink->lpVtbl->Close(ps->sink);
+    }
+    free(ps->blockMemory);
+    free(ps->editFrames);
+    ps->blockMemory = NULL;
+    ps->editFrames = NULL;
+    ps->queued = 0;
+}
+
+void PlaybackStatsPrint(const PlaybackStats *stats, FILE *out) {
+    fprintf(out, "Playback: %llu blocks (%llu frames), %llu underruns, %llu seeks\n",
+            (unsigned long long)stats->blocksPlayed, (unsigned long long)stats->framesPlayed,
+            (unsigned long long)stats->underruns, (unsigned long long)stats->seeks);
+    fprintf(out, "Time to first block: %.2f ms\n", stats->firstBlockNs / 1e6);
+    if (stats->refills > 0) {
+        fprintf(out, "Refill: avg %.3f ms, max %.3f ms over %llu blocks\n",
+                stats->refillTotalNs / 1e6 / stats->refills, stats->refillMaxNs / 1e6,
+                (unsigned long long)stats->refills);
+    }
+}
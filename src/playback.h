@@ -0,0 +1,73 @@
+// playback.h
+#ifndef PLAYBACK_H
+#define PLAYBACK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "edit_list.h"
+#include "output_sink.h"
+#include "sample_convert.h"
+#include "take_storage.h"
+#include "wav_writer.h"
+
+#define PLAYBACK_BLOCK_COUNT 4
+#define PLAYBACK_BLOCK_MS 40
+#define PLAYBACK_WAIT_MS 200
+#define PLAYBACK_NO_SEEK UINT64_MAX
+
+typedef struct {
+    uint64_t blocksPlayed;
+    uint64_t framesPlayed;
+    uint64_t underruns;           // The sink ran dry with audio still to play
+    uint64_t seeks;
+    uint64_t firstBlockNs;        // Open until the first block was queued
+    uint64_t refills;
+    uint64_t refillTotalNs;
+    uint64_t refillMaxNs;
+} PlaybackStats;
+
+// Streams a slice of a take to an output sink through a small ring of blocks,
+// converting each block to 16-bit PCM just before it is queued. Memory use and
+// time to first sample do not depend on the length of the take. Given an edit
+// list, each block is rendered from it instead, and frames count in the edit.
+//
+// Open, Pump and Close must not run concurrently; normally Pump runs on a
+// dedicated playback thread. Seek, RequestStop and Position may be called
+// from any thread.
+typedef struct {
+    OutputSink *sink;
+    TakeSlice slice;
+    const EditList *edits;        // NULL plays the slice as it is
+    float *editFrames;            // One block rendered from the edits
+    uint64_t frameCount;          // Of the slice or the edit
+    WavFormat inFormat;
+    WavFormat outFormat;
+    SampleConverter converter;
+    uint32_t blockFrames;
+    PlaybackBlock blocks[PLAYBACK_BLOCK_COUNT];
+    uint8_t *blockMemory;
+    uint32_t queued;
+    uint64_t nextFrame;           // Next frame to convert
+    atomic_uint_fast64_t seekRequest;
+    atomic_uint_fast64_t position;
+    atomic_int stopRequested;
+    PlaybackStats stats;
+} PlaybackStream;
+
+// Accepts any input format with a sample converter. edits may be NULL, and must
+// be over slice when it is not. Playback starts at startFrame of the slice or edit.
+int PlaybackStreamOpen(PlaybackStream *ps, OutputSink *sink, const TakeSlice *slice,
+                       const EditList *edits, const WavFormat *format, uint64_t startFrame);
+// Waits for one block to finish and refills it. Returns 1 while playing,
+// 0 once everything has played or a stop was requested, -1 on error.
+int PlaybackStreamPump(PlaybackStream *ps, uint32_t timeoutMs);
+void PlaybackStreamSeek(PlaybackStream *ps, uint64_t frame);
+void PlaybackStreamRequestStop(PlaybackStream *ps);
+// Slice or edit frame at the start of the block now playing.
+uint64_t PlaybackStreamPosition(PlaybackStream *ps);
+void PlaybackStreamClose(PlaybackStream *ps);
+
+void PlaybackStatsPrint(const PlaybackStats *stats, FILE *out);
+
+#endif // PLAYBACK_H
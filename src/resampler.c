@@ -0,0 +1,286 @@
+// resampler.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resampler.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RESAMPLER_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static float DotScalar(const float *a, const float *b, uint32_t count) {
+    float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (uint32_t i = 0; i < count; i += 4) {
+        acc[0] += a[i] * b[i];
+        acc[1] += a[i + 1] * b[i + 1];
+        acc[2] += a[i + 2] * b[i + 2];
+        acc[3] += a[i + 3] * b[i + 3];
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+#ifdef RESAMPLER_HAVE_X86
+
+__attribute__((target("sse2")))
+static float DotSse2(const float *a, const float *b, uint32_t count) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    float lanes[4];
+
+    for (uint32_t i = 0; i < count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2")))
+static float DotAvx2(const float *a, const float *b, uint32_t count) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    uint32_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    if (i < count) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#endif // RESAMPLER_HAVE_X86
+
+ResamplerDotFn ResamplerBestDot(void) {
+#ifdef RESAMPLER_HAVE_X86
+    switch (ConvertBestKernel()) {
+    case CONVERT_KERNEL_AVX2: return DotAvx2;
+    case CONVERT_KERNEL_SSE2: return DotSse2;
+    default: break;
+    }
+#endif
+    return DotScalar;
+}
+
+static uint32_t Gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function of the first kind, by its power series
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+static void BuildFilters(Resampler *r) {
+    uint32_t L = r->upFactor;
+    uint32_t T = r->taps;
+    uint32_t length = L * T;
+    double center = length / 2.0;
+    double attenuation = RESAMPLER_STOPBAND_DB;
+    double beta = 0.1102 * (attenuation - 8.7);
+    double i0Beta = BesselI0(beta);
+    // Kaiser's estimate of the transition width, in cycles per input sample
+    double transition = (attenuation - 8.0) / (2.285 * 2.0 * M_PI * T);
+    double stopband = 0.5 * (r->upFactor < r->downFactor ? (double)L / r->downFactor : 1.0);
+    double cutoff = (stopband - transition / 2.0) / L;
+    double sum = 0.0;
+
+    if (cutoff <= 0.0) cutoff = stopband / (2.0 * L);
+
+    for (uint32_t m = 0; m < length; ++m) {
+        double t = m - center;
+        double x = t / center;
+        double sinc = t == 0.0 ? 1.0 : sin(2.0 * M_PI * cutoff * t) / (M_PI * t * 2.0 * cutoff);
+        double window = BesselI0(beta * sqrt(x * x < 1.0 ? 1.0 - x * x : 0.0)) / i0Beta;
+        double h = 2.0 * cutoff * sinc * window;
+        uint32_t phase = m % L;
+        uint32_t k = m / L;
+
+        r->filters[(size_t)phase * T + (T - 1 - k)] = (float)h;
+        sum += h;
+    }
+
+    // Unity gain at DC for every phase on average
+    for (size_t i = 0; i < length; ++i) r->filters[i] = (float)(r->filters[i] * L / sum);
+}
+
+static int AllocateHistory(Resampler *r) {
+    r->historyStride = r->taps - 1 + RESAMPLER_CHUNK_FRAMES;
+    r->history = (float *)malloc((size_t)r->historyStride * r->channels * sizeof(float));
+    if (!r->history) return -1;
+    ResamplerReset(r);
+    return 0;
+}
+
+int ResamplerInit(Resampler *r, uint32_t inRate, uint32_t outRate, uint16_t channels) {
+    uint32_t g;
+    uint32_t taps;
+
+    memset(r, 0, sizeof(*r));
+    if (inRate == 0 || outRate == 0 || channels == 0 || channels > RESAMPLER_MAX_CHANNELS) return -1;
+
+    g = Gcd(inRate, outRate);
+    r->inRate = inRate;
+    r->outRate = outRate;
+    r->upFactor = outRate / g;
+    r->downFactor = inRate / g;
+    r->channels = channels;
+    if (r->upFactor > RESAMPLER_MAX_PHASES) return -1;
+
+    // Decimating narrows the passband relative to the input, so the filter
+    // needs proportionally more taps for the same transition width
+    taps = RESAMPLER_TAPS;
+    if (r->downFactor > r->upFactor) {
+        taps = (uint32_t)(((uint64_t)RESAMPLER_TAPS * r->downFactor + r->upFactor - 1) / r->upFactor);
+    }
+    r->taps = (taps + 7) & ~7u;
+
+    r->filters = (float *)malloc((size_t)r->upFactor * r->taps * sizeof(float));
+    if (!r->filters) return -1;
+    r->ownsFilters = 1;
+    BuildFilters(r);
+    r->dot = ResamplerBestDot();
+
+    if (AllocateHistory(r) != 0) {
+        free(r->filters);
+        r->filters = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int ResamplerClone(Resampler *r, const Resampler *src) {
+    *r = *src;
+    r->ownsFilters = 0;
+    return AllocateHistory(r);
+}
+
+void ResamplerClose(Resampler *r) {
+    if (r->ownsFilters) free(r->filters);
+    free(r->history);
+    r->filters = NULL;
+    r->history = NULL;
+}
+
+void ResamplerReset(Resampler *r) {
+    memset(r->history, 0, (size_t)r->historyStride * r->channels * sizeof(float));
+    // Starting half a filter in absorbs the delay, so output frame 0 lines up with input frame 0
+    r->phase = 0;
+    r->pos = r->taps / 2;
+    r->inFrames = 0;
+    r->outFrames = 0;
+}
+
+void ResamplerPrime(Resampler *r, const float *in, uint32_t frameCount) {
+    uint32_t keep = r->taps - 1;
+
+    if (frameCount > keep) {
+        in += (size_t)(frameCount - keep) * r->channels;
+        frameCount = keep;
+    }
+    for (uint16_t ch = 0; ch < r->channels; ++ch) {
+        float *h = r->history + (size_t)ch * r->historyStride;
+        memmove(h, h + frameCount, (size_t)(keep - frameCount) * sizeof(float));
+        for (uint32_t i = 0; i < frameCount; ++i) h[keep - frameCount + i] = in[(size_t)i * r->channels + ch];
+    }
+}
+
+uint32_t ResamplerMaxOutput(const Resampler *r, uint32_t frameCount) {
+    return (uint32_t)(((uint64_t)frameCount * r->upFactor + r->downFactor - 1) / r->downFactor) + 1;
+}
+
+// Runs one chunk of at most RESAMPLER_CHUNK_FRAMES input frames
+static uint32_t ProcessChunk(Resampler *r, const float *in, uint32_t frameCount, float *out) {
+    uint32_t keep = r->taps - 1;
+    uint32_t L = r->upFactor;
+    uint32_t M = r->downFactor;
+    uint32_t produced = 0;
+    uint32_t phase = r->phase;
+    uint32_t pos = r->pos;
+
+    for (uint16_t ch = 0; ch < r->channels; ++ch) {
+        float *h = r->history + (size_t)ch * r->historyStride;
+        uint32_t n = 0;
+
+        if (in) {
+            for (uint32_t i = 0; i < frameCount; ++i) h[keep + i] = in[(size_t)i * r->channels + ch];
+        } else {
+            memset(h + keep, 0, (size_t)frameCount * sizeof(float));
+        }
+
+        // Every channel walks the same phase sequence from the saved state
+        phase = r->phase;
+        pos = r->pos;
+        while (pos < frameCount) {
+            out[(size_t)n * r->channels + ch] = r->dot(h + pos, r->filters + (size_t)phase * r->taps, r->taps);
+            phase += M;
+            pos += phase / L;
+            phase %= L;
+            ++n;
+        }
+        produced = n;
+
+        memmove(h, h + frameCount, (size_t)keep * sizeof(float));
+    }
+
+    r->phase = phase;
+    r->pos = pos - frameCount;
+    return produced;
+}
+
+uint32_t ResamplerProcess(Resampler *r, const float *in, uint32_t frameCount, float *out) {
+    uint32_t written = 0;
+
+    r->inFrames += frameCount;
+    while (frameCount > 0) {
+        uint32_t n = frameCount < RESAMPLER_CHUNK_FRAMES ? frameCount : RESAMPLER_CHUNK_FRAMES;
+        written += ProcessChunk(r, in, n, out + (size_t)written * r->channels);
+        if (in) in += (size_t)n * r->channels;
+        frameCount -= n;
+    }
+    r->outFrames += written;
+    return written;
+}
+
+uint32_t ResamplerFlush(Resampler *r, float *out) {
+    uint64_t inFrames = r->inFrames;
+    uint32_t written = ResamplerProcess(r, NULL, r->taps / 2, out);
+
+    // The silence pushed through is not part of the stream
+    r->inFrames = inFrames;
+    return written;
+}
+
+uint64_t ResamplerOutputFrames(uint64_t frameCount, uint32_t inRate, uint32_t outRate) {
+    uint32_t g = Gcd(inRate, outRate);
+    uint64_t up = outRate / g;
+    uint64_t down = inRate / g;
+
+    return (frameCount * up + down - 1) / down;
+}
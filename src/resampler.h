@@ -0,0 +1,64 @@
+// resampler.h
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include "sample_convert.h"
+
+#define RESAMPLER_MAX_CHANNELS 8
+#define RESAMPLER_MAX_PHASES 1024
+#define RESAMPLER_TAPS 128            // Taps per phase at the lower of the two rates
+#define RESAMPLER_STOPBAND_DB 100.0
+#define RESAMPLER_CHUNK_FRAMES 1024
+
+typedef float (*ResamplerDotFn)(const float *a, const float *b, uint32_t count);
+
+// Streaming rational resampler. The Kaiser-windowed sinc prototype is split
+// into upFactor phases of `taps` coefficients each, stored reversed so every
+// output sample is one contiguous dot product over the input history.
+// The stopband starts at the lower Nyquist frequency, so nothing aliases into
+// the output. Output is aligned with the input: the filter delay is absorbed
+// at the start and ResamplerFlush emits the tail, so N input frames always
+// produce ceil(N * outRate / inRate) output frames.
+typedef struct {
+    uint32_t inRate;
+    uint32_t outRate;
+    uint32_t upFactor;            // L: phases per input sample
+    uint32_t downFactor;          // M: phase advance per output sample
+    uint16_t channels;
+    uint32_t taps;                // Per phase, a multiple of 8
+    float *filters;               // upFactor * taps, phase-major
+    int ownsFilters;
+    ResamplerDotFn dot;
+
+    float *history;               // Per channel: taps - 1 frames of history + a chunk of input
+    uint32_t historyStride;
+    uint32_t phase;               // Position between input samples, 0..upFactor-1
+    uint32_t pos;                 // Window start in history for the next output
+    uint64_t inFrames;
+    uint64_t outFrames;
+} Resampler;
+
+int ResamplerInit(Resampler *r, uint32_t inRate, uint32_t outRate, uint16_t channels);
+// Shares src's filter table, which must outlive the clone; state starts reset.
+int ResamplerClone(Resampler *r, const Resampler *src);
+void ResamplerClose(Resampler *r);
+void ResamplerReset(Resampler *r);
+// Loads frames that precede the next input as history without producing output.
+// Only the last taps - 1 frames matter.
+void ResamplerPrime(Resampler *r, const float *in, uint32_t frameCount);
+
+// Output frames that frameCount more input frames can produce, at most.
+uint32_t ResamplerMaxOutput(const Resampler *r, uint32_t frameCount);
+// in and out are interleaved float. Returns the frames written to out.
+uint32_t ResamplerProcess(Resampler *r, const float *in, uint32_t frameCount, float *out);
+// Pushes the filter delay through with silence; out needs ResamplerMaxOutput(r, taps / 2) frames.
+uint32_t ResamplerFlush(Resampler *r, float *out);
+
+// The fastest dot product the CPU supports; count must be a multiple of 8.
+ResamplerDotFn ResamplerBestDot(void);
+
+// Frames after resampling frameCount input frames from the stream start.
+uint64_t ResamplerOutputFrames(uint64_t frameCount, uint32_t inRate, uint32_t outRate);
+
+#endif // RESAMPLER_H
@@ -0,0 +1,162 @@
+// ring_buffer.c
+#include <stdlib.h>
+#include <string.h>
+
+#include "ring_buffer.h"
+
+static size_t RoundUpPow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+static void *AlignedAlloc(size_t bytes) {
+#ifdef _WIN32
+    return _aligned_malloc(bytes, RING_BUFFER_CACHE_LINE);
+#else
+    void *p = NULL;
+    if (posix_memalign(&p, RING_BUFFER_CACHE_LINE, bytes) != 0) return NULL;
+    return p;
+#endif
+}
+
+static void AlignedFree(void *p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+int RingBufferInit(RingBuffer *rb, size_t minCapacity) {
+    memset(rb, 0, sizeof(*rb));
+
+    rb->capacity = RoundUpPow2(minCapacity < RING_BUFFER_CACHE_LINE ? RING_BUFFER_CACHE_LINE : minCapacity);
+    rb->mask = rb->capacity - 1;
+    rb->data = (uint8_t *)AlignedAlloc(rb->capacity);
+    if (!rb->data) return -1;
+
+    // Touch every page now so the capture thread never takes a first-use fault
+    memset(rb->data, 0, rb->capacity);
+
+    atomic_init(&rb->writePos, 0);
+    atomic_init(&rb->readPos, 0);
+    atomic_init(&rb->overrunCount, 0);
+    atomic_init(&rb->overrunBytes, 0);
+    atomic_init(&rb->highWater, 0);
+    return 0;
+}
+
+void RingBufferFree(RingBuffer *rb) {
+    if (rb->data) AlignedFree(rb->data);
+    rb->data = NULL;
+    rb->capacity = 0;
+    rb->mask = 0;
+}
+
+// Reserves room for a write, refreshing the cached read position only when needed.
+// Returns the current write position, or (size_t)-1 if the data does not fit.
+static size_t ReserveWrite(RingBuffer *rb, size_t bytes) {
+    size_t w = atomic_load_explicit(&rb->writePos, memory_order_relaxed);
+
+    if (w - rb->cachedReadPos + bytes > rb->capacity) {
+        rb->cachedReadPos = atomic_load_explicit(&rb->readPos, memory_order_acquire);
+        if (w - rb->cachedReadPos + bytes > rb->capacity) {
+            atomic_fetch_add_explicit(&rb->overrunCount, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&rb->overrunBytes, bytes, memory_order_relaxed);
+            return (size_t)-1;
+        }
+    }
+    return w;
+}
+
+static void PublishWrite(RingBuffer *rb, size_t w, size_t bytes) {
+    size_t fill = w + bytes - rb->cachedReadPos;
+    if (fill > atomic_load_explicit(&rb->highWater, memory_order_relaxed)) {
+        // The cached read position may be stale; confirm before recording a new peak
+        rb->cachedReadPos = atomic_load_explicit(&rb->readPos, memory_order_acquire);
+        fill = w + bytes - rb->cachedReadPos;
+        if (fill > atomic_load_explicit(&rb->highWater, memory_order_relaxed)) {
+            atomic_store_explicit(&rb->highWater, fill, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&rb->writePos, w + bytes, memory_order_release);
+}
+
+size_t RingBufferWritable(RingBuffer *rb) {
+    size_t w = atomic_load_explicit(&rb->writePos, memory_order_relaxed);
+    rb->cachedReadPos = atomic_load_explicit(&rb->readPos, memory_order_acquire);
+    return rb->capacity - (w - rb->cachedReadPos);
+}
+
+size_t RingBufferWrite(RingBuffer *rb, const void *src, size_t bytes) {
+    size_t w = ReserveWrite(rb, bytes);
+    if (w == (size_t)-1) return 0;
+
+    size_t offset = w & rb->mask;
+    size_t first = rb->capacity - offset;
+    if (first > bytes) first = bytes;
+
+    memcpy(rb->data + offset, src, first);
+    memcpy(rb->data, (const uint8_t *)src + first, bytes - first);
+
+    PublishWrite(rb, w, bytes);
+    return bytes;
+}
+
+size_t RingBufferWriteZeros(RingBuffer *rb, size_t bytes) {
+    size_t w = ReserveWrite(rb, bytes);
+    if (w == (size_t)-1) return 0;
+
+    size_t offset = w & rb->mask;
+    size_t first = rb->capacity - offset;
+    if (first > bytes) first = bytes;
+
+    memset(rb->data + offset, 0, first);
+    memset(rb->data, 0, bytes - first);
+
+    PublishWrite(rb, w, bytes);
+    return bytes;
+}
+
+size_t RingBufferReadable(RingBuffer *rb) {
+    rb->cachedWritePos = atomic_load_explicit(&rb->writePos, memory_order_acquire);
+    return rb->cachedWritePos - atomic_load_explicit(&rb->readPos, memory_order_relaxed);
+}
+
+// Returns the number of bytes readable contiguously at *ptr (up to the wrap point).
+size_t RingBufferPeek(RingBuffer *rb, const void **ptr) {
+    size_t r = atomic_load_explicit(&rb->readPos, memory_order_relaxed);
+
+    if (rb->cachedWritePos == r) {
+        rb->cachedWritePos = atomic_load_explicit(&rb->writePos, memory_order_acquire);
+    }
+
+    size_t avail = rb->cachedWritePos - r;
+    size_t offset = r & rb->mask;
+    size_t contiguous = rb->capacity - offset;
+
+    *ptr = rb->data + offset;
+    return avail < contiguous ? avail : contiguous;
+}
+
+void RingBufferConsume(RingBuffer *rb, size_t bytes) {
+    size_t r = atomic_load_explicit(&rb->readPos, memory_order_relaxed);
+    atomic_store_explicit(&rb->readPos, r + bytes, memory_order_release);
+}
+
+size_t RingBufferRead(RingBuffer *rb, void *dst, size_t maxBytes) {
+    size_t total = 0;
+
+    while (total < maxBytes) {
+        const void *p;
+        size_t n = RingBufferPeek(rb, &p);
+        if (n == 0) break;
+        if (n > maxBytes - total) n = maxBytes - total;
+
+        memcpy((uint8_t *)dst + total, p, n);
+        RingBufferConsume(rb, n);
+        total += n;
+    }
+    return total;
+}
@@ -0,0 +1,46 @@
+// ring_buffer.h
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define RING_BUFFER_CACHE_LINE 64
+
+// Fixed-capacity single-producer/single-consumer byte queue.
+// The producer (capture thread) never allocates, locks or blocks: a write that
+// does not fit is dropped whole and counted as an overrun.
+typedef struct {
+    // Producer cache line
+    _Alignas(RING_BUFFER_CACHE_LINE) atomic_size_t writePos;
+    size_t cachedReadPos;
+    atomic_uint_fast64_t overrunCount;
+    atomic_uint_fast64_t overrunBytes;
+    atomic_size_t highWater;
+
+    // Consumer cache line
+    _Alignas(RING_BUFFER_CACHE_LINE) atomic_size_t readPos;
+    size_t cachedWritePos;
+
+    // Shared, read-only after init
+    _Alignas(RING_BUFFER_CACHE_LINE) uint8_t *data;
+    size_t capacity;
+    size_t mask;
+} RingBuffer;
+
+int RingBufferInit(RingBuffer *rb, size_t minCapacity);
+void RingBufferFree(RingBuffer *rb);
+
+// Producer side
+size_t RingBufferWritable(RingBuffer *rb);
+size_t RingBufferWrite(RingBuffer *rb, const void *src, size_t bytes);
+size_t RingBufferWriteZeros(RingBuffer *rb, size_t bytes);
+
+// Consumer side
+size_t RingBufferRead(RingBuffer *rb, void *dst, size_t maxBytes);
+size_t RingBufferPeek(RingBuffer *rb, const void **ptr);
+void RingBufferConsume(RingBuffer *rb, size_t bytes);
+size_t RingBufferReadable(RingBuffer *rb);
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,452 @@
+// sample_convert.c
+#include <math.h>
+#include <string.h>
+
+#include "sample_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERT_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#define S16_SCALE 32767.0f
+#define S16_MAX 32767.0f
+#define S16_MIN -32768.0f
+#define S24_SCALE 8388607.0f
+#define S24_MAX 8388607.0f
+#define S24_MIN -8388608.0f
+#define S32_SCALE 2147483647.0
+#define S32_MAX 2147483647.0
+#define S32_MIN -2147483648.0
+#define RAND_TO_UNIT (1.0f / 16777216.0f)
+
+typedef void (*ConvertFloatToS16Fn)(int16_t *dst, const float *src, size_t count, DitherState *dither);
+
+void DitherInit(DitherState *dither, uint32_t seed) {
+    // xorshift32 must never be seeded with zero
+    for (int i = 0; i < DITHER_LANES; ++i) {
+        uint32_t s = seed + 0x9E3779B9u * (uint32_t)(i + 1);
+        dither->lanes[i] = s ? s : 0x6D2B79F5u;
+    }
+}
+
+static inline uint32_t XorShift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Triangular noise in (-1, 1) LSB: difference of two uniform variables
+static inline float TpdfScalar(uint32_t *state) {
+    float a = (float)(XorShift32(state) >> 8) * RAND_TO_UNIT;
+    float b = (float)(XorShift32(state) >> 8) * RAND_TO_UNIT;
+    return a - b;
+}
+
+// Reference implementation; the SIMD kernels must match it bit for bit when undithered.
+static void ConvertFloatToS16Scalar(int16_t *dst, const float *src, size_t count, DitherState *dither) {
+    for (size_t i = 0; i < count; ++i) {
+        float sample = src[i] * S16_SCALE;
+        if (dither) sample += TpdfScalar(&dither->lanes[0]);
+        if (sample > S16_MAX) sample = S16_MAX;
+        // NaN fails the test and clamps to the minimum, as it does in _mm_max_ps
+        if (!(sample >= S16_MIN)) sample = S16_MIN;
+        dst[i] = (int16_t)lrintf(sample);
+    }
+}
+
+#ifdef CONVERT_HAVE_X86
+
+__attribute__((target("sse2")))
+static inline __m128i XorShift32x4(__m128i *state) {
+    __m128i x = *state;
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    *state = x;
+    return x;
+}
+
+__attribute__((target("sse2")))
+static inline __m128 TpdfSse2(__m128i *state) {
+    const __m128 unit = _mm_set1_ps(RAND_TO_UNIT);
+    __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(XorShift32x4(state), 8)), unit);
+    __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(XorShift32x4(state), 8)), unit);
+    return _mm_sub_ps(a, b);
+}
+
+__attribute__((target("sse2")))
+static void ConvertFloatToS16Sse2(int16_t *dst, const float *src, size_t count, DitherState *dither) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    const __m128 hi = _mm_set1_ps(S16_MAX);
+    const __m128 lo = _mm_set1_ps(S16_MIN);
+    __m128i state = _mm_setzero_si128();
+    size_t i = 0;
+
+    if (dither) state = _mm_loadu_si128((const __m128i *)dither->lanes);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        if (dither) {
+            a = _mm_add_ps(a, TpdfSse2(&state));
+            b = _mm_add_ps(b, TpdfSse2(&state));
+        }
+        // Clamp in float so out-of-range values never hit the int32 "indefinite" result
+        a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+        b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i *)(dst + i), packed);
+    }
+
+    if (dither) _mm_storeu_si128((__m128i *)dither->lanes, state);
+    ConvertFloatToS16Scalar(dst + i, src + i, count - i, dither);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i XorShift32x8(__m256i *state) {
+    __m256i x = *state;
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+    *state = x;
+    return x;
+}
+
+__attribute__((target("avx2")))
+static inline __m256 TpdfAvx2(__m256i *state) {
+    const __m256 unit = _mm256_set1_ps(RAND_TO_UNIT);
+    __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(XorShift32x8(state), 8)), unit);
+    __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(XorShift32x8(state), 8)), unit);
+    return _mm256_sub_ps(a, b);
+}
+
+__attribute__((target("avx2")))
+static void ConvertFloatToS16Avx2(int16_t *dst, const float *src, size_t count, DitherState *dither) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+    const __m256 hi = _mm256_set1_ps(S16_MAX);
+    const __m256 lo = _mm256_set1_ps(S16_MIN);
+    __m256i state = _mm256_setzero_si256();
+    size_t i = 0;
+
+    if (dither) state = _mm256_loadu_si256((const __m256i *)dither->lanes);
+
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale);
+        if (dither) {
+            a = _mm256_add_ps(a, TpdfAvx2(&state));
+            b = _mm256_add_ps(b, TpdfAvx2(&state));
+        }
+        a = _mm256_min_ps(_mm256_max_ps(a, lo), hi);
+        b = _mm256_min_ps(_mm256_max_ps(b, lo), hi);
+        // packs works per 128-bit lane, so restore sample order afterwards
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(dst + i), packed);
+    }
+
+    if (dither) _mm256_storeu_si256((__m256i *)dither->lanes, state);
+    ConvertFloatToS16Sse2(dst + i, src + i, count - i, dither);
+}
+
+#endif // CONVERT_HAVE_X86
+
+static ConvertFloatToS16Fn KernelFunction(ConvertKernel kernel) {
+    switch (kernel) {
+    case CONVERT_KERNEL_SCALAR: return ConvertFloatToS16Scalar;
+#ifdef CONVERT_HAVE_X86
+    case CONVERT_KERNEL_SSE2: return ConvertFloatToS16Sse2;
+    case CONVERT_KERNEL_AVX2: return ConvertFloatToS16Avx2;
+#endif
+    default: return NULL;
+    }
+}
+
+int ConvertKernelSupported(ConvertKernel kernel) {
+    switch (kernel) {
+    case CONVERT_KERNEL_SCALAR: return 1;
+#ifdef CONVERT_HAVE_X86
+    case CONVERT_KERNEL_SSE2: return __builtin_cpu_supports("sse2");
+    case CONVERT_KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+    default: return 0;
+    }
+}
+
+ConvertKernel ConvertBestKernel(void) {
+    static int best = -1;
+
+    // Racing first calls all compute the same answer, so no lock is needed
+    if (best < 0) {
+        ConvertKernel k = CONVERT_KERNEL_SCALAR;
+        if (ConvertKernelSupported(CONVERT_KERNEL_SSE2)) k = CONVERT_KERNEL_SSE2;
+        if (ConvertKernelSupported(CONVERT_KERNEL_AVX2)) k = CONVERT_KERNEL_AVX2;
+        best = (int)k;
+    }
+    return (ConvertKernel)best;
+}
+
+const char *ConvertKernelName(ConvertKernel kernel) {
+    switch (kernel) {
+    case CONVERT_KERNEL_SCALAR: return "scalar";
+    case CONVERT_KERNEL_SSE2: return "sse2";
+    case CONVERT_KERNEL_AVX2: return "avx2";
+    default: return "unknown";
+    }
+}
+
+void ConvertFloatToS16(int16_t *dst, const float *src, size_t count, DitherState *dither) {
+    static ConvertFloatToS16Fn fn = NULL;
+
+    if (!fn) fn = KernelFunction(ConvertBestKernel());
+    fn(dst, src, count, dither);
+}
+
+int ConvertFloatToS16WithKernel(ConvertKernel kernel, int16_t *dst, const float *src,
+                                size_t count, DitherState *dither) {
+    if (!ConvertKernelSupported(kernel)) return -1;
+
+    KernelFunction(kernel)(dst, src, count, dither);
+    return 0;
+}
+
+void ConvertFloatToS24(uint8_t *dst, const float *src, size_t count, DitherState *dither) {
+    for (size_t i = 0; i < count; ++i) {
+        float sample = src[i] * S24_SCALE;
+        if (dither) sample += TpdfScalar(&dither->lanes[0]);
+        if (sample > S24_MAX) sample = S24_MAX;
+        if (!(sample >= S24_MIN)) sample = S24_MIN;
+
+        int32_t v = (int32_t)lrintf(sample);
+        dst[0] = (uint8_t)v;
+        dst[1] = (uint8_t)(v >> 8);
+        dst[2] = (uint8_t)(v >> 16);
+        dst += 3;
+    }
+}
+
+static inline int32_t GetS16(const uint8_t *p) {
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static inline int32_t GetS24(const uint8_t *p) {
+    return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+}
+
+static inline int32_t GetS32(const uint8_t *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline float GetF32(const uint8_t *p) {
+    float v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void PutS16(uint8_t *p, int32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void PutS24(uint8_t *p, int32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+}
+
+static inline void PutS32(uint8_t *p, int32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void PutF32(uint8_t *p, float v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+// Drops the low bits of a wider integer sample, rounding to nearest and saturating
+static inline int32_t NarrowInt(int32_t v, int shift) {
+    int64_t r = ((int64_t)v + ((int64_t)1 << (shift - 1))) >> shift;
+    int64_t max = ((int64_t)1 << (31 - shift)) - 1;
+    return (int32_t)(r > max ? max : r);
+}
+
+// Same rounding and clamping as the contiguous kernels, so strided and
+// contiguous conversion produce identical output
+static inline int32_t FloatToInt(float v, float scale, float lo, float hi, DitherState *dither) {
+    float sample = v * scale;
+    if (dither) sample += TpdfScalar(&dither->lanes[0]);
+    if (sample > hi) sample = hi;
+    if (!(sample >= lo)) sample = lo;
+    return (int32_t)lrintf(sample);
+}
+
+// 32-bit integers do not fit a float mantissa, so they are scaled in double
+static inline int32_t FloatToS32(float v, DitherState *dither) {
+    double sample = v * S32_SCALE;
+    if (dither) sample += TpdfScalar(&dither->lanes[0]);
+    if (sample > S32_MAX) sample = S32_MAX;
+    if (!(sample >= S32_MIN)) sample = S32_MIN;
+    return (int32_t)llrint(sample);
+}
+
+#define SAMPLE_KERNEL(name, inBytes, outBytes, convert)                                      \
+    static void name(uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,  \
+                     size_t count, DitherState *dither) {                                    \
+        size_t inStep = srcStride * (inBytes);                                               \
+        size_t outStep = dstStride * (outBytes);                                             \
+        (void)dither;                                                                        \
+        for (size_t i = 0; i < count; ++i, src += inStep, dst += outStep) {                  \
+            convert;                                                                         \
+        }                                                                                    \
+    }
+
+SAMPLE_KERNEL(KernelS16ToS24, 2, 3, PutS24(dst, GetS16(src) * 256))
+SAMPLE_KERNEL(KernelS16ToS32, 2, 4, PutS32(dst, (int32_t)((uint32_t)GetS16(src) << 16)))
+SAMPLE_KERNEL(KernelS16ToF32, 2, 4, PutF32(dst, (float)GetS16(src) * (1.0f / S16_SCALE)))
+SAMPLE_KERNEL(KernelS24ToS16, 3, 2, PutS16(dst, NarrowInt(GetS24(src) * 256, 16)))
+SAMPLE_KERNEL(KernelS24ToS32, 3, 4, PutS32(dst, (int32_t)((uint32_t)GetS24(src) << 8)))
+SAMPLE_KERNEL(KernelS24ToF32, 3, 4, PutF32(dst, (float)GetS24(src) * (1.0f / S24_SCALE)))
+SAMPLE_KERNEL(KernelS32ToS16, 4, 2, PutS16(dst, NarrowInt(GetS32(src), 16)))
+SAMPLE_KERNEL(KernelS32ToS24, 4, 3, PutS24(dst, NarrowInt(GetS32(src), 8)))
+SAMPLE_KERNEL(KernelS32ToF32, 4, 4, PutF32(dst, (float)(GetS32(src) * (1.0 / S32_SCALE))))
+SAMPLE_KERNEL(KernelF32ToS16Strided, 4, 2, PutS16(dst, FloatToInt(GetF32(src), S16_SCALE, S16_MIN, S16_MAX, dither)))
+SAMPLE_KERNEL(KernelF32ToS24Strided, 4, 3, PutS24(dst, FloatToInt(GetF32(src), S24_SCALE, S24_MIN, S24_MAX, dither)))
+SAMPLE_KERNEL(KernelF32ToS32, 4, 4, PutS32(dst, FloatToS32(GetF32(src), dither)))
+
+// The hot float paths go to the SIMD kernels whenever the run is contiguous
+static void KernelF32ToS16(uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,
+                           size_t count, DitherState *dither) {
+    if (dstStride == 1 && srcStride == 1) {
+        ConvertFloatToS16((int16_t *)dst, (const float *)src, count, dither);
+    } else {
+        KernelF32ToS16Strided(dst, dstStride, src, srcStride, count, dither);
+    }
+}
+
+static void KernelF32ToS24(uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,
+                           size_t count, DitherState *dither) {
+    if (dstStride == 1 && srcStride == 1) {
+        ConvertFloatToS24(dst, (const float *)src, count, dither);
+    } else {
+        KernelF32ToS24Strided(dst, dstStride, src, srcStride, count, dither);
+    }
+}
+
+#define COPY_KERNEL(name, bytes)                                                             \
+    static void name(uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,  \
+                     size_t count, DitherState *dither) {                                    \
+        (void)dither;                                                                        \
+        if (dstStride == 1 && srcStride == 1) {                                              \
+            memcpy(dst, src, count * (bytes));                                               \
+            return;                                                                          \
+        }                                                                                    \
+        for (size_t i = 0; i < count; ++i) {                                                 \
+            memcpy(dst + i * dstStride * (bytes), src + i * srcStride * (bytes), (bytes));   \
+        }                                                                                    \
+    }
+
+COPY_KERNEL(KernelCopy2, 2)
+COPY_KERNEL(KernelCopy3, 3)
+COPY_KERNEL(KernelCopy4, 4)
+
+// [in][out]
+static const SampleKernelFn SampleKernels[SAMPLE_TYPE_COUNT][SAMPLE_TYPE_COUNT] = {
+    { KernelCopy2,    KernelS16ToS24, KernelS16ToS32, KernelS16ToF32 },
+    { KernelS24ToS16, KernelCopy3,    KernelS24ToS32, KernelS24ToF32 },
+    { KernelS32ToS16, KernelS32ToS24, KernelCopy4,    KernelS32ToF32 },
+    { KernelF32ToS16, KernelF32ToS24, KernelF32ToS32, KernelCopy4    }
+};
+
+uint32_t SampleTypeBytes(SampleType type) {
+    switch (type) {
+    case SAMPLE_S16: return 2;
+    case SAMPLE_S24: return 3;
+    case SAMPLE_S32: return 4;
+    case SAMPLE_F32: return 4;
+    default: return 0;
+    }
+}
+
+const char *SampleTypeName(SampleType type) {
+    switch (type) {
+    case SAMPLE_S16: return "s16";
+    case SAMPLE_S24: return "s24";
+    case SAMPLE_S32: return "s32";
+    case SAMPLE_F32: return "f32";
+    default: return "unknown";
+    }
+}
+
+uint32_t SampleFormatFrameBytes(const SampleFormat *format) {
+    return SampleTypeBytes(format->type) * format->channels;
+}
+
+int SampleFormatFromWav(const WavFormat *wav, SampleFormat *out) {
+    out->channels = wav->channels;
+    out->planar = 0;
+
+    if (wav->formatTag == WAV_FORMAT_IEEE_FLOAT && wav->bitsPerSample == 32) {
+        out->type = SAMPLE_F32;
+    } else if (wav->formatTag != WAV_FORMAT_PCM) {
+        return -1;
+    } else if (wav->bitsPerSample == 16) {
+        out->type = SAMPLE_S16;
+    } else if (wav->bitsPerSample == 24) {
+        out->type = SAMPLE_S24;
+    } else if (wav->bitsPerSample == 32) {
+        out->type = SAMPLE_S32;
+    } else {
+        return -1;
+    }
+    return wav->channels > 0 ? 0 : -1;
+}
+
+void SampleFormatToWav(const SampleFormat *format, uint32_t sampleRate, WavFormat *out) {
+    memset(out, 0, sizeof(*out));
+    out->formatTag = format->type == SAMPLE_F32 ? WAV_FORMAT_IEEE_FLOAT : WAV_FORMAT_PCM;
+    out->channels = format->channels;
+    out->sampleRate = sampleRate;
+    out->bitsPerSample = (uint16_t)(SampleTypeBytes(format->type) * 8);
+}
+
+SampleKernelFn SampleKernelLookup(SampleType in, SampleType out) {
+    if (in >= SAMPLE_TYPE_COUNT || out >= SAMPLE_TYPE_COUNT) return NULL;
+    return SampleKernels[in][out];
+}
+
+int SampleConverterInit(SampleConverter *c, const SampleFormat *in, const SampleFormat *out) {
+    if (in->channels != out->channels) return -1;
+
+    c->in = *in;
+    c->out = *out;
+    c->kernel = SampleKernelLookup(in->type, out->type);
+    return c->kernel ? 0 : -1;
+}
+
+void SampleConverterRun(const SampleConverter *c, void *dst, const void *src, uint32_t frameCount,
+                        DitherState *dither) {
+    uint8_t *out = (uint8_t *)dst;
+    const uint8_t *in = (const uint8_t *)src;
+    uint16_t channels = c->in.channels;
+    size_t inBytes = SampleTypeBytes(c->in.type);
+    size_t outBytes = SampleTypeBytes(c->out.type);
+
+    // Same layout: planes and interleaved frames are both one contiguous run
+    if (c->in.planar == c->out.planar || channels == 1) {
+        c->kernel(out, 1, in, 1, (size_t)frameCount * channels, dither);
+        return;
+    }
+
+    for (uint16_t ch = 0; ch < channels; ++ch) {
+        if (c->out.planar) {
+            c->kernel(out + (size_t)ch * frameCount * outBytes, 1, in + ch * inBytes, channels, frameCount, dither);
+        } else {
+            c->kernel(out + ch * outBytes, channels, in + (size_t)ch * frameCount * inBytes, 1, frameCount, dither);
+        }
+    }
+}
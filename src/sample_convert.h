@@ -0,0 +1,88 @@
+// sample_convert.h
+#ifndef SAMPLE_CONVERT_H
+#define SAMPLE_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "wav_writer.h"
+
+typedef enum {
+    CONVERT_KERNEL_SCALAR = 0,
+    CONVERT_KERNEL_SSE2,
+    CONVERT_KERNEL_AVX2,
+    CONVERT_KERNEL_COUNT
+} ConvertKernel;
+
+#define DITHER_LANES 8
+
+// Per-stream TPDF dither generator. Seed once with DitherInit and keep it
+// alive across blocks so the noise does not restart at every call.
+typedef struct {
+    uint32_t lanes[DITHER_LANES];
+} DitherState;
+
+void DitherInit(DitherState *dither, uint32_t seed);
+
+// Float samples in [-1, 1] to int16 with clamping and round-to-nearest.
+// dst and src must not overlap. Pass dither = NULL for undithered output.
+// The fastest kernel supported by the CPU is picked on first use.
+void ConvertFloatToS16(int16_t *dst, const float *src, size_t count, DitherState *dither);
+
+// Float samples in [-1, 1] to packed little-endian 24-bit, 3 bytes per sample.
+void ConvertFloatToS24(uint8_t *dst, const float *src, size_t count, DitherState *dither);
+
+// Explicit kernel selection, for benchmarking and cross-checking.
+// Returns -1 if the kernel is not available on this CPU.
+int ConvertFloatToS16WithKernel(ConvertKernel kernel, int16_t *dst, const float *src,
+                                size_t count, DitherState *dither);
+
+ConvertKernel ConvertBestKernel(void);
+int ConvertKernelSupported(ConvertKernel kernel);
+const char *ConvertKernelName(ConvertKernel kernel);
+
+typedef enum {
+    SAMPLE_S16 = 0,
+    SAMPLE_S24,                   // Packed, 3 bytes per sample
+    SAMPLE_S32,
+    SAMPLE_F32,
+    SAMPLE_TYPE_COUNT
+} SampleType;
+
+// In-memory layout of a stream of frames. Planar buffers hold each channel's
+// samples for the whole block back to back, channel 0 first.
+typedef struct {
+    SampleType type;
+    uint16_t channels;
+    int planar;
+} SampleFormat;
+
+// Converts count samples, reading every srcStride-th and writing every
+// dstStride-th sample (strides in samples). Integer narrowing rounds to nearest;
+// dither only applies to float to integer conversion.
+typedef void (*SampleKernelFn)(uint8_t *dst, size_t dstStride, const uint8_t *src, size_t srcStride,
+                               size_t count, DitherState *dither);
+
+// A conversion between two layouts, resolved once per stream.
+typedef struct {
+    SampleFormat in;
+    SampleFormat out;
+    SampleKernelFn kernel;
+} SampleConverter;
+
+uint32_t SampleTypeBytes(SampleType type);
+const char *SampleTypeName(SampleType type);
+uint32_t SampleFormatFrameBytes(const SampleFormat *format);
+
+// Interleaved layout for a WAV format. Returns -1 for formats with no kernels.
+int SampleFormatFromWav(const WavFormat *wav, SampleFormat *out);
+void SampleFormatToWav(const SampleFormat *format, uint32_t sampleRate, WavFormat *out);
+
+SampleKernelFn SampleKernelLookup(SampleType in, SampleType out);
+
+// Returns -1 if the channel counts differ.
+int SampleConverterInit(SampleConverter *c, const SampleFormat *in, const SampleFormat *out);
+// dst and src must not overlap.
+void SampleConverterRun(const SampleConverter *c, void *dst, const void *src, uint32_t frameCount,
+                        DitherState *dither);
+
+#endif // SAMPLE_CONVERT_H
@@ -0,0 +1,121 @@
+// silence_gate.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "silence_gate.h"
+
+static void ClearWindow(SilenceGate *g) {
+    for (uint16_t ch = 0; ch < g->channels; ++ch) {
+        g->peak[ch] = 0.0f;
+        g->sumSquares[ch] = 0.0;
+        g->clips[ch] = 0;
+    }
+    g->framesInWindow = 0;
+}
+
+static void CloseWindow(SilenceGate *g) {
+    int loud = 0;
+
+    for (uint16_t ch = 0; ch < g->channels; ++ch) {
+        if (g->sumSquares[ch] >= g->thresholdSquares) loud = 1;
+    }
+
+    if (loud) {
+        g->quietFrames = 0;
+        g->inGap = 0;
+    } else {
+        g->quietFrames += g->windowFrames;
+        if (!g->inGap && g->quietFrames >= g->holdFrames) {
+            g->inGap = 1;
+            g->stats.gaps++;
+        }
+    }
+    ClearWindow(g);
+}
+
+int SilenceGateInit(SilenceGate *g, const WavFormat *format, const SilenceGateConfig *config) {
+    SampleFormat inSamples;
+    SampleFormat floatSamples;
+    double threshold;
+
+    memset(g, 0, sizeof(*g));
+    if (format->channels == 0 || format->channels > METER_MAX_CHANNELS) return -1;
+    if (config->hangoverSeconds < 0.0 || config->minGapSeconds < 0.0) return -1;
+    if (SampleFormatFromWav(format, &inSamples) != 0) return -1;
+
+    floatSamples = inSamples;
+    floatSamples.type = SAMPLE_F32;
+    SampleConverterInit(&g->toFloat, &inSamples, &floatSamples);
+
+    g->config = *config;
+    g->channels = format->channels;
+    g->windowFrames = format->sampleRate * GATE_WINDOW_MS / 1000;
+    if (g->windowFrames == 0) g->windowFrames = 1;
+    threshold = pow(10.0, config->thresholdDb / 20.0);
+    g->thresholdSquares = threshold * threshold * g->windowFrames;
+    g->holdFrames = (uint64_t)((config->hangoverSeconds + config->minGapSeconds) * format->sampleRate);
+    g->inGap = 1;
+
+    if (inSamples.type != SAMPLE_F32) {
+        g->scratch = (float *)malloc((size_t)GATE_SCRATCH_FRAMES * g->channels * sizeof(float));
+        if (!g->scratch) return -1;
+    }
+    ClearWindow(g);
+    return 0;
+}
+
+void SilenceGateClose(SilenceGate *g) {
+    free(g->scratch);
+    g->scratch = NULL;
+}
+
+uint32_t SilenceGateStep(SilenceGate *g, const void *frames, uint32_t frameCount, int *keep) {
+    uint32_t n = g->windowFrames - g->framesInWindow;
+
+    if (n > frameCount) n = frameCount;
+    *keep = !g->inGap;
+
+    if (!frames) {
+        // Flagged silence adds nothing to the sums
+        g->stats.framesFlagged += n;
+    } else if (g->scratch) {
+        if (n > GATE_SCRATCH_FRAMES) n = GATE_SCRATCH_FRAMES;
+        SampleConverterRun(&g->toFloat, g->scratch, frames, n, NULL);
+        MeasureLevels(g->scratch, n, g->channels, g->peak, g->sumSquares, g->clips);
+    } else {
+        MeasureLevels((const float *)frames, n, g->channels, g->peak, g->sumSquares, g->clips);
+    }
+
+    if (*keep) {
+        g->stats.framesKept += n;
+    } else {
+        g->stats.framesDropped += n;
+    }
+
+    g->framesInWindow += n;
+    if (g->framesInWindow == g->windowFrames) CloseWindow(g);
+    return n;
+}
+
+const char *SilenceGateModeName(SilenceGateMode mode) {
+    switch (mode) {
+    case SILENCE_GATE_OFF: return "off";
+    case SILENCE_GATE_DROP: return "drop";
+    case SILENCE_GATE_SPLIT: return "split";
+    }
+    return "unknown";
+}
+
+int ParseSilenceGateMode(const char *name, SilenceGateMode *mode) {
+    if (strcmp(name, "off") == 0) {
+        *mode = SILENCE_GATE_OFF;
+    } else if (strcmp(name, "drop") == 0) {
+        *mode = SILENCE_GATE_DROP;
+    } else if (strcmp(name, "split") == 0) {
+        *mode = SILENCE_GATE_SPLIT;
+    } else {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+// silence_gate.h
+#ifndef SILENCE_GATE_H
+#define SILENCE_GATE_H
+
+#include <stdint.h>
+#include "level_meter.h"
+#include "sample_convert.h"
+#include "wav_writer.h"
+
+#define GATE_WINDOW_MS 10
+#define GATE_SCRATCH_FRAMES 512
+#define GATE_DEFAULT_THRESHOLD_DB -50.0
+#define GATE_DEFAULT_HANGOVER_SECONDS 0.5
+#define GATE_DEFAULT_MIN_GAP_SECONDS 2.0
+
+typedef enum {
+    SILENCE_GATE_OFF = 0,
+    SILENCE_GATE_DROP,            // Leave long silences out of the file
+    SILENCE_GATE_SPLIT            // Also start a new numbered file after each one
+} SilenceGateMode;
+
+typedef struct {
+    SilenceGateMode mode;
+    double thresholdDb;           // A window whose loudest channel RMS is below this is quiet
+    double hangoverSeconds;       // Kept after the level falls, so decays are not cut
+    double minGapSeconds;         // Quiet this long after the hangover makes a gap
+} SilenceGateConfig;
+
+typedef struct {
+    uint64_t framesKept;
+    uint64_t framesDropped;
+    uint64_t framesFlagged;       // Taken as silent from the source's flag, not measured
+    uint64_t gaps;
+} SilenceGateStats;
+
+// Voice/silence gate over fixed windows. Each window is classified as it
+// completes and the decision applies from the next window on, so frames can
+// be passed on as they arrive without buffering. Quiet stretches shorter than
+// hangover + minGap are always kept; a longer one is kept up to that point
+// and dropped from there until a loud window. The gate starts in a gap, so
+// leading silence is dropped too.
+typedef struct {
+    SilenceGateConfig config;
+    uint16_t channels;
+    uint32_t windowFrames;
+    double thresholdSquares;      // Sum of squares per window at the threshold
+    uint64_t holdFrames;          // hangover + minGap
+    SampleConverter toFloat;
+    float *scratch;
+
+    uint32_t framesInWindow;
+    float peak[METER_MAX_CHANNELS];
+    double sumSquares[METER_MAX_CHANNELS];
+    uint64_t clips[METER_MAX_CHANNELS];
+    uint64_t quietFrames;
+    int inGap;
+
+    SilenceGateStats stats;
+} SilenceGate;
+
+int SilenceGateInit(SilenceGate *g, const WavFormat *format, const SilenceGateConfig *config);
+void SilenceGateClose(SilenceGate *g);
+// Handles the leading frames up to the end of the current window and returns
+// how many that was. *keep says whether they belong in the output. frames =
+// NULL means the source flagged them silent, which skips measuring them.
+uint32_t SilenceGateStep(SilenceGate *g, const void *frames, uint32_t frameCount, int *keep);
+
+const char *SilenceGateModeName(SilenceGateMode mode);
+int ParseSilenceGateMode(const char *name, SilenceGateMode *mode);
+
+#endif // SILENCE_GATE_H
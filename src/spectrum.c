@@ -0,0 +1,544 @@
+// spectrum.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spectrum.h"
+#include "platform.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPECTRUM_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#define SPECTRUM_PI 3.14159265358979323846
+
+static void ButterflyScalar(float *re, float *im, const float *twRe, const float *twIm,
+                            uint32_t half, uint32_t count) {
+    for (uint32_t k = 0; k < count; k += 2 * half) {
+        float *ar = re + k, *ai = im + k;
+        float *br = ar + half, *bi = ai + half;
+
+        for (uint32_t j = 0; j < half; ++j) {
+            float tr = br[j] * twRe[j] - bi[j] * twIm[j];
+            float ti = br[j] * twIm[j] + bi[j] * twRe[j];
+            br[j] = ar[j] - tr;
+            bi[j] = ai[j] - ti;
+            ar[j] += tr;
+            ai[j] += ti;
+        }
+    }
+}
+
+static void MagnitudeScalar(float *mag, const float *re, const float *im, float scale, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) mag[i] = sqrtf(re[i] * re[i] + im[i] * im[i]) * scale;
+}
+
+#ifdef SPECTRUM_HAVE_X86
+
+// The first passes are narrower than a vector and stay scalar
+__attribute__((target("sse2")))
+static void ButterflySse2(float *re, float *im, const float *twRe, const float *twIm,
+                          uint32_t half, uint32_t count) {
+    if (half < 4) {
+        ButterflyScalar(re, im, twRe, twIm, half, count);
+        return;
+    }
+    for (uint32_t k = 0; k < count; k += 2 * half) {
+        float *ar = re + k, *ai = im + k;
+        float *br = ar + half, *bi = ai + half;
+
+        for (uint32_t j = 0; j < half; j += 4) {
+            __m128 wr = _mm_loadu_ps(twRe + j), wi = _mm_loadu_ps(twIm + j);
+            __m128 xr = _mm_loadu_ps(br + j), xi = _mm_loadu_ps(bi + j);
+            __m128 yr = _mm_loadu_ps(ar + j), yi = _mm_loadu_ps(ai + j);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+            _mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+            _mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+            _mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+            _mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static void MagnitudeSse2(float *mag, const float *re, const float *im, float scale, uint32_t count) {
+    const __m128 s = _mm_set1_ps(scale);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 r = _mm_loadu_ps(re + i), m = _mm_loadu_ps(im + i);
+        __m128 power = _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(m, m));
+        _mm_storeu_ps(mag + i, _mm_mul_ps(_mm_sqrt_ps(power), s));
+    }
+    MagnitudeScalar(mag + i, re + i, im + i, scale, count - i);
+}
+
+__attribute__((target("avx2")))
+static void ButterflyAvx2(float *re, float *im, const float *twRe, const float *twIm,
+                          uint32_t half, uint32_t count) {
+    if (half < 8) {
+        ButterflySse2(re, im, twRe, twIm, half, count);
+        return;
+    }
+    for (uint32_t k = 0; k < count; k += 2 * half) {
+        float *ar = re + k, *ai = im + k;
+        float *br = ar + half, *bi = ai + half;
+
+        for (uint32_t j = 0; j < half; j += 8) {
+            __m256 wr = _mm256_loadu_ps(twRe + j), wi = _mm256_loadu_ps(twIm + j);
+            __m256 xr = _mm256_loadu_ps(br + j), xi = _mm256_loadu_ps(bi + j);
+            __m256 yr = _mm256_loadu_ps(ar + j), yi = _mm256_loadu_ps(ai + j);
+            __m256 tr = _mm256_sub_ps(_mm256_mul_ps(xr, wr), _mm256_mul_ps(xi, wi));
+            __m256 ti = _mm256_add_ps(_mm256_mul_ps(xr, wi), _mm256_mul_ps(xi, wr));
+            _mm256_storeu_ps(br + j, _mm256_sub_ps(yr, tr));
+            _mm256_storeu_ps(bi + j, _mm256_sub_ps(yi, ti));
+            _mm256_storeu_ps(ar + j, _mm256_add_ps(yr, tr));
+            _mm256_storeu_ps(ai + j, _mm256_add_ps(yi, ti));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void MagnitudeAvx2(float *mag, const float *re, const float *im, float scale, uint32_t count) {
+    const __m256 s = _mm256_set1_ps(scale);
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 r = _mm256_loadu_ps(re + i), m = _mm256_loadu_ps(im + i);
+        __m256 power = _mm256_add_ps(_mm256_mul_ps(r, r), _mm256_mul_ps(m, m));
+        _mm256_storeu_ps(mag + i, _mm256_mul_ps(_mm256_sqrt_ps(power), s));
+    }
+    MagnitudeSse2(mag + i, re + i, im + i, scale, count - i);
+}
+
+#endif // SPECTRUM_HAVE_X86
+
+static void PickKernels(SpectrumPlan *plan) {
+    plan->butterfly = ButterflyScalar;
+    plan->magnitude = MagnitudeScalar;
+#ifdef SPECTRUM_HAVE_X86
+    switch (ConvertBestKernel()) {
+    case CONVERT_KERNEL_AVX2:
+        plan->butterfly = ButterflyAvx2;
+        plan->magnitude = MagnitudeAvx2;
+        break;
+    case CONVERT_KERNEL_SSE2:
+        plan->butterfly = ButterflySse2;
+        plan->magnitude = MagnitudeSse2;
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
+int SpectrumPlanInit(SpectrumPlan *plan, uint32_t size) {
+    uint32_t half = size / 2;
+    uint32_t bits = 0;
+    double windowSum = 0.0;
+
+    memset(plan, 0, sizeof(*plan));
+    if (size < SPECTRUM_MIN_SIZE || size > SPECTRUM_MAX_SIZE || (size & (size - 1)) != 0) return -1;
+    while ((1u << bits) < half) bits++;
+
+    plan->size = size;
+    plan->bins = half + 1;
+    plan->bitReverse = (uint32_t *)malloc(half * sizeof(uint32_t));
+    plan->twRe = (float *)malloc(half * sizeof(float));
+    plan->twIm = (float *)malloc(half * sizeof(float));
+    plan->splitRe = (float *)malloc(half * sizeof(float));
+    plan->splitIm = (float *)malloc(half * sizeof(float));
+    plan->window = (float *)malloc(size * sizeof(float));
+    if (!plan->bitReverse || !plan->twRe || !plan->twIm || !plan->splitRe || !plan->splitIm || !plan->window) {
+        SpectrumPlanClose(plan);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < half; ++i) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; ++b) r |= ((i >> b) & 1u) << (bits - 1 - b);
+        plan->bitReverse[i] = r;
+    }
+    // Computed in double, so the error does not grow with the transform size
+    for (uint32_t h = 1; h < half; h *= 2) {
+        for (uint32_t j = 0; j < h; ++j) {
+            double angle = -SPECTRUM_PI * j / h;
+            plan->twRe[h - 1 + j] = (float)cos(angle);
+            plan->twIm[h - 1 + j] = (float)sin(angle);
+        }
+    }
+    for (uint32_t k = 0; k < half; ++k) {
+        double angle = -2.0 * SPECTRUM_PI * k / size;
+        plan->splitRe[k] = (float)cos(angle);
+        plan->splitIm[k] = (float)sin(angle);
+    }
+    for (uint32_t i = 0; i < size; ++i) {
+        double w = 0.5 - 0.5 * cos(2.0 * SPECTRUM_PI * i / size);
+        plan->window[i] = (float)w;
+        windowSum += w;
+    }
+    plan->scale = (float)(2.0 / windowSum);
+
+    PickKernels(plan);
+    return 0;
+}
+
+void SpectrumPlanClose(SpectrumPlan *plan) {
+    free(plan->bitReverse);
+    free(plan->twRe);
+    free(plan->twIm);
+    free(plan->splitRe);
+    free(plan->splitIm);
+    free(plan->window);
+    memset(plan, 0, sizeof(*plan));
+}
+
+int SpectrumWorkInit(SpectrumWork *work, const SpectrumPlan *plan) {
+    uint32_t half = plan->size / 2;
+
+    work->re = (float *)malloc(half * sizeof(float));
+    work->im = (float *)malloc(half * sizeof(float));
+    work->binRe = (float *)malloc(plan->bins * sizeof(float));
+    work->binIm = (float *)malloc(plan->bins * sizeof(float));
+    if (!work->re || !work->im || !work->binRe || !work->binIm) {
+        SpectrumWorkClose(work);
+        return -1;
+    }
+    return 0;
+}
+
+void SpectrumWorkClose(SpectrumWork *work) {
+    free(work->re);
+    free(work->im);
+    free(work->binRe);
+    free(work->binIm);
+    memset(work, 0, sizeof(*work));
+}
+
+void SpectrumTransform(const SpectrumPlan *plan, SpectrumWork *work, const float *samples, float *magnitudes) {
+    uint32_t half = plan->size / 2;
+    const float *w = plan->window;
+    float *re = work->re;
+    float *im = work->im;
+
+    // Even samples become the real parts and odd ones the imaginary parts,
+    // windowed and placed in bit-reversed order in the same pass
+    for (uint32_t k = 0; k < half; ++k) {
+        uint32_t r = plan->bitReverse[k];
+        re[r] = samples[2 * k] * w[2 * k];
+        im[r] = samples[2 * k + 1] * w[2 * k + 1];
+    }
+    for (uint32_t h = 1; h < half; h *= 2) {
+        plan->butterfly(re, im, plan->twRe + h - 1, plan->twIm + h - 1, h, half);
+    }
+
+    // Split the packed transform Z into the real spectrum X:
+    // X[k] = (Z[k] + conj(Z[N/2 - k])) / 2 - i W^k (Z[k] - conj(Z[N/2 - k])) / 2
+    work->binRe[0] = re[0] + im[0];
+    work->binIm[0] = 0.0f;
+    work->binRe[half] = re[0] - im[0];
+    work->binIm[half] = 0.0f;
+    for (uint32_t k = 1; k < half; ++k) {
+        float ar = re[k], ai = im[k];
+        float cr = re[half - k], ci = im[half - k];
+        float er = 0.5f * (ar + cr), ei = 0.5f * (ai - ci);
+        float dr = 0.5f * (ai + ci), di = -0.5f * (ar - cr);
+        float wr = plan->splitRe[k], wi = plan->splitIm[k];
+        work->binRe[k] = er + dr * wr - di * wi;
+        work->binIm[k] = ei + dr * wi + di * wr;
+    }
+
+    plan->magnitude(magnitudes, work->binRe, work->binIm, plan->scale, plan->bins);
+    // DC and Nyquist have no mirror image to share their energy with
+    magnitudes[0] *= 0.5f;
+    magnitudes[half] *= 0.5f;
+}
+
+double SpectrumPeakFrequency(const float *magnitudes, uint32_t bins, uint32_t sampleRate, float *level) {
+    uint32_t best = 1;
+    double offset = 0.0;
+
+    if (bins < 3) {
+        *level = 0.0f;
+        return 0.0;
+    }
+    for (uint32_t i = 2; i < bins; ++i) {
+        if (magnitudes[i] > magnitudes[best]) best = i;
+    }
+    *level = magnitudes[best];
+    if (best + 1 < bins && magnitudes[best - 1] > 0.0f && magnitudes[best] > 0.0f && magnitudes[best + 1] > 0.0f) {
+        double a = log(magnitudes[best - 1]), b = log(magnitudes[best]), c = log(magnitudes[best + 1]);
+        double denominator = a - 2.0 * b + c;
+        if (denominator < 0.0) offset = 0.5 * (a - c) / denominator;
+    }
+    return (best + offset) * sampleRate / (2.0 * (bins - 1));
+}
+
+// Live analyzer
+
+int SpectrogramInit(Spectrogram *s, const WavFormat *format, const SpectrogramConfig *config) {
+    SpectrogramConfig defaults = {0};
+    SampleFormat inSamples;
+    SampleFormat floatSamples;
+
+    memset(s, 0, sizeof(*s));
+    if (!config) config = &defaults;
+    if (format->channels == 0 || format->channels > SPECTRUM_MAX_CHANNELS) return -1;
+    if (SampleFormatFromWav(format, &inSamples) != 0) return -1;
+    if (SpectrumPlanInit(&s->plan, config->fftSize ? config->fftSize : SPECTRUM_DEFAULT_SIZE) != 0) return -1;
+
+    s->hop = config->hop ? config->hop : SPECTRUM_DEFAULT_HOP;
+    s->historyColumns = config->historyColumns ? config->historyColumns : SPECTRUM_HISTORY_COLUMNS;
+    if (s->hop > s->plan.size || s->historyColumns < 2) {
+        SpectrumPlanClose(&s->plan);
+        return -1;
+    }
+
+    floatSamples = inSamples;
+    floatSamples.type = SAMPLE_F32;
+    SampleConverterInit(&s->toFloat, &inSamples, &floatSamples);
+    s->channels = format->channels;
+    s->sampleRate = format->sampleRate;
+
+    if (SpectrumWorkInit(&s->work, &s->plan) != 0) {
+        SpectrogramClose(s);
+        return -1;
+    }
+    s->frame = (float *)calloc(s->plan.size, sizeof(float));
+    s->columns = (float *)calloc((size_t)s->historyColumns * s->plan.bins, sizeof(float));
+    if (inSamples.type != SAMPLE_F32) {
+        s->scratch = (float *)malloc((size_t)SPECTRUM_SCRATCH_FRAMES * s->channels * sizeof(float));
+    }
+    if (!s->frame || !s->columns || (inSamples.type != SAMPLE_F32 && !s->scratch)) {
+        SpectrogramClose(s);
+        return -1;
+    }
+    atomic_init(&s->columnCount, 0);
+    return 0;
+}
+
+void SpectrogramClose(Spectrogram *s) {
+    SpectrumWorkClose(&s->work);
+    SpectrumPlanClose(&s->plan);
+    free(s->scratch);
+    free(s->frame);
+    free(s->columns);
+    s->scratch = NULL;
+    s->frame = NULL;
+    s->columns = NULL;
+}
+
+// Appends frames averaged to mono; x is NULL for silence
+static uint32_t Downmix(float *dst, const float *x, uint32_t frames, uint16_t channels) {
+    float gain = 1.0f / channels;
+
+    if (!x) {
+        memset(dst, 0, frames * sizeof(float));
+    } else if (channels == 1) {
+        memcpy(dst, x, frames * sizeof(float));
+    } else {
+        for (uint32_t i = 0; i < frames; ++i) {
+            float sum = 0.0f;
+            for (uint16_t ch = 0; ch < channels; ++ch) sum += x[ch];
+            dst[i] = sum * gain;
+            x += channels;
+        }
+    }
+    return frames;
+}
+
+static void CompleteColumn(Spectrogram *s) {
+    uint64_t column = atomic_load_explicit(&s->columnCount, memory_order_relaxed);
+    float *out = s->columns + (size_t)(column % s->historyColumns) * s->plan.bins;
+
+    SpectrumTransform(&s->plan, &s->work, s->frame, out);
+    atomic_store_explicit(&s->columnCount, column + 1, memory_order_release);
+
+    // Keep the overlap for the next column
+    memmove(s->frame, s->frame + s->hop, (s->plan.size - s->hop) * sizeof(float));
+    s->filled = s->plan.size - s->hop;
+}
+
+void SpectrogramProcess(Spectrogram *s, const void *frames, uint32_t frameCount) {
+    const uint8_t *src = (const uint8_t *)frames;
+    uint32_t frameBytes = SampleFormatFrameBytes(&s->toFloat.in);
+
+    while (frameCount > 0) {
+        uint32_t n = s->plan.size - s->filled;
+        const float *x = (const float *)src;
+
+        if (n > frameCount) n = frameCount;
+        if (src && s->scratch) {
+            if (n > SPECTRUM_SCRATCH_FRAMES) n = SPECTRUM_SCRATCH_FRAMES;
+            SampleConverterRun(&s->toFloat, s->scratch, src, n, NULL);
+            x = s->scratch;
+        }
+        s->filled += Downmix(s->frame + s->filled, x, n, s->channels);
+
+        if (src) src += (size_t)n * frameBytes;
+        frameCount -= n;
+        if (s->filled == s->plan.size) CompleteColumn(s);
+    }
+}
+
+uint64_t SpectrogramColumns(Spectrogram *s) {
+    return atomic_load_explicit(&s->columnCount, memory_order_acquire);
+}
+
+int SpectrogramReadColumn(Spectrogram *s, uint64_t column, float *out) {
+    uint64_t count = atomic_load_explicit(&s->columnCount, memory_order_acquire);
+
+    // The slot of the column being written is the oldest one's, so that one is out too
+    if (column >= count || count - column >= s->historyColumns) return 0;
+    memcpy(out, s->columns + (size_t)(column % s->historyColumns) * s->plan.bins, s->plan.bins * sizeof(float));
+
+    atomic_thread_fence(memory_order_acquire);
+    count = atomic_load_explicit(&s->columnCount, memory_order_relaxed);
+    return count - column < s->historyColumns;
+}
+
+// Whole takes
+
+typedef struct {
+    const SpectrumPlan *plan;
+    TakeSpectrogram *out;
+    TakeSlice slice;
+    const WavFormat *format;
+    SampleConverter toFloat;
+    uint64_t firstColumn;
+    uint64_t columnCount;
+    int failed;
+} TakeSpectrumJob;
+
+// Walks the job's columns in order, reading only the hop of new frames for each
+static int TakeSpectrumMain(void *arg) {
+    TakeSpectrumJob *job = (TakeSpectrumJob *)arg;
+    const SpectrumPlan *plan = job->plan;
+    TakeSpectrogram *out = job->out;
+    uint16_t channels = job->format->channels;
+    uint32_t frameBytes = job->slice.storage->frameBytes;
+    SpectrumWork work;
+    float *frame = (float *)malloc(plan->size * sizeof(float));
+    float *floats = (float *)malloc((size_t)SPECTRUM_SCRATCH_FRAMES * channels * sizeof(float));
+    uint8_t *raw = (uint8_t *)malloc((size_t)SPECTRUM_SCRATCH_FRAMES * frameBytes);
+    uint32_t filled = 0;
+    uint64_t position = job->firstColumn * out->hop;
+
+    if (!frame || !floats || !raw || SpectrumWorkInit(&work, plan) != 0) {
+        job->failed = 1;
+        free(frame);
+        free(floats);
+        free(raw);
+        return 0;
+    }
+
+    for (uint64_t c = job->firstColumn; c < job->firstColumn + job->columnCount; ++c) {
+        while (filled < plan->size) {
+            uint32_t n = plan->size - filled;
+            uint64_t offset = (job->slice.startFrame + position) * frameBytes;
+
+            if (n > SPECTRUM_SCRATCH_FRAMES) n = SPECTRUM_SCRATCH_FRAMES;
+            if (TakeStorageRead(job->slice.storage, offset, raw, (size_t)n * frameBytes) != (size_t)n * frameBytes) {
+                job->failed = 1;
+                break;
+            }
+            SampleConverterRun(&job->toFloat, floats, raw, n, NULL);
+            filled += Downmix(frame + filled, floats, n, channels);
+            position += n;
+        }
+        if (job->failed) break;
+
+        SpectrumTransform(plan, &work, frame, out->magnitudes + c * out->bins);
+        memmove(frame, frame + out->hop, (plan->size - out->hop) * sizeof(float));
+        filled = plan->size - out->hop;
+    }
+
+    SpectrumWorkClose(&work);
+    free(frame);
+    free(floats);
+    free(raw);
+    return 0;
+}
+
+int TakeSpectrogramCompute(TakeSpectrogram *out, const TakeSlice *slice, const WavFormat *format,
+                           const SpectrogramConfig *config, uint32_t threads) {
+    SpectrogramConfig defaults = {0};
+    TakeSpectrumJob jobs[SPECTRUM_MAX_THREADS];
+    PlatformThread handles[SPECTRUM_MAX_THREADS];
+    int started[SPECTRUM_MAX_THREADS] = {0};
+    SampleFormat inSamples;
+    SampleFormat floatSamples;
+    SpectrumPlan plan;
+    uint32_t jobCount;
+    uint64_t startNs = PlatformNowNs();
+    int result = 0;
+
+    memset(out, 0, sizeof(*out));
+    if (!config) config = &defaults;
+    if (format->channels == 0 || SampleFormatFromWav(format, &inSamples) != 0) return -1;
+    if (SpectrumPlanInit(&plan, config->fftSize ? config->fftSize : SPECTRUM_DEFAULT_SIZE) != 0) return -1;
+
+    out->fftSize = plan.size;
+    out->hop = config->hop ? config->hop : SPECTRUM_DEFAULT_HOP;
+    out->bins = plan.bins;
+    out->sampleRate = format->sampleRate;
+    if (out->hop > plan.size) {
+        SpectrumPlanClose(&plan);
+        return -1;
+    }
+    if (slice->frameCount >= plan.size) out->columns = (slice->frameCount - plan.size) / out->hop + 1;
+    if (out->columns > 0) {
+        out->magnitudes = (float *)malloc((size_t)out->columns * out->bins * sizeof(float));
+        if (!out->magnitudes) {
+            SpectrumPlanClose(&plan);
+            return -1;
+        }
+    }
+
+    floatSamples = inSamples;
+    floatSamples.type = SAMPLE_F32;
+    if (threads > SPECTRUM_MAX_THREADS) threads = SPECTRUM_MAX_THREADS;
+    jobCount = threads ? threads : 1;
+    if (jobCount > out->columns) jobCount = out->columns ? (uint32_t)out->columns : 1;
+
+    for (uint32_t i = 0; i < jobCount; ++i) {
+        TakeSpectrumJob *job = &jobs[i];
+
+        job->plan = &plan;
+        job->out = out;
+        job->slice = *slice;
+        job->format = format;
+        SampleConverterInit(&job->toFloat, &inSamples, &floatSamples);
+        job->firstColumn = out->columns * i / jobCount;
+        job->columnCount = out->columns * (i + 1) / jobCount - job->firstColumn;
+        job->failed = 0;
+    }
+
+    // Without a worker thread a job runs on the calling thread
+    for (uint32_t i = 0; i < jobCount && threads > 0; ++i) {
+        if (PlatformThreadCreate(&handles[i], TakeSpectrumMain, &jobs[i]) == 0) {
+            started[i] = 1;
+            out->threads++;
+        }
+    }
+    for (uint32_t i = 0; i < jobCount; ++i) {
+        if (!started[i]) TakeSpectrumMain(&jobs[i]);
+    }
+    for (uint32_t i = 0; i < jobCount; ++i) {
+        if (started[i]) PlatformThreadJoin(handles[i]);
+        if (jobs[i].failed) result = -1;
+    }
+
+    SpectrumPlanClose(&plan);
+    out->elapsedNs = PlatformNowNs() - startNs;
+    if (result != 0) TakeSpectrogramClose(out);
+    return result;
+}
+
+void TakeSpectrogramClose(TakeSpectrogram *ts) {
+    free(ts->magnitudes);
+    ts->magnitudes = NULL;
+    ts->columns = 0;
+}
@@ -0,0 +1,117 @@
+// spectrum.h
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "sample_convert.h"
+#include "take_storage.h"
+#include "wav_writer.h"
+
+#define SPECTRUM_MIN_SIZE 16
+#define SPECTRUM_MAX_SIZE 32768
+#define SPECTRUM_DEFAULT_SIZE 2048
+#define SPECTRUM_DEFAULT_HOP 512
+#define SPECTRUM_HISTORY_COLUMNS 512  // Live columns kept for display, 5.5 s at the defaults and 48 kHz
+#define SPECTRUM_SCRATCH_FRAMES 1024
+#define SPECTRUM_MAX_CHANNELS 8
+#define SPECTRUM_MAX_THREADS 16
+
+// One radix-2 pass over every block of 2 * half complex values
+typedef void (*SpectrumButterflyFn)(float *re, float *im, const float *twRe, const float *twIm,
+                                    uint32_t half, uint32_t count);
+typedef void (*SpectrumMagnitudeFn)(float *mag, const float *re, const float *im, float scale, uint32_t count);
+
+// Tables for one transform size. A real frame of `size` samples is packed
+// into size / 2 complex values, transformed with an iterative radix-2 FFT
+// and split into the size / 2 + 1 bins of the real spectrum. Twiddles are
+// stored per pass, contiguous, so each pass is a plain vector loop. Read-only
+// once made: any number of threads may share one plan.
+typedef struct {
+    uint32_t size;                // Real samples per frame, a power of two
+    uint32_t bins;                // size / 2 + 1, DC to Nyquist
+    uint32_t *bitReverse;         // size / 2
+    float *twRe;                  // The pass with half h starts at h - 1; size / 2 - 1 in all
+    float *twIm;
+    float *splitRe;               // exp(-2 pi i k / size) for k < size / 2
+    float *splitIm;
+    float *window;                // Periodic Hann
+    float scale;                  // A full-scale sine reads 1.0 at its bin
+    SpectrumButterflyFn butterfly;
+    SpectrumMagnitudeFn magnitude;
+} SpectrumPlan;
+
+// Scratch for one transform at a time; one per thread.
+typedef struct {
+    float *re;                    // size / 2 each
+    float *im;
+    float *binRe;                 // bins each
+    float *binIm;
+} SpectrumWork;
+
+int SpectrumPlanInit(SpectrumPlan *plan, uint32_t size);
+void SpectrumPlanClose(SpectrumPlan *plan);
+int SpectrumWorkInit(SpectrumWork *work, const SpectrumPlan *plan);
+void SpectrumWorkClose(SpectrumWork *work);
+// Windows plan->size mono samples and writes plan->bins linear magnitudes.
+void SpectrumTransform(const SpectrumPlan *plan, SpectrumWork *work, const float *samples, float *magnitudes);
+// Strongest bin above DC, refined between bins by a parabola through the
+// neighbouring levels in dB. Returns the frequency and its magnitude in *level.
+double SpectrumPeakFrequency(const float *magnitudes, uint32_t bins, uint32_t sampleRate, float *level);
+
+typedef struct {
+    uint32_t fftSize;             // 0: SPECTRUM_DEFAULT_SIZE
+    uint32_t hop;                 // Frames between columns, at most fftSize; 0: SPECTRUM_DEFAULT_HOP
+    uint32_t historyColumns;      // Live analyzer only; 0: SPECTRUM_HISTORY_COLUMNS
+} SpectrogramConfig;
+
+// Short-time spectrum of a live stream, the channels averaged to mono. Column
+// c covers frames [c * hop, c * hop + fftSize), so the first one completes
+// once fftSize frames have arrived. Process runs on the capture thread without
+// locking or allocating. The newest historyColumns columns are kept in a
+// ring; each is written before the column count is published, and a reader
+// that was lapped while copying is told so, so the GUI never shows a torn one.
+typedef struct {
+    SpectrumPlan plan;
+    SpectrumWork work;
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint32_t hop;
+    uint32_t historyColumns;
+    SampleConverter toFloat;
+    float *scratch;               // Source frames widened to float
+    float *frame;                 // Mono input for the next column
+    uint32_t filled;
+    float *columns;               // historyColumns * plan.bins
+    atomic_uint_fast64_t columnCount;
+} Spectrogram;
+
+int SpectrogramInit(Spectrogram *s, const WavFormat *format, const SpectrogramConfig *config);
+void SpectrogramClose(Spectrogram *s);
+// frames are interleaved samples in the format given to Init; NULL analyzes silence.
+void SpectrogramProcess(Spectrogram *s, const void *frames, uint32_t frameCount);
+uint64_t SpectrogramColumns(Spectrogram *s);
+// Copies column's plan.bins magnitudes to out. Returns 0 if the column is not
+// complete yet or has already left the history.
+int SpectrogramReadColumn(Spectrogram *s, uint64_t column, float *out);
+
+// Spectrogram of a whole take, with the live analyzer's columns.
+typedef struct {
+    uint32_t fftSize;
+    uint32_t hop;
+    uint32_t bins;
+    uint32_t sampleRate;
+    uint64_t columns;
+    float *magnitudes;            // columns * bins, linear
+    uint32_t threads;             // Workers used, 0 if it ran on the calling thread
+    uint64_t elapsedNs;
+} TakeSpectrogram;
+
+// Analyzes a stored take, splitting its columns between up to threads
+// workers that share one plan; 0 runs on the calling thread. Returns when
+// every column is done. The take must not be appended to meanwhile.
+int TakeSpectrogramCompute(TakeSpectrogram *out, const TakeSlice *slice, const WavFormat *format,
+                           const SpectrogramConfig *config, uint32_t threads);
+void TakeSpectrogramClose(TakeSpectrogram *ts);
+
+#endif // SPECTRUM_H
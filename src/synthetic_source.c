@@ -0,0 +1,209 @@
+// synthetic_source.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture_source.h"
+
+#define TWO_PI 6.283185307179586
+#define BURST_HISS_LEVEL 0.001f       // About -66 dBFS below the tone
+
+typedef enum {
+    BURST_TONE = 0,
+    BURST_FLAGGED,                // Silent packets, as a device reports them
+    BURST_HISS                    // Quiet noise that has to be measured
+} BurstSegmentKind;
+
+typedef struct {
+    BurstSegmentKind kind;
+    uint32_t ms;
+} BurstSegment;
+
+// One cycle: a phrase with a short pause in it, a long flagged silence, another
+// phrase and a long stretch of hiss
+static const BurstSegment BurstCycle[] = {
+    { BURST_TONE, 1000 }, { BURST_FLAGGED, 300 }, { BURST_TONE, 700 }, { BURST_FLAGGED, 4000 },
+    { BURST_TONE, 500 }, { BURST_HISS, 4000 }
+};
+
+typedef struct {
+    CaptureSource base;
+    SyntheticSourceConfig config;
+    CapturePacer pacer;
+    float *packetBuffer;
+    double phase;
+    double phaseStep;
+    uint32_t noiseState;
+    uint64_t framesGenerated;
+    int running;
+} SyntheticCaptureSource;
+
+// Finds the burst segment at the current position and how many frames are left in it
+static BurstSegmentKind CurrentBurst(SyntheticCaptureSource *s, uint32_t *framesLeft) {
+    uint64_t cycleFrames = 0;
+    uint64_t position;
+    size_t count = sizeof(BurstCycle) / sizeof(BurstCycle[0]);
+
+    for (size_t i = 0; i < count; ++i) cycleFrames += (uint64_t)BurstCycle[i].ms * s->config.sampleRate / 1000;
+    position = s->framesGenerated % cycleFrames;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t frames = (uint64_t)BurstCycle[i].ms * s->config.sampleRate / 1000;
+        if (position < frames) {
+            *framesLeft = (uint32_t)(frames - position);
+            return BurstCycle[i].kind;
+        }
+        position -= frames;
+    }
+    *framesLeft = 0;
+    return BURST_TONE;
+}
+
+static void GenerateSine(SyntheticCaptureSource *s, float *out, uint32_t frames, float amplitude) {
+    for (uint32_t i = 0; i < frames; ++i) {
+        float v = amplitude * (float)sin(s->phase);
+        for (uint16_t c = 0; c < s->config.channels; ++c) *out++ = v;
+        s->phase += s->phaseStep;
+        if (s->phase >= TWO_PI) s->phase -= TWO_PI;
+    }
+}
+
+static void GenerateNoise(SyntheticCaptureSource *s, float *out, uint32_t samples, float amplitude) {
+    // Uniform white noise from xorshift32, independent per channel
+    for (uint32_t i = 0; i < samples; ++i) {
+        uint32_t x = s->noiseState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        s->noiseState = x;
+        *out++ = amplitude * ((float)(x >> 8) * (2.0f / 16777216.0f) - 1.0f);
+    }
+}
+
+static void GenerateFrames(SyntheticCaptureSource *s, uint32_t frames, BurstSegmentKind burst) {
+    uint16_t channels = s->config.channels;
+    float amplitude = s->config.amplitude;
+    float *out = s->packetBuffer;
+
+    switch (s->config.waveform) {
+    case SYNTHETIC_SINE:
+        GenerateSine(s, out, frames, amplitude);
+        break;
+
+    case SYNTHETIC_NOISE:
+        GenerateNoise(s, out, frames * channels, amplitude);
+        break;
+
+    case SYNTHETIC_SILENCE:
+        memset(out, 0, (size_t)frames * channels * sizeof(float));
+        break;
+
+    case SYNTHETIC_BURSTS:
+        if (burst == BURST_TONE) {
+            GenerateSine(s, out, frames, amplitude);
+        } else if (burst == BURST_HISS) {
+            GenerateNoise(s, out, frames * channels, amplitude * BURST_HISS_LEVEL);
+        } else {
+            memset(out, 0, (size_t)frames * channels * sizeof(float));
+        }
+        break;
+    }
+}
+
+static int SyntheticStart(CaptureSource *src) {
+    SyntheticCaptureSource *s = (SyntheticCaptureSource *)src;
+
+    CapturePacerStart(&s->pacer);
+    s->framesGenerated = 0;
+    s->running = 1;
+    return 0;
+}
+
+static int SyntheticWait(CaptureSource *src, uint32_t timeoutMs) {
+    SyntheticCaptureSource *s = (SyntheticCaptureSource *)src;
+    return CapturePacerWait(&s->pacer, timeoutMs);
+}
+
+static int SyntheticReadPacket(CaptureSource *src, CapturePacket *packet) {
+    SyntheticCaptureSource *s = (SyntheticCaptureSource *)src;
+    uint32_t frames = s->config.packetFrames;
+    BurstSegmentKind burst = BURST_TONE;
+    int silent = s->config.waveform == SYNTHETIC_SILENCE;
+
+    if (!s->running || src->endOfStream || !CapturePacerReady(&s->pacer)) return 0;
+
+    if (s->config.durationFrames && s->config.durationFrames - s->framesGenerated < frames) {
+        frames = (uint32_t)(s->config.durationFrames - s->framesGenerated);
+    }
+
+    // Burst packets never straddle a segment, so each is either flagged silent or not
+    if (s->config.waveform == SYNTHETIC_BURSTS) {
+        uint32_t left;
+        burst = CurrentBurst(s, &left);
+        if (frames > left) frames = left;
+        silent = burst == BURST_FLAGGED;
+    }
+
+    GenerateFrames(s, frames, burst);
+
+    packet->data = (const uint8_t *)s->packetBuffer;
+    packet->frames = frames;
+    packet->flags = silent ? CAPTURE_PACKET_SILENT : 0;
+    packet->timestampNs = CapturePacerTimestamp(&s->pacer);
+    if (packet->flags & CAPTURE_PACKET_SILENT) packet->data = NULL;
+    return 1;
+}
+
+static int SyntheticReleasePacket(CaptureSource *src, CapturePacket *packet) {
+    SyntheticCaptureSource *s = (SyntheticCaptureSource *)src;
+
+    CapturePacerAdvance(&s->pacer, packet->frames);
+    s->framesGenerated += packet->frames;
+    if (s->config.durationFrames && s->framesGenerated >= s->config.durationFrames) src->endOfStream = 1;
+    return 0;
+}
+
+static void SyntheticStop(CaptureSource *src) {
+    ((SyntheticCaptureSource *)src)->running = 0;
+}
+
+static void SyntheticDestroy(CaptureSource *src) {
+    SyntheticCaptureSource *s = (SyntheticCaptureSource *)src;
+
+    free(s->packetBuffer);
+    free(s);
+}
+
+static const CaptureSourceVtbl SyntheticVtbl = {
+    "synthetic",
+    SyntheticStart,
+    SyntheticWait,
+    SyntheticReadPacket,
+    SyntheticReleasePacket,
+    SyntheticStop,
+    SyntheticDestroy
+};
+
+int CreateSyntheticCaptureSource(const SyntheticSourceConfig *config, CaptureMode mode, CaptureSource **out) {
+    WavFormat format = { WAV_FORMAT_IEEE_FLOAT, config->channels, config->sampleRate, 32, 0 };
+    SyntheticCaptureSource *s;
+
+    if (!config->sampleRate || !config->channels || !config->packetFrames) return -1;
+
+    s = (SyntheticCaptureSource *)calloc(1, sizeof(*s));
+    if (!s) return -1;
+
+    CaptureSourceInitBase(&s->base, &SyntheticVtbl, &format, mode);
+    CapturePacerInit(&s->pacer, mode, config->sampleRate, config->packetFrames);
+    CapturePacerSetClockSkew(&s->pacer, config->clockSkewPpm);
+    s->config = *config;
+    s->phaseStep = TWO_PI * config->frequencyHz / config->sampleRate;
+    s->noiseState = 0x12345678u;
+    s->packetBuffer = (float *)malloc((size_t)config->packetFrames * config->channels * sizeof(float));
+    if (!s->packetBuffer) {
+        free(s);
+        return -1;
+    }
+
+    *out = &s->base;
+    return 0;
+}
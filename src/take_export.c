@@ -0,0 +1,558 @@
+// take_export.c
+#include "take_export.h"
+#include "instrument.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void ConvertSlot(const TakeExport *x, ExportSlot *slot, DitherState *dither) {
+    TakeSlice block = TakeSliceSub(&x->slice, slot->startFrame, slot->frames);
+    uint32_t outFrameBytes = SampleFormatFrameBytes(&x->converter.out);
+    TakeIterator it;
+    const void *frames;
+    uint32_t frameCount;
+    uint8_t *dst = slot->out;
+
+    TakeIteratorInit(&it, &block);
+    while ((frameCount = TakeIteratorNext(&it, &frames, slot->frames)) != 0) {
+        SampleConverterRun(&x->converter, dst, frames, frameCount, dither);
+        dst += (size_t)frameCount * outFrameBytes;
+    }
+    slot->outFrames = slot->frames;
+}
+
+// Take or edit frames [startFrame, startFrame + frameCount) as float
+static void ReadFloats(const TakeExport *x, uint64_t startFrame, uint64_t frameCount, float *dst) {
+    if (x->edits) {
+        EditListRender(x->edits, startFrame, (uint32_t)frameCount, dst);
+        return;
+    }
+
+    TakeSlice range = TakeSliceSub(&x->slice, startFrame, frameCount);
+    TakeIterator it;
+    const void *frames;
+    uint32_t n;
+
+    TakeIteratorInit(&it, &range);
+    while ((n = TakeIteratorNext(&it, &frames, EXPORT_FLOAT_FRAMES)) != 0) {
+        SampleConverterRun(&x->toFloat, dst, frames, n, NULL);
+        dst += (size_t)n * x->outFormat.channels;
+    }
+}
+
+// Frames the limiter reads before and after the ones it writes: the gain
+// looks back over the attack and hold and ahead over the attack, and the peak
+// detector needs its own history and delay on top
+static uint32_t LimiterFramesBefore(const TakeExport *x) {
+    return x->attackFrames - 1 + x->holdFrames + TRUE_PEAK_TAPS;
+}
+
+static uint32_t LimiterFramesAfter(const TakeExport *x) {
+    return x->attackFrames + TRUE_PEAK_DELAY;
+}
+
+static void LimitRange(const TakeExport *x, ExportSlot *slot, uint64_t startFrame, uint32_t frameCount) {
+    uint16_t channels = x->outFormat.channels;
+    uint64_t total = x->frameCount;
+    uint32_t before = LimiterFramesBefore(x);
+    uint32_t span = before + frameCount + LimiterFramesAfter(x);
+    uint64_t first = startFrame < before ? 0 : startFrame - before;
+    uint64_t end = startFrame + frameCount + LimiterFramesAfter(x);
+    uint32_t lead = (uint32_t)(first + before - startFrame);
+    uint32_t window = x->attackFrames + x->holdFrames;
+    float *need = slot->limitGain;
+    float *held = slot->limitGain + span;
+    uint32_t *order = slot->limitWindow;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    TruePeakDetector detector;
+    double sum = 0.0;
+
+    // Frames outside the take are silence
+    if (end > total) end = total;
+    memset(slot->limitIn, 0, (size_t)span * channels * sizeof(float));
+    ReadFloats(x, first, end - first, slot->limitIn + (size_t)lead * channels);
+
+    // The peak found after frame k lies between frames k - TRUE_PEAK_DELAY and the one after
+    TruePeakDetectorInit(&detector, channels);
+    memset(need, 0, (size_t)span * sizeof(float));
+    for (uint32_t k = 0; k < span; ++k) {
+        float peak = TruePeakDetectorPush(&detector, slot->limitIn + (size_t)k * channels) * x->gain;
+
+        if (k >= TRUE_PEAK_DELAY && peak > need[k - TRUE_PEAK_DELAY]) need[k - TRUE_PEAK_DELAY] = peak;
+        if (k + 1 >= TRUE_PEAK_DELAY && peak > need[k + 1 - TRUE_PEAK_DELAY]) need[k + 1 - TRUE_PEAK_DELAY] = peak;
+    }
+    for (uint32_t j = 0; j < span; ++j) need[j] = need[j] > x->ceiling ? x->ceiling / need[j] : 1.0f;
+
+    // Sliding minimum over the attack and hold up to each frame, indices in
+    // increasing order of both position and need
+    for (uint32_t j = TRUE_PEAK_TAPS; j < before + frameCount + x->attackFrames - 1; ++j) {
+        while (tail > head && need[order[tail - 1]] >= need[j]) tail--;
+        order[tail++] = j;
+        if (order[head] + window <= j) head++;
+        if (j >= before) held[j - before] = need[order[head]];
+    }
+
+    // Averaging over the attack ahead keeps every frame at or under the gain its own peak needs
+    for (uint32_t i = 0; i < x->attackFrames; ++i) sum += held[i];
+    for (uint32_t n = 0; n < frameCount; ++n) {
+        float gain = (float)(sum / x->attackFrames);
+        const float *src = slot->limitIn + (size_t)(before + n) * channels;
+        float *dst = slot->normal + (size_t)n * channels;
+        uint64_t frame = startFrame + n;
+
+        if (gain > 1.0f) gain = 1.0f;
+        for (uint16_t ch = 0; ch < channels; ++ch) dst[ch] = src[ch] * x->gain * gain;
+        if (gain < 1.0f && frame >= slot->startFrame && frame < slot->startFrame + slot->frames) slot->limitedFrames++;
+        if (n + 1 < frameCount) sum += held[n + x->attackFrames] - held[n];
+    }
+}
+
+// Writes take or edit frames [startFrame, startFrame + frameCount) to the slot's
+// normal buffer at the export's gain, limited if it has to be
+static void NormalizeRange(const TakeExport *x, ExportSlot *slot, uint64_t startFrame, uint32_t frameCount) {
+    size_t samples = (size_t)frameCount * x->outFormat.channels;
+
+    if (x->limiting) {
+        LimitRange(x, slot, startFrame, frameCount);
+        return;
+    }
+    ReadFloats(x, startFrame, frameCount, slot->normal);
+    for (size_t i = 0; i < samples; ++i) slot->normal[i] *= x->gain;
+}
+
+// Runs n float frames through the slot's resampler, or only primes it with them
+static uint32_t ResampleFloats(ExportSlot *slot, const float *in, uint32_t n, int prime, uint32_t produced) {
+    if (prime) {
+        ResamplerPrime(&slot->resampler, in, n);
+        return produced;
+    }
+    return produced + ResamplerProcess(&slot->resampler, in, n,
+                                       slot->floatOut + (size_t)produced * slot->resampler.channels);
+}
+
+// Feeds take or edit frames [startFrame, startFrame + frameCount) through the
+// slot's resampler as float; with prime set they only become history.
+// Returns the output frames produced.
+static uint32_t FeedResampler(const TakeExport *x, ExportSlot *slot, uint64_t startFrame, uint64_t frameCount,
+                              int prime, uint32_t produced) {
+    TakeSlice range = TakeSliceSub(&x->slice, startFrame, frameCount);
+    TakeIterator it;
+    const void *frames;
+    uint32_t n;
+
+    if (x->edits) {
+        while (frameCount > 0) {
+            n = frameCount < EXPORT_FLOAT_FRAMES ? (uint32_t)frameCount : EXPORT_FLOAT_FRAMES;
+            n = EditListRender(x->edits, startFrame, n, slot->floatIn);
+            if (n == 0) break;
+            produced = ResampleFloats(slot, slot->floatIn, n, prime, produced);
+            startFrame += n;
+            frameCount -= n;
+        }
+        return produced;
+    }
+
+    TakeIteratorInit(&it, &range);
+    while ((n = TakeIteratorNext(&it, &frames, EXPORT_FLOAT_FRAMES)) != 0) {
+        const float *in = (const float *)frames;
+
+        if (x->toFloat.in.type != SAMPLE_F32) {
+            SampleConverterRun(&x->toFloat, slot->floatIn, frames, n, NULL);
+            in = slot->floatIn;
+        }
+        produced = ResampleFloats(slot, in, n, prime, produced);
+    }
+    return produced;
+}
+
+static void ResampleSlot(const TakeExport *x, ExportSlot *slot) {
+    Resampler *r = &slot->resampler;
+    uint64_t total = x->frameCount;
+    uint64_t history = slot->startFrame < r->taps - 1 ? slot->startFrame : r->taps - 1;
+    uint64_t end = slot->startFrame + slot->frames;
+    uint64_t lookahead = r->taps / 2;
+    uint64_t available = total - end < lookahead ? total - end : lookahead;
+    uint32_t produced;
+
+    // The frames before the block become history and the filter's lookahead
+    // comes from after it, silence past the end of the take
+    ResamplerReset(r);
+    if (x->normalizing) {
+        const float *in = slot->normal + (size_t)history * r->channels;
+
+        NormalizeRange(x, slot, slot->startFrame - history, (uint32_t)(history + slot->frames + available));
+        ResamplerPrime(r, slot->normal, (uint32_t)history);
+        produced = ResamplerProcess(r, in, (uint32_t)(slot->frames + available), slot->floatOut);
+    } else {
+        FeedResampler(x, slot, slot->startFrame - history, history, 1, 0);
+        produced = FeedResampler(x, slot, slot->startFrame, slot->frames + available, 0, 0);
+    }
+    if (available < lookahead) {
+        produced += ResamplerProcess(r, NULL, (uint32_t)(lookahead - available),
+                                     slot->floatOut + (size_t)produced * r->channels);
+    }
+    slot->outFrames = produced;
+}
+
+static void ProcessSlot(const TakeExport *x, ExportSlot *slot) {
+    uint64_t startNs = PlatformNowNs();
+    DitherState dither;
+    DitherState *ditherPtr = NULL;
+
+    // Seeding by block index keeps the noise independent of which worker ran it
+    if (x->config.dither) {
+        DitherInit(&dither, (uint32_t)(slot->startFrame / x->blockFrames) + 1u);
+        ditherPtr = &dither;
+    }
+
+    slot->limitedFrames = 0;
+    if (x->resampling) {
+        ResampleSlot(x, slot);
+        SampleConverterRun(&x->converter, slot->out, slot->floatOut, slot->outFrames, ditherPtr);
+    } else if (x->normalizing) {
+        NormalizeRange(x, slot, slot->startFrame, slot->frames);
+        SampleConverterRun(&x->converter, slot->out, slot->normal, slot->frames, ditherPtr);
+        slot->outFrames = slot->frames;
+    } else if (x->edits) {
+        ReadFloats(x, slot->startFrame, slot->frames, slot->normal);
+        SampleConverterRun(&x->converter, slot->out, slot->normal, slot->frames, ditherPtr);
+        slot->outFrames = slot->frames;
+    } else {
+        ConvertSlot(x, slot, ditherPtr);
+    }
+    slot->convertNs = PlatformNowNs() - startNs;
+    INSTR_RECORD(INSTR_EXPORT_CONVERT_NS, slot->convertNs);
+}
+
+static int WorkerMain(void *arg) {
+    TakeExport *x = (TakeExport *)arg;
+
+    while (!atomic_load(&x->stopWorkers)) {
+        int found = 0;
+
+        for (uint32_t i = 0; i < x->slotCount; ++i) {
+            ExportSlot *slot = &x->slots[i];
+            int expected = EXPORT_SLOT_READY;
+
+            if (atomic_compare_exchange_strong(&slot->state, &expected, EXPORT_SLOT_BUSY)) {
+                ProcessSlot(x, slot);
+                atomic_store(&slot->state, EXPORT_SLOT_DONE);
+                PlatformEventSignal(&x->doneEvent);
+                found = 1;
+            }
+        }
+        if (!found) PlatformEventWait(&x->workEvent, EXPORT_WAIT_MS);
+    }
+    return 0;
+}
+
+static void StopWorkers(TakeExport *x) {
+    atomic_store(&x->stopWorkers, 1);
+    for (uint32_t i = 0; i < x->workerCount; ++i) PlatformEventSignal(&x->workEvent);
+    for (uint32_t i = 0; i < x->workerCount; ++i) PlatformThreadJoin(x->workers[i]);
+    x->workerCount = 0;
+    PlatformEventDestroy(&x->workEvent);
+    PlatformEventDestroy(&x->doneEvent);
+}
+
+static void StartWorkers(TakeExport *x, uint32_t threads) {
+    atomic_init(&x->stopWorkers, 0);
+    if (threads == 0) return;
+    if (PlatformEventInit(&x->workEvent) != 0) return;
+    if (PlatformEventInit(&x->doneEvent) != 0) {
+        PlatformEventDestroy(&x->workEvent);
+        return;
+    }
+    for (uint32_t i = 0; i < threads; ++i) {
+        if (PlatformThreadCreate(&x->workers[i], WorkerMain, x) != 0) break;
+        x->workerCount++;
+    }
+    // Without a single worker, blocks are converted on the export thread
+    if (x->workerCount == 0) {
+        PlatformEventDestroy(&x->workEvent);
+        PlatformEventDestroy(&x->doneEvent);
+    }
+}
+
+static void FreeSlots(TakeExport *x) {
+    for (uint32_t i = 0; i < x->slotCount; ++i) {
+        ResamplerClose(&x->slots[i].resampler);
+        free(x->slots[i].floatIn);
+        free(x->slots[i].floatOut);
+        free(x->slots[i].normal);
+        free(x->slots[i].limitIn);
+        free(x->slots[i].limitGain);
+        free(x->slots[i].limitWindow);
+        x->slots[i].floatIn = NULL;
+        x->slots[i].floatOut = NULL;
+        x->slots[i].normal = NULL;
+        x->slots[i].limitIn = NULL;
+        x->slots[i].limitGain = NULL;
+        x->slots[i].limitWindow = NULL;
+    }
+    ResamplerClose(&x->resampler);
+    free(x->slotMemory);
+    x->slotMemory = NULL;
+}
+
+static int AllocateSlots(TakeExport *x) {
+    uint32_t slotFrames = x->blockFrames;
+    size_t slotBytes;
+
+    if (x->resampling) slotFrames = ResamplerMaxOutput(&x->resampler, x->blockFrames + x->resampler.taps / 2);
+    slotBytes = (size_t)slotFrames * SampleFormatFrameBytes(&x->converter.out);
+    x->slotMemory = (uint8_t *)malloc(slotBytes * x->slotCount);
+    if (!x->slotMemory) return -1;
+
+    for (uint32_t i = 0; i < x->slotCount; ++i) {
+        ExportSlot *slot = &x->slots[i];
+        uint16_t channels = x->outFormat.channels;
+
+        slot->out = x->slotMemory + slotBytes * i;
+        atomic_init(&slot->state, EXPORT_SLOT_IDLE);
+        if (x->normalizing || x->edits) {
+            slot->normal = (float *)malloc((size_t)x->normalFrames * channels * sizeof(float));
+            if (!slot->normal) return -1;
+        }
+        if (x->limiting) {
+            size_t span = (size_t)LimiterFramesBefore(x) + x->normalFrames + LimiterFramesAfter(x);
+
+            slot->limitIn = (float *)malloc(span * channels * sizeof(float));
+            slot->limitGain = (float *)malloc(2 * span * sizeof(float));
+            slot->limitWindow = (uint32_t *)malloc(span * sizeof(uint32_t));
+            if (!slot->limitIn || !slot->limitGain || !slot->limitWindow) return -1;
+        }
+        if (!x->resampling) continue;
+
+        slot->floatIn = (float *)malloc((size_t)EXPORT_FLOAT_FRAMES * channels * sizeof(float));
+        slot->floatOut = (float *)malloc((size_t)slotFrames * channels * sizeof(float));
+        if (!slot->floatIn || !slot->floatOut || ResamplerClone(&slot->resampler, &x->resampler) != 0) return -1;
+    }
+    return 0;
+}
+
+static int ExportMain(void *arg) {
+    TakeExport *x = (TakeExport *)arg;
+    uint64_t total = x->frameCount;
+    uint64_t nextFrame = 0;
+    uint64_t framesDone = 0;
+    uint32_t fillSlot = 0;
+    uint32_t writeSlot = 0;
+    int result = 0;
+
+    for (;;) {
+        // Hand out blocks while there are free slots; stop handing out once cancelled
+        while (nextFrame < total && !atomic_load(&x->cancelRequested) &&
+               atomic_load(&x->slots[fillSlot].state) == EXPORT_SLOT_IDLE) {
+            ExportSlot *slot = &x->slots[fillSlot];
+            uint64_t left = total - nextFrame;
+
+            slot->startFrame = nextFrame;
+            slot->frames = left < x->blockFrames ? (uint32_t)left : x->blockFrames;
+            nextFrame += slot->frames;
+            if (x->workerCount == 0) {
+                ProcessSlot(x, slot);
+                atomic_store(&slot->state, EXPORT_SLOT_DONE);
+            } else {
+                atomic_store(&slot->state, EXPORT_SLOT_READY);
+                PlatformEventSignal(&x->workEvent);
+            }
+            fillSlot = (fillSlot + 1) % x->slotCount;
+        }
+
+        // Write the oldest block once converted; an idle oldest slot means nothing is in flight
+        ExportSlot *slot = &x->slots[writeSlot];
+        int state;
+        while ((state = atomic_load(&slot->state)) != EXPORT_SLOT_DONE && state != EXPORT_SLOT_IDLE) {
+            PlatformEventWait(&x->doneEvent, EXPORT_WAIT_MS);
+        }
+        if (state == EXPORT_SLOT_IDLE) break;
+
+        if (result == 0 && !atomic_load(&x->cancelRequested)) {
+            INSTR_TIMER(writeStartNs);
+            int appended = WavWriterAppend(&x->writer, slot->out, slot->outFrames);
+            INSTR_ELAPSED(INSTR_EXPORT_WRITE_NS, writeStartNs);
+            if (appended != 0) {
+                result = -1;
+                atomic_store(&x->cancelRequested, 1);
+            } else {
+                // Progress counts take frames, whatever the output rate
+                framesDone += slot->frames;
+                x->stats.framesWritten += slot->outFrames;
+                atomic_store(&x->framesDone, framesDone);
+                if (x->config.progress) x->config.progress(x->config.user, framesDone, total);
+            }
+        }
+        x->stats.convertNs += slot->convertNs;
+        x->stats.limitedFrames += slot->limitedFrames;
+        atomic_store(&slot->state, EXPORT_SLOT_IDLE);
+        writeSlot = (writeSlot + 1) % x->slotCount;
+    }
+
+    if (x->workerCount) StopWorkers(x);
+
+    x->stats.bytesWritten = x->writer.dataBytes;
+    if (WavWriterFinalize(&x->writer) != 0) result = -1;
+    if (result == 0 && framesDone < total) result = 1;
+    if (result != 0) remove(x->path);
+
+    x->stats.endNs = PlatformNowNs();
+    x->stats.result = result;
+    FreeSlots(x);
+
+    atomic_store(&x->running, 0);
+    if (x->config.done) x->config.done(x->config.user, result);
+    return result;
+}
+
+int TakeExportStart(TakeExport *x, const TakeSlice *slice, const WavFormat *inFormat, const TakeExportConfig *config) {
+    SampleFormat inSamples;
+    SampleFormat outSamples;
+    uint32_t threads = config->threads;
+
+    memset(x, 0, sizeof(*x));
+    if (SampleFormatFromWav(inFormat, &inSamples) != 0) {
+        fprintf(stderr, "No converter for the take's sample format\n");
+        return -1;
+    }
+    outSamples = inSamples;
+    outSamples.type = config->outType;
+    SampleFormatToWav(&outSamples, inFormat->sampleRate, &x->outFormat);
+    x->outFormat.channelMask = inFormat->channelMask;
+    x->blockFrames = EXPORT_BLOCK_FRAMES;
+
+    if (config->normalize && !isfinite(config->loudness.integrated)) {
+        fprintf(stderr, "The take has no measured loudness; exporting it without normalizing\n");
+    } else if (config->normalize) {
+        double target = config->targetLufs != 0.0 ? config->targetLufs : LOUDNESS_DEFAULT_TARGET_LUFS;
+        double ceiling = config->ceilingDbtp != 0.0 ? config->ceilingDbtp : LOUDNESS_DEFAULT_CEILING_DBTP;
+
+        x->normalizing = 1;
+        x->stats.gainDb = target - config->loudness.integrated;
+        x->gain = (float)pow(10.0, x->stats.gainDb / 20.0);
+        x->ceiling = (float)pow(10.0, ceiling / 20.0);
+        x->limiting = config->loudness.truePeak + x->stats.gainDb > ceiling;
+        x->attackFrames = (uint32_t)(inFormat->sampleRate * EXPORT_LIMITER_ATTACK_MS / 1000.0);
+        x->holdFrames = (uint32_t)(inFormat->sampleRate * EXPORT_LIMITER_HOLD_MS / 1000.0);
+        if (x->attackFrames == 0) x->attackFrames = 1;
+    }
+
+    // An edit that changes nothing exports faster straight from the slice
+    x->slice = *slice;
+    x->frameCount = slice->frameCount;
+    if (config->edits && !EditListIsIdentity(config->edits)) {
+        x->edits = config->edits;
+        x->frameCount = EditListFrames(config->edits);
+    }
+
+    // Resampling, normalizing and editing run on float, so the take is widened first and narrowed after.
+    // Blocks start on whole phase periods so every block begins at phase 0.
+    if (config->outRate && config->outRate != inFormat->sampleRate) {
+        if (ResamplerInit(&x->resampler, inFormat->sampleRate, config->outRate, inFormat->channels) != 0) {
+            fprintf(stderr, "Cannot resample from %u Hz to %u Hz\n", inFormat->sampleRate, config->outRate);
+            return -1;
+        }
+        x->resampling = 1;
+        x->outFormat.sampleRate = config->outRate;
+
+        x->blockFrames -= x->blockFrames % x->resampler.downFactor;
+        if (x->blockFrames == 0) x->blockFrames = x->resampler.downFactor;
+    }
+    x->normalFrames = x->blockFrames;
+    if (x->resampling) x->normalFrames += x->resampler.taps - 1 + x->resampler.taps / 2;
+    if (x->resampling || x->normalizing || x->edits) {
+        SampleFormat floatSamples = inSamples;
+        floatSamples.type = SAMPLE_F32;
+
+        SampleConverterInit(&x->toFloat, &inSamples, &floatSamples);
+        inSamples = floatSamples;
+    }
+    SampleConverterInit(&x->converter, &inSamples, &outSamples);
+
+    x->config = *config;
+    x->path = (char *)malloc(strlen(config->path) + 1);
+    if (!x->path) {
+        ResamplerClose(&x->resampler);
+        return -1;
+    }
+    strcpy(x->path, config->path);
+    x->config.path = x->path;
+
+    if (threads > EXPORT_MAX_THREADS) threads = EXPORT_MAX_THREADS;
+    x->slotCount = (threads ? threads : 1) * EXPORT_SLOTS_PER_THREAD;
+    if (AllocateSlots(x) != 0) {
+        FreeSlots(x);
+        free(x->path);
+        return -1;
+    }
+
+    if (WavWriterOpen(&x->writer, x->path, &x->outFormat) != 0) {
+        fprintf(stderr, "Failed to open %s for writing\n", x->path);
+        FreeSlots(x);
+        free(x->path);
+        return -1;
+    }
+
+    atomic_init(&x->cancelRequested, 0);
+    atomic_init(&x->framesDone, 0);
+    atomic_init(&x->running, 1);
+    x->stats.startNs = PlatformNowNs();
+    StartWorkers(x, threads);
+    x->stats.threads = x->workerCount;
+
+    if (PlatformThreadCreate(&x->exportThread, ExportMain, x) != 0) {
+        if (x->workerCount) StopWorkers(x);
+        WavWriterFinalize(&x->writer);
+        remove(x->path);
+        FreeSlots(x);
+        free(x->path);
+        return -1;
+    }
+    return 0;
+}
+
+void TakeExportCancel(TakeExport *x) {
+    atomic_store(&x->cancelRequested, 1);
+}
+
+int TakeExportIsRunning(TakeExport *x) {
+    return atomic_load(&x->running);
+}
+
+uint64_t TakeExportFramesDone(TakeExport *x) {
+    return atomic_load(&x->framesDone);
+}
+
+int TakeExportWait(TakeExport *x) {
+    PlatformThreadJoin(x->exportThread);
+    free(x->path);
+    x->path = NULL;
+    return x->stats.result;
+}
+
+void TakeExportPrintStats(const TakeExport *x, FILE *out) {
+    double seconds = (double)(x->stats.endNs - x->stats.startNs) / 1e9;
+    double audioSeconds = (double)x->stats.framesWritten / x->outFormat.sampleRate;
+    double megabytes = (double)x->stats.bytesWritten / (1024.0 * 1024.0);
+
+    fprintf(out, "Export: %llu frames at %u Hz, %.1f MB in %.3f s (%s)\n",
+            (unsigned long long)x->stats.framesWritten, x->outFormat.sampleRate, megabytes, seconds,
+            x->stats.result == 0 ? "complete" : x->stats.result > 0 ? "cancelled" : "failed");
+    if (seconds > 0.0) {
+        fprintf(out, "  throughput %.1f MB/s, %.0fx realtime, %u worker(s), %u slots of %u frames\n",
+                megabytes / seconds, audioSeconds / seconds, x->stats.threads, x->slotCount, x->blockFrames);
+    }
+    if (x->resampling) {
+        fprintf(out, "  resampled %u -> %u Hz, %u taps x %u phases\n", x->resampler.inRate, x->resampler.outRate,
+                x->resampler.taps, x->resampler.upFactor);
+    }
+    if (x->normalizing) {
+        fprintf(out, "  normalized from %.1f LUFS with %+.1f dB gain, %llu frames limited under %.1f dBTP\n",
+                x->config.loudness.integrated, x->stats.gainDb, (unsigned long long)x->stats.limitedFrames,
+                20.0 * log10(x->ceiling));
+    }
+    if (x->stats.convertNs > 0) {
+        fprintf(out, "  conversion %.3f s summed over workers\n", (double)x->stats.convertNs / 1e9);
+    }
+}
@@ -0,0 +1,151 @@
+// take_export.h
+#ifndef TAKE_EXPORT_H
+#define TAKE_EXPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "take_storage.h"
+#include "edit_list.h"
+#include "sample_convert.h"
+#include "wav_writer.h"
+#include "resampler.h"
+#include "loudness.h"
+#include "platform.h"
+
+#define EXPORT_BLOCK_FRAMES (64 * 1024)
+#define EXPORT_MAX_THREADS 16
+#define EXPORT_SLOTS_PER_THREAD 2
+#define EXPORT_MAX_SLOTS (EXPORT_MAX_THREADS * EXPORT_SLOTS_PER_THREAD)
+#define EXPORT_WAIT_MS 50
+#define EXPORT_FLOAT_FRAMES 4096
+#define EXPORT_LIMITER_ATTACK_MS 2.0      // Gain ramps down over this before a peak and back up after
+#define EXPORT_LIMITER_HOLD_MS 50.0       // and holds this long between the two
+
+typedef enum {
+    EXPORT_SLOT_IDLE = 0,
+    EXPORT_SLOT_READY,            // Block assigned, waiting for a worker
+    EXPORT_SLOT_BUSY,
+    EXPORT_SLOT_DONE              // Converted, waiting to be written in order
+} ExportSlotState;
+
+// One block of the reorder buffer. When resampling, each slot runs its own
+// resampler state over the shared filter table.
+typedef struct {
+    uint64_t startFrame;
+    uint32_t frames;              // Input frames
+    uint32_t outFrames;
+    uint8_t *out;
+    Resampler resampler;
+    float *floatIn;
+    float *floatOut;
+    float *normal;                // Normalized frames for the block and the resampler's margins
+    float *limitIn;               // Take frames the limiter looks at, before and after those too
+    float *limitGain;             // Gain each of them needs, then the gain held over the window
+    uint32_t *limitWindow;        // Sliding minimum of the needed gains, as indices
+    uint64_t limitedFrames;
+    uint64_t convertNs;
+    atomic_int state;
+} ExportSlot;
+
+// Both run on the export thread. result is 0 when the whole take was written,
+// 1 if the export was cancelled and -1 on error.
+typedef void (*TakeExportProgressFn)(void *user, uint64_t framesDone, uint64_t framesTotal);
+typedef void (*TakeExportDoneFn)(void *user, int result);
+
+typedef struct {
+    const char *path;
+    SampleType outType;
+    uint32_t outRate;             // 0 keeps the take's rate
+    uint32_t threads;             // Conversion workers; 0 converts on the export thread
+    int dither;
+    int normalize;                // Gain the take to targetLufs, limited to ceilingDbtp
+    double targetLufs;            // 0: LOUDNESS_DEFAULT_TARGET_LUFS
+    double ceilingDbtp;           // 0: LOUDNESS_DEFAULT_CEILING_DBTP
+    LoudnessSummary loudness;     // Of what is exported: the take's, or the edit's when there is one
+    const EditList *edits;        // Over the slice; NULL exports the slice as it is
+    TakeExportProgressFn progress;
+    TakeExportDoneFn done;
+    void *user;
+} TakeExportConfig;
+
+typedef struct {
+    uint64_t framesWritten;
+    uint64_t bytesWritten;
+    uint64_t convertNs;           // Conversion time summed over all workers
+    uint64_t startNs;
+    uint64_t endNs;
+    uint32_t threads;
+    double gainDb;                // Applied by normalization, before limiting
+    uint64_t limitedFrames;       // Input frames the limiter turned down
+    int result;
+} TakeExportStats;
+
+// Writes a take slice to a WAV file off the calling thread. The slice is cut
+// into blocks that workers convert concurrently; the export thread writes them
+// strictly in order through a ring of slots, so at most a few blocks are held
+// in memory whatever the length of the take. The take must not be appended to
+// while the export runs. Dither is seeded per block, so the output does not
+// depend on the number of threads. When resampling, blocks start on multiples
+// of the resampler's phase period and are primed with the frames before them,
+// so they join up exactly as one continuous stream would. Given an edit list,
+// each block is rendered from it on float, so the edits cost nothing until
+// the frames they cover are written.
+//
+// Normalizing applies one gain that takes the loudness measured beforehand to
+// the target, so the take is read only once, by the export itself. When that
+// gain would push the measured true peak over the ceiling, a lookahead
+// limiter turns the gain down around each peak: the gain every frame needs to
+// keep its 4x oversampled peak under the ceiling is held at its minimum over
+// the attack and hold times, then averaged over the attack time, so it ramps
+// smoothly and is never above what any frame needs. Each block computes its
+// gain from the take frames around it, so blocks join up without passing
+// state between workers.
+typedef struct {
+    TakeSlice slice;
+    const EditList *edits;        // NULL when there is nothing to render
+    uint64_t frameCount;          // Of the slice or the edit
+    TakeExportConfig config;
+    char *path;
+    WavFormat outFormat;
+    SampleConverter converter;    // To the output format; from float when resampling, normalizing or editing
+    SampleConverter toFloat;
+    Resampler resampler;
+    int resampling;
+    int normalizing;
+    int limiting;
+    float gain;
+    float ceiling;
+    uint32_t attackFrames;
+    uint32_t holdFrames;
+    uint32_t normalFrames;        // Frames a slot normalizes at most
+    uint32_t blockFrames;
+    WavWriter writer;
+
+    ExportSlot slots[EXPORT_MAX_SLOTS];
+    uint32_t slotCount;
+    uint8_t *slotMemory;
+
+    PlatformThread exportThread;
+    PlatformThread workers[EXPORT_MAX_THREADS];
+    uint32_t workerCount;
+    PlatformEvent workEvent;
+    PlatformEvent doneEvent;
+    atomic_int stopWorkers;
+    atomic_int cancelRequested;
+    atomic_int running;
+    atomic_uint_fast64_t framesDone;
+
+    TakeExportStats stats;
+} TakeExport;
+
+int TakeExportStart(TakeExport *x, const TakeSlice *slice, const WavFormat *inFormat, const TakeExportConfig *config);
+// Stops after the blocks in flight; the partial file is deleted.
+void TakeExportCancel(TakeExport *x);
+int TakeExportIsRunning(TakeExport *x);
+uint64_t TakeExportFramesDone(TakeExport *x);
+// Joins the export thread and returns the result passed to the done callback.
+int TakeExportWait(TakeExport *x);
+void TakeExportPrintStats(const TakeExport *x, FILE *out);
+
+#endif // TAKE_EXPORT_H
@@ -0,0 +1,195 @@
+// take_storage.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "take_storage.h"
+#include "instrument.h"
+
+// Doubles a pointer table until it has room for one more entry.
+static int GrowTable(uint8_t ***table, size_t *capacity, size_t count) {
+    if (count < *capacity) return 0;
+
+    size_t newCapacity = *capacity ? *capacity * 2 : TAKE_TABLE_INITIAL;
+    uint8_t **grown = (uint8_t **)realloc(*table, newCapacity * sizeof(**table));
+    if (!grown) return -1;
+
+    *table = grown;
+    *capacity = newCapacity;
+    return 0;
+}
+
+// Adds a region to the pool and pushes its chunk slots onto the free stack.
+// Regions start on TAKE_REGION_BYTES boundaries in the file so every view is aligned.
+static int AddRegion(TakeStorage *ts) {
+    uint8_t *region;
+
+    if (GrowTable(&ts->regions, &ts->regionCapacity, ts->regionCount) != 0) return -1;
+    // Keep room on the free stack for every slot in the pool, so Reset never allocates
+    while (ts->freeCapacity < (ts->regionCount + 1) * TAKE_REGION_CHUNKS) {
+        if (GrowTable(&ts->freeChunks, &ts->freeCapacity, ts->freeCapacity) != 0) return -1;
+    }
+
+    if (ts->fileBacked) {
+        region = (uint8_t *)PlatformMapFileView(&ts->file, (uint64_t)ts->regionCount * TAKE_REGION_BYTES,
+                                                TAKE_REGION_BYTES);
+    } else {
+        region = (uint8_t *)malloc(TAKE_REGION_BYTES);
+    }
+    if (!region) return -1;
+
+    ts->regions[ts->regionCount++] = region;
+    // The first region comes with the take; later ones are the take outgrowing its pool
+    if (ts->regionCount > 1) INSTR_COUNT(INSTR_TAKE_GROWS);
+
+    // Pushed in reverse so chunks are handed out in address order
+    for (int i = TAKE_REGION_CHUNKS - 1; i >= 0; --i) {
+        ts->freeChunks[ts->freeCount++] = region + (size_t)i * TAKE_CHUNK_BYTES;
+    }
+    return 0;
+}
+
+static int AddChunk(TakeStorage *ts) {
+    if (GrowTable(&ts->chunks, &ts->chunkCapacity, ts->chunkCount) != 0) return -1;
+    if (ts->freeCount == 0 && AddRegion(ts) != 0) return -1;
+
+    ts->chunks[ts->chunkCount++] = ts->freeChunks[--ts->freeCount];
+    return 0;
+}
+
+int TakeStorageOpen(TakeStorage *ts, const char *spillPath, uint32_t frameBytes) {
+    memset(ts, 0, sizeof(*ts));
+    if (frameBytes == 0 || frameBytes > TAKE_CHUNK_BYTES) return -1;
+
+    ts->frameBytes = frameBytes;
+    ts->chunkBytes = (TAKE_CHUNK_BYTES / frameBytes) * frameBytes;
+
+    if (spillPath) {
+        if (PlatformMapFileOpen(&ts->file, spillPath) == 0) {
+            ts->fileBacked = 1;
+        } else {
+            printf("Failed to create %s, keeping the take in memory\n", spillPath);
+        }
+    }
+
+    if (AddRegion(ts) != 0) {
+        TakeStorageClose(ts);
+        return -1;
+    }
+    return 0;
+}
+
+void TakeStorageClose(TakeStorage *ts) {
+    for (size_t i = 0; i < ts->regionCount; ++i) {
+        if (ts->fileBacked) {
+            PlatformMapFileUnview(ts->regions[i], TAKE_REGION_BYTES);
+        } else {
+            free(ts->regions[i]);
+        }
+    }
+    free(ts->regions);
+    free(ts->chunks);
+    free(ts->freeChunks);
+    if (ts->fileBacked) PlatformMapFileClose(&ts->file);
+    memset(ts, 0, sizeof(*ts));
+}
+
+void TakeStorageReset(TakeStorage *ts) {
+    while (ts->chunkCount > 0) {
+        ts->freeChunks[ts->freeCount++] = ts->chunks[--ts->chunkCount];
+    }
+    ts->length = 0;
+}
+
+int TakeStorageAppend(TakeStorage *ts, const void *data, size_t bytes) {
+    const uint8_t *src = (const uint8_t *)data;
+
+    while (bytes > 0) {
+        size_t index = (size_t)(ts->length / ts->chunkBytes);
+        size_t offset = (size_t)(ts->length % ts->chunkBytes);
+
+        if (index == ts->chunkCount && AddChunk(ts) != 0) return -1;
+
+        size_t n = ts->chunkBytes - offset;
+        if (n > bytes) n = bytes;
+
+        memcpy(ts->chunks[index] + offset, src, n);
+        ts->length += n;
+        src += n;
+        bytes -= n;
+    }
+    return 0;
+}
+
+uint64_t TakeStorageFrames(const TakeStorage *ts) {
+    return ts->frameBytes ? ts->length / ts->frameBytes : 0;
+}
+
+size_t TakeStorageSpan(const TakeStorage *ts, uint64_t offset, const void **ptr) {
+    if (offset >= ts->length) return 0;
+
+    size_t index = (size_t)(offset / ts->chunkBytes);
+    size_t within = (size_t)(offset % ts->chunkBytes);
+    uint64_t left = ts->length - offset;
+    size_t n = ts->chunkBytes - within;
+
+    if (n > left) n = (size_t)left;
+    *ptr = ts->chunks[index] + within;
+    return n;
+}
+
+size_t TakeStorageRead(const TakeStorage *ts, uint64_t offset, void *dst, size_t bytes) {
+    size_t total = 0;
+
+    while (total < bytes) {
+        const void *p;
+        size_t n = TakeStorageSpan(ts, offset + total, &p);
+        if (n == 0) break;
+        if (n > bytes - total) n = bytes - total;
+
+        memcpy((uint8_t *)dst + total, p, n);
+        total += n;
+    }
+    return total;
+}
+
+TakeSlice TakeStorageSlice(const TakeStorage *ts, uint64_t startFrame, uint64_t frameCount) {
+    TakeSlice slice = { ts, 0, 0 };
+    uint64_t total = TakeStorageFrames(ts);
+
+    if (startFrame > total) startFrame = total;
+    if (frameCount > total - startFrame) frameCount = total - startFrame;
+    slice.startFrame = startFrame;
+    slice.frameCount = frameCount;
+    return slice;
+}
+
+TakeSlice TakeSliceSub(const TakeSlice *slice, uint64_t startFrame, uint64_t frameCount) {
+    TakeSlice sub = *slice;
+
+    if (startFrame > slice->frameCount) startFrame = slice->frameCount;
+    if (frameCount > slice->frameCount - startFrame) frameCount = slice->frameCount - startFrame;
+    sub.startFrame = slice->startFrame + startFrame;
+    sub.frameCount = frameCount;
+    return sub;
+}
+
+void TakeIteratorInit(TakeIterator *it, const TakeSlice *slice) {
+    it->slice = *slice;
+    it->position = 0;
+}
+
+uint32_t TakeIteratorNext(TakeIterator *it, const void **ptr, uint32_t maxFrames) {
+    const TakeStorage *ts = it->slice.storage;
+    uint64_t left = it->slice.frameCount - it->position;
+
+    if (left == 0) return 0;
+
+    uint64_t offset = (it->slice.startFrame + it->position) * ts->frameBytes;
+    uint64_t frames = TakeStorageSpan(ts, offset, ptr) / ts->frameBytes;
+
+    if (frames > left) frames = left;
+    if (frames > maxFrames) frames = maxFrames;
+    it->position += frames;
+    return (uint32_t)frames;
+}
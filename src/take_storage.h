@@ -0,0 +1,78 @@
+// take_storage.h
+#ifndef TAKE_STORAGE_H
+#define TAKE_STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "platform.h"
+
+// Chunk slot size; each chunk holds the largest whole number of frames that fits
+#define TAKE_CHUNK_BYTES (4 * 1024 * 1024)
+// Chunks are carved out of regions of this many slots, allocated or mapped at once
+#define TAKE_REGION_CHUNKS 16
+#define TAKE_REGION_BYTES ((size_t)TAKE_CHUNK_BYTES * TAKE_REGION_CHUNKS)
+#define TAKE_TABLE_INITIAL 64
+
+// Append-only storage for a recorded take, held as a list of fixed-size chunks.
+// Appending is O(1) and never moves data that is already stored. Chunks come from
+// a pool of regions: with a spill path the regions are views of a scratch file, so
+// the OS can page cold audio out to disk; otherwise they come from the heap.
+// Chunks released by TakeStorageReset go back to the pool for the next take.
+typedef struct {
+    uint8_t **chunks;
+    size_t chunkCount;
+    size_t chunkCapacity;
+    size_t chunkBytes;            // Usable bytes per chunk, a multiple of frameBytes
+    uint32_t frameBytes;
+    uint64_t length;              // Bytes stored
+
+    // Pool
+    uint8_t **regions;
+    size_t regionCount;
+    size_t regionCapacity;
+    uint8_t **freeChunks;         // Stack of unused chunk slots
+    size_t freeCount;
+    size_t freeCapacity;
+
+    int fileBacked;
+    PlatformMappedFile file;
+} TakeStorage;
+
+// A range of frames in a take. Slices are views: making one copies nothing.
+typedef struct {
+    const TakeStorage *storage;
+    uint64_t startFrame;
+    uint64_t frameCount;
+} TakeSlice;
+
+// Walks a slice as a sequence of contiguous runs of whole frames.
+typedef struct {
+    TakeSlice slice;
+    uint64_t position;            // Frames already returned
+} TakeIterator;
+
+// spillPath may be NULL for heap chunks. Falls back to the heap if the file
+// cannot be created.
+int TakeStorageOpen(TakeStorage *ts, const char *spillPath, uint32_t frameBytes);
+void TakeStorageClose(TakeStorage *ts);
+// Discards the contents and returns every chunk to the pool.
+void TakeStorageReset(TakeStorage *ts);
+
+int TakeStorageAppend(TakeStorage *ts, const void *data, size_t bytes);
+uint64_t TakeStorageFrames(const TakeStorage *ts);
+
+// Returns the number of bytes readable contiguously at offset and points *ptr at them.
+// Spans never split a frame. Returns 0 at or past the end.
+size_t TakeStorageSpan(const TakeStorage *ts, uint64_t offset, const void **ptr);
+size_t TakeStorageRead(const TakeStorage *ts, uint64_t offset, void *dst, size_t bytes);
+
+// Clamps the range to the frames stored when the slice is made.
+TakeSlice TakeStorageSlice(const TakeStorage *ts, uint64_t startFrame, uint64_t frameCount);
+TakeSlice TakeSliceSub(const TakeSlice *slice, uint64_t startFrame, uint64_t frameCount);
+
+void TakeIteratorInit(TakeIterator *it, const TakeSlice *slice);
+// Points *ptr at up to maxFrames contiguous frames and advances past them.
+// Returns the number of frames, 0 at the end of the slice.
+uint32_t TakeIteratorNext(TakeIterator *it, const void **ptr, uint32_t maxFrames);
+
+#endif // TAKE_STORAGE_H
@@ -0,0 +1,117 @@
+// wav_reader.c
+#include <string.h>
+
+#include "wav_reader.h"
+#include "platform.h"
+
+static uint16_t GetLE16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t GetLE32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t GetLE64(const uint8_t *p) {
+    return (uint64_t)GetLE32(p) | ((uint64_t)GetLE32(p + 4) << 32);
+}
+
+static int ParseFmt(WavReader *r, const uint8_t *fmt, uint32_t size) {
+    if (size < 16) return -1;
+
+    r->format.formatTag = GetLE16(fmt);
+    r->format.channels = GetLE16(fmt + 2);
+    r->format.sampleRate = GetLE32(fmt + 4);
+    r->format.bitsPerSample = GetLE16(fmt + 14);
+
+    // WAVEFORMATEXTENSIBLE: the real tag is the first two bytes of the subformat GUID
+    if (r->format.formatTag == WAV_FORMAT_EXTENSIBLE) {
+        if (size < 40) return -1;
+        r->format.channelMask = GetLE32(fmt + 20);
+        r->format.formatTag = GetLE16(fmt + 24);
+    }
+
+    r->blockAlign = r->format.channels * (r->format.bitsPerSample / 8);
+    return r->blockAlign ? 0 : -1;
+}
+
+static int ParseChunks(WavReader *r) {
+    uint8_t header[12];
+    uint8_t chunk[8];
+    uint8_t payload[64];
+    uint64_t ds64DataSize = 0;
+    int haveFmt = 0;
+    int rf64;
+
+    if (fread(header, 1, 12, r->file) != 12) return -1;
+    if (memcmp(header + 8, "WAVE", 4) != 0) return -1;
+    if (memcmp(header, "RIFF", 4) == 0) rf64 = 0;
+    else if (memcmp(header, "RF64", 4) == 0) rf64 = 1;
+    else return -1;
+
+    while (fread(chunk, 1, 8, r->file) == 8) {
+        uint32_t size = GetLE32(chunk + 4);
+        int64_t next = PlatformFileTell(r->file) + size + (size & 1);
+
+        if (memcmp(chunk, "ds64", 4) == 0 && size >= 24) {
+            if (fread(payload, 1, 24, r->file) != 24) return -1;
+            ds64DataSize = GetLE64(payload + 8);
+        } else if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint32_t n = size < sizeof(payload) ? size : (uint32_t)sizeof(payload);
+            if (fread(payload, 1, n, r->file) != n) return -1;
+            if (ParseFmt(r, payload, n) != 0) return -1;
+            haveFmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFmt) return -1;
+            r->dataOffset = PlatformFileTell(r->file);
+            r->dataBytes = (rf64 && size == 0xFFFFFFFFu) ? ds64DataSize : size;
+            return 0;
+        }
+
+        if (PlatformFileSeek(r->file, next, SEEK_SET) != 0) return -1;
+    }
+    return -1;
+}
+
+int WavReaderOpen(WavReader *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+
+    r->file = fopen(path, "rb");
+    if (!r->file) return -1;
+
+    if (ParseChunks(r) != 0) {
+        WavReaderClose(r);
+        return -1;
+    }
+
+    // Files cut short by a crash still carry the last flushed (or placeholder) size
+    PlatformFileSeek(r->file, 0, SEEK_END);
+    uint64_t available = (uint64_t)(PlatformFileTell(r->file) - r->dataOffset);
+    if (r->dataBytes == 0 || r->dataBytes > available) r->dataBytes = available;
+
+    r->totalFrames = r->dataBytes / r->blockAlign;
+    return WavReaderSeek(r, 0);
+}
+
+uint32_t WavReaderRead(WavReader *r, void *frames, uint32_t maxFrames) {
+    uint64_t remaining = r->totalFrames - r->framePos;
+    uint32_t want = remaining < maxFrames ? (uint32_t)remaining : maxFrames;
+
+    if (want == 0) return 0;
+
+    size_t got = fread(frames, r->blockAlign, want, r->file);
+    r->framePos += got;
+    return (uint32_t)got;
+}
+
+int WavReaderSeek(WavReader *r, uint64_t frame) {
+    if (frame > r->totalFrames) frame = r->totalFrames;
+    if (PlatformFileSeek(r->file, r->dataOffset + (int64_t)(frame * r->blockAlign), SEEK_SET) != 0) return -1;
+    r->framePos = frame;
+    return 0;
+}
+
+void WavReaderClose(WavReader *r) {
+    if (r->file) fclose(r->file);
+    r->file = NULL;
+}
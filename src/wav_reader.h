@@ -0,0 +1,26 @@
+// wav_reader.h
+#ifndef WAV_READER_H
+#define WAV_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "wav_writer.h"
+
+// Reads RIFF and RF64 files, including ones whose header was never finalized:
+// a data chunk that claims more bytes than the file holds is clamped to the file.
+typedef struct {
+    FILE *file;
+    WavFormat format;
+    uint16_t blockAlign;
+    int64_t dataOffset;
+    uint64_t dataBytes;
+    uint64_t totalFrames;
+    uint64_t framePos;
+} WavReader;
+
+int WavReaderOpen(WavReader *r, const char *path);
+uint32_t WavReaderRead(WavReader *r, void *frames, uint32_t maxFrames);
+int WavReaderSeek(WavReader *r, uint64_t frame);
+void WavReaderClose(WavReader *r);
+
+#endif // WAV_READER_H
@@ -0,0 +1,282 @@
+// wav_writer.c
+#include <string.h>
+
+#include "wav_writer.h"
+#include "platform.h"
+
+#define RIFF_SIZE_OFFSET 4
+#define DS64_OFFSET 12
+#define FMT_PCM_SIZE 16
+#define FMT_EX_SIZE 18
+#define FMT_EXTENSIBLE_SIZE 40
+
+// KSDATAFORMAT_SUBTYPE_* GUIDs are the format tag followed by this fixed tail
+static const uint8_t SubFormatTail[12] = {
+    0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+static uint8_t *PutLE16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *PutLE32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+static uint8_t *PutTag(uint8_t *p, const char *tag) {
+    memcpy(p, tag, 4);
+    return p + 4;
+}
+
+static uint8_t *PutLE64(uint8_t *p, uint64_t v) {
+    p = PutLE32(p, (uint32_t)v);
+    return PutLE32(p, (uint32_t)(v >> 32));
+}
+
+// RIFF payload: everything after the 8-byte RIFF chunk header, plus a pad byte for odd data
+static uint64_t RiffPayloadSize(size_t headerLength, uint64_t dataSize) {
+    return headerLength - 8 + dataSize + (dataSize & 1);
+}
+
+// ds64 payload (EBU Tech 3306): RIFF size, data size, sample count, empty table
+static uint8_t *PutDs64(uint8_t *p, uint64_t riffSize, uint64_t dataSize, uint64_t sampleCount) {
+    p = PutTag(p, "ds64");
+    p = PutLE32(p, WAV_DS64_PAYLOAD);
+    p = PutLE64(p, riffSize);
+    p = PutLE64(p, dataSize);
+    p = PutLE64(p, sampleCount);
+    return PutLE32(p, 0);
+}
+
+static int NeedsExtensible(const WavFormat *format) {
+    if (format->channels > 2 || format->channelMask != 0) return 1;
+    return format->formatTag == WAV_FORMAT_PCM && format->bitsPerSample > 16;
+}
+
+// Default speaker masks (SPEAKER_FRONT_LEFT = 0x1 ...) for the usual layouts
+static uint32_t DefaultChannelMask(uint16_t channels) {
+    switch (channels) {
+    case 1: return 0x4;           // Front centre
+    case 2: return 0x3;
+    case 3: return 0x7;
+    case 4: return 0x33;          // Quad
+    case 5: return 0x37;
+    case 6: return 0x3F;          // 5.1
+    case 7: return 0x13F;
+    case 8: return 0x63F;         // 7.1
+    default: return 0;
+    }
+}
+
+// Builds the RIFF/fmt/data header into buf and returns its length.
+// With reserveDs64 a JUNK chunk the size of a ds64 chunk follows "WAVE", so the
+// file can be promoted to RF64 in place once it outgrows 32-bit sizes. Headers
+// whose data already exceeds the RIFF limit are written as RF64 directly.
+// Non-PCM formats carry the cbSize field, as the WAVEFORMATEX layout requires.
+static size_t BuildHeader(uint8_t *buf, const WavFormat *format, uint64_t dataSize,
+                          int reserveDs64, long *dataSizeOffset) {
+    uint16_t blockAlign = format->channels * (format->bitsPerSample / 8);
+    int extensible = NeedsExtensible(format);
+    uint32_t fmtSize = extensible ? FMT_EXTENSIBLE_SIZE
+                     : format->formatTag == WAV_FORMAT_PCM ? FMT_PCM_SIZE : FMT_EX_SIZE;
+    size_t length = 12 + 8 + fmtSize + 8;
+    uint8_t *p = buf;
+
+    if (RiffPayloadSize(length, dataSize) > WAV_RIFF_LIMIT) reserveDs64 = 1;
+    if (reserveDs64) length += 8 + WAV_DS64_PAYLOAD;
+
+    uint64_t riffSize = RiffPayloadSize(length, dataSize);
+    int rf64 = riffSize > WAV_RIFF_LIMIT;
+
+    p = PutTag(p, rf64 ? "RF64" : "RIFF");
+    p = PutLE32(p, rf64 ? 0xFFFFFFFFu : (uint32_t)riffSize);
+    p = PutTag(p, "WAVE");
+
+    if (rf64) {
+        p = PutDs64(p, riffSize, dataSize, blockAlign ? dataSize / blockAlign : 0);
+    } else if (reserveDs64) {
+        p = PutTag(p, "JUNK");
+        p = PutLE32(p, WAV_DS64_PAYLOAD);
+        memset(p, 0, WAV_DS64_PAYLOAD);
+        p += WAV_DS64_PAYLOAD;
+    }
+
+    p = PutTag(p, "fmt ");
+    p = PutLE32(p, fmtSize);
+    p = PutLE16(p, extensible ? WAV_FORMAT_EXTENSIBLE : format->formatTag);
+    p = PutLE16(p, format->channels);
+    p = PutLE32(p, format->sampleRate);
+    p = PutLE32(p, format->sampleRate * blockAlign);
+    p = PutLE16(p, blockAlign);
+    p = PutLE16(p, format->bitsPerSample);
+    if (fmtSize == FMT_EX_SIZE) p = PutLE16(p, 0);
+    if (extensible) {
+        p = PutLE16(p, FMT_EXTENSIBLE_SIZE - FMT_EX_SIZE);
+        p = PutLE16(p, format->bitsPerSample);
+        p = PutLE32(p, format->channelMask ? format->channelMask : DefaultChannelMask(format->channels));
+        p = PutLE32(p, format->formatTag);
+        memcpy(p, SubFormatTail, sizeof(SubFormatTail));
+        p += sizeof(SubFormatTail);
+    }
+
+    p = PutTag(p, "data");
+    if (dataSizeOffset) *dataSizeOffset = (long)(p - buf);
+    p = PutLE32(p, rf64 ? 0xFFFFFFFFu : (uint32_t)dataSize);
+
+    return (size_t)(p - buf);
+}
+
+static int WriteBytes(WavWriter *w, const void *bytes, size_t length) {
+    if (w->direct) return DiskWriterAppend(&w->disk, bytes, length);
+    return fwrite(bytes, 1, length, w->file) == length ? 0 : -1;
+}
+
+static int PatchBytes(WavWriter *w, long offset, const uint8_t *bytes, size_t length) {
+    if (w->direct) return DiskWriterPatch(&w->disk, (uint64_t)offset, bytes, length);
+    if (PlatformFileSeek(w->file, offset, SEEK_SET) != 0) return -1;
+    if (fwrite(bytes, 1, length, w->file) != length) return -1;
+    return 0;
+}
+
+int WavWriteHeader(FILE *file, const WavFormat *format, uint64_t dataSize) {
+    uint8_t header[WAV_MAX_HEADER];
+    size_t length = BuildHeader(header, format, dataSize, 0, NULL);
+
+    if (fwrite(header, 1, length, file) != length) return -1;
+    return 0;
+}
+
+static int OpenWriter(WavWriter *w, const char *path, const WavFormat *format, int direct) {
+    uint8_t header[WAV_MAX_HEADER];
+
+    memset(w, 0, sizeof(*w));
+    w->format = *format;
+    w->blockAlign = format->channels * (format->bitsPerSample / 8);
+    w->flushIntervalBytes = format->sampleRate * w->blockAlign * WAV_WRITER_FLUSH_SECONDS;
+
+    if (direct) {
+        if (DiskWriterOpen(&w->disk, path) != 0) return -1;
+        w->direct = 1;
+    } else {
+        w->file = fopen(path, "wb");
+        if (!w->file) return -1;
+    }
+
+    w->headerLength = BuildHeader(header, format, 0, 1, &w->dataSizeOffset);
+    if (WriteBytes(w, header, w->headerLength) != 0) {
+        if (direct) {
+            DiskWriterClose(&w->disk);
+        } else {
+            fclose(w->file);
+        }
+        w->file = NULL;
+        w->direct = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int WavWriterOpen(WavWriter *w, const char *path, const WavFormat *format) {
+    return OpenWriter(w, path, format, 0);
+}
+
+int WavWriterOpenDirect(WavWriter *w, const char *path, const WavFormat *format) {
+    return OpenWriter(w, path, format, 1);
+}
+
+// Rewrites the size fields to cover everything written so far. Once the RIFF
+// payload passes 4 GiB the reserved JUNK chunk becomes ds64 and the file RF64;
+// the 32-bit fields are then pinned to 0xFFFFFFFF as the spec requires.
+static int PatchSizes(WavWriter *w) {
+    uint8_t field[8 + WAV_DS64_PAYLOAD];
+    uint64_t riffSize = RiffPayloadSize(w->headerLength, w->dataBytes);
+
+    if (riffSize > WAV_RIFF_LIMIT) w->isRf64 = 1;
+
+    if (w->isRf64) {
+        uint8_t *p = PutTag(field, "RF64");
+        PutLE32(p, 0xFFFFFFFFu);
+        if (PatchBytes(w, 0, field, 8) != 0) return -1;
+
+        PutDs64(field, riffSize, w->dataBytes, w->dataBytes / w->blockAlign);
+        if (PatchBytes(w, DS64_OFFSET, field, sizeof(field)) != 0) return -1;
+
+        PutLE32(field, 0xFFFFFFFFu);
+        if (PatchBytes(w, w->dataSizeOffset, field, 4) != 0) return -1;
+    } else {
+        PutLE32(field, (uint32_t)riffSize);
+        if (PatchBytes(w, RIFF_SIZE_OFFSET, field, 4) != 0) return -1;
+
+        PutLE32(field, (uint32_t)w->dataBytes);
+        if (PatchBytes(w, w->dataSizeOffset, field, 4) != 0) return -1;
+    }
+
+    return w->direct ? 0 : PlatformFileSeek(w->file, 0, SEEK_END);
+}
+
+int WavWriterAppend(WavWriter *w, const void *frames, uint32_t frameCount) {
+    size_t bytes = (size_t)frameCount * w->blockAlign;
+
+    if (w->error) return -1;
+
+    if (WriteBytes(w, frames, bytes) != 0) {
+        w->error = 1;
+        return -1;
+    }
+    w->dataBytes += bytes;
+    w->bytesSinceFlush += bytes;
+
+    if (w->flushIntervalBytes && w->bytesSinceFlush >= w->flushIntervalBytes) {
+        // The disk writer writes in its own time; forcing a partial buffer out
+        // every interval would only shrink its writes
+        if (w->direct) {
+            w->bytesSinceFlush = 0;
+            if (PatchSizes(w) != 0) w->error = 1;
+            return w->error ? -1 : 0;
+        }
+        return WavWriterFlush(w);
+    }
+    return 0;
+}
+
+// Patches the size fields, then pushes everything to the OS.
+int WavWriterFlush(WavWriter *w) {
+    if (w->error) return -1;
+
+    if (PatchSizes(w) != 0 || (w->direct ? DiskWriterFlush(&w->disk) : fflush(w->file)) != 0) {
+        w->error = 1;
+        return -1;
+    }
+
+    w->bytesSinceFlush = 0;
+    return 0;
+}
+
+int WavWriterFinalize(WavWriter *w) {
+    int result = 0;
+
+    if (!w->file && !w->direct) return -1;
+
+    // Chunks are word aligned; an odd-sized data chunk needs a pad byte
+    if (!w->error && (w->dataBytes & 1)) {
+        uint8_t pad = 0;
+        if (WriteBytes(w, &pad, 1) != 0) w->error = 1;
+    }
+
+    if (WavWriterFlush(w) != 0) result = -1;
+    if (w->direct) {
+        if (DiskWriterClose(&w->disk) != 0) result = -1;
+        w->direct = 0;
+    } else if (fclose(w->file) != 0) {
+        result = -1;
+    }
+    w->file = NULL;
+
+    return result;
+}
@@ -0,0 +1,63 @@
+// wav_writer.h
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "disk_writer.h"
+
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_IEEE_FLOAT 0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+#define WAV_WRITER_FLUSH_SECONDS 1
+
+// Largest RIFF payload a 32-bit size field can describe; beyond it the writer switches to RF64
+#define WAV_RIFF_LIMIT 0xFFFFFFFFull
+#define WAV_DS64_PAYLOAD 28
+#define WAV_MAX_HEADER 128
+
+typedef struct {
+    uint16_t formatTag;
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint16_t bitsPerSample;
+    uint32_t channelMask;         // Speaker positions; 0 means the usual layout for the channel count
+} WavFormat;
+
+// Incremental WAV writer: open, append frames as they arrive, finalize.
+// Every flushIntervalBytes the RIFF and data sizes are patched and the stream
+// is flushed, so a crash leaves a readable file up to the last flush.
+// Takes larger than 4 GiB are promoted to RF64 automatically.
+// WavWriterOpenDirect streams through a DiskWriter instead of stdio: Append
+// only copies, and the periodic size patches ride out with the disk writer's
+// next buffer, so a crash loses at most the audio still queued.
+typedef struct {
+    FILE *file;
+    DiskWriter disk;
+    int direct;
+    WavFormat format;
+    uint16_t blockAlign;
+    uint64_t dataBytes;
+    uint64_t bytesSinceFlush;
+    uint64_t flushIntervalBytes;
+    size_t headerLength;
+    long dataSizeOffset;
+    int isRf64;
+    int error;
+} WavWriter;
+
+int WavWriterOpen(WavWriter *w, const char *path, const WavFormat *format);
+int WavWriterOpenDirect(WavWriter *w, const char *path, const WavFormat *format);
+int WavWriterAppend(WavWriter *w, const void *frames, uint32_t frameCount);
+int WavWriterFlush(WavWriter *w);
+int WavWriterFinalize(WavWriter *w);
+
+// Headers use WAVE_FORMAT_EXTENSIBLE, tagged by subformat, for more than two
+// channels or integer samples wider than 16 bits; plain PCM/float otherwise.
+
+// One-shot header for callers that already know the data size.
+// Emits RF64 with a ds64 chunk when dataSize does not fit a RIFF header.
+int WavWriteHeader(FILE *file, const WavFormat *format, uint64_t dataSize);
+
+#endif // WAV_WRITER_H
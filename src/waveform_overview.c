@@ -0,0 +1,225 @@
+// waveform_overview.c
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "waveform_overview.h"
+
+static uint64_t BucketFrames(int level) {
+    uint64_t frames = OVERVIEW_BASE_FRAMES;
+    for (int i = 0; i < level; ++i) frames *= OVERVIEW_FANOUT;
+    return frames;
+}
+
+static int16_t Quantize(float v) {
+    float scaled = v * 32767.0f;
+    if (scaled > 32767.0f) scaled = 32767.0f;
+    if (scaled < -32768.0f) scaled = -32768.0f;
+    return (int16_t)lrintf(scaled);
+}
+
+static void ClearPartial(WaveformOverview *o, OverviewLevel *lv) {
+    for (uint16_t ch = 0; ch < o->channels; ++ch) {
+        lv->partialMin[ch] = INFINITY;
+        lv->partialMax[ch] = -INFINITY;
+    }
+    lv->partialCount = 0;
+}
+
+// Stores the level's finished bucket, publishes it and merges it into the level above
+static void CommitBucket(WaveformOverview *o, int level) {
+    OverviewLevel *lv = &o->levels[level];
+    uint64_t index = atomic_load_explicit(&lv->buckets, memory_order_relaxed);
+    uint64_t page = index / OVERVIEW_PAGE_BUCKETS;
+    OverviewBucket *bucket;
+
+    if (page >= OVERVIEW_MAX_PAGES) {
+        o->full = 1;
+        return;
+    }
+    if (!lv->pages[page]) {
+        lv->pages[page] = (OverviewBucket *)malloc((size_t)OVERVIEW_PAGE_BUCKETS * o->channels * sizeof(OverviewBucket));
+        if (!lv->pages[page]) {
+            o->full = 1;
+            return;
+        }
+    }
+
+    bucket = lv->pages[page] + (index % OVERVIEW_PAGE_BUCKETS) * o->channels;
+    for (uint16_t ch = 0; ch < o->channels; ++ch) {
+        bucket[ch].min = Quantize(lv->partialMin[ch]);
+        bucket[ch].max = Quantize(lv->partialMax[ch]);
+    }
+    atomic_store_explicit(&lv->buckets, index + 1, memory_order_release);
+
+    if (level + 1 < OVERVIEW_LEVELS) {
+        OverviewLevel *up = &o->levels[level + 1];
+        for (uint16_t ch = 0; ch < o->channels; ++ch) {
+            if (lv->partialMin[ch] < up->partialMin[ch]) up->partialMin[ch] = lv->partialMin[ch];
+            if (lv->partialMax[ch] > up->partialMax[ch]) up->partialMax[ch] = lv->partialMax[ch];
+        }
+        if (++up->partialCount == OVERVIEW_FANOUT) CommitBucket(o, level + 1);
+    }
+    ClearPartial(o, lv);
+}
+
+// x = NULL adds silence
+static void AddFrames(WaveformOverview *o, const float *x, uint32_t frameCount) {
+    OverviewLevel *lv = &o->levels[0];
+
+    while (frameCount > 0 && !o->full) {
+        uint32_t n = OVERVIEW_BASE_FRAMES - lv->partialCount;
+        if (n > frameCount) n = frameCount;
+
+        if (x) {
+            for (uint32_t i = 0; i < n; ++i) {
+                for (uint16_t ch = 0; ch < o->channels; ++ch) {
+                    float v = *x++;
+                    if (v < lv->partialMin[ch]) lv->partialMin[ch] = v;
+                    if (v > lv->partialMax[ch]) lv->partialMax[ch] = v;
+                }
+            }
+        } else {
+            for (uint16_t ch = 0; ch < o->channels; ++ch) {
+                if (lv->partialMin[ch] > 0.0f) lv->partialMin[ch] = 0.0f;
+                if (lv->partialMax[ch] < 0.0f) lv->partialMax[ch] = 0.0f;
+            }
+        }
+
+        lv->partialCount += n;
+        frameCount -= n;
+        if (lv->partialCount == OVERVIEW_BASE_FRAMES) CommitBucket(o, 0);
+    }
+}
+
+int WaveformOverviewInit(WaveformOverview *o, const WavFormat *format) {
+    SampleFormat inSamples;
+    SampleFormat floatSamples;
+
+    memset(o, 0, sizeof(*o));
+    if (format->channels == 0 || format->channels > OVERVIEW_MAX_CHANNELS) return -1;
+    if (SampleFormatFromWav(format, &inSamples) != 0) return -1;
+
+    floatSamples = inSamples;
+    floatSamples.type = SAMPLE_F32;
+    SampleConverterInit(&o->toFloat, &inSamples, &floatSamples);
+    o->channels = format->channels;
+    o->sampleRate = format->sampleRate;
+
+    o->scratch = (float *)malloc((size_t)OVERVIEW_SCRATCH_FRAMES * o->channels * sizeof(float));
+    if (!o->scratch) return -1;
+    for (int level = 0; level < OVERVIEW_LEVELS; ++level) {
+        o->levels[level].pages = (OverviewBucket **)calloc(OVERVIEW_MAX_PAGES, sizeof(OverviewBucket *));
+        if (!o->levels[level].pages) {
+            WaveformOverviewClose(o);
+            return -1;
+        }
+    }
+    WaveformOverviewReset(o);
+    return 0;
+}
+
+void WaveformOverviewClose(WaveformOverview *o) {
+    for (int level = 0; level < OVERVIEW_LEVELS; ++level) {
+        OverviewLevel *lv = &o->levels[level];
+        if (!lv->pages) continue;
+        for (uint32_t page = 0; page < OVERVIEW_MAX_PAGES; ++page) free(lv->pages[page]);
+        free(lv->pages);
+        lv->pages = NULL;
+    }
+    free(o->scratch);
+    o->scratch = NULL;
+}
+
+void WaveformOverviewReset(WaveformOverview *o) {
+    for (int level = 0; level < OVERVIEW_LEVELS; ++level) {
+        atomic_store(&o->levels[level].buckets, 0);
+        ClearPartial(o, &o->levels[level]);
+    }
+    atomic_store(&o->frames, 0);
+    o->full = 0;
+}
+
+void WaveformOverviewAppend(WaveformOverview *o, const void *frames, uint32_t frameCount) {
+    const uint8_t *src = (const uint8_t *)frames;
+    uint32_t frameBytes = SampleFormatFrameBytes(&o->toFloat.in);
+
+    atomic_fetch_add(&o->frames, frameCount);
+    if (!src) {
+        AddFrames(o, NULL, frameCount);
+        return;
+    }
+    if (o->toFloat.in.type == SAMPLE_F32) {
+        AddFrames(o, (const float *)src, frameCount);
+        return;
+    }
+
+    while (frameCount > 0) {
+        uint32_t n = frameCount < OVERVIEW_SCRATCH_FRAMES ? frameCount : OVERVIEW_SCRATCH_FRAMES;
+        SampleConverterRun(&o->toFloat, o->scratch, src, n, NULL);
+        AddFrames(o, o->scratch, n);
+        src += (size_t)n * frameBytes;
+        frameCount -= n;
+    }
+}
+
+uint64_t WaveformOverviewFrames(WaveformOverview *o) {
+    return atomic_load(&o->frames);
+}
+
+// Merges frames [from, to) into lo/hi from the given level, taking the tail
+// past its last complete bucket from the finer levels below
+static void MergeRange(WaveformOverview *o, int level, uint64_t from, uint64_t to, int16_t *lo, int16_t *hi) {
+    OverviewLevel *lv = &o->levels[level];
+    uint64_t bucketFrames = BucketFrames(level);
+    uint64_t available = atomic_load_explicit(&lv->buckets, memory_order_acquire);
+    uint64_t first = from / bucketFrames;
+    uint64_t last = (to - 1) / bucketFrames;
+
+    if (last >= available) {
+        uint64_t covered = available * bucketFrames;
+        if (level > 0 && to > covered) MergeRange(o, level - 1, from > covered ? from : covered, to, lo, hi);
+        if (first >= available) return;
+        last = available - 1;
+    }
+
+    for (uint64_t b = first; b <= last; ++b) {
+        const OverviewBucket *bucket = lv->pages[b / OVERVIEW_PAGE_BUCKETS] + (b % OVERVIEW_PAGE_BUCKETS) * o->channels;
+        for (uint16_t ch = 0; ch < o->channels; ++ch) {
+            if (bucket[ch].min < *lo) *lo = bucket[ch].min;
+            if (bucket[ch].max > *hi) *hi = bucket[ch].max;
+        }
+    }
+}
+
+uint32_t WaveformOverviewColumns(WaveformOverview *o, uint64_t startFrame, uint64_t frameCount,
+                                 uint32_t columns, float *mins, float *maxs) {
+    double perColumn = columns ? (double)frameCount / columns : 0.0;
+    uint64_t frames = atomic_load(&o->frames);
+    int level = 0;
+    uint32_t filled = 0;
+
+    memset(mins, 0, columns * sizeof(float));
+    memset(maxs, 0, columns * sizeof(float));
+    if (perColumn <= 0.0) return 0;
+
+    while (level + 1 < OVERVIEW_LEVELS && (double)BucketFrames(level + 1) <= perColumn) level++;
+
+    for (uint32_t c = 0; c < columns; ++c) {
+        uint64_t from = startFrame + (uint64_t)(c * perColumn);
+        uint64_t to = startFrame + (uint64_t)((c + 1) * perColumn);
+        int16_t lo = INT16_MAX;
+        int16_t hi = INT16_MIN;
+
+        if (to <= from) to = from + 1;
+        if (from >= frames) break;
+        MergeRange(o, level, from, to, &lo, &hi);
+        // Only audio still in level 0's partial bucket; nothing to draw yet
+        if (lo > hi) break;
+
+        mins[c] = lo / 32767.0f;
+        maxs[c] = hi / 32767.0f;
+        filled = c + 1;
+    }
+    return filled;
+}
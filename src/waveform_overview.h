@@ -0,0 +1,65 @@
+// waveform_overview.h
+#ifndef WAVEFORM_OVERVIEW_H
+#define WAVEFORM_OVERVIEW_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "sample_convert.h"
+#include "wav_writer.h"
+
+#define OVERVIEW_MAX_CHANNELS 8
+#define OVERVIEW_BASE_FRAMES 256          // Frames per bucket at level 0
+#define OVERVIEW_FANOUT 4                 // Buckets merged into one at the next level
+#define OVERVIEW_LEVELS 8
+#define OVERVIEW_PAGE_BUCKETS 4096
+#define OVERVIEW_MAX_PAGES 4096           // Level 0 covers 2^32 frames, about 24 h at 48 kHz
+#define OVERVIEW_SCRATCH_FRAMES 1024
+
+// Min and max of one channel over a bucket, scaled to int16.
+typedef struct {
+    int16_t min;
+    int16_t max;
+} OverviewBucket;
+
+typedef struct {
+    OverviewBucket **pages;       // OVERVIEW_PAGE_BUCKETS buckets per channel each
+    atomic_uint_fast64_t buckets; // Complete buckets, counted only once written
+    float partialMin[OVERVIEW_MAX_CHANNELS];
+    float partialMax[OVERVIEW_MAX_CHANNELS];
+    uint32_t partialCount;        // Frames (level 0) or buckets merged so far
+} OverviewLevel;
+
+// Min/max pyramid of a take for drawing waveforms at any zoom. Level n has
+// one bucket per OVERVIEW_BASE_FRAMES * OVERVIEW_FANOUT^n frames. Append is
+// incremental: each finished bucket is merged into the level above, so
+// growing the take never rescans audio. Buckets live in fixed pages that
+// never move, and a level's count is published only after its bucket is
+// written, so one thread may append while another draws.
+typedef struct {
+    uint16_t channels;
+    uint32_t sampleRate;
+    SampleConverter toFloat;
+    float *scratch;
+    OverviewLevel levels[OVERVIEW_LEVELS];
+    atomic_uint_fast64_t frames;
+    int full;                     // Out of pages or memory; later audio is not added
+} WaveformOverview;
+
+int WaveformOverviewInit(WaveformOverview *o, const WavFormat *format);
+void WaveformOverviewClose(WaveformOverview *o);
+// Starts a new take in the same format, keeping the pages. Not safe while drawing.
+void WaveformOverviewReset(WaveformOverview *o);
+// frames are interleaved samples in the format given to Init; NULL appends silence.
+void WaveformOverviewAppend(WaveformOverview *o, const void *frames, uint32_t frameCount);
+uint64_t WaveformOverviewFrames(WaveformOverview *o);
+
+// Fills one min/max pair per column, merged over channels and scaled to
+// [-1, 1], for frames [startFrame, startFrame + frameCount). Reads the
+// coarsest level whose buckets still fit in a column, and finer levels for
+// the tail past its last complete bucket. The newest frames, less than one
+// base bucket, show once that bucket completes. Returns how many leading
+// columns have audio; the rest are left at zero.
+uint32_t WaveformOverviewColumns(WaveformOverview *o, uint64_t startFrame, uint64_t frameCount,
+                                 uint32_t columns, float *mins, float *maxs);
+
+#endif // WAVEFORM_OVERVIEW_H